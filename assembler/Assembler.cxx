@@ -0,0 +1,928 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "Assembler.h"
+#include "AssemblerDSPIC.h"
+#include "AssemblerMIPS.h"
+#include "AssemblerMSP430.h"
+
+// Returns NULL for a cpu_name there's no assembler for
+Assembler *new_assembler(const char *cpu_name)
+{
+  if (strcasecmp("msp430g2231", cpu_name) == 0 ||
+      strcasecmp("msp430g2553", cpu_name) == 0 ||
+      strcasecmp("msp430x", cpu_name) == 0 ||
+      strcasecmp("msp430fr5969", cpu_name) == 0)
+  {
+    return new AssemblerMSP430();
+  }
+
+  if (strcasecmp("dspic30f3012", cpu_name) == 0 ||
+      strcasecmp("dspic33fj06gs101a", cpu_name) == 0)
+  {
+    return new AssemblerDSPIC();
+  }
+
+  if (strcasecmp("pic32mx250f128b", cpu_name) == 0 ||
+      strcasecmp("pic32mx795f512l", cpu_name) == 0)
+  {
+    return new AssemblerMIPS();
+  }
+
+  return NULL;
+}
+
+Assembler::Assembler() :
+  address(0),
+  pass(1),
+  line(0),
+  filename(""),
+  pages(NULL),
+  symbols(NULL),
+  symbol_count(0),
+  symbol_max(0),
+  block_start(0),
+  eval_uses_label(false),
+  eval_extern(-1),
+  relocatable(false),
+  relocs(NULL),
+  reloc_count(0),
+  reloc_max(0),
+  errors(0)
+{
+}
+
+Assembler::~Assembler()
+{
+  while (pages != NULL)
+  {
+    assembler_page_t *next = pages->next;
+    free(pages);
+    pages = next;
+  }
+
+  free(symbols);
+  free(relocs);
+}
+
+int Assembler::assemble(const char *filename)
+{
+FILE *in;
+char text[1024];
+int n;
+
+  this->filename = filename;
+
+  in = fopen(filename, "rb");
+
+  if (in == NULL)
+  {
+    printf("Couldn't open file %s\n", filename);
+    return -1;
+  }
+
+  for (n = 1; n <= 2; n++)
+  {
+    fseek(in, 0, SEEK_SET);
+    begin_pass(n);
+
+    while(fgets(text, sizeof(text), in) != NULL)
+    {
+      add_line(text);
+    }
+
+    if (end_pass() != 0) { break; }
+  }
+
+  fclose(in);
+
+  return errors == 0 ? 0 : -1;
+}
+
+// Lines can also be handed over one at a time (java_grinder does this
+// from its instruction list) as long as every line is given for both
+// passes.
+void Assembler::begin_pass(int pass)
+{
+  this->pass = pass;
+  address = 0;
+  line = 0;
+}
+
+void Assembler::add_line(const char *text)
+{
+char copy[1024];
+
+  line++;
+
+  strncpy(copy, text, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = 0;
+
+  assemble_line(copy);
+}
+
+int Assembler::end_pass()
+{
+  end_block();
+
+  return errors == 0 ? 0 : -1;
+}
+
+// Intel HEX with an extended linear address record whenever the upper
+// 16 bits of the address change.  Only bytes that were written go in.
+int Assembler::write_hex(const char *filename)
+{
+FILE *out;
+assembler_page_t *page;
+uint32_t address = 0;
+uint32_t upper = 0;
+uint8_t checksum;
+int offset, length, n;
+
+  out = fopen(filename, "wb");
+
+  if (out == NULL)
+  {
+    printf("Couldn't open file %s for writing.\n", filename);
+    return -1;
+  }
+
+  while ((page = next_page(address)) != NULL)
+  {
+    offset = 0;
+
+    while (offset < ASSEMBLER_PAGE_SIZE)
+    {
+      if ((page->used[offset / 8] & (1 << (offset % 8))) == 0)
+      {
+        offset++;
+        continue;
+      }
+
+      address = page->address + offset;
+
+      if ((address >> 16) != upper)
+      {
+        upper = address >> 16;
+        checksum = 2 + 4 + (upper >> 8) + (upper & 0xff);
+        fprintf(out, ":02000004%04X%02X\n", upper, (uint8_t)-checksum);
+      }
+
+      // Records stop at a gap, after 16 bytes or at a 64k boundary
+      for (length = 0; length < 16 && offset + length < ASSEMBLER_PAGE_SIZE; length++)
+      {
+        n = offset + length;
+        if ((page->used[n / 8] & (1 << (n % 8))) == 0) { break; }
+        if (length != 0 && ((address + length) & 0xffff) == 0) { break; }
+      }
+
+      checksum = length + ((address >> 8) & 0xff) + (address & 0xff);
+      fprintf(out, ":%02X%04X00", length, address & 0xffff);
+
+      for (n = 0; n < length; n++)
+      {
+        fprintf(out, "%02X", page->data[offset + n]);
+        checksum += page->data[offset + n];
+      }
+
+      fprintf(out, "%02X\n", (uint8_t)-checksum);
+
+      offset += length;
+    }
+
+    address = page->address + ASSEMBLER_PAGE_SIZE;
+    if (address == 0) { break; }
+  }
+
+  fprintf(out, ":00000001FF\n");
+  fclose(out);
+
+  return 0;
+}
+
+// Raw image from the lowest to the highest byte written with any gaps
+// filled with 0xff (erased flash).
+int Assembler::write_bin(const char *filename)
+{
+FILE *out;
+assembler_page_t *page;
+uint32_t start = 0, end = 0, address;
+bool found = false;
+int data;
+
+  for (page = pages; page != NULL; page = page->next)
+  {
+    for (address = page->address; address < page->address + ASSEMBLER_PAGE_SIZE; address++)
+    {
+      if (read8(address) == -1) { continue; }
+      if (!found || address < start) { start = address; }
+      if (!found || address >= end) { end = address + 1; }
+      found = true;
+    }
+  }
+
+  out = fopen(filename, "wb");
+
+  if (out == NULL)
+  {
+    printf("Couldn't open file %s for writing.\n", filename);
+    return -1;
+  }
+
+  for (address = start; address < end; address++)
+  {
+    data = read8(address);
+    putc(data == -1 ? 0xff : data, out);
+  }
+
+  fclose(out);
+
+  return 0;
+}
+
+int Assembler::read8(uint32_t address)
+{
+assembler_page_t *page;
+uint32_t offset;
+
+  for (page = pages; page != NULL; page = page->next)
+  {
+    if (address < page->address) { continue; }
+
+    offset = address - page->address;
+    if (offset >= ASSEMBLER_PAGE_SIZE) { continue; }
+
+    if ((page->used[offset / 8] & (1 << (offset % 8))) == 0) { return -1; }
+
+    return page->data[offset];
+  }
+
+  return -1;
+}
+
+bool Assembler::get_symbol(const char *name, uint32_t *value)
+{
+assembler_symbol_t *symbol = lookup(name);
+
+  if (symbol == NULL) { return false; }
+
+  *value = symbol->value;
+
+  return true;
+}
+
+const char *Assembler::find_label(uint32_t address)
+{
+int n;
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (symbols[n].is_label && symbols[n].value == address)
+    {
+      return symbols[n].name;
+    }
+  }
+
+  return NULL;
+}
+
+// Returns where the function at address ends: the next label that isn't
+// one of its own or the end of the .org block.  java_grinder names the
+// labels inside a method <method>_<pc>, loop labels label_<n> and the
+// runtime helpers' internal labels _<helper><n>.
+uint32_t Assembler::get_code_end(uint32_t address)
+{
+const char *function = NULL;
+const char *name;
+uint32_t end = address;
+int n;
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label) { continue; }
+
+    if (function == NULL)
+    {
+      if (symbols[n].value != address) { continue; }
+
+      function = symbols[n].name;
+      end = symbols[n].end;
+      continue;
+    }
+
+    if (symbols[n].value < address || symbols[n].value >= end) { break; }
+
+    name = symbols[n].name;
+
+    if (is_local_label(name, function)) { continue; }
+
+    // start: and main: can both be at the same address
+    if (symbols[n].value == address)
+    {
+      function = name;
+      continue;
+    }
+
+    return symbols[n].value;
+  }
+
+  return end;
+}
+
+bool Assembler::is_local_label(const char *name, const char *function)
+{
+int length = strlen(function);
+
+  if (strncmp(name, function, length) == 0 && name[length] == '_') { return true; }
+  if (strncmp(name, "label_", 6) == 0) { return true; }
+
+  if (function[0] == '_' && name[0] == '_' && isdigit(name[strlen(name) - 1]))
+  {
+    return true;
+  }
+
+  return false;
+}
+
+int Assembler::eval(const char *expr, int32_t *value, bool *uses_label)
+{
+const char *s = expr;
+
+  eval_uses_label = false;
+  eval_extern = -1;
+
+  if (eval_or(&s, value) != 0) { return -1; }
+
+  while (*s == ' ' || *s == '\t') { s++; }
+
+  if (*s != 0)
+  {
+    error("Bad expression");
+    return -1;
+  }
+
+  if (uses_label != NULL) { *uses_label = eval_uses_label; }
+
+  return 0;
+}
+
+void Assembler::define(const char *name, uint32_t value)
+{
+assembler_symbol_t *symbol = lookup(name);
+
+  if (symbol != NULL)
+  {
+    symbol->value = value;
+    return;
+  }
+
+  if (symbol_count == symbol_max)
+  {
+    symbol_max += 256;
+    symbols = (assembler_symbol_t *)realloc(symbols, symbol_max * sizeof(assembler_symbol_t));
+  }
+
+  strncpy(symbols[symbol_count].name, name, sizeof(symbols[0].name) - 1);
+  symbols[symbol_count].name[sizeof(symbols[0].name) - 1] = 0;
+  symbols[symbol_count].value = value;
+  symbols[symbol_count].end = value;
+  symbols[symbol_count].is_label = false;
+  symbols[symbol_count].is_extern = false;
+  symbols[symbol_count].is_global = false;
+  symbol_count++;
+}
+
+void Assembler::write8(uint32_t address, uint8_t data)
+{
+assembler_page_t *page;
+uint32_t base = address - (address % ASSEMBLER_PAGE_SIZE);
+uint32_t offset = address - base;
+
+  // Only the second pass has all the labels right
+  if (pass != 2) { return; }
+
+  for (page = pages; page != NULL; page = page->next)
+  {
+    if (page->address == base) { break; }
+  }
+
+  if (page == NULL)
+  {
+    page = (assembler_page_t *)malloc(sizeof(assembler_page_t));
+    memset(page, 0, sizeof(assembler_page_t));
+    page->address = base;
+    page->next = pages;
+    pages = page;
+  }
+
+  if ((page->used[offset / 8] & (1 << (offset % 8))) != 0)
+  {
+    printf("Warning: %s:%d overwrites address 0x%04x\n", filename, line, address);
+  }
+
+  page->data[offset] = data;
+  page->used[offset / 8] |= 1 << (offset % 8);
+}
+
+// Only kept in pass 2 of relocatable output
+void Assembler::add_reloc(uint32_t address, int type, int32_t value, int symbol, bool pc_relative)
+{
+  if (pass != 2 || !relocatable) { return; }
+
+  if (reloc_count == reloc_max)
+  {
+    reloc_max += 256;
+    relocs = (assembler_reloc_t *)realloc(relocs, reloc_max * sizeof(assembler_reloc_t));
+  }
+
+  relocs[reloc_count].address = address;
+  relocs[reloc_count].type = type;
+  relocs[reloc_count].symbol = symbol;
+  relocs[reloc_count].value = value;
+  relocs[reloc_count].pc_relative = pc_relative;
+  reloc_count++;
+}
+
+void Assembler::error(const char *message)
+{
+  printf("Error: %s:%d %s\n", filename, line, message);
+  errors++;
+}
+
+int Assembler::assemble_line(char *text)
+{
+char *operands[ASSEMBLER_MAX_OPERANDS];
+char *instr;
+char *s;
+int count = 0;
+int depth = 0;
+bool in_quote = false;
+
+  // Strip the comment and end of line
+  for (s = text; *s != 0; s++)
+  {
+    if (*s == '"') { in_quote = !in_quote; }
+    if ((*s == ';' && !in_quote) || *s == '\n' || *s == '\r') { *s = 0; break; }
+  }
+
+  s = text;
+  while (*s == ' ' || *s == '\t') { s++; }
+  if (*s == 0) { return 0; }
+
+  instr = s;
+  while (*s != 0 && *s != ' ' && *s != '\t') { s++; }
+
+  if (s[-1] == ':')
+  {
+    s[-1] = 0;
+    if (set_label(instr) != 0) { return -1; }
+    if (*s == 0) { return 0; }
+    return assemble_line(s + 1);
+  }
+
+  if (*s != 0) { *s++ = 0; }
+
+  for (char *c = instr; *c != 0; c++) { *c = tolower(*c); }
+
+  // Split operands on commas that aren't inside () or quotes
+  while (*s == ' ' || *s == '\t') { s++; }
+
+  if (*s != 0)
+  {
+    operands[count++] = s;
+
+    for ( ; *s != 0; s++)
+    {
+      if (*s == '"') { in_quote = !in_quote; }
+      if (in_quote) { continue; }
+      if (*s == '(') { depth++; }
+      if (*s == ')') { depth--; }
+
+      if (*s == ',' && depth == 0)
+      {
+        if (count == ASSEMBLER_MAX_OPERANDS)
+        {
+          error("Too many operands");
+          return -1;
+        }
+
+        *s = 0;
+        operands[count++] = s + 1;
+      }
+    }
+  }
+
+  for (int n = 0; n < count; n++)
+  {
+    while (*operands[n] == ' ' || *operands[n] == '\t') { operands[n]++; }
+
+    s = operands[n] + strlen(operands[n]);
+    while (s != operands[n] && (s[-1] == ' ' || s[-1] == '\t')) { *--s = 0; }
+  }
+
+  if (strcmp(instr, ".org") == 0)
+  {
+    int32_t value;
+
+    if (count != 1) { error(".org takes one operand"); return -1; }
+    if (relocatable) { error(".org in relocatable output"); return -1; }
+    if (eval(operands[0], &value, NULL) != 0) { return -1; }
+
+    end_block();
+    address = value;
+
+    return 0;
+  }
+
+  if (strcmp(instr, ".include") == 0)
+  {
+    char name[256];
+
+    if (count != 1) { error(".include takes one operand"); return -1; }
+
+    s = operands[0];
+    if (*s == '"') { s++; }
+    strncpy(name, s, sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+    s = name + strlen(name);
+    if (s != name && s[-1] == '"') { s[-1] = 0; }
+
+    if (include(name) != 0)
+    {
+      error("Unknown include file");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  if (strcmp(instr, ".equ") == 0 || strcmp(instr, ".define") == 0)
+  {
+    int32_t value;
+
+    if (count != 2) { error(".equ takes two operands"); return -1; }
+    if (eval(operands[1], &value, NULL) != 0) { return -1; }
+
+    define(operands[0], value);
+
+    return 0;
+  }
+
+  // The label can come after it so it's only looked up in pass 2
+  if (strcmp(instr, ".global") == 0)
+  {
+    assembler_symbol_t *symbol;
+
+    if (count != 1) { error(".global takes one operand"); return -1; }
+    if (pass != 2) { return 0; }
+
+    symbol = lookup(operands[0]);
+
+    if (symbol == NULL || !symbol->is_label)
+    {
+      error("Unknown label");
+      return -1;
+    }
+
+    symbol->is_global = true;
+
+    return 0;
+  }
+
+  if (instr[0] == '.' || strcmp(instr, "db") == 0 || strcmp(instr, "dw") == 0 ||
+      strncmp(instr, "dc", 2) == 0)
+  {
+    int ret = directive(instr, operands, count);
+
+    if (ret == -1)
+    {
+      error("Unknown directive");
+    }
+
+    return ret;
+  }
+
+  return instruction(instr, operands, count);
+}
+
+int Assembler::set_label(const char *name)
+{
+assembler_symbol_t *symbol = lookup(name);
+
+  if (pass == 1)
+  {
+    if (symbol != NULL)
+    {
+      error("Label defined twice");
+      return -1;
+    }
+
+    define(name, address);
+    lookup(name)->is_label = true;
+
+    return 0;
+  }
+
+  // Once something failed to assemble the addresses are off anyway
+  if (errors != 0) { return 0; }
+
+  if (symbol == NULL || symbol->value != address)
+  {
+    error("Label moved between passes");
+    return -1;
+  }
+
+  return 0;
+}
+
+// Labels only get defined in pass 1 so that's when the end of each
+// .org block gets filled in.
+void Assembler::end_block()
+{
+int n;
+
+  if (pass != 1) { return; }
+
+  for (n = block_start; n < symbol_count; n++)
+  {
+    symbols[n].end = address;
+  }
+
+  block_start = symbol_count;
+}
+
+// Operator precedence follows C: | ^ & << >> + - * / % unary
+int Assembler::eval_or(const char **s, int32_t *value)
+{
+int32_t rhs;
+
+  if (eval_xor(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != '|') { return 0; }
+    (*s)++;
+    if (eval_xor(s, &rhs) != 0) { return -1; }
+    *value |= rhs;
+  }
+}
+
+int Assembler::eval_xor(const char **s, int32_t *value)
+{
+int32_t rhs;
+
+  if (eval_and(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != '^') { return 0; }
+    (*s)++;
+    if (eval_and(s, &rhs) != 0) { return -1; }
+    *value ^= rhs;
+  }
+}
+
+int Assembler::eval_and(const char **s, int32_t *value)
+{
+int32_t rhs;
+
+  if (eval_shift(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != '&') { return 0; }
+    (*s)++;
+    if (eval_shift(s, &rhs) != 0) { return -1; }
+    *value &= rhs;
+  }
+}
+
+int Assembler::eval_shift(const char **s, int32_t *value)
+{
+int32_t rhs;
+char op;
+
+  if (eval_add(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (((*s)[0] != '<' && (*s)[0] != '>') || (*s)[1] != (*s)[0]) { return 0; }
+    op = **s;
+    (*s) += 2;
+    if (eval_add(s, &rhs) != 0) { return -1; }
+    if (op == '<') { *value = (uint32_t)*value << rhs; }
+    else { *value >>= rhs; }
+  }
+}
+
+int Assembler::eval_add(const char **s, int32_t *value)
+{
+int32_t rhs;
+char op;
+
+  if (eval_mul(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != '+' && **s != '-') { return 0; }
+    op = **s;
+    (*s)++;
+    if (eval_mul(s, &rhs) != 0) { return -1; }
+    if (op == '+') { *value += rhs; }
+    else { *value -= rhs; }
+  }
+}
+
+int Assembler::eval_mul(const char **s, int32_t *value)
+{
+int32_t rhs;
+char op;
+
+  if (eval_unary(s, value) != 0) { return -1; }
+
+  while (1)
+  {
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != '*' && **s != '/' && **s != '%') { return 0; }
+    op = **s;
+    (*s)++;
+    if (eval_unary(s, &rhs) != 0) { return -1; }
+    if (op == '*') { *value *= rhs; continue; }
+    if (rhs == 0) { error("Divide by zero"); return -1; }
+    if (op == '/') { *value /= rhs; }
+    else { *value %= rhs; }
+  }
+}
+
+int Assembler::eval_unary(const char **s, int32_t *value)
+{
+char token[64];
+int len = 0;
+
+  while (**s == ' ' || **s == '\t') { (*s)++; }
+
+  if (**s == '-')
+  {
+    (*s)++;
+    if (eval_unary(s, value) != 0) { return -1; }
+    *value = -*value;
+    return 0;
+  }
+
+  if (**s == '~')
+  {
+    (*s)++;
+    if (eval_unary(s, value) != 0) { return -1; }
+    *value = ~*value;
+    return 0;
+  }
+
+  if (**s == '(')
+  {
+    (*s)++;
+    if (eval_or(s, value) != 0) { return -1; }
+    while (**s == ' ' || **s == '\t') { (*s)++; }
+    if (**s != ')') { error("Missing )"); return -1; }
+    (*s)++;
+    return 0;
+  }
+
+  if (**s == '$' && !isalnum((*s)[1]) && (*s)[1] != '_')
+  {
+    (*s)++;
+    *value = address;
+    return 0;
+  }
+
+  while (isalnum(**s) || **s == '_' || **s == '.' || **s == '$')
+  {
+    if (len == sizeof(token) - 1) { error("Token too long"); return -1; }
+    token[len++] = *(*s)++;
+  }
+
+  token[len] = 0;
+
+  if (len == 0)
+  {
+    error("Bad expression");
+    return -1;
+  }
+
+  if (isdigit(token[0]))
+  {
+    char *end;
+
+    // 0x1234, 0b1010, 1234 and the 0FFFFh form
+    if (token[len - 1] == 'h' || token[len - 1] == 'H')
+    {
+      token[len - 1] = 0;
+      *value = strtoul(token, &end, 16);
+    }
+      else
+    if (token[0] == '0' && (token[1] == 'b' || token[1] == 'B'))
+    {
+      *value = strtoul(token + 2, &end, 2);
+    }
+      else
+    {
+      *value = strtoul(token, &end, 0);
+    }
+
+    if (*end != 0)
+    {
+      error("Bad number");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  assembler_symbol_t *symbol = lookup(token);
+
+  if (symbol == NULL)
+  {
+    // Has to be a label further down
+    if (pass == 1)
+    {
+      eval_uses_label = true;
+      *value = 0;
+      return 0;
+    }
+
+    // or something the linker will find
+    if (relocatable)
+    {
+      define(token, 0);
+      symbol = lookup(token);
+      symbol->is_extern = true;
+    }
+  }
+
+  if (symbol == NULL)
+  {
+    char message[128];
+    snprintf(message, sizeof(message), "Undefined symbol '%s'", token);
+    error(message);
+    return -1;
+  }
+
+  if (symbol->is_label) { eval_uses_label = true; }
+
+  if (symbol->is_extern)
+  {
+    eval_uses_label = true;
+    eval_extern = symbol - symbols;
+  }
+
+  *value = symbol->value;
+
+  return 0;
+}
+
+// Page with the lowest address at or above address
+assembler_page_t *Assembler::next_page(uint32_t address)
+{
+assembler_page_t *page;
+assembler_page_t *found = NULL;
+
+  for (page = pages; page != NULL; page = page->next)
+  {
+    if (page->address < address) { continue; }
+    if (found == NULL || page->address < found->address) { found = page; }
+  }
+
+  return found;
+}
+
+assembler_symbol_t *Assembler::lookup(const char *name)
+{
+int n;
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (strcmp(symbols[n].name, name) == 0) { return &symbols[n]; }
+  }
+
+  return NULL;
+}
+
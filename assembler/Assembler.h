@@ -0,0 +1,129 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _ASSEMBLER_H
+#define _ASSEMBLER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Two pass assembler for the .asm files the generators write.  It only
+// knows the syntax and directives java_grinder emits, not everything
+// naken_asm does.  Each CPU subclass encodes instructions and fills in
+// the symbols its .include files would normally define.
+
+#define ASSEMBLER_PAGE_SIZE 4096
+#define ASSEMBLER_MAX_OPERANDS 4
+
+struct assembler_page_t
+{
+  uint32_t address;
+  uint8_t data[ASSEMBLER_PAGE_SIZE];
+  uint8_t used[ASSEMBLER_PAGE_SIZE / 8];
+  assembler_page_t *next;
+};
+
+struct assembler_symbol_t
+{
+  char name[64];
+  uint32_t value;
+  uint32_t end;         // location counter at the end of the label's .org block
+  bool is_label;
+  bool is_extern;       // used but not defined in relocatable mode
+  bool is_global;       // .global, exported from relocatable output
+};
+
+// A word that has to be fixed up when the code is linked.  value is
+// what the expression came to (the offset from symbol for an extern).
+struct assembler_reloc_t
+{
+  uint32_t address;
+  int type;             // ELF relocation type
+  int symbol;           // index of an extern symbol or -1
+  int32_t value;
+  bool pc_relative;
+};
+
+class Assembler
+{
+public:
+  Assembler();
+  virtual ~Assembler();
+
+  int assemble(const char *filename);
+  void begin_pass(int pass);
+  void add_line(const char *text);
+  int end_pass();
+  int get_error_count() { return errors; }
+  void set_filename(const char *filename) { this->filename = filename; }
+  void set_relocatable() { relocatable = true; }
+  bool is_relocatable() { return relocatable; }
+  virtual int get_elf_machine() { return -1; }
+  assembler_symbol_t *get_symbols(int *count) { *count = symbol_count; return symbols; }
+  assembler_reloc_t *get_relocs(int *count) { *count = reloc_count; return relocs; }
+  bool is_local_label(const char *name, const char *function);
+  int write_hex(const char *filename);
+  int write_bin(const char *filename);
+  int read8(uint32_t address);
+  bool get_symbol(const char *name, uint32_t *value);
+  const char *find_label(uint32_t address);
+  uint32_t get_code_end(uint32_t address);
+  assembler_page_t *get_pages() { return pages; }
+
+protected:
+  virtual int instruction(char *instr, char *operands[], int count) = 0;
+  virtual int include(const char *filename) { return -1; }
+  virtual int directive(char *name, char *operands[], int count) { return -1; }
+
+  int eval(const char *expr, int32_t *value, bool *uses_label);
+  void define(const char *name, uint32_t value);
+  void write8(uint32_t address, uint8_t data);
+  void error(const char *message);
+  void add_reloc(uint32_t address, int type, int32_t value, int symbol, bool pc_relative);
+  int get_eval_extern() { return eval_extern; }
+
+  uint32_t address;    // location counter in the CPU's address units
+  int pass;
+  int line;
+  const char *filename;
+
+private:
+  int assemble_line(char *text);
+  assembler_page_t *next_page(uint32_t address);
+  int set_label(const char *name);
+  void end_block();
+  int eval_or(const char **s, int32_t *value);
+  int eval_xor(const char **s, int32_t *value);
+  int eval_and(const char **s, int32_t *value);
+  int eval_shift(const char **s, int32_t *value);
+  int eval_add(const char **s, int32_t *value);
+  int eval_mul(const char **s, int32_t *value);
+  int eval_unary(const char **s, int32_t *value);
+  assembler_symbol_t *lookup(const char *name);
+
+  assembler_page_t *pages;
+  assembler_symbol_t *symbols;
+  int symbol_count;
+  int symbol_max;
+  int block_start;
+  bool eval_uses_label;
+  int eval_extern;
+  bool relocatable;
+  assembler_reloc_t *relocs;
+  int reloc_count;
+  int reloc_max;
+  int errors;
+};
+
+Assembler *new_assembler(const char *cpu_name);
+
+#endif
+
@@ -0,0 +1,1327 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "AssemblerDSPIC.h"
+
+struct dspic_define_t
+{
+  const char *name;
+  uint32_t value;
+};
+
+// Core registers and bits every part's .inc file has
+static dspic_define_t dspic_core_inc[] =
+{
+  { "SPLIM", 0x0020 },
+  { "ACCAL", 0x0022 },
+  { "ACCAH", 0x0024 },
+  { "ACCAU", 0x0026 },
+  { "ACCBL", 0x0028 },
+  { "ACCBH", 0x002a },
+  { "ACCBU", 0x002c },
+  { "PCL", 0x002e },
+  { "PCH", 0x0030 },
+  { "TBLPAG", 0x0032 },
+  { "PSVPAG", 0x0034 },
+  { "RCOUNT", 0x0036 },
+  { "DCOUNT", 0x0038 },
+  { "SR", 0x0042 },
+  { "CORCON", 0x0044 },
+  { "IF", 0 },
+  { "RND", 1 },
+  { "PSV", 2 },
+  { "ACCSAT", 4 },
+  { "SATDW", 5 },
+  { "SATB", 6 },
+  { "SATA", 7 },
+  { "SPIRBF", 0 },
+  { "SPITBF", 1 },
+  { "SPIROV", 6 },
+  { "SPISIDL", 13 },
+  { "SPIEN", 15 },
+  { "PPRE0", 0 },
+  { "PPRE1", 1 },
+  { "SPRE0", 2 },
+  { "SPRE1", 3 },
+  { "SPRE2", 4 },
+  { "MSTEN", 5 },
+  { "CKP", 6 },
+  { "SSEN", 7 },
+  { "CKE", 8 },
+  { "SMP", 9 },
+  { "MODE16", 10 },
+  { "DISSDO", 11 },
+  { "DISSCK", 12 },
+  { NULL, 0 }
+};
+
+// The part of p30f3012.inc the generator uses
+static dspic_define_t p30f3012_inc[] =
+{
+  { "SPI1STAT", 0x0220 },
+  { "SPI1CON", 0x0222 },
+  { "SPI1BUF", 0x0226 },
+  { "TRISA", 0x02c0 },
+  { "PORTA", 0x02c2 },
+  { "LATA", 0x02c4 },
+  { "TRISB", 0x02c6 },
+  { "PORTB", 0x02c8 },
+  { "LATB", 0x02ca },
+  { "TRISC", 0x02cc },
+  { "PORTC", 0x02ce },
+  { "LATC", 0x02d0 },
+  { "TRISD", 0x02d2 },
+  { "PORTD", 0x02d4 },
+  { "LATD", 0x02d6 },
+  { "__FOSC", 0xf80000 },
+  { "__FWDT", 0xf80002 },
+  { "__FBORPOR", 0xf80004 },
+  { "__FGS", 0xf8000a },
+  { "__FICD", 0xf8000c },
+  { NULL, 0 }
+};
+
+// The part of p33fj06gs101a.inc the generator uses
+static dspic_define_t p33fj06gs101a_inc[] =
+{
+  { "SPI1STAT", 0x0240 },
+  { "SPI1CON1", 0x0242 },
+  { "SPI1CON2", 0x0244 },
+  { "SPI1BUF", 0x0248 },
+  { "TRISA", 0x02c0 },
+  { "PORTA", 0x02c2 },
+  { "LATA", 0x02c4 },
+  { "ODCA", 0x02c6 },
+  { "TRISB", 0x02c8 },
+  { "PORTB", 0x02ca },
+  { "LATB", 0x02cc },
+  { "ODCB", 0x02ce },
+  { "RPINR20", 0x06a8 },
+  { "RPOR0", 0x06c0 },
+  { "RPOR1", 0x06c2 },
+  { "SDI1R0", 0 },
+  { "SDI1R1", 1 },
+  { "SDI1R2", 2 },
+  { "SDI1R3", 3 },
+  { "SDI1R4", 4 },
+  { "SCK1R0", 8 },
+  { "SCK1R1", 9 },
+  { "SCK1R2", 10 },
+  { "SCK1R3", 11 },
+  { "SCK1R4", 12 },
+  { "__FBS", 0xf80000 },
+  { "__FGS", 0xf80004 },
+  { "__FOSCSEL", 0xf80006 },
+  { "__FOSC", 0xf80008 },
+  { "__FWDT", 0xf8000a },
+  { "__FPOR", 0xf8000c },
+  { "__FICD", 0xf8000e },
+  { NULL, 0 }
+};
+
+struct dspic_cond_t
+{
+  const char *name;
+  int opcode;
+};
+
+static dspic_cond_t dspic_cond[] =
+{
+  { "ov", 0x30 },
+  { "c", 0x31 },
+  { "geu", 0x31 },
+  { "z", 0x32 },
+  { "n", 0x33 },
+  { "le", 0x34 },
+  { "lt", 0x35 },
+  { "leu", 0x36 },
+  { "nov", 0x38 },
+  { "nc", 0x39 },
+  { "ltu", 0x39 },
+  { "nz", 0x3a },
+  { "nn", 0x3b },
+  { "gt", 0x3c },
+  { "ge", 0x3d },
+  { "gtu", 0x3e },
+  { "oa", 0x0c },
+  { "ob", 0x0d },
+  { "sa", 0x0e },
+  { "sb", 0x0f },
+  { NULL, 0 }
+};
+
+// Index is the opcode: Wb,Ws,Wd form is 0x40+index*8, #lit10,Wn is
+// 0xb0+index/2 and f is 0xb4+index/2.
+static const char *dspic_alu[] =
+{
+  "add", "addc", "sub", "subb", "and", "xor", "ior", NULL
+};
+
+static const char *dspic_shift[] =
+{
+  "sl", "lsr", "asr", NULL
+};
+
+// Ws,Wd instructions with the same layout as neg
+struct dspic_unary_t
+{
+  const char *name;
+  uint32_t opcode;
+};
+
+static dspic_unary_t dspic_unary[] =
+{
+  { "neg", 0xea0000 },
+  { "com", 0xea8000 },
+  { "inc", 0xe80000 },
+  { "inc2", 0xe88000 },
+  { "dec", 0xe90000 },
+  { "dec2", 0xe98000 },
+  { NULL, 0 }
+};
+
+// No X or Y prefetch and no accumulator write back for the DSP
+// multiply/clr instructions.
+#define DSPIC_NO_PREFETCH ((4 << 6) | (4 << 2) | 2)
+
+static int find_instr(const char **table, const char *name)
+{
+int n;
+
+  for (n = 0; table[n] != NULL; n++)
+  {
+    if (strcmp(table[n], name) == 0) { return n; }
+  }
+
+  return -1;
+}
+
+static int get_bw(const char *suffix)
+{
+  if (suffix == NULL || strcmp(suffix, ".w") == 0) { return 0; }
+  if (strcmp(suffix, ".b") == 0) { return 1; }
+
+  return -1;
+}
+
+AssemblerDSPIC::AssemblerDSPIC()
+{
+}
+
+AssemblerDSPIC::~AssemblerDSPIC()
+{
+}
+
+int AssemblerDSPIC::instruction(char *instr, char *operands[], int count)
+{
+dspic_operand_t operand[ASSEMBLER_MAX_OPERANDS];
+char name[16];
+char *suffix;
+bool has_accum = false;
+int32_t value;
+int bw;
+int n;
+
+  strncpy(name, instr, sizeof(name) - 1);
+  name[sizeof(name) - 1] = 0;
+
+  suffix = strchr(name, '.');
+  if (suffix != NULL) { *suffix = 0; suffix = instr + (suffix - name); }
+
+  bw = get_bw(suffix);
+
+  // Branch targets are labels so they skip the operand parser (a method
+  // could be called "a").
+  if (strcmp(name, "bra") == 0)
+  {
+    if (count == 1)
+    {
+      if (eval(operands[0], &value, NULL) != 0) { return -1; }
+      return branch(0x37, value);
+    }
+
+    if (count == 2)
+    {
+      for (n = 0; dspic_cond[n].name != NULL; n++)
+      {
+        if (strcasecmp(dspic_cond[n].name, operands[0]) == 0)
+        {
+          if (eval(operands[1], &value, NULL) != 0) { return -1; }
+          return branch(dspic_cond[n].opcode, value);
+        }
+      }
+
+      error("Unknown branch condition");
+      return -1;
+    }
+
+    error("bra takes one or two operands");
+    return -1;
+  }
+
+  if (strcmp(name, "call") == 0 || strcmp(name, "goto") == 0)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    if (eval(operands[0], &value, NULL) != 0) { return -1; }
+
+    add_word((name[0] == 'c' ? 0x020000 : 0x040000) | (value & 0xfffe));
+    add_word((value >> 16) & 0x7f);
+
+    return 0;
+  }
+
+  // do #lit14, Expr or do Wn, Expr where Expr is the last instruction of
+  // the loop.  The second word is the offset to it from after the do.
+  if (strcmp(name, "do") == 0)
+  {
+    if (count != 2 || parse_operand(operands[0], &operand[0]) != 0 ||
+        (operand[0].type != DSPIC_OPERAND_REGISTER &&
+         (operand[0].type != DSPIC_OPERAND_LITERAL ||
+          operand[0].value < 0 || operand[0].value > 0x3fff)))
+    {
+      error("do takes #lit14 or Wn and a label");
+      return -1;
+    }
+
+    if (eval(operands[1], &value, NULL) != 0) { return -1; }
+
+    value = (value - (int32_t)(address + 4)) / 2;
+
+    if (pass == 2 && (value < 0 || value > 32767))
+    {
+      error("do loop end out of range");
+      return -1;
+    }
+
+    if (operand[0].type == DSPIC_OPERAND_REGISTER)
+    {
+      add_word(0x088000 | operand[0].reg);
+    }
+      else
+    {
+      add_word(0x080000 | operand[0].value);
+    }
+
+    add_word(value & 0xffff);
+
+    return 0;
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    if (parse_operand(operands[n], &operand[n]) != 0) { return -1; }
+    if (operand[n].type == DSPIC_OPERAND_ACCUM) { has_accum = true; }
+  }
+
+  if (count == 0)
+  {
+    if (strcmp(name, "nop") == 0) { add_word(0x000000); return 0; }
+    if (strcmp(name, "return") == 0 || strcmp(name, "ret") == 0)
+    {
+      add_word(0x060000);
+      return 0;
+    }
+    if (strcmp(name, "retfie") == 0) { add_word(0x064000); return 0; }
+    if (strcmp(name, "ulnk") == 0) { add_word(0xfa8000); return 0; }
+    if (strcmp(name, "reset") == 0) { add_word(0xfe0000); return 0; }
+  }
+
+  if (has_accum || strcmp(name, "lac") == 0 || strcmp(name, "sac") == 0 ||
+      strcmp(name, "sftac") == 0)
+  {
+    if (strcmp(name, "mac") == 0 || strcmp(name, "mpy") == 0 ||
+        strcmp(name, "msc") == 0)
+    {
+      return dsp_multiply(instr, operand, count);
+    }
+
+    if (suffix != NULL && strcmp(instr, "sac.r") != 0)
+    {
+      error("Unknown instruction size");
+      return -1;
+    }
+
+    return dsp_accum(name, operand, count, suffix != NULL);
+  }
+
+  if (bw == -1 && strcmp(name, "div") != 0 && strcmp(name, "mul") != 0)
+  {
+    error("Unknown instruction size");
+    return -1;
+  }
+
+  if (strcmp(name, "mov") == 0)
+  {
+    if (count == 1) { return mov(bw, &operand[0], NULL); }
+    if (count != 2) { error("mov takes one or two operands"); return -1; }
+    return mov(bw, &operand[0], &operand[1]);
+  }
+
+  n = find_instr(dspic_alu, name);
+  if (n != -1) { return alu(n, bw, operand, count); }
+
+  n = find_instr(dspic_shift, name);
+  if (n != -1)
+  {
+    if (bw == 1) { error(".b not allowed here"); return -1; }
+    return shift(n, operand, count);
+  }
+
+  for (n = 0; dspic_unary[n].name != NULL; n++)
+  {
+    if (strcmp(dspic_unary[n].name, name) == 0)
+    {
+      int src_mode,src,dst_mode,dst,wb;
+
+      if (count == 1) { operand[1] = operand[0]; count = 2; }
+
+      if (count != 2 ||
+          encode_source(&operand[0], &src_mode, &src, &wb) != 0 ||
+          encode_source(&operand[1], &dst_mode, &dst, &wb) != 0 ||
+          src_mode == 6 || dst_mode == 6)
+      {
+        error("Bad operands");
+        return -1;
+      }
+
+      add_word(dspic_unary[n].opcode | (bw << 14) | (dst_mode << 11) |
+               (dst << 7) | (src_mode << 4) | src);
+
+      return 0;
+    }
+  }
+
+  if (strcmp(name, "cp") == 0)
+  {
+    int mode,reg,wb;
+
+    if (count != 2 || operand[0].type != DSPIC_OPERAND_REGISTER)
+    {
+      error("cp takes Wb and Ws or #lit5");
+      return -1;
+    }
+
+    if (operand[1].type == DSPIC_OPERAND_LITERAL)
+    {
+      if (operand[1].value < 0 || operand[1].value > 31)
+      {
+        error("Literal out of range");
+        return -1;
+      }
+
+      add_word(0xe10060 | (operand[0].reg << 11) | (bw << 10) | operand[1].value);
+      return 0;
+    }
+
+    if (encode_source(&operand[1], &mode, &reg, &wb) != 0 || mode == 6)
+    {
+      error("Bad operand");
+      return -1;
+    }
+
+    add_word(0xe10000 | (operand[0].reg << 11) | (bw << 10) | (mode << 4) | reg);
+
+    return 0;
+  }
+
+  if (strcmp(name, "cp0") == 0)
+  {
+    int mode,reg,wb;
+
+    if (count != 1 ||
+        encode_source(&operand[0], &mode, &reg, &wb) != 0 || mode == 6)
+    {
+      error("cp0 takes one Ws operand");
+      return -1;
+    }
+
+    add_word(0xe00000 | (bw << 10) | (mode << 4) | reg);
+
+    return 0;
+  }
+
+  if (strcmp(name, "clr") == 0)
+  {
+    int mode,reg,wb;
+
+    if (count != 1 ||
+        encode_source(&operand[0], &mode, &reg, &wb) != 0 || mode == 6)
+    {
+      error("clr takes one Wd operand");
+      return -1;
+    }
+
+    add_word(0xeb0000 | (bw << 14) | (mode << 11) | (reg << 7));
+
+    return 0;
+  }
+
+  if (strcmp(name, "se") == 0 || strcmp(name, "ze") == 0)
+  {
+    int mode,reg,wb;
+
+    if (count != 2 || operand[1].type != DSPIC_OPERAND_REGISTER ||
+        encode_source(&operand[0], &mode, &reg, &wb) != 0 || mode == 6)
+    {
+      error("Instruction takes Ws and Wnd");
+      return -1;
+    }
+
+    add_word((name[0] == 's' ? 0xfb0000 : 0xfb8000) |
+             (operand[1].reg << 7) | (mode << 4) | reg);
+
+    return 0;
+  }
+
+  if (strcmp(name, "bset") == 0 || strcmp(name, "bclr") == 0 ||
+      strcmp(name, "btg") == 0)
+  {
+    int op = name[1] == 's' ? 0 : (name[1] == 'c' ? 1 : 2);
+    int bit;
+
+    if (count != 2 || operand[1].type != DSPIC_OPERAND_LITERAL ||
+        operand[1].value < 0 || operand[1].value > (bw ? 7 : 15))
+    {
+      error("Instruction takes an operand and #bit");
+      return -1;
+    }
+
+    bit = operand[1].value;
+
+    if (operand[0].type == DSPIC_OPERAND_ADDRESS)
+    {
+      int32_t f = operand[0].value;
+
+      // The f form works on bytes
+      if (bit >= 8) { f++; bit -= 8; }
+
+      if (f < 0 || f > 0x1fff) { error("Address out of range"); return -1; }
+
+      add_word((0xa80000 + (op << 16)) | (bit << 13) | f);
+
+      return 0;
+    }
+      else
+    {
+      int mode,reg,wb;
+
+      if (encode_source(&operand[0], &mode, &reg, &wb) != 0 || mode == 6)
+      {
+        error("Bad operand");
+        return -1;
+      }
+
+      add_word((0xa00000 + (op << 16)) | (bit << 12) | (bw << 10) | (mode << 4) | reg);
+
+      return 0;
+    }
+  }
+
+  if (strcmp(name, "push") == 0 || strcmp(name, "pop") == 0)
+  {
+    bool is_push = name[1] == 'u';
+    int mode,reg,wb = 0;
+
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+
+    if (operand[0].type == DSPIC_OPERAND_ADDRESS)
+    {
+      if ((operand[0].value & 1) != 0 || operand[0].value > 0xffff)
+      {
+        error("Bad address");
+        return -1;
+      }
+
+      add_word((is_push ? 0xf80000 : 0xf90000) | operand[0].value);
+
+      return 0;
+    }
+
+    if (encode_source(&operand[0], &mode, &reg, &wb) != 0)
+    {
+      error("Bad operand");
+      return -1;
+    }
+
+    // push is mov Ws, [W15++] and pop is mov [--W15], Wd
+    if (is_push)
+    {
+      add_word(0x780000 | (wb << 15) | (bw << 14) | (3 << 11) | (15 << 7) |
+               (mode << 4) | reg);
+    }
+      else
+    {
+      add_word(0x780000 | (wb << 15) | (bw << 14) | (mode << 11) | (reg << 7) |
+               (4 << 4) | 15);
+    }
+
+    return 0;
+  }
+
+  if (strcmp(name, "lnk") == 0)
+  {
+    if (count != 1 || operand[0].type != DSPIC_OPERAND_LITERAL ||
+        operand[0].value < 0 || operand[0].value > 0x3ffe ||
+        (operand[0].value & 1) != 0)
+    {
+      error("lnk takes an even #lit14");
+      return -1;
+    }
+
+    add_word(0xfa0000 | operand[0].value);
+
+    return 0;
+  }
+
+  if (strcmp(name, "repeat") == 0)
+  {
+    if (count == 1 && operand[0].type == DSPIC_OPERAND_REGISTER)
+    {
+      add_word(0x098000 | operand[0].reg);
+      return 0;
+    }
+
+    if (count != 1 || operand[0].type != DSPIC_OPERAND_LITERAL ||
+        operand[0].value < 0 || operand[0].value > 0x3fff)
+    {
+      error("repeat takes #lit14 or Wn");
+      return -1;
+    }
+
+    add_word(0x090000 | operand[0].value);
+
+    return 0;
+  }
+
+  if (strcmp(name, "div") == 0)
+  {
+    int is_unsigned,is_long;
+
+    if (strcmp(instr, "div.s") == 0 || strcmp(instr, "div.sw") == 0)
+    { is_unsigned = 0; is_long = 0; }
+      else
+    if (strcmp(instr, "div.u") == 0 || strcmp(instr, "div.uw") == 0)
+    { is_unsigned = 1; is_long = 0; }
+      else
+    if (strcmp(instr, "div.sd") == 0) { is_unsigned = 0; is_long = 1; }
+      else
+    if (strcmp(instr, "div.ud") == 0) { is_unsigned = 1; is_long = 1; }
+      else
+    { error("Unknown instruction size"); return -1; }
+
+    if (count != 2 || operand[0].type != DSPIC_OPERAND_REGISTER ||
+        operand[1].type != DSPIC_OPERAND_REGISTER ||
+        (is_long && (operand[0].reg & 1) != 0))
+    {
+      error("div takes Wm and Wn");
+      return -1;
+    }
+
+    add_word(0xd80000 | (is_unsigned << 15) | (operand[0].reg << 11) |
+             (operand[0].reg << 7) | (is_long << 6) | operand[1].reg);
+
+    return 0;
+  }
+
+  if (strcmp(name, "mul") == 0)
+  {
+    static const char *mul_sign[] = { "uu", "us", "su", "ss", NULL };
+    int mode,reg,wb;
+
+    n = suffix == NULL ? -1 : find_instr(mul_sign, suffix + 1);
+
+    if (n == -1) { error("Unknown instruction size"); return -1; }
+
+    if (count != 3 || operand[0].type != DSPIC_OPERAND_REGISTER ||
+        operand[2].type != DSPIC_OPERAND_REGISTER ||
+        (operand[2].reg & 1) != 0 ||
+        encode_source(&operand[1], &mode, &reg, &wb) != 0 || mode == 6)
+    {
+      error("mul takes Wb, Ws and an even Wnd");
+      return -1;
+    }
+
+    add_word((0xb80000 + (n << 15)) | (operand[0].reg << 11) |
+             (operand[2].reg << 7) | (mode << 4) | reg);
+
+    return 0;
+  }
+
+  char message[64];
+  snprintf(message, sizeof(message), "Unknown instruction '%s'", instr);
+  error(message);
+
+  return -1;
+}
+
+int AssemblerDSPIC::include(const char *filename)
+{
+dspic_define_t *table;
+int n;
+
+  if (strcmp(filename, "p30f3012.inc") == 0) { table = p30f3012_inc; }
+  else if (strcmp(filename, "p33fj06gs101a.inc") == 0) { table = p33fj06gs101a_inc; }
+  else { return -1; }
+
+  for (n = 0; dspic_core_inc[n].name != NULL; n++)
+  {
+    define(dspic_core_inc[n].name, dspic_core_inc[n].value);
+  }
+
+  for (n = 0; table[n].name != NULL; n++)
+  {
+    define(table[n].name, table[n].value);
+  }
+
+  for (n = 0; n < 16; n++)
+  {
+    char name[16];
+
+    sprintf(name, "WREG%d", n);
+    define(name, n * 2);
+  }
+
+  return 0;
+}
+
+int AssemblerDSPIC::directive(char *name, char *operands[], int count)
+{
+int32_t value;
+int n;
+
+  if (strcmp(name, ".dspic") == 0) { return 0; }
+
+  // Program memory data is a full 24 bit word per entry
+  if (strcmp(name, "dc32") == 0 || strcmp(name, "dw") == 0 ||
+      strcmp(name, ".dw") == 0 || strcmp(name, "dc16") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (eval(operands[n], &value, NULL) != 0) { return -2; }
+      add_word(value & 0xffffff);
+    }
+
+    return 0;
+  }
+
+  return -1;
+}
+
+int AssemblerDSPIC::parse_operand(const char *text, dspic_operand_t *operand)
+{
+char expr[256];
+char *s;
+int len;
+
+  operand->reg = 0;
+  operand->reg2 = 0;
+  operand->mode = 0;
+  operand->value = 0;
+
+  if (text[0] == '#')
+  {
+    operand->type = DSPIC_OPERAND_LITERAL;
+    return eval(text + 1, &operand->value, NULL);
+  }
+
+  if (text[0] == '[')
+  {
+    len = strlen(text);
+
+    if (text[len - 1] != ']' || len - 2 >= (int)sizeof(expr))
+    {
+      error("Missing ]");
+      return -1;
+    }
+
+    memcpy(expr, text + 1, len - 2);
+    expr[len - 2] = 0;
+    len -= 2;
+
+    operand->type = DSPIC_OPERAND_INDIRECT;
+
+    if (strncmp(expr, "++", 2) == 0 || strncmp(expr, "--", 2) == 0)
+    {
+      operand->mode = expr[0] == '+' ? 5 : 4;
+      operand->reg = get_register(expr + 2);
+    }
+      else
+    if (len > 2 && (strcmp(expr + len - 2, "++") == 0 ||
+                    strcmp(expr + len - 2, "--") == 0))
+    {
+      operand->mode = expr[len - 1] == '+' ? 3 : 2;
+      expr[len - 2] = 0;
+      operand->reg = get_register(expr);
+    }
+      else
+    {
+      s = expr;
+      while (*s != 0 && *s != '+' && *s != '-') { s++; }
+
+      if (*s == 0)
+      {
+        operand->mode = 1;
+        operand->reg = get_register(expr);
+      }
+        else
+      {
+        char sign = *s;
+
+        *s = 0;
+        operand->reg = get_register(expr);
+        *s = sign;
+
+        if (sign == '+' && get_register(s + 1) != -1)
+        {
+          operand->type = DSPIC_OPERAND_INDIRECT_REG;
+          operand->mode = 6;
+          operand->reg2 = get_register(s + 1);
+        }
+          else
+        {
+          operand->type = DSPIC_OPERAND_INDIRECT_LIT;
+          if (eval(s + (sign == '+' ? 1 : 0), &operand->value, NULL) != 0)
+          {
+            return -1;
+          }
+        }
+      }
+    }
+
+    if (operand->reg == -1)
+    {
+      error("Expected register inside []");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  operand->reg = get_register(text);
+
+  if (operand->reg != -1)
+  {
+    operand->type = DSPIC_OPERAND_REGISTER;
+    return 0;
+  }
+
+  if (strcasecmp(text, "a") == 0 || strcasecmp(text, "b") == 0)
+  {
+    operand->type = DSPIC_OPERAND_ACCUM;
+    operand->reg = tolower(text[0]) - 'a';
+    return 0;
+  }
+
+  // Wm*Wn for the DSP multiplies
+  s = (char *)strchr(text, '*');
+
+  if (s != NULL && s - text < (int)sizeof(expr))
+  {
+    memcpy(expr, text, s - text);
+    expr[s - text] = 0;
+
+    if (get_register(expr) != -1 && get_register(s + 1) != -1)
+    {
+      operand->type = DSPIC_OPERAND_PRODUCT;
+      operand->reg = get_register(expr);
+      operand->reg2 = get_register(s + 1);
+      return 0;
+    }
+  }
+
+  operand->type = DSPIC_OPERAND_ADDRESS;
+
+  return eval(text, &operand->value, NULL);
+}
+
+int AssemblerDSPIC::get_register(const char *text)
+{
+char *end;
+int reg;
+
+  while (*text == ' ') { text++; }
+
+  if (strcasecmp(text, "sp") == 0) { return 15; }
+
+  if (text[0] != 'w' && text[0] != 'W') { return -1; }
+  if (!isdigit(text[1])) { return -1; }
+
+  reg = strtol(text + 1, &end, 10);
+  while (*end == ' ') { end++; }
+  if (*end != 0 || reg > 15) { return -1; }
+
+  return reg;
+}
+
+// Ws/Wd operands: returns the ppp/qqq mode bits, the register and the
+// Wb offset register for [Wn+Wb].
+int AssemblerDSPIC::encode_source(dspic_operand_t *operand, int *mode, int *reg, int *wb)
+{
+  *reg = operand->reg;
+
+  switch(operand->type)
+  {
+    case DSPIC_OPERAND_REGISTER:
+      *mode = 0;
+      return 0;
+    case DSPIC_OPERAND_INDIRECT:
+      *mode = operand->mode;
+      return 0;
+    case DSPIC_OPERAND_INDIRECT_REG:
+      *mode = 6;
+      *wb = operand->reg2;
+      return 0;
+  }
+
+  return -1;
+}
+
+int AssemblerDSPIC::mov(int bw, dspic_operand_t *src, dspic_operand_t *dst)
+{
+int src_mode,src_reg,dst_mode,dst_reg;
+int src_wb = -1,dst_wb = -1;
+int32_t k;
+
+  // mov f sets N and Z from a file register
+  if (dst == NULL)
+  {
+    if (src->type != DSPIC_OPERAND_ADDRESS || src->value < 0 || src->value > 0x1fff)
+    {
+      error("Bad operand");
+      return -1;
+    }
+
+    add_word(0xbf8000 | (bw << 14) | (1 << 13) | src->value);
+
+    return 0;
+  }
+
+  if (src->type == DSPIC_OPERAND_LITERAL && dst->type == DSPIC_OPERAND_REGISTER)
+  {
+    if (bw == 1)
+    {
+      add_word(0xb3c000 | ((src->value & 0xff) << 4) | dst->reg);
+    }
+      else
+    {
+      if (src->value < -32768 || src->value > 65535)
+      {
+        error("Literal out of range");
+        return -1;
+      }
+
+      add_word(0x200000 | ((src->value & 0xffff) << 4) | dst->reg);
+    }
+
+    return 0;
+  }
+
+  if (src->type == DSPIC_OPERAND_ADDRESS && dst->type == DSPIC_OPERAND_REGISTER)
+  {
+    if (bw == 1)
+    {
+      if (dst->reg != 0 || src->value < 0 || src->value > 0x1fff)
+      {
+        error("mov.b f can only load WREG");
+        return -1;
+      }
+
+      add_word(0xbfc000 | src->value);
+      return 0;
+    }
+
+    if ((src->value & 1) != 0 || src->value < 0 || src->value > 0xffff)
+    {
+      error("Bad address");
+      return -1;
+    }
+
+    add_word(0x800000 | (src->value << 3) | dst->reg);
+
+    return 0;
+  }
+
+  if (src->type == DSPIC_OPERAND_REGISTER && dst->type == DSPIC_OPERAND_ADDRESS)
+  {
+    if (bw == 1)
+    {
+      if (src->reg != 0 || dst->value < 0 || dst->value > 0x1fff)
+      {
+        error("mov.b to f can only store WREG");
+        return -1;
+      }
+
+      add_word(0xb7e000 | dst->value);
+      return 0;
+    }
+
+    if ((dst->value & 1) != 0 || dst->value < 0 || dst->value > 0xffff)
+    {
+      error("Bad address");
+      return -1;
+    }
+
+    add_word(0x880000 | (dst->value << 3) | src->reg);
+
+    return 0;
+  }
+
+  // [Wn+Slit10] is scaled to words unless it's a byte move
+  if ((src->type == DSPIC_OPERAND_INDIRECT_LIT && dst->type == DSPIC_OPERAND_REGISTER) ||
+      (src->type == DSPIC_OPERAND_REGISTER && dst->type == DSPIC_OPERAND_INDIRECT_LIT))
+  {
+    dspic_operand_t *indirect = src->type == DSPIC_OPERAND_INDIRECT_LIT ? src : dst;
+
+    k = indirect->value;
+
+    if (bw == 0)
+    {
+      if ((k & 1) != 0) { error("Word offset must be even"); return -1; }
+      k /= 2;
+    }
+
+    if (k < -512 || k > 511) { error("Offset out of range"); return -1; }
+
+    add_word((src == indirect ? 0x900000 : 0x980000) |
+             (((k >> 6) & 0xf) << 15) | (bw << 14) | (((k >> 3) & 7) << 11) |
+             (dst->reg << 7) | ((k & 7) << 4) | src->reg);
+
+    return 0;
+  }
+
+  if (encode_source(src, &src_mode, &src_reg, &src_wb) != 0 ||
+      encode_source(dst, &dst_mode, &dst_reg, &dst_wb) != 0 ||
+      (src_wb != -1 && dst_wb != -1 && src_wb != dst_wb))
+  {
+    error("Bad operands for mov");
+    return -1;
+  }
+
+  if (src_wb == -1) { src_wb = dst_wb == -1 ? 0 : dst_wb; }
+
+  add_word(0x780000 | (src_wb << 15) | (bw << 14) | (dst_mode << 11) |
+           (dst_reg << 7) | (src_mode << 4) | src_reg);
+
+  return 0;
+}
+
+int AssemblerDSPIC::alu(int opcode, int bw, dspic_operand_t *operand, int count)
+{
+int src_mode,src,dst_mode,dst,wb;
+
+  if (count == 1)
+  {
+    if (operand[0].type != DSPIC_OPERAND_ADDRESS ||
+        operand[0].value < 0 || operand[0].value > 0x1fff)
+    {
+      error("Bad operand");
+      return -1;
+    }
+
+    // f = f op WREG
+    add_word((0xb40000 + (opcode << 15)) | (bw << 14) | (1 << 13) | operand[0].value);
+
+    return 0;
+  }
+
+  if (count == 2)
+  {
+    if (operand[0].type != DSPIC_OPERAND_LITERAL ||
+        operand[1].type != DSPIC_OPERAND_REGISTER)
+    {
+      error("Instruction takes #lit10 and Wn");
+      return -1;
+    }
+
+    if (operand[0].value < 0 || operand[0].value > (bw ? 255 : 1023))
+    {
+      error("Literal out of range");
+      return -1;
+    }
+
+    add_word((0xb00000 + (opcode << 15)) | (bw << 14) |
+             (operand[0].value << 4) | operand[1].reg);
+
+    return 0;
+  }
+
+  if (count != 3 || operand[0].type != DSPIC_OPERAND_REGISTER ||
+      encode_source(&operand[2], &dst_mode, &dst, &wb) != 0 || dst_mode == 6)
+  {
+    error("Instruction takes Wb, Ws and Wd");
+    return -1;
+  }
+
+  if (operand[1].type == DSPIC_OPERAND_LITERAL)
+  {
+    if (operand[1].value < 0 || operand[1].value > 31)
+    {
+      error("Literal out of range");
+      return -1;
+    }
+
+    add_word((0x400000 + (opcode << 19)) | (operand[0].reg << 15) | (bw << 14) |
+             (dst_mode << 11) | (dst << 7) | 0x60 | operand[1].value);
+
+    return 0;
+  }
+
+  if (encode_source(&operand[1], &src_mode, &src, &wb) != 0 || src_mode == 6)
+  {
+    error("Instruction takes Wb, Ws and Wd");
+    return -1;
+  }
+
+  add_word((0x400000 + (opcode << 19)) | (operand[0].reg << 15) | (bw << 14) |
+           (dst_mode << 11) | (dst << 7) | (src_mode << 4) | src);
+
+  return 0;
+}
+
+int AssemblerDSPIC::shift(int op, dspic_operand_t *operand, int count)
+{
+static const uint32_t shift_multi[] = { 0xdd0000, 0xde0000, 0xde8000 };
+static const uint32_t shift_single[] = { 0xd00000, 0xd10000, 0xd18000 };
+int src_mode,src,dst_mode,dst,wb;
+
+  // Wb, #lit4 or Wns, Wnd
+  if (count == 3)
+  {
+    if (operand[0].type != DSPIC_OPERAND_REGISTER ||
+        operand[2].type != DSPIC_OPERAND_REGISTER)
+    {
+      error("Instruction takes Wb, #lit4 or Wns, Wnd");
+      return -1;
+    }
+
+    if (operand[1].type == DSPIC_OPERAND_LITERAL)
+    {
+      if (operand[1].value < 0 || operand[1].value > 15)
+      {
+        error("Shift out of range");
+        return -1;
+      }
+
+      add_word(shift_multi[op] | (operand[0].reg << 11) | (operand[2].reg << 7) |
+               0x40 | operand[1].value);
+
+      return 0;
+    }
+
+    if (operand[1].type != DSPIC_OPERAND_REGISTER)
+    {
+      error("Instruction takes Wb, #lit4 or Wns, Wnd");
+      return -1;
+    }
+
+    add_word(shift_multi[op] | (operand[0].reg << 11) | (operand[2].reg << 7) |
+             operand[1].reg);
+
+    return 0;
+  }
+
+  // Shift by one: Ws, Wd
+  if (count == 1) { operand[1] = operand[0]; count = 2; }
+
+  if (count != 2 ||
+      encode_source(&operand[0], &src_mode, &src, &wb) != 0 ||
+      encode_source(&operand[1], &dst_mode, &dst, &wb) != 0 ||
+      src_mode == 6 || dst_mode == 6)
+  {
+    error("Bad operands");
+    return -1;
+  }
+
+  add_word(shift_single[op] | (dst_mode << 11) | (dst << 7) | (src_mode << 4) | src);
+
+  return 0;
+}
+
+// Accumulator instructions.  Shifts are #Slit4, positive is right.
+int AssemblerDSPIC::dsp_accum(const char *name, dspic_operand_t *operand, int count, int round)
+{
+dspic_operand_t *accum;
+int mode,reg,wb = 0;
+int shift = 0;
+
+  if (count == 1 && operand[0].type == DSPIC_OPERAND_ACCUM)
+  {
+    int acc = operand[0].reg << 15;
+
+    if (strcmp(name, "clr") == 0) { add_word(0xc30000 | acc | DSPIC_NO_PREFETCH); return 0; }
+    if (strcmp(name, "add") == 0) { add_word(0xcb0000 | acc); return 0; }
+    if (strcmp(name, "neg") == 0) { add_word(0xcb1000 | acc); return 0; }
+    if (strcmp(name, "sub") == 0) { add_word(0xcb3000 | acc); return 0; }
+
+    error("Bad accumulator instruction");
+    return -1;
+  }
+
+  if (strcmp(name, "sftac") == 0)
+  {
+    if (count != 2 || operand[0].type != DSPIC_OPERAND_ACCUM)
+    {
+      error("sftac takes an accumulator and Wn or #Slit6");
+      return -1;
+    }
+
+    if (operand[1].type == DSPIC_OPERAND_REGISTER)
+    {
+      add_word(0xc80000 | (operand[0].reg << 15) | operand[1].reg);
+      return 0;
+    }
+
+    if (operand[1].type == DSPIC_OPERAND_LITERAL &&
+        operand[1].value >= -16 && operand[1].value <= 16)
+    {
+      add_word(0xc80040 | (operand[0].reg << 15) | (operand[1].value & 0x3f));
+      return 0;
+    }
+
+    error("sftac takes an accumulator and Wn or #Slit6");
+    return -1;
+  }
+
+  if (count == 3)
+  {
+    if (operand[1].type != DSPIC_OPERAND_LITERAL ||
+        operand[1].value < -8 || operand[1].value > 7)
+    {
+      error("Shift must be #-8 to #7");
+      return -1;
+    }
+
+    shift = operand[1].value & 0xf;
+    operand[1] = operand[2];
+  }
+    else
+  if (count != 2)
+  {
+    error("Bad operands");
+    return -1;
+  }
+
+  if (strcmp(name, "sac") == 0)
+  {
+    accum = &operand[0];
+
+    if (accum->type != DSPIC_OPERAND_ACCUM ||
+        encode_source(&operand[1], &mode, &reg, &wb) != 0)
+    {
+      error("sac takes an accumulator and Wd");
+      return -1;
+    }
+
+    add_word((round ? 0xcd0000 : 0xcc0000) | (accum->reg << 15) | (wb << 11) |
+             (shift << 7) | (mode << 4) | reg);
+
+    return 0;
+  }
+
+  accum = &operand[1];
+
+  if (accum->type != DSPIC_OPERAND_ACCUM ||
+      encode_source(&operand[0], &mode, &reg, &wb) != 0 ||
+      (strcmp(name, "add") != 0 && strcmp(name, "lac") != 0))
+  {
+    error("Bad accumulator instruction");
+    return -1;
+  }
+
+  add_word((name[0] == 'a' ? 0xc90000 : 0xca0000) | (accum->reg << 15) |
+           (wb << 11) | (shift << 7) | (mode << 4) | reg);
+
+  return 0;
+}
+
+// mac/msc/mpy/mpy.n Wm*Wn, Acc without prefetches.  Wm and Wn have to
+// be two of w4 to w7.
+int AssemblerDSPIC::dsp_multiply(const char *name, dspic_operand_t *operand, int count)
+{
+int m,n,mmm;
+int acc;
+
+  if (count != 2 || operand[0].type != DSPIC_OPERAND_PRODUCT ||
+      operand[1].type != DSPIC_OPERAND_ACCUM)
+  {
+    error("Instruction takes Wm*Wn and an accumulator");
+    return -1;
+  }
+
+  m = operand[0].reg;
+  n = operand[0].reg2;
+  acc = operand[1].reg << 15;
+
+  if (m > n) { int t = m; m = n; n = t; }
+
+  if (m < 4 || n > 7)
+  {
+    error("DSP multiply only works on w4 to w7");
+    return -1;
+  }
+
+  if (m == n)
+  {
+    if (strcmp(name, "mac") == 0) { add_word(0xf00000 | ((m - 4) << 16) | acc | (DSPIC_NO_PREFETCH & ~3)); return 0; }
+    if (strcmp(name, "mpy") == 0) { add_word(0xf00000 | ((m - 4) << 16) | acc | (DSPIC_NO_PREFETCH & ~3) | 1); return 0; }
+
+    error("Instruction can't square");
+    return -1;
+  }
+
+  // w4*w5, w4*w6, w4*w7, -, w5*w6, w5*w7, w6*w7
+  if (m == 4) { mmm = n - 5; }
+  else if (m == 5) { mmm = n - 2; }
+  else { mmm = 6; }
+
+  if (strcmp(name, "mac") == 0) { add_word(0xc00000 | (mmm << 16) | acc | DSPIC_NO_PREFETCH); }
+  else if (strcmp(name, "msc") == 0) { add_word(0xc04000 | (mmm << 16) | acc | DSPIC_NO_PREFETCH); }
+  else if (strcmp(name, "mpy") == 0) { add_word(0xc00000 | (mmm << 16) | acc | DSPIC_NO_PREFETCH | 1); }
+  else if (strcmp(name, "mpy.n") == 0) { add_word(0xc04000 | (mmm << 16) | acc | DSPIC_NO_PREFETCH | 1); }
+  else { error("Unknown instruction"); return -1; }
+
+  return 0;
+}
+
+int AssemblerDSPIC::branch(int cond, int32_t target)
+{
+int32_t offset;
+
+  offset = (target - (int32_t)(address + 2)) / 2;
+
+  if (pass == 2 && (offset < -32768 || offset > 32767))
+  {
+    error("Branch out of range");
+    return -1;
+  }
+
+  add_word((cond << 16) | (offset & 0xffff));
+
+  return 0;
+}
+
+void AssemblerDSPIC::add_word(uint32_t data)
+{
+uint32_t offset = address * 2;
+
+  write8(offset + 0, data & 0xff);
+  write8(offset + 1, (data >> 8) & 0xff);
+  write8(offset + 2, (data >> 16) & 0xff);
+  write8(offset + 3, 0);
+
+  address += 2;
+}
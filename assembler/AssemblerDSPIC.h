@@ -0,0 +1,68 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _ASSEMBLER_DSPIC_H
+#define _ASSEMBLER_DSPIC_H
+
+#include "Assembler.h"
+
+enum
+{
+  DSPIC_OPERAND_REGISTER,
+  DSPIC_OPERAND_INDIRECT,       // [Wn], [Wn++], [Wn--], [++Wn], [--Wn]
+  DSPIC_OPERAND_INDIRECT_REG,   // [Wn+Wb]
+  DSPIC_OPERAND_INDIRECT_LIT,   // [Wn+lit]
+  DSPIC_OPERAND_LITERAL,        // #lit
+  DSPIC_OPERAND_ACCUM,          // A or B
+  DSPIC_OPERAND_PRODUCT,        // Wm*Wn
+  DSPIC_OPERAND_ADDRESS,        // file register or label
+};
+
+struct dspic_operand_t
+{
+  int type;
+  int reg;
+  int reg2;
+  int mode;           // ppp/qqq addressing mode bits
+  int32_t value;
+};
+
+// Program memory is 24 bit words at even addresses.  The location
+// counter is in program addresses and every word takes 4 bytes in the
+// image (the top byte is the unused "phantom" byte) like a Microchip
+// .hex file.
+
+class AssemblerDSPIC : public Assembler
+{
+public:
+  AssemblerDSPIC();
+  virtual ~AssemblerDSPIC();
+
+protected:
+  virtual int instruction(char *instr, char *operands[], int count);
+  virtual int include(const char *filename);
+  virtual int directive(char *name, char *operands[], int count);
+
+private:
+  int parse_operand(const char *text, dspic_operand_t *operand);
+  int get_register(const char *text);
+  int encode_source(dspic_operand_t *operand, int *mode, int *reg, int *wb);
+  int mov(int bw, dspic_operand_t *src, dspic_operand_t *dst);
+  int alu(int opcode, int bw, dspic_operand_t *operand, int count);
+  int shift(int op, dspic_operand_t *operand, int count);
+  int dsp_accum(const char *name, dspic_operand_t *operand, int count, int round);
+  int dsp_multiply(const char *name, dspic_operand_t *operand, int count);
+  int branch(int cond, int32_t target);
+  void add_word(uint32_t data);
+};
+
+#endif
+
@@ -0,0 +1,469 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "AssemblerMIPS.h"
+
+enum
+{
+  MIPS_RD_RS_RT,        // addu rd, rs, rt
+  MIPS_RD_RT_RS,        // sllv rd, rt, rs
+  MIPS_RD_RT_SA,        // sll rd, rt, sa
+  MIPS_RS_RT,           // div rs, rt
+  MIPS_RD,              // mflo rd
+  MIPS_RS,              // jr rs
+  MIPS_JALR,            // jalr rs or jalr rd, rs
+  MIPS_NONE,            // break
+  MIPS_RT_RS_SIMM,      // addiu rt, rs, -32768 to 32767
+  MIPS_RT_RS_UIMM,      // ori rt, rs, 0 to 65535
+  MIPS_RT_IMM,          // lui rt, 0 to 65535
+  MIPS_RT_MEM,          // lw rt, offset(rs)
+  MIPS_BRANCH_RS_RT,    // beq rs, rt, label
+  MIPS_BRANCH_RS,       // bltz rs, label (function is the rt field)
+  MIPS_JUMP,            // j label
+  MIPS_RD_RT,           // seb rd, rt (function is the sa field)
+};
+
+struct mips_instr_t
+{
+  const char *name;
+  int opcode;
+  int function;
+  int format;
+};
+
+static mips_instr_t mips_instr[] =
+{
+  { "add", 0x00, 0x20, MIPS_RD_RS_RT },
+  { "addu", 0x00, 0x21, MIPS_RD_RS_RT },
+  { "sub", 0x00, 0x22, MIPS_RD_RS_RT },
+  { "subu", 0x00, 0x23, MIPS_RD_RS_RT },
+  { "and", 0x00, 0x24, MIPS_RD_RS_RT },
+  { "or", 0x00, 0x25, MIPS_RD_RS_RT },
+  { "xor", 0x00, 0x26, MIPS_RD_RS_RT },
+  { "nor", 0x00, 0x27, MIPS_RD_RS_RT },
+  { "slt", 0x00, 0x2a, MIPS_RD_RS_RT },
+  { "sltu", 0x00, 0x2b, MIPS_RD_RS_RT },
+  { "mul", 0x1c, 0x02, MIPS_RD_RS_RT },
+  { "sllv", 0x00, 0x04, MIPS_RD_RT_RS },
+  { "srlv", 0x00, 0x06, MIPS_RD_RT_RS },
+  { "srav", 0x00, 0x07, MIPS_RD_RT_RS },
+  { "sll", 0x00, 0x00, MIPS_RD_RT_SA },
+  { "srl", 0x00, 0x02, MIPS_RD_RT_SA },
+  { "sra", 0x00, 0x03, MIPS_RD_RT_SA },
+  { "seb", 0x1f, 0x10, MIPS_RD_RT },
+  { "seh", 0x1f, 0x18, MIPS_RD_RT },
+  { "mult", 0x00, 0x18, MIPS_RS_RT },
+  { "multu", 0x00, 0x19, MIPS_RS_RT },
+  { "div", 0x00, 0x1a, MIPS_RS_RT },
+  { "divu", 0x00, 0x1b, MIPS_RS_RT },
+  { "mfhi", 0x00, 0x10, MIPS_RD },
+  { "mflo", 0x00, 0x12, MIPS_RD },
+  { "mthi", 0x00, 0x11, MIPS_RS },
+  { "mtlo", 0x00, 0x13, MIPS_RS },
+  { "jr", 0x00, 0x08, MIPS_RS },
+  { "jalr", 0x00, 0x09, MIPS_JALR },
+  { "syscall", 0x00, 0x0c, MIPS_NONE },
+  { "break", 0x00, 0x0d, MIPS_NONE },
+  { "addi", 0x08, 0, MIPS_RT_RS_SIMM },
+  { "addiu", 0x09, 0, MIPS_RT_RS_SIMM },
+  { "slti", 0x0a, 0, MIPS_RT_RS_SIMM },
+  { "sltiu", 0x0b, 0, MIPS_RT_RS_SIMM },
+  { "andi", 0x0c, 0, MIPS_RT_RS_UIMM },
+  { "ori", 0x0d, 0, MIPS_RT_RS_UIMM },
+  { "xori", 0x0e, 0, MIPS_RT_RS_UIMM },
+  { "lui", 0x0f, 0, MIPS_RT_IMM },
+  { "lb", 0x20, 0, MIPS_RT_MEM },
+  { "lh", 0x21, 0, MIPS_RT_MEM },
+  { "lw", 0x23, 0, MIPS_RT_MEM },
+  { "lbu", 0x24, 0, MIPS_RT_MEM },
+  { "lhu", 0x25, 0, MIPS_RT_MEM },
+  { "sb", 0x28, 0, MIPS_RT_MEM },
+  { "sh", 0x29, 0, MIPS_RT_MEM },
+  { "sw", 0x2b, 0, MIPS_RT_MEM },
+  { "beq", 0x04, 0, MIPS_BRANCH_RS_RT },
+  { "bne", 0x05, 0, MIPS_BRANCH_RS_RT },
+  { "blez", 0x06, 0, MIPS_BRANCH_RS },
+  { "bgtz", 0x07, 0, MIPS_BRANCH_RS },
+  { "bltz", 0x01, 0, MIPS_BRANCH_RS },
+  { "bgez", 0x01, 1, MIPS_BRANCH_RS },
+  { "j", 0x02, 0, MIPS_JUMP },
+  { "jal", 0x03, 0, MIPS_JUMP },
+  { NULL, 0, 0, 0 }
+};
+
+// How many registers each format takes before any immediate or label
+static const int mips_reg_count[] =
+{
+  3, 3, 2, 2, 1, 1, 0, 0, 2, 2, 1, 1, 2, 1, 0, 2
+};
+
+static const char *mips_reg_names[] =
+{
+  "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+  "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+  "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+#define R_TYPE(op, rs, rt, rd, sa, fn) \
+  (((op) << 26) | ((rs) << 21) | ((rt) << 16) | ((rd) << 11) | ((sa) << 6) | (fn))
+#define I_TYPE(op, rs, rt, imm) \
+  (((op) << 26) | ((rs) << 21) | ((rt) << 16) | ((imm) & 0xffff))
+
+AssemblerMIPS::AssemblerMIPS()
+{
+}
+
+AssemblerMIPS::~AssemblerMIPS()
+{
+}
+
+int AssemblerMIPS::instruction(char *instr, char *operands[], int count)
+{
+mips_instr_t *info;
+int regs[3];
+int32_t value;
+int n;
+
+  if (strcmp(instr, "nop") == 0 && count == 0)
+  {
+    add_word(0);
+    return 0;
+  }
+
+  // move rd, rs is addu rd, rs, $0
+  if (strcmp(instr, "move") == 0)
+  {
+    if (count != 2) { error("Instruction takes two operands"); return -1; }
+    if (get_registers(operands, 2, regs) != 0) { return -1; }
+    add_word(R_TYPE(0, regs[1], 0, regs[0], 0, 0x21));
+    return 0;
+  }
+
+  // la rt, address is always lui / ori so it's the same size both passes
+  if (strcmp(instr, "la") == 0)
+  {
+    if (count != 2) { error("Instruction takes two operands"); return -1; }
+    if (get_registers(operands, 1, regs) != 0) { return -1; }
+    if (eval(operands[1], &value, NULL) != 0) { return -1; }
+    add_word(I_TYPE(0x0f, 0, regs[0], (uint32_t)value >> 16));
+    add_word(I_TYPE(0x0d, regs[0], regs[0], value));
+    return 0;
+  }
+
+  if (strcmp(instr, "b") == 0)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    return branch(0x04, 0, 0, operands[0]);
+  }
+
+  for (info = mips_instr; info->name != NULL; info++)
+  {
+    if (strcmp(info->name, instr) == 0) { break; }
+  }
+
+  if (info->name == NULL)
+  {
+    error("Unknown instruction");
+    return -1;
+  }
+
+  n = mips_reg_count[info->format];
+
+  if (info->format == MIPS_JALR)
+  {
+    if (count != 1 && count != 2) { error("Wrong number of operands"); return -1; }
+    if (get_registers(operands, count, regs) != 0) { return -1; }
+    if (count == 1) { add_word(R_TYPE(0, regs[0], 0, 31, 0, info->function)); }
+    else { add_word(R_TYPE(0, regs[1], 0, regs[0], 0, info->function)); }
+    return 0;
+  }
+
+  if (info->format == MIPS_NONE)
+  {
+    if (count != 0) { error("Instruction takes no operands"); return -1; }
+    add_word(info->function);
+    return 0;
+  }
+
+  if (info->format == MIPS_JUMP)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    return jump(info->opcode, operands[0]);
+  }
+
+  // Everything else is registers and maybe one more operand
+  if (count != n && count != n + 1) { error("Wrong number of operands"); return -1; }
+  if (get_registers(operands, n, regs) != 0) { return -1; }
+
+  switch(info->format)
+  {
+    case MIPS_RD_RS_RT:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      add_word(R_TYPE(info->opcode, regs[1], regs[2], regs[0], 0, info->function));
+      return 0;
+    case MIPS_RD_RT_RS:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      add_word(R_TYPE(0, regs[2], regs[1], regs[0], 0, info->function));
+      return 0;
+    case MIPS_RD_RT_SA:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      if (get_immediate(operands[2], &value, 0, 31) != 0) { return -1; }
+      add_word(R_TYPE(0, 0, regs[1], regs[0], value, info->function));
+      return 0;
+    case MIPS_RS_RT:
+      if (count != 2) { error("Instruction takes two operands"); return -1; }
+      add_word(R_TYPE(0, regs[0], regs[1], 0, 0, info->function));
+      return 0;
+    case MIPS_RD_RT:
+      if (count != 2) { error("Instruction takes two operands"); return -1; }
+      add_word(R_TYPE(info->opcode, 0, regs[1], regs[0], info->function, 0x20));
+      return 0;
+    case MIPS_RD:
+      if (count != 1) { error("Instruction takes one operand"); return -1; }
+      add_word(R_TYPE(0, 0, 0, regs[0], 0, info->function));
+      return 0;
+    case MIPS_RS:
+      if (count != 1) { error("Instruction takes one operand"); return -1; }
+      add_word(R_TYPE(0, regs[0], 0, 0, 0, info->function));
+      return 0;
+    case MIPS_RT_RS_SIMM:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      if (get_immediate(operands[2], &value, -32768, 32767) != 0) { return -1; }
+      add_word(I_TYPE(info->opcode, regs[1], regs[0], value));
+      return 0;
+    case MIPS_RT_RS_UIMM:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      if (get_immediate(operands[2], &value, 0, 65535) != 0) { return -1; }
+      add_word(I_TYPE(info->opcode, regs[1], regs[0], value));
+      return 0;
+    case MIPS_RT_IMM:
+      if (count != 2) { error("Instruction takes two operands"); return -1; }
+      if (get_immediate(operands[1], &value, 0, 65535) != 0) { return -1; }
+      add_word(I_TYPE(info->opcode, 0, regs[0], value));
+      return 0;
+    case MIPS_RT_MEM:
+    {
+      int base;
+
+      if (count != 2) { error("Instruction takes two operands"); return -1; }
+      if (get_memory(operands[1], &base, &value) != 0) { return -1; }
+      add_word(I_TYPE(info->opcode, base, regs[0], value));
+      return 0;
+    }
+    case MIPS_BRANCH_RS_RT:
+      if (count != 3) { error("Instruction takes three operands"); return -1; }
+      return branch(info->opcode, regs[0], regs[1], operands[2]);
+    case MIPS_BRANCH_RS:
+      if (count != 2) { error("Instruction takes two operands"); return -1; }
+      return branch(info->opcode, regs[0], info->function, operands[1]);
+  }
+
+  error("Unknown instruction");
+
+  return -1;
+}
+
+int AssemblerMIPS::directive(char *name, char *operands[], int count)
+{
+int32_t value;
+int n;
+
+  if (strcmp(name, ".mips32") == 0) { return 0; }
+
+  if (strcmp(name, "dc32") == 0 || strcmp(name, ".dc32") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (eval(operands[n], &value, NULL) != 0) { return -2; }
+      add_word(value);
+    }
+
+    return 0;
+  }
+
+  if (strcmp(name, "dc16") == 0 || strcmp(name, ".dc16") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (eval(operands[n], &value, NULL) != 0) { return -2; }
+      write8(address++, value & 0xff);
+      write8(address++, (value >> 8) & 0xff);
+    }
+
+    return 0;
+  }
+
+  if (strcmp(name, "db") == 0 || strcmp(name, ".db") == 0 ||
+      strcmp(name, "dc8") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (eval(operands[n], &value, NULL) != 0) { return -2; }
+      write8(address++, value);
+    }
+
+    return 0;
+  }
+
+  return -1;
+}
+
+// $0 to $31 or the ABI names ($fp is also $s8)
+int AssemblerMIPS::get_register(const char *text)
+{
+int n;
+
+  if (text[0] != '$') { return -1; }
+  text++;
+
+  if (isdigit(text[0]))
+  {
+    n = atoi(text);
+    if (n > 31) { return -1; }
+    while (isdigit(*text)) { text++; }
+    return *text == 0 ? n : -1;
+  }
+
+  if (strcmp(text, "s8") == 0) { return 30; }
+
+  for (n = 0; n < 32; n++)
+  {
+    if (strcmp(mips_reg_names[n], text) == 0) { return n; }
+  }
+
+  return -1;
+}
+
+int AssemblerMIPS::get_registers(char *operands[], int count, int *regs)
+{
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    regs[n] = get_register(operands[n]);
+
+    if (regs[n] == -1)
+    {
+      error("Bad register");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// offset($reg) where offset can be left out
+int AssemblerMIPS::get_memory(const char *text, int *base, int32_t *offset)
+{
+char expr[256];
+const char *paren = strrchr(text, '(');
+int len;
+
+  if (paren == NULL || text[strlen(text) - 1] != ')')
+  {
+    error("Bad memory operand");
+    return -1;
+  }
+
+  len = paren - text;
+  if (len >= (int)sizeof(expr)) { error("Bad memory operand"); return -1; }
+
+  memcpy(expr, paren + 1, strlen(paren + 1) - 1);
+  expr[strlen(paren + 1) - 1] = 0;
+
+  *base = get_register(expr);
+
+  if (*base == -1)
+  {
+    error("Bad register");
+    return -1;
+  }
+
+  *offset = 0;
+
+  if (len == 0) { return 0; }
+
+  memcpy(expr, text, len);
+  expr[len] = 0;
+
+  return get_immediate(expr, offset, -32768, 32767);
+}
+
+// Labels aren't known until pass 2 so they're only checked then
+int AssemblerMIPS::get_immediate(const char *text, int32_t *value, int32_t min, int32_t max)
+{
+bool uses_label;
+
+  if (eval(text, value, &uses_label) != 0) { return -1; }
+
+  if ((pass == 2 || !uses_label) && (*value < min || *value > max))
+  {
+    error("Constant out of range");
+    return -1;
+  }
+
+  return 0;
+}
+
+// The offset is in instructions from the delay slot
+int AssemblerMIPS::branch(int opcode, int rs, int rt, const char *text)
+{
+int32_t target;
+int32_t offset;
+
+  if (eval(text, &target, NULL) != 0) { return -1; }
+
+  offset = (int32_t)(target - (address + 4)) >> 2;
+
+  if (pass == 2 && (offset < -32768 || offset > 32767 || (target & 3) != 0))
+  {
+    error("Branch out of range");
+    return -1;
+  }
+
+  add_word(I_TYPE(opcode, rs, rt, offset));
+
+  return 0;
+}
+
+// j and jal keep the top 4 bits of the address of the delay slot
+int AssemblerMIPS::jump(int opcode, const char *text)
+{
+int32_t target;
+
+  if (eval(text, &target, NULL) != 0) { return -1; }
+
+  if (pass == 2 && ((((uint32_t)target ^ (address + 4)) & 0xf0000000) != 0 || (target & 3) != 0))
+  {
+    error("Jump out of range");
+    return -1;
+  }
+
+  add_word((opcode << 26) | (((uint32_t)target >> 2) & 0x3ffffff));
+
+  return 0;
+}
+
+void AssemblerMIPS::add_word(uint32_t data)
+{
+  write8(address++, data & 0xff);
+  write8(address++, (data >> 8) & 0xff);
+  write8(address++, (data >> 16) & 0xff);
+  write8(address++, data >> 24);
+}
+
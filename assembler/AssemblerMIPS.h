@@ -0,0 +1,41 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _ASSEMBLER_MIPS_H
+#define _ASSEMBLER_MIPS_H
+
+#include "Assembler.h"
+
+// MIPS32 as used by the PIC32MX (little endian).  Only the integer
+// instructions and the la pseudo instruction the generator emits.
+
+class AssemblerMIPS : public Assembler
+{
+public:
+  AssemblerMIPS();
+  virtual ~AssemblerMIPS();
+
+protected:
+  virtual int instruction(char *instr, char *operands[], int count);
+  virtual int directive(char *name, char *operands[], int count);
+
+private:
+  int get_register(const char *text);
+  int get_registers(char *operands[], int count, int *regs);
+  int get_memory(const char *text, int *base, int32_t *offset);
+  int get_immediate(const char *text, int32_t *value, int32_t min, int32_t max);
+  int branch(int opcode, int rs, int rt, const char *text);
+  int jump(int opcode, const char *text);
+  void add_word(uint32_t data);
+};
+
+#endif
+
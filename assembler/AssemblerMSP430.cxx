@@ -0,0 +1,1006 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "AssemblerMSP430.h"
+
+struct msp430_define_t
+{
+  const char *name;
+  uint16_t value;
+};
+
+// The part of msp430x2xx.inc the generator uses
+static msp430_define_t msp430x2xx_inc[] =
+{
+  { "P1IN", 0x0020 },
+  { "P1OUT", 0x0021 },
+  { "P1DIR", 0x0022 },
+  { "P1IFG", 0x0023 },
+  { "P1IES", 0x0024 },
+  { "P1IE", 0x0025 },
+  { "P1SEL", 0x0026 },
+  { "P1REN", 0x0027 },
+  { "P2IN", 0x0028 },
+  { "P2OUT", 0x0029 },
+  { "P2DIR", 0x002a },
+  { "P2IFG", 0x002b },
+  { "P2IES", 0x002c },
+  { "P2IE", 0x002d },
+  { "P2SEL", 0x002e },
+  { "P2REN", 0x002f },
+  { "DCOCTL", 0x0056 },
+  { "BCSCTL1", 0x0057 },
+  { "BCSCTL2", 0x0058 },
+  { "USICTL0", 0x0078 },
+  { "USICTL1", 0x0079 },
+  { "USICKCTL", 0x007a },
+  { "USICNT", 0x007b },
+  { "USISRL", 0x007c },
+  { "USISRH", 0x007d },
+  { "WDTCTL", 0x0120 },
+  { "WDTPW", 0x5a00 },
+  { "WDTHOLD", 0x0080 },
+  { "MPY", 0x0130 },       // hardware multiplier on the 2xx parts that have one
+  { "MPYS", 0x0132 },
+  { "MAC", 0x0134 },
+  { "MACS", 0x0136 },
+  { "OP2", 0x0138 },
+  { "RESLO", 0x013a },
+  { "RESHI", 0x013c },
+  { "SUMEXT", 0x013e },
+  { "USIPE7", 0x80 },
+  { "USIPE6", 0x40 },
+  { "USIPE5", 0x20 },
+  { "USILSB", 0x10 },
+  { "USIMST", 0x08 },
+  { "USIGE", 0x04 },
+  { "USIOE", 0x02 },
+  { "USISWRST", 0x01 },
+  { "USICKPH", 0x80 },
+  { "USII2C", 0x40 },
+  { "USISTTIE", 0x20 },
+  { "USIIE", 0x10 },
+  { "USIAL", 0x08 },
+  { "USISTP", 0x04 },
+  { "USISTTIFG", 0x02 },
+  { "USIIFG", 0x01 },
+  { "USICKPL", 0x02 },
+  { "USISWCLK", 0x01 },
+  { NULL, 0 }
+};
+
+// The part of msp430fr5969.inc the generator uses.  The FR5xx family
+// moved everything: ports are at 0x0200, the watchdog at 0x015c, MPY32
+// at 0x04c0, and SPI is on eUSCI_B0 instead of the USI.
+static msp430_define_t msp430fr5969_inc[] =
+{
+  { "P1IN", 0x0200 },
+  { "P2IN", 0x0201 },
+  { "P1OUT", 0x0202 },
+  { "P2OUT", 0x0203 },
+  { "P1DIR", 0x0204 },
+  { "P2DIR", 0x0205 },
+  { "P1REN", 0x0206 },
+  { "P2REN", 0x0207 },
+  { "P1SEL0", 0x020a },
+  { "P2SEL0", 0x020b },
+  { "P1SEL1", 0x020c },
+  { "P2SEL1", 0x020d },
+  { "PM5CTL0", 0x0130 },
+  { "LOCKLPM5", 0x0001 },
+  { "FRCTL0", 0x0140 },
+  { "FRCTLPW", 0xa500 },
+  { "NWAITS_1", 0x0010 },
+  { "WDTCTL", 0x015c },
+  { "WDTPW", 0x5a00 },
+  { "WDTHOLD", 0x0080 },
+  { "CSCTL0", 0x0160 },
+  { "CSCTL1", 0x0162 },
+  { "CSCTL2", 0x0164 },
+  { "CSCTL3", 0x0166 },
+  { "CSKEY", 0xa500 },
+  { "DCORSEL", 0x0040 },
+  { "DCOFSEL_4", 0x0008 },
+  { "MPY", 0x04c0 },
+  { "MPYS", 0x04c2 },
+  { "MAC", 0x04c4 },
+  { "MACS", 0x04c6 },
+  { "OP2", 0x04c8 },
+  { "RESLO", 0x04ca },
+  { "RESHI", 0x04cc },
+  { "SUMEXT", 0x04ce },
+  { "UCB0CTLW0", 0x0640 },
+  { "UCB0BRW", 0x0646 },
+  { "UCB0STATW", 0x0648 },
+  { "UCB0RXBUF", 0x064c },
+  { "UCB0TXBUF", 0x064e },
+  { "UCB0IFG", 0x066c },
+  { "UCSWRST", 0x0001 },
+  { "UCSSEL__SMCLK", 0x00c0 },
+  { "UCSYNC", 0x0100 },
+  { "UCMST", 0x0800 },
+  { "UCMSB", 0x2000 },
+  { "UCCKPL", 0x4000 },
+  { "UCCKPH", 0x8000 },
+  { "UCBUSY", 0x0001 },
+  { "UCRXIFG", 0x0001 },
+  { "UCTXIFG", 0x0002 },
+  { NULL, 0 }
+};
+
+static const char *msp430_double_operand[] =
+{
+  "mov", "add", "addc", "subc", "sub", "cmp", "dadd", "bit", "bic", "bis",
+  "xor", "and", NULL
+};
+
+static const char *msp430_single_operand[] =
+{
+  "rrc", "swpb", "rra", "sxt", "push", "call", "reti", NULL
+};
+
+static const char *msp430_jump[] =
+{
+  "jne", "jeq", "jnc", "jc", "jn", "jge", "jl", "jmp", NULL
+};
+
+struct msp430_alias_t
+{
+  const char *name;
+  const char *instr;
+  int cond;
+};
+
+static msp430_alias_t msp430_jump_alias[] =
+{
+  { "jnz", "jne", 0 },
+  { "jz", "jeq", 1 },
+  { "jlo", "jnc", 2 },
+  { "jhs", "jc", 3 },
+  { NULL, NULL, 0 }
+};
+
+// Emulated instructions with a source operand built in:
+// "inc dst" is "add #1, dst"
+struct msp430_emulated_t
+{
+  const char *name;
+  const char *instr;
+  int constant;
+};
+
+static msp430_emulated_t msp430_emulated[] =
+{
+  { "adc", "addc", 0 },
+  { "dadc", "dadd", 0 },
+  { "dec", "sub", 1 },
+  { "decd", "sub", 2 },
+  { "inc", "add", 1 },
+  { "incd", "add", 2 },
+  { "sbc", "subc", 0 },
+  { "inv", "xor", -1 },
+  { "tst", "cmp", 0 },
+  { "clr", "mov", 0 },
+  { NULL, NULL, 0 }
+};
+
+// Emulated instructions that set or clear bits in SR
+static msp430_emulated_t msp430_emulated_sr[] =
+{
+  { "clrc", "bic", 1 },
+  { "setc", "bis", 1 },
+  { "clrz", "bic", 2 },
+  { "setz", "bis", 2 },
+  { "clrn", "bic", 4 },
+  { "setn", "bis", 4 },
+  { "dint", "bic", 8 },
+  { "eint", "bis", 8 },
+  { NULL, NULL, 0 }
+};
+
+// MSP430X rotate by 1 to 4 bits
+static const char *msp430x_rotate[] =
+{
+  "rrcm", "rram", "rlam", "rrum", NULL
+};
+
+static int find_instr(const char **table, const char *name)
+{
+int n;
+
+  for (n = 0; table[n] != NULL; n++)
+  {
+    if (strcmp(table[n], name) == 0) { return n; }
+  }
+
+  return -1;
+}
+
+AssemblerMSP430::AssemblerMSP430() :
+  rpt_end(0xffffffff)
+{
+}
+
+AssemblerMSP430::~AssemblerMSP430()
+{
+}
+
+int AssemblerMSP430::instruction(char *instr, char *operands[], int count)
+{
+msp430_operand_t operand[2];
+char name[16];
+char *suffix;
+int bw = 0;
+int al = 0;
+int n;
+
+  strncpy(name, instr, sizeof(name) - 1);
+  name[sizeof(name) - 1] = 0;
+
+  suffix = strchr(name, '.');
+
+  if (suffix != NULL)
+  {
+    if (strcmp(suffix, ".b") == 0) { bw = 1; }
+    else if (strcmp(suffix, ".w") == 0) { bw = 0; }
+    else if (strcmp(suffix, ".a") == 0) { al = 1; }
+    else { error("Unknown instruction size"); return -1; }
+    *suffix = 0;
+  }
+
+  if (count > 2)
+  {
+    error("Too many operands");
+    return -1;
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    if (parse_operand(operands[n], &operand[n]) != 0) { return -1; }
+  }
+
+  if (strcmp(name, "nop") == 0 && count == 0)
+  {
+    add_word(0x4303);
+    return 0;
+  }
+
+  if (strcmp(name, "ret") == 0 && count == 0)
+  {
+    add_word(0x4130);
+    return 0;
+  }
+
+  if (strcmp(name, "reti") == 0 && count == 0)
+  {
+    add_word(0x1300);
+    return 0;
+  }
+
+  // MSP430X: pushm.a / popm.a are the only ones that take .a
+  if (strcmp(name, "pushm") == 0 || strcmp(name, "popm") == 0)
+  {
+    if (count != 2) { error("Instruction takes two operands"); return -1; }
+    return push_pop_multiple(name, al, &operand[0], &operand[1]);
+  }
+
+  if (al == 1) { error(".a not allowed here"); return -1; }
+
+  if (strcmp(name, "reta") == 0 && count == 0)
+  {
+    add_word(0x0110);
+    return 0;
+  }
+
+  if (strcmp(name, "calla") == 0 || strcmp(name, "bra") == 0)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    return address_instr(name, &operand[0], NULL);
+  }
+
+  if (strcmp(name, "mova") == 0)
+  {
+    if (count != 2) { error("Instruction takes two operands"); return -1; }
+    return address_instr(name, &operand[0], &operand[1]);
+  }
+
+  n = find_instr(msp430_double_operand, name);
+
+  if (n != -1)
+  {
+    if (count != 2) { error("Instruction takes two operands"); return -1; }
+    return double_operand(n + 4, bw, &operand[0], &operand[1]);
+  }
+
+  n = find_instr(msp430_single_operand, name);
+
+  if (n != -1)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    return single_operand(n, bw, &operand[0]);
+  }
+
+  n = find_instr(msp430_jump, name);
+
+  if (n == -1)
+  {
+    for (int i = 0; msp430_jump_alias[i].name != NULL; i++)
+    {
+      if (strcmp(msp430_jump_alias[i].name, name) == 0)
+      {
+        n = msp430_jump_alias[i].cond;
+        break;
+      }
+    }
+  }
+
+  if (n != -1)
+  {
+    if (count != 1) { error("Jump takes one operand"); return -1; }
+    return jump(n, &operand[0]);
+  }
+
+  for (n = 0; msp430_emulated[n].name != NULL; n++)
+  {
+    if (strcmp(msp430_emulated[n].name, name) == 0)
+    {
+      msp430_operand_t src;
+
+      if (count != 1) { error("Instruction takes one operand"); return -1; }
+
+      src.type = MSP430_OPERAND_IMMEDIATE;
+      src.reg = 0;
+      src.value = msp430_emulated[n].constant;
+      src.uses_label = false;
+      src.extern_symbol = -1;
+
+      return double_operand(find_instr(msp430_double_operand, msp430_emulated[n].instr) + 4, bw, &src, &operand[0]);
+    }
+  }
+
+  for (n = 0; msp430_emulated_sr[n].name != NULL; n++)
+  {
+    if (strcmp(msp430_emulated_sr[n].name, name) == 0)
+    {
+      msp430_operand_t src,dst;
+
+      if (count != 0) { error("Instruction takes no operands"); return -1; }
+
+      src.type = MSP430_OPERAND_IMMEDIATE;
+      src.reg = 0;
+      src.value = msp430_emulated_sr[n].constant;
+      src.uses_label = false;
+      src.extern_symbol = -1;
+      dst.type = MSP430_OPERAND_REGISTER;
+      dst.reg = 2;
+      dst.value = 0;
+      dst.uses_label = false;
+      dst.extern_symbol = -1;
+
+      return double_operand(find_instr(msp430_double_operand, msp430_emulated_sr[n].instr) + 4, 0, &src, &dst);
+    }
+  }
+
+  if (strcmp(name, "rla") == 0 || strcmp(name, "rlc") == 0)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+    return double_operand(name[2] == 'a' ? 5 : 6, bw, &operand[0], &operand[0]);
+  }
+
+  if (strcmp(name, "pop") == 0)
+  {
+    msp430_operand_t src;
+
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+
+    src.type = MSP430_OPERAND_INDIRECT_INC;
+    src.reg = 1;
+    src.value = 0;
+    src.uses_label = false;
+    src.extern_symbol = -1;
+
+    return double_operand(4, bw, &src, &operand[0]);
+  }
+
+  if (strcmp(name, "br") == 0)
+  {
+    msp430_operand_t dst;
+
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+
+    dst.type = MSP430_OPERAND_REGISTER;
+    dst.reg = 0;
+    dst.value = 0;
+    dst.uses_label = false;
+    dst.extern_symbol = -1;
+
+    return double_operand(4, 0, &operand[0], &dst);
+  }
+
+  // MSP430X: repeat the next instruction Rn[3:0]+1 or #n times.  This is
+  // the extension word on its own so the instruction after it gets it.
+  // A/L is set since only .w register instructions follow it.
+  if (strcmp(name, "repeat") == 0 || strcmp(name, "rpt") == 0)
+  {
+    if (count != 1) { error("Instruction takes one operand"); return -1; }
+
+    if (operand[0].type == MSP430_OPERAND_REGISTER)
+    {
+      add_word(0x18c0 | operand[0].reg);
+      rpt_end = address;
+      return 0;
+    }
+
+    if (operand[0].type == MSP430_OPERAND_IMMEDIATE &&
+        operand[0].value >= 1 && operand[0].value <= 16)
+    {
+      add_word(0x1840 | (operand[0].value - 1));
+      rpt_end = address;
+      return 0;
+    }
+
+    error("Bad repeat count");
+    return -1;
+  }
+
+  // MSP430X register rla / rra / rrc.  Right after rpt its extension
+  // word is the one this uses.
+  if (strcmp(name, "rlax") == 0 || strcmp(name, "rrax") == 0 ||
+      strcmp(name, "rrcx") == 0)
+  {
+    if (count != 1 || operand[0].type != MSP430_OPERAND_REGISTER)
+    {
+      error("Instruction takes a register");
+      return -1;
+    }
+
+    if (bw == 1) { error(".b not allowed here"); return -1; }
+    if (rpt_end != address) { add_word(0x1840); }
+
+    if (name[1] == 'l') { return double_operand(5, 0, &operand[0], &operand[0]); }
+
+    return single_operand(name[2] == 'a' ? 2 : 0, 0, &operand[0]);
+  }
+
+  n = find_instr(msp430x_rotate, name);
+
+  if (n != -1)
+  {
+    if (count != 2 ||
+        operand[0].type != MSP430_OPERAND_IMMEDIATE ||
+        operand[0].value < 1 || operand[0].value > 4 ||
+        operand[1].type != MSP430_OPERAND_REGISTER)
+    {
+      error("Instruction takes #1 to #4 and a register");
+      return -1;
+    }
+
+    if (bw == 1) { error(".b not allowed here"); return -1; }
+
+    add_word(((operand[0].value - 1) << 10) | (n << 8) | 0x0050 | operand[1].reg);
+
+    return 0;
+  }
+
+  char message[64];
+  snprintf(message, sizeof(message), "Unknown instruction '%s'", instr);
+  error(message);
+
+  return -1;
+}
+
+int AssemblerMSP430::include(const char *filename)
+{
+int n;
+
+  if (strcmp(filename, "msp430fr5969.inc") == 0)
+  {
+    for (n = 0; msp430fr5969_inc[n].name != NULL; n++)
+    {
+      define(msp430fr5969_inc[n].name, msp430fr5969_inc[n].value);
+    }
+
+    return 0;
+  }
+
+  if (strcmp(filename, "msp430x2xx.inc") != 0) { return -1; }
+
+  for (n = 0; msp430x2xx_inc[n].name != NULL; n++)
+  {
+    define(msp430x2xx_inc[n].name, msp430x2xx_inc[n].value);
+  }
+
+  for (n = 0; n < 8; n++)
+  {
+    char name[16];
+
+    sprintf(name, "USIDIV_%d", n);
+    define(name, n << 5);
+    sprintf(name, "USISSEL_%d", n);
+    define(name, n << 2);
+    sprintf(name, "DCO_%d", n);
+    define(name, n << 5);
+  }
+
+  for (n = 0; n < 16; n++)
+  {
+    char name[16];
+
+    sprintf(name, "RSEL_%d", n);
+    define(name, n);
+  }
+
+  return 0;
+}
+
+int AssemblerMSP430::directive(char *name, char *operands[], int count)
+{
+int32_t value;
+int n;
+
+  if (strcmp(name, ".msp430") == 0 || strcmp(name, ".msp430x") == 0)
+  {
+    return 0;
+  }
+
+  if (strcmp(name, "dw") == 0 || strcmp(name, ".dw") == 0 ||
+      strcmp(name, "dc16") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      bool uses_label;
+
+      if (eval(operands[n], &value, &uses_label) != 0) { return -2; }
+      if (uses_label) { add_reloc(address, R_MSP430_ABS16, value, get_eval_extern(), false); }
+      add_word(value);
+    }
+
+    return 0;
+  }
+
+  if (strcmp(name, "db") == 0 || strcmp(name, ".db") == 0 ||
+      strcmp(name, "dc8") == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (eval(operands[n], &value, NULL) != 0) { return -2; }
+      write8(address++, value);
+    }
+
+    return 0;
+  }
+
+  return -1;
+}
+
+int AssemblerMSP430::parse_operand(const char *text, msp430_operand_t *operand)
+{
+char expr[256];
+const char *paren;
+
+  operand->reg = 0;
+  operand->value = 0;
+  operand->uses_label = false;
+  operand->extern_symbol = -1;
+
+  if (text[0] == '#')
+  {
+    operand->type = MSP430_OPERAND_IMMEDIATE;
+    return eval_operand(text + 1, operand);
+  }
+
+  if (text[0] == '&')
+  {
+    operand->type = MSP430_OPERAND_ABSOLUTE;
+    operand->reg = 2;
+    return eval_operand(text + 1, operand);
+  }
+
+  if (text[0] == '@')
+  {
+    int len = strlen(text);
+
+    if (text[len - 1] == '+')
+    {
+      operand->type = MSP430_OPERAND_INDIRECT_INC;
+      strncpy(expr, text + 1, len - 2);
+      expr[len - 2] = 0;
+    }
+      else
+    {
+      operand->type = MSP430_OPERAND_INDIRECT;
+      strcpy(expr, text + 1);
+    }
+
+    operand->reg = get_register(expr);
+
+    if (operand->reg == -1)
+    {
+      error("Expected register after @");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  operand->reg = get_register(text);
+
+  if (operand->reg != -1)
+  {
+    operand->type = MSP430_OPERAND_REGISTER;
+    return 0;
+  }
+
+  // x(Rn)
+  paren = strrchr(text, '(');
+
+  if (paren != NULL && paren != text && text[strlen(text) - 1] == ')')
+  {
+    int len = paren - text;
+
+    strncpy(expr, paren + 1, sizeof(expr) - 1);
+    expr[sizeof(expr) - 1] = 0;
+    expr[strlen(expr) - 1] = 0;
+    operand->reg = get_register(expr);
+
+    if (operand->reg != -1)
+    {
+      operand->type = MSP430_OPERAND_INDEXED;
+      strncpy(expr, text, len);
+      expr[len] = 0;
+      return eval_operand(expr, operand);
+    }
+  }
+
+  operand->type = MSP430_OPERAND_SYMBOLIC;
+  return eval_operand(text, operand);
+}
+
+int AssemblerMSP430::eval_operand(const char *text, msp430_operand_t *operand)
+{
+  if (eval(text, &operand->value, &operand->uses_label) != 0) { return -1; }
+
+  operand->extern_symbol = get_eval_extern();
+
+  return 0;
+}
+
+// In relocatable output every extension word that came from a label
+// gets a relocation.  The ELF writer drops the PC relative ones that
+// stay inside a function.
+void AssemblerMSP430::add_operand_reloc(msp430_operand_t *operand, uint32_t address)
+{
+  if (!operand->uses_label) { return; }
+
+  switch(operand->type)
+  {
+    case MSP430_OPERAND_INDEXED:
+    case MSP430_OPERAND_ABSOLUTE:
+    case MSP430_OPERAND_IMMEDIATE:
+      add_reloc(address, R_MSP430_ABS16, operand->value, operand->extern_symbol, false);
+      break;
+    case MSP430_OPERAND_SYMBOLIC:
+      add_reloc(address, R_MSP430_PCR16, operand->value, operand->extern_symbol, true);
+      break;
+  }
+}
+
+int AssemblerMSP430::get_register(const char *text)
+{
+char *end;
+int reg;
+
+  if (strcasecmp(text, "pc") == 0) { return 0; }
+  if (strcasecmp(text, "sp") == 0) { return 1; }
+  if (strcasecmp(text, "sr") == 0) { return 2; }
+  if (strcasecmp(text, "cg") == 0) { return 3; }
+
+  if (text[0] != 'r' && text[0] != 'R') { return -1; }
+  if (!isdigit(text[1])) { return -1; }
+
+  reg = strtol(text + 1, &end, 10);
+  if (*end != 0 || reg > 15) { return -1; }
+
+  return reg;
+}
+
+// Returns the number of extension words (0 or 1)
+int AssemblerMSP430::encode_source(msp430_operand_t *operand, int bw, int *as, int *reg, int *ext, uint32_t ext_address)
+{
+  *reg = operand->reg;
+
+  switch(operand->type)
+  {
+    case MSP430_OPERAND_REGISTER:
+      *as = 0;
+      return 0;
+    case MSP430_OPERAND_INDEXED:
+      *as = 1;
+      *ext = operand->value;
+      return 1;
+    case MSP430_OPERAND_SYMBOLIC:
+      *as = 1;
+      *reg = 0;
+      *ext = operand->value - ext_address;
+      return 1;
+    case MSP430_OPERAND_ABSOLUTE:
+      *as = 1;
+      *reg = 2;
+      *ext = operand->value;
+      return 1;
+    case MSP430_OPERAND_INDIRECT:
+      *as = 2;
+      return 0;
+    case MSP430_OPERAND_INDIRECT_INC:
+      *as = 3;
+      return 0;
+    case MSP430_OPERAND_IMMEDIATE:
+      // Constant generator.  A label could still move so the size of
+      // the instruction can't depend on one.
+      if (!operand->uses_label)
+      {
+        int value = bw == 1 ? (int8_t)operand->value : (int16_t)operand->value;
+
+        switch(value)
+        {
+          case 0: *reg = 3; *as = 0; return 0;
+          case 1: *reg = 3; *as = 1; return 0;
+          case 2: *reg = 3; *as = 2; return 0;
+          case -1: *reg = 3; *as = 3; return 0;
+          case 4: *reg = 2; *as = 2; return 0;
+          case 8: *reg = 2; *as = 3; return 0;
+        }
+      }
+
+      *as = 3;
+      *reg = 0;
+      *ext = operand->value;
+      return 1;
+  }
+
+  return -1;
+}
+
+int AssemblerMSP430::encode_dest(msp430_operand_t *operand, int *ad, int *reg, int *ext, uint32_t ext_address)
+{
+  *reg = operand->reg;
+
+  switch(operand->type)
+  {
+    case MSP430_OPERAND_REGISTER:
+      *ad = 0;
+      return 0;
+    case MSP430_OPERAND_INDIRECT:
+      // Only indexed mode exists for a destination so @Rn is 0(Rn)
+      *ad = 1;
+      *ext = 0;
+      return 1;
+    case MSP430_OPERAND_INDEXED:
+      *ad = 1;
+      *ext = operand->value;
+      return 1;
+    case MSP430_OPERAND_SYMBOLIC:
+      *ad = 1;
+      *reg = 0;
+      *ext = operand->value - ext_address;
+      return 1;
+    case MSP430_OPERAND_ABSOLUTE:
+      *ad = 1;
+      *reg = 2;
+      *ext = operand->value;
+      return 1;
+  }
+
+  error("Bad destination operand");
+
+  return -1;
+}
+
+int AssemblerMSP430::double_operand(int opcode, int bw, msp430_operand_t *src, msp430_operand_t *dst)
+{
+int as,ad,sreg,dreg;
+int src_ext = 0,dst_ext = 0;
+int src_count,dst_count;
+
+  src_count = encode_source(src, bw, &as, &sreg, &src_ext, address + 2);
+  if (src_count < 0) { return -1; }
+
+  dst_count = encode_dest(dst, &ad, &dreg, &dst_ext, address + 2 + src_count * 2);
+  if (dst_count < 0) { return -1; }
+
+  add_word((opcode << 12) | (sreg << 8) | (ad << 7) | (bw << 6) | (as << 4) | dreg);
+  if (src_count == 1) { add_operand_reloc(src, address); add_word(src_ext); }
+  if (dst_count == 1) { add_operand_reloc(dst, address); add_word(dst_ext); }
+
+  return 0;
+}
+
+int AssemblerMSP430::single_operand(int opcode, int bw, msp430_operand_t *operand)
+{
+int as,reg;
+int ext = 0;
+int count;
+
+  if (operand->type == MSP430_OPERAND_INDIRECT_INC && opcode < 4)
+  {
+    error("Bad operand");
+    return -1;
+  }
+
+  count = encode_source(operand, bw, &as, &reg, &ext, address + 2);
+  if (count < 0) { return -1; }
+
+  // rrc/rra/sxt/swpb write the operand back so it can't be a constant
+  if (opcode < 4 && (operand->type == MSP430_OPERAND_IMMEDIATE))
+  {
+    error("Bad operand");
+    return -1;
+  }
+
+  add_word(0x1000 | (opcode << 7) | (bw << 6) | (as << 4) | reg);
+  if (count == 1) { add_operand_reloc(operand, address); add_word(ext); }
+
+  return 0;
+}
+
+int AssemblerMSP430::jump(int cond, msp430_operand_t *operand)
+{
+int offset;
+
+  if (operand->type != MSP430_OPERAND_SYMBOLIC)
+  {
+    error("Bad jump target");
+    return -1;
+  }
+
+  if (operand->extern_symbol != -1)
+  {
+    error("Jump to an extern symbol");
+    return -1;
+  }
+
+  offset = (operand->value - (int32_t)(address + 2)) / 2;
+
+  if (operand->uses_label)
+  {
+    add_reloc(address, R_MSP430X_10_PCREL, operand->value, -1, true);
+  }
+
+  if (pass == 2 && (offset < -512 || offset > 511))
+  {
+    error("Jump out of range");
+    return -1;
+  }
+
+  add_word(0x2000 | (cond << 10) | (offset & 0x3ff));
+
+  return 0;
+}
+
+// MSP430X 20 bit address instructions.  Only the forms java_grinder
+// writes are here:  calla Rn / #imm, bra Rn / #imm and mova from #imm,
+// Rn, @Rn or @Rn+ into a register.  bra is mova into PC.  The top 4
+// bits of an immediate go in the opcode.
+int AssemblerMSP430::address_instr(const char *name, msp430_operand_t *src, msp430_operand_t *dst)
+{
+msp430_operand_t pc;
+uint32_t value = src->value & 0xfffff;
+int opcode_address = address;
+
+  if (strcmp(name, "calla") == 0)
+  {
+    if (src->type == MSP430_OPERAND_REGISTER)
+    {
+      add_word(0x1340 | src->reg);
+      return 0;
+    }
+
+    if (src->type != MSP430_OPERAND_IMMEDIATE)
+    {
+      error("Bad calla operand");
+      return -1;
+    }
+
+    if (src->uses_label)
+    {
+      add_reloc(opcode_address, R_MSP430X_ABS20_ADR_DST, src->value, src->extern_symbol, false);
+    }
+
+    add_word(0x13b0 | (value >> 16));
+    add_word(value & 0xffff);
+
+    return 0;
+  }
+
+  if (dst == NULL)
+  {
+    pc.type = MSP430_OPERAND_REGISTER;
+    pc.reg = 0;
+    pc.value = 0;
+    pc.uses_label = false;
+    pc.extern_symbol = -1;
+    dst = &pc;
+  }
+
+  if (dst->type != MSP430_OPERAND_REGISTER)
+  {
+    error("Bad mova destination");
+    return -1;
+  }
+
+  switch(src->type)
+  {
+    case MSP430_OPERAND_IMMEDIATE:
+      if (src->uses_label)
+      {
+        add_reloc(opcode_address, R_MSP430X_ABS20_ADR_SRC, src->value, src->extern_symbol, false);
+      }
+
+      add_word(0x0080 | ((value >> 16) << 8) | dst->reg);
+      add_word(value & 0xffff);
+      return 0;
+    case MSP430_OPERAND_REGISTER:
+      add_word(0x00c0 | (src->reg << 8) | dst->reg);
+      return 0;
+    case MSP430_OPERAND_INDIRECT:
+      add_word(0x0000 | (src->reg << 8) | dst->reg);
+      return 0;
+    case MSP430_OPERAND_INDIRECT_INC:
+      add_word(0x0010 | (src->reg << 8) | dst->reg);
+      return 0;
+  }
+
+  error("Bad mova source");
+
+  return -1;
+}
+
+// pushm #n, Rn pushes Rn down to Rn-n+1 and popm #n, Rn pops them back.
+// popm's opcode has the lowest register in it.
+int AssemblerMSP430::push_pop_multiple(const char *name, int al, msp430_operand_t *count, msp430_operand_t *reg)
+{
+int n = count->value;
+int opcode;
+
+  if (count->type != MSP430_OPERAND_IMMEDIATE ||
+      reg->type != MSP430_OPERAND_REGISTER ||
+      n < 1 || n > 16 || reg->reg - n + 1 < 0)
+  {
+    error("Instruction takes #1 to #16 and a register");
+    return -1;
+  }
+
+  if (strcmp(name, "pushm") == 0)
+  {
+    opcode = (al ? 0x1400 : 0x1500) | reg->reg;
+  }
+    else
+  {
+    opcode = (al ? 0x1600 : 0x1700) | (reg->reg - n + 1);
+  }
+
+  add_word(opcode | ((n - 1) << 4));
+
+  return 0;
+}
+
+void AssemblerMSP430::add_word(uint16_t data)
+{
+  write8(address++, data & 0xff);
+  write8(address++, data >> 8);
+}
+
@@ -0,0 +1,76 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _ASSEMBLER_MSP430_H
+#define _ASSEMBLER_MSP430_H
+
+#include "Assembler.h"
+
+enum
+{
+  MSP430_OPERAND_REGISTER,
+  MSP430_OPERAND_INDEXED,
+  MSP430_OPERAND_SYMBOLIC,
+  MSP430_OPERAND_ABSOLUTE,
+  MSP430_OPERAND_INDIRECT,
+  MSP430_OPERAND_INDIRECT_INC,
+  MSP430_OPERAND_IMMEDIATE,
+};
+
+struct msp430_operand_t
+{
+  int type;
+  int reg;
+  int32_t value;
+  bool uses_label;
+  int extern_symbol;    // symbol index if value is an offset from an extern
+};
+
+// ELF relocation types.  These are the TI EABI numbers which binutils
+// uses for objects with ELFOSABI_NONE like the ones write_elf() makes.
+#define R_MSP430_ABS16 2
+#define R_MSP430_PCR16 4
+#define R_MSP430X_ABS20_ADR_SRC 11
+#define R_MSP430X_ABS20_ADR_DST 12
+#define R_MSP430X_10_PCREL 19
+#define EM_MSP430 105
+
+class AssemblerMSP430 : public Assembler
+{
+public:
+  AssemblerMSP430();
+  virtual ~AssemblerMSP430();
+
+protected:
+  virtual int instruction(char *instr, char *operands[], int count);
+  virtual int include(const char *filename);
+  virtual int directive(char *name, char *operands[], int count);
+  virtual int get_elf_machine() { return EM_MSP430; }
+
+private:
+  int parse_operand(const char *text, msp430_operand_t *operand);
+  int eval_operand(const char *text, msp430_operand_t *operand);
+  void add_operand_reloc(msp430_operand_t *operand, uint32_t address);
+  int get_register(const char *text);
+  int encode_source(msp430_operand_t *operand, int bw, int *as, int *reg, int *ext, uint32_t ext_address);
+  int encode_dest(msp430_operand_t *operand, int *ad, int *reg, int *ext, uint32_t ext_address);
+  int double_operand(int opcode, int bw, msp430_operand_t *src, msp430_operand_t *dst);
+  int single_operand(int opcode, int bw, msp430_operand_t *operand);
+  int jump(int cond, msp430_operand_t *operand);
+  int address_instr(const char *name, msp430_operand_t *src, msp430_operand_t *dst);
+  int push_pop_multiple(const char *name, int al, msp430_operand_t *count, msp430_operand_t *reg);
+  void add_word(uint16_t data);
+
+  uint32_t rpt_end;     // address after the last rpt
+};
+
+#endif
+
@@ -0,0 +1,429 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "elf.h"
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_FUNC 2
+#define STT_SECTION 3
+
+#define ELF_HEADER_SIZE 52
+#define ELF_SECTION_SIZE 40
+#define ELF_SYMBOL_SIZE 16
+#define ELF_RELA_SIZE 12
+
+struct elf_buffer_t
+{
+  uint8_t *data;
+  int len;
+  int max;
+};
+
+struct elf_section_t
+{
+  int name;
+  int type;
+  int flags;
+  int link;
+  int info;
+  int align;
+  int entsize;
+  elf_buffer_t body;
+  int offset;
+};
+
+struct elf_function_t
+{
+  int symbol;           // assembler symbol index
+  uint32_t start;
+  uint32_t end;
+  int section;
+  int section_symbol;
+  elf_buffer_t rela;
+};
+
+static void buffer_add(elf_buffer_t *buffer, const void *data, int len)
+{
+  if (buffer->len + len > buffer->max)
+  {
+    buffer->max = (buffer->len + len) * 2 + 256;
+    buffer->data = (uint8_t *)realloc(buffer->data, buffer->max);
+  }
+
+  memcpy(buffer->data + buffer->len, data, len);
+  buffer->len += len;
+}
+
+static void buffer_add8(elf_buffer_t *buffer, uint8_t value)
+{
+  buffer_add(buffer, &value, 1);
+}
+
+static void buffer_add16(elf_buffer_t *buffer, uint16_t value)
+{
+uint8_t data[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+
+  buffer_add(buffer, data, 2);
+}
+
+static void buffer_add32(elf_buffer_t *buffer, uint32_t value)
+{
+uint8_t data[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+
+  buffer_add(buffer, data, 4);
+}
+
+static int buffer_string(elf_buffer_t *buffer, const char *text)
+{
+int offset = buffer->len;
+
+  buffer_add(buffer, text, strlen(text) + 1);
+
+  return offset;
+}
+
+static void add_symbol(elf_buffer_t *symtab, int name, uint32_t value, uint32_t size, int bind, int type, int section)
+{
+  buffer_add32(symtab, name);
+  buffer_add32(symtab, value);
+  buffer_add32(symtab, size);
+  buffer_add8(symtab, (bind << 4) | type);
+  buffer_add8(symtab, 0);
+  buffer_add16(symtab, section);
+}
+
+static elf_section_t *add_section(elf_section_t *sections, int *count, elf_buffer_t *shstrtab, const char *name, int type, int flags, int align)
+{
+elf_section_t *section = &sections[(*count)++];
+
+  memset(section, 0, sizeof(elf_section_t));
+  section->name = buffer_string(shstrtab, name);
+  section->type = type;
+  section->flags = flags;
+  section->align = align;
+
+  return section;
+}
+
+static elf_function_t *find_function(elf_function_t *functions, int count, uint32_t address)
+{
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    if (address >= functions[n].start && address < functions[n].end)
+    {
+      return &functions[n];
+    }
+  }
+
+  return NULL;
+}
+
+int write_elf(Assembler *assembler, const char *filename)
+{
+FILE *out;
+assembler_symbol_t *symbols;
+assembler_reloc_t *relocs;
+elf_function_t *functions;
+elf_section_t *sections;
+elf_buffer_t symtab = { NULL, 0, 0 };
+elf_buffer_t strtab = { NULL, 0, 0 };
+elf_buffer_t shstrtab = { NULL, 0, 0 };
+elf_buffer_t header = { NULL, 0, 0 };
+elf_section_t *section;
+elf_function_t *function = NULL;
+elf_function_t *target;
+int *extern_index;
+int symbol_count, reloc_count;
+int function_count = 0;
+int section_count = 1;
+int symtab_section, strtab_section, shstrtab_section;
+int first_global;
+int offset;
+int errors = 0;
+int data;
+int n, i;
+
+  symbols = assembler->get_symbols(&symbol_count);
+  relocs = assembler->get_relocs(&reloc_count);
+
+  functions = (elf_function_t *)calloc(symbol_count + 1, sizeof(elf_function_t));
+  extern_index = (int *)calloc(symbol_count + 1, sizeof(int));
+  sections = (elf_section_t *)calloc(symbol_count * 2 + 8, sizeof(elf_section_t));
+
+  // Section 0 is all zeros
+  buffer_string(&shstrtab, "");
+  buffer_string(&strtab, "");
+
+  // Labels are in the order they were in the source so a label either
+  // belongs to the function before it or starts a new one.
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label) { continue; }
+
+    if (function != NULL)
+    {
+      if (symbols[n].value == function->start) { continue; }
+      if (assembler->is_local_label(symbols[n].name, symbols[function->symbol].name)) { continue; }
+    }
+
+    function = &functions[function_count++];
+    function->symbol = n;
+    function->start = symbols[n].value;
+    function->end = assembler->get_code_end(symbols[n].value);
+  }
+
+  for (n = 0; n < function_count; n++)
+  {
+    char name[80];
+
+    snprintf(name, sizeof(name), ".text.%s", symbols[functions[n].symbol].name);
+    section = add_section(sections, &section_count, &shstrtab, name, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 2);
+    functions[n].section = section_count - 1;
+
+    for (offset = functions[n].start; offset < (int)functions[n].end; offset++)
+    {
+      data = assembler->read8(offset);
+      buffer_add8(&section->body, data == -1 ? 0 : data);
+    }
+  }
+
+  add_section(sections, &section_count, &shstrtab, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 2);
+  add_section(sections, &section_count, &shstrtab, ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 2);
+
+  // Locals have to come before the globals in the symbol table
+  add_symbol(&symtab, 0, 0, 0, STB_LOCAL, STT_NOTYPE, 0);
+
+  for (n = 0; n < function_count; n++)
+  {
+    functions[n].section_symbol = symtab.len / ELF_SYMBOL_SIZE;
+    add_symbol(&symtab, 0, 0, 0, STB_LOCAL, STT_SECTION, functions[n].section);
+  }
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label) { continue; }
+
+    function = find_function(functions, function_count, symbols[n].value);
+    if (function == NULL) { continue; }
+
+    if (symbols[n].is_global) { continue; }
+
+    if (symbols[n].value == function->start)
+    {
+      add_symbol(&symtab, buffer_string(&strtab, symbols[n].name), 0, function->end - function->start, STB_LOCAL, STT_FUNC, function->section);
+    }
+      else
+    {
+      add_symbol(&symtab, buffer_string(&strtab, symbols[n].name), symbols[n].value - function->start, 0, STB_LOCAL, STT_NOTYPE, function->section);
+    }
+  }
+
+  first_global = symtab.len / ELF_SYMBOL_SIZE;
+
+  // Only .global functions can be called from outside.  Java methods
+  // don't use the C calling convention so the generator exports wrappers
+  // for them instead.
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label || !symbols[n].is_global) { continue; }
+
+    function = find_function(functions, function_count, symbols[n].value);
+    if (function == NULL || symbols[n].value != function->start) { continue; }
+
+    add_symbol(&symtab, buffer_string(&strtab, symbols[n].name), 0, function->end - function->start, STB_GLOBAL, STT_FUNC, function->section);
+  }
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_extern) { continue; }
+
+    extern_index[n] = symtab.len / ELF_SYMBOL_SIZE;
+    add_symbol(&symtab, buffer_string(&strtab, symbols[n].name), 0, 0, STB_GLOBAL, STT_NOTYPE, 0);
+  }
+
+  for (n = 0; n < reloc_count; n++)
+  {
+    assembler_reloc_t *reloc = &relocs[n];
+
+    function = find_function(functions, function_count, reloc->address);
+
+    if (function == NULL)
+    {
+      printf("Error: relocation at 0x%04x isn't in a function\n", reloc->address);
+      errors++;
+      continue;
+    }
+
+    buffer_add32(&function->rela, reloc->address - function->start);
+
+    if (reloc->symbol != -1)
+    {
+      buffer_add32(&function->rela, (extern_index[reloc->symbol] << 8) | reloc->type);
+      buffer_add32(&function->rela, reloc->value);
+      continue;
+    }
+
+    target = find_function(functions, function_count, reloc->value);
+
+    // Already right as long as the two stay together
+    if (target == function && reloc->pc_relative)
+    {
+      function->rela.len -= 4;
+      continue;
+    }
+
+    if (target == NULL || reloc->pc_relative)
+    {
+      printf("Error: can't relocate reference at 0x%04x to 0x%04x\n", reloc->address, reloc->value);
+      function->rela.len -= 4;
+      errors++;
+      continue;
+    }
+
+    buffer_add32(&function->rela, (target->section_symbol << 8) | reloc->type);
+    buffer_add32(&function->rela, reloc->value - target->start);
+  }
+
+  symtab_section = section_count;
+  strtab_section = section_count + 1;
+
+  section = add_section(sections, &section_count, &shstrtab, ".symtab", SHT_SYMTAB, 0, 4);
+  section->body = symtab;
+  section->link = strtab_section;
+  section->info = first_global;
+  section->entsize = ELF_SYMBOL_SIZE;
+
+  section = add_section(sections, &section_count, &shstrtab, ".strtab", SHT_STRTAB, 0, 1);
+  section->body = strtab;
+
+  for (n = 0; n < function_count; n++)
+  {
+    char name[80];
+
+    if (functions[n].rela.len == 0) { continue; }
+
+    snprintf(name, sizeof(name), ".rela.text.%s", symbols[functions[n].symbol].name);
+    section = add_section(sections, &section_count, &shstrtab, name, SHT_RELA, SHF_INFO_LINK, 4);
+    section->body = functions[n].rela;
+    section->link = symtab_section;
+    section->info = functions[n].section;
+    section->entsize = ELF_RELA_SIZE;
+  }
+
+  shstrtab_section = section_count;
+  section = add_section(sections, &section_count, &shstrtab, ".shstrtab", SHT_STRTAB, 0, 1);
+  section->body = shstrtab;
+
+  // Section contents follow the ELF header with the section headers last
+  offset = ELF_HEADER_SIZE;
+
+  for (n = 1; n < section_count; n++)
+  {
+    offset = (offset + sections[n].align - 1) & ~(sections[n].align - 1);
+    sections[n].offset = offset;
+    if (sections[n].type != SHT_NOBITS) { offset += sections[n].body.len; }
+  }
+
+  offset = (offset + 3) & ~3;
+
+  buffer_add(&header, "\177ELF", 4);
+  buffer_add8(&header, 1);       // ELFCLASS32
+  buffer_add8(&header, 1);       // ELFDATA2LSB
+  buffer_add8(&header, 1);       // EV_CURRENT
+  for (i = 0; i < 9; i++) { buffer_add8(&header, 0); }
+  buffer_add16(&header, 1);      // ET_REL
+  buffer_add16(&header, assembler->get_elf_machine());
+  buffer_add32(&header, 1);
+  buffer_add32(&header, 0);      // e_entry
+  buffer_add32(&header, 0);      // e_phoff
+  buffer_add32(&header, offset); // e_shoff
+  buffer_add32(&header, 0);      // e_flags
+  buffer_add16(&header, ELF_HEADER_SIZE);
+  buffer_add16(&header, 0);
+  buffer_add16(&header, 0);
+  buffer_add16(&header, ELF_SECTION_SIZE);
+  buffer_add16(&header, section_count);
+  buffer_add16(&header, shstrtab_section);
+
+  for (n = 1; n < section_count; n++)
+  {
+    while (header.len < sections[n].offset) { buffer_add8(&header, 0); }
+    if (sections[n].type != SHT_NOBITS)
+    {
+      buffer_add(&header, sections[n].body.data, sections[n].body.len);
+    }
+  }
+
+  while (header.len < offset) { buffer_add8(&header, 0); }
+
+  for (n = 0; n < section_count; n++)
+  {
+    buffer_add32(&header, sections[n].name);
+    buffer_add32(&header, sections[n].type);
+    buffer_add32(&header, sections[n].flags);
+    buffer_add32(&header, 0);    // sh_addr
+    buffer_add32(&header, sections[n].offset);
+    buffer_add32(&header, sections[n].body.len);
+    buffer_add32(&header, sections[n].link);
+    buffer_add32(&header, sections[n].info);
+    buffer_add32(&header, sections[n].align);
+    buffer_add32(&header, sections[n].entsize);
+  }
+
+  if (errors == 0)
+  {
+    out = fopen(filename, "wb");
+
+    if (out == NULL)
+    {
+      printf("Couldn't open file %s for writing.\n", filename);
+      errors++;
+    }
+      else
+    {
+      fwrite(header.data, 1, header.len, out);
+      fclose(out);
+    }
+  }
+
+  for (n = 0; n < section_count; n++) { free(sections[n].body.data); }
+  for (n = 0; n < function_count; n++)
+  {
+    if (functions[n].rela.len == 0) { free(functions[n].rela.data); }
+  }
+  free(header.data);
+  free(sections);
+  free(functions);
+  free(extern_index);
+
+  return errors == 0 ? 0 : -1;
+}
+
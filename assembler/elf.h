@@ -0,0 +1,29 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "Assembler.h"
+
+// ELF32 relocatable object from an assembler that ran in relocatable
+// mode.  Every function (a label that isn't local to the one before it)
+// gets its own .text.<name> section so the linker can throw away the
+// ones nothing calls.  Labels named by .global (the C entry points the
+// generator writes for Java methods) are global, everything else is
+// local and anything used but not defined is an undefined global for
+// the linker to find.  .data and .bss are there but empty since nothing the
+// generators write goes in them yet.
+
+int write_elf(Assembler *assembler, const char *filename);
+
+#endif
+
@@ -84,6 +84,12 @@ int t;
     memset(attributes, 0, attributes_count * sizeof(int));
     read_attributes(in);
   }
+
+  // Calls to methods in this class are looked up by name
+  if (get_class_name(class_name, sizeof(class_name), this_class) != 0)
+  {
+    class_name[0] = 0;
+  }
 }
 
 JavaClass::~JavaClass()
@@ -51,8 +51,8 @@
 struct generic_twoint16_t
 {
   uint8_t tag;
-  int16_t int1;
-  int16_t int2;
+  uint16_t int1;
+  uint16_t int2;
 };
 
 struct generic_32bit_t
@@ -70,34 +70,34 @@ struct generic_64bit_t
 struct constant_class_t
 {
   uint8_t tag;
-  int16_t name_index;
+  uint16_t name_index;
 };
 
 struct constant_fieldref_t
 {
   uint8_t tag;
-  int16_t class_index;
-  int16_t name_and_type_index;
+  uint16_t class_index;
+  uint16_t name_and_type_index;
 };
 
 struct constant_methodref_t
 {
   uint8_t tag;
-  int16_t class_index;
-  int16_t name_and_type_index;
+  uint16_t class_index;
+  uint16_t name_and_type_index;
 };
 
 struct constant_interfacemethodref_t
 {
   uint8_t tag;
-  int16_t class_index;
-  int16_t name_and_type_index;
+  uint16_t class_index;
+  uint16_t name_and_type_index;
 };
 
 struct constant_string_t
 {
   uint8_t tag;
-  int16_t string_index;
+  uint16_t string_index;
 };
 
 struct constant_integer_t
@@ -127,20 +127,20 @@ struct constant_double_t
 struct constant_nameandtype_t
 {
   uint8_t tag;
-  int16_t name_index;
-  int16_t descriptor_index;
+  uint16_t name_index;
+  uint16_t descriptor_index;
 };
 
 struct constant_utf8_t
 {
   uint8_t tag;
-  int16_t length;
+  uint16_t length;
   uint8_t bytes[];
 };
 
 struct attributes_t
 {
-  int16_t name_index;
+  uint16_t name_index;
   int32_t length;
   uint8_t info[];
 };
@@ -148,18 +148,18 @@ struct attributes_t
 struct fields_t
 {
   int16_t access_flags;
-  int16_t name_index;
-  int16_t descriptor_index;
-  int16_t attribute_count;
+  uint16_t name_index;
+  uint16_t descriptor_index;
+  uint16_t attribute_count;
   struct attributes_t attributes[];
 };
 
 struct methods_t
 {
   int16_t access_flags;
-  int16_t name_index;
-  int16_t descriptor_index;
-  int16_t attribute_count;
+  uint16_t name_index;
+  uint16_t descriptor_index;
+  uint16_t attribute_count;
   struct attributes_t attributes[];
 };
 
@@ -183,8 +183,8 @@ public:
   int16_t minor_version;
   int16_t major_version;
   int16_t access_flags;
-  int16_t this_class;
-  int16_t super_class;
+  uint16_t this_class;
+  uint16_t super_class;
 
   char class_name[128];
 
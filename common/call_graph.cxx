@@ -0,0 +1,374 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "call_graph.h"
+#include "compile.h"
+#include "flow.h"
+#include "invoke.h"
+#include "range.h"
+
+CallGraph::CallGraph(JavaClass *java_class, int int_size)
+{
+int n;
+
+  this->int_size = int_size;
+  node_count = java_class->get_method_count();
+  nodes = (call_graph_node_t *)calloc(node_count, sizeof(call_graph_node_t));
+
+  // Names first so calls to methods further down can be found
+  for (n = 0; n < node_count; n++)
+  {
+    get_method_label(java_class, n, nodes[n].name, sizeof(nodes[n].name));
+  }
+
+  for (n = 0; n < node_count; n++)
+  {
+    scan_method(java_class, n);
+  }
+}
+
+CallGraph::~CallGraph()
+{
+int n;
+
+  for (n = 0; n < node_count; n++) { free(nodes[n].callees); }
+
+  free(nodes);
+}
+
+int CallGraph::find(const char *name)
+{
+int n;
+
+  for (n = 0; n < node_count; n++)
+  {
+    if (strcmp(nodes[n].name, name) == 0) { return n; }
+  }
+
+  return -1;
+}
+
+void CallGraph::scan_method(JavaClass *java_class, int index)
+{
+call_graph_node_t *node = &nodes[index];
+struct methods_t *method = java_class->get_method(index);
+char method_name[128];
+char method_sig[128];
+char method_class[128];
+char function[256];
+uint8_t *bytes;
+int is_void;
+int code_len, pc_start;
+int address, len, pc;
+int local;
+int opcode;
+int callee;
+
+  if (method->attribute_count == 0)
+  {
+    node->flags = CALL_GRAPH_UNKNOWN;
+    return;
+  }
+
+  java_class->get_name_constant(method_sig, sizeof(method_sig), method->descriptor_index);
+  if (strcmp(node->name, "main") != 0) { get_signature(method_sig, &node->params, &is_void); }
+  else { method_sig[0] = 0; }
+
+  bytes = method->attributes[0].info;
+  node->max_stack = ((int)bytes[0] << 8) | ((int)bytes[1]);
+  node->max_locals = ((int)bytes[2] << 8) | ((int)bytes[3]);
+  code_len = ((int)bytes[4] << 24) |
+             ((int)bytes[5] << 16) |
+             ((int)bytes[6] << 8) |
+             ((int)bytes[7]);
+  pc_start = (((int)bytes[code_len + 8] << 8) |
+              ((int)bytes[code_len + 9])) + 8;
+
+  if (int_size < 32) { scan_int32(java_class, node, method_sig, bytes, pc_start, code_len); }
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+
+    if (len <= 0)
+    {
+      node->flags |= CALL_GRAPH_UNKNOWN;
+      return;
+    }
+
+    pc = pc_start + address;
+    opcode = bytes[pc];
+    local = -1;
+
+    if (opcode == 0xc4)
+    {
+      opcode = bytes[pc + 1];
+      pc++;
+      if ((opcode >= 0x36 && opcode <= 0x3a) || opcode == 0x84) { local = GET_PC_UINT16(1); }
+    }
+      else
+    if ((opcode >= 0x36 && opcode <= 0x3a) || opcode == 0x84)
+    {
+      local = bytes[pc + 1];
+    }
+      else
+    if (opcode >= 0x3b && opcode <= 0x4e)
+    {
+      local = (opcode - 0x3b) & 3;
+    }
+
+    if (local >= 0 && local < 32) { node->stored_locals |= 1U << local; }
+
+    switch(opcode)
+    {
+      case 0x68:  // imul
+        node->flags |= CALL_GRAPH_MUL;
+        break;
+      case 0x6c:  // idiv
+      case 0x70:  // irem
+        node->flags |= CALL_GRAPH_DIV;
+        break;
+      case 0xb8:  // invokestatic
+        if (java_class->get_class_name(method_class, sizeof(method_class), GET_PC_UINT16(1)) != 0 ||
+            java_class->get_ref_name_type(method_name, method_sig, sizeof(method_name), GET_PC_UINT16(1)) != 0)
+        {
+          node->flags |= CALL_GRAPH_UNKNOWN;
+          break;
+        }
+
+        // Calls to the API classes turn into inline code
+        if (strcmp(method_class, java_class->class_name) != 0) { break; }
+
+        get_static_function(function, method_name, method_sig);
+        callee = find(function);
+
+        if (callee == -1) { node->flags |= CALL_GRAPH_UNKNOWN; }
+        else { add_callee(node, callee); }
+        break;
+      case 0xa8:  // jsr
+      case 0xa9:  // ret
+        node->flags |= CALL_GRAPH_UNKNOWN;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// With 16 bit ints the values compile_method() keeps in 2 words take
+// more of the frame and the stack.
+void CallGraph::scan_int32(JavaClass *java_class, call_graph_node_t *node, char *method_sig, uint8_t *bytes, int pc_start, int code_len)
+{
+range_info_t *info;
+uint8_t *locals_32;
+int stack_32;
+int n;
+
+  info = (range_info_t *)malloc(code_len * sizeof(range_info_t));
+  locals_32 = (uint8_t *)calloc(node->max_locals + 1, 1);
+
+  if (info != NULL && locals_32 != NULL &&
+      compute_ranges(java_class, method_sig, int_size, bytes, pc_start, code_len, node->max_locals, node->max_stack, info) == 0 &&
+      find_int32_values(java_class, bytes, pc_start, code_len, node->max_locals, node->max_stack, info, locals_32, &stack_32) > 0)
+  {
+    for (n = 0; n < node->max_locals; n++)
+    {
+      if (locals_32[n]) { node->int32_locals++; }
+    }
+
+    node->int32_stack = stack_32;
+  }
+
+  free(info);
+  free(locals_32);
+}
+
+void CallGraph::add_callee(call_graph_node_t *node, int callee)
+{
+int n;
+
+  for (n = 0; n < node->callee_count; n++)
+  {
+    if (node->callees[n] == callee) { return; }
+  }
+
+  node->callees = (int *)realloc(node->callees, (node->callee_count + 1) * sizeof(int));
+  node->callees[node->callee_count++] = callee;
+}
+
+// Gives every method a fixed place in RAM for its locals.  Two methods
+// that can never be running at the same time can share bytes so each
+// frame goes right after the deepest frame of anything that can call it
+// (overlaying as SDCC does it for non-reentrant functions).  Returns the
+// bytes needed for all frames or -1 if a method can call itself (even
+// through others) or the scan couldn't follow a method.
+int CallGraph::overlay_frames()
+{
+call_graph_node_t *node, *callee;
+uint8_t *state;
+int *order;
+int count = 0;
+int size = 0;
+int n, i;
+
+  state = (uint8_t *)calloc(node_count, 1);
+  order = (int *)malloc(node_count * sizeof(int));
+
+  for (n = 0; n < node_count; n++)
+  {
+    nodes[n].frame_offset = 0;
+
+    if ((nodes[n].flags & CALL_GRAPH_UNKNOWN) != 0 ||
+        sort_callees(n, state, order, &count) != 0)
+    {
+      free(state);
+      free(order);
+      return -1;
+    }
+  }
+
+  // order has callees before callers so walk it backwards
+  for (n = count - 1; n >= 0; n--)
+  {
+    node = &nodes[order[n]];
+
+    for (i = 0; i < node->callee_count; i++)
+    {
+      callee = &nodes[node->callees[i]];
+
+      if (callee->frame_offset < node->frame_offset + node->frame_size)
+      {
+        callee->frame_offset = node->frame_offset + node->frame_size;
+      }
+    }
+
+    if (node->frame_offset + node->frame_size > size)
+    {
+      size = node->frame_offset + node->frame_size;
+    }
+  }
+
+  free(state);
+  free(order);
+
+  return size;
+}
+
+// Worst case bytes of stack in use: the deepest chain of calls adding up
+// what each method pushes itself.  Returns -1 with recursion.
+int CallGraph::get_stack_depth()
+{
+call_graph_node_t *node;
+uint8_t *state;
+int *order;
+int *depth;
+int count = 0;
+int max = 0;
+int n, i;
+
+  state = (uint8_t *)calloc(node_count, 1);
+  order = (int *)malloc(node_count * sizeof(int));
+  depth = (int *)calloc(node_count, sizeof(int));
+
+  for (n = 0; n < node_count; n++)
+  {
+    if (sort_callees(n, state, order, &count) != 0)
+    {
+      max = -1;
+      break;
+    }
+  }
+
+  // order has callees before callers so their depth is known first
+  for (n = 0; n < count && max != -1; n++)
+  {
+    node = &nodes[order[n]];
+
+    for (i = 0; i < node->callee_count; i++)
+    {
+      if (depth[node->callees[i]] > depth[order[n]])
+      {
+        depth[order[n]] = depth[node->callees[i]];
+      }
+    }
+
+    depth[order[n]] += node->stack_size;
+    if (depth[order[n]] > max) { max = depth[order[n]]; }
+  }
+
+  free(state);
+  free(order);
+  free(depth);
+
+  return max;
+}
+
+// Depth first so every method lands in order after all of its callees.
+// Finding a method that is still being visited means recursion.
+int CallGraph::sort_callees(int index, uint8_t *state, int *order, int *count)
+{
+int n;
+
+  if (state[index] == 2) { return 0; }
+  if (state[index] == 1) { return -1; }
+
+  state[index] = 1;
+
+  for (n = 0; n < nodes[index].callee_count; n++)
+  {
+    if (sort_callees(nodes[index].callees[n], state, order, count) != 0)
+    {
+      return -1;
+    }
+  }
+
+  state[index] = 2;
+  order[(*count)++] = index;
+
+  return 0;
+}
+
+// Name of a method as it appears in the .asm file.  Everything but main
+// has its parameter types added so overloaded methods don't collide:
+// add_nums(int,int) is add_nums_II.
+int get_method_label(JavaClass *java_class, int index, char *name, int len)
+{
+struct methods_t *method = java_class->get_method(index);
+char method_sig[64];
+char *s;
+
+  if (java_class->get_method_name(name, len, index) != 0)
+  {
+    snprintf(name, len, "error");
+    return -1;
+  }
+
+  if (strcmp(name, "main") == 0 || name[0] == 0) { return 0; }
+
+  java_class->get_name_constant(method_sig, sizeof(method_sig), method->descriptor_index);
+
+  s = method_sig + 1;
+  while(*s != ')' && *s != 0) { s++; }
+  *s = 0;
+  method_sig[0] = '_';
+  if (method_sig[1] != 0 && strlen(name) + strlen(method_sig) < (size_t)len)
+  {
+    strcat(name, method_sig);
+  }
+
+  return 0;
+}
+
@@ -0,0 +1,71 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _CALL_GRAPH_H
+#define _CALL_GRAPH_H
+
+#include <stdint.h>
+
+#include "JavaClass.h"
+
+// Which methods of a class call which, found by scanning every method's
+// bytecode before anything is compiled.  The generators use it to know
+// what a method can change before they've compiled it.
+
+#define CALL_GRAPH_MUL 0x01       // imul
+#define CALL_GRAPH_DIV 0x02       // idiv or irem
+#define CALL_GRAPH_UNKNOWN 0x80   // bytecode the scan couldn't follow
+
+struct call_graph_node_t
+{
+  char name[128];           // label in the .asm file (add_nums_II)
+  int params;
+  int max_stack;
+  int max_locals;
+  int int32_locals;         // locals that need a high word (16 bit ints)
+  int int32_stack;          // more stack values for high words
+  uint32_t stored_locals;   // bit n set if the method writes local n
+  uint8_t flags;
+  int *callees;             // methods in this class it calls (no repeats)
+  int callee_count;
+  uint32_t clobber;         // registers it can change, set by the generator
+  int frame_size;           // bytes of locals in RAM, set by the generator
+  int frame_offset;         // where they go with static frames
+  int stack_size;           // bytes of stack it can push, set by the generator
+};
+
+class CallGraph
+{
+public:
+  CallGraph(JavaClass *java_class, int int_size);
+  ~CallGraph();
+
+  int get_count() { return node_count; }
+  call_graph_node_t *get_node(int index) { return &nodes[index]; }
+  int find(const char *name);
+  int overlay_frames();
+  int get_stack_depth();
+
+private:
+  void scan_method(JavaClass *java_class, int index);
+  void scan_int32(JavaClass *java_class, call_graph_node_t *node, char *method_sig, uint8_t *bytes, int pc_start, int code_len);
+  void add_callee(call_graph_node_t *node, int callee);
+  int sort_callees(int index, uint8_t *state, int *order, int *count);
+
+  call_graph_node_t *nodes;
+  int node_count;
+  int int_size;
+};
+
+int get_method_label(JavaClass *java_class, int index, char *name, int len);
+
+#endif
+
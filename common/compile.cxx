@@ -15,13 +15,24 @@
 #include <stdint.h>
 
 #include "JavaClass.h"
+#include "call_graph.h"
 #include "compile.h"
+#include "flow.h"
 #include "invoke.h"
+#include "layout.h"
+#include "liveness.h"
+#include "loop.h"
+#include "profile.h"
+#include "range.h"
 #include "table_java_instr.h"
+#include "time_report.h"
+#include "value.h"
 
 // http://docs.oracle.com/javase/specs/jvms/se7/html/jvms-6.html
 
 #define UNIMPL() printf("Opcode (%d) '%s' unimplemented\n", bytes[pc], table_java_instr[(int)bytes[pc]].name); ret = -1;
+#define TIME_START(a) if (time_report != NULL) { time_report->start(a); }
+#define TIME_STOP(a) if (time_report != NULL) { time_report->stop(a); }
 
 //#define CONST_STACK_SIZE 4
 
@@ -35,7 +46,17 @@ static uint8_t cond_table[] =
   COND_LESS_EQUAL,    // 164 (0xa4) if_icmple
 };
 
-static void fill_label_map(uint8_t *label_map, int label_map_len, uint8_t *bytes, int code_len, int pc_start)
+static uint8_t invert_cond_table[] =
+{
+  COND_NOT_EQUAL,     // COND_EQUAL
+  COND_EQUAL,         // COND_NOT_EQUAL
+  COND_GREATER_EQUAL, // COND_LESS
+  COND_GREATER,       // COND_LESS_EQUAL
+  COND_LESS_EQUAL,    // COND_GREATER
+  COND_LESS,          // COND_GREATER_EQUAL
+};
+
+void fill_label_map(uint8_t *label_map, int label_map_len, uint8_t *bytes, int code_len, int pc_start)
 {
 int pc = pc_start;
 int wide = 0;
@@ -101,15 +122,438 @@ int address;
   }
 }
 
+// If the value the next few instructions compute is already in a stack
+// slot or a local it's copied from there instead.  Returns how many bytes
+// of bytecode were skipped, 0 if nothing was pushed.
+static int push_known_value(Generator *generator, ValueTable *values, int address, int *frame_slot)
+{
+int slot,local;
+int len;
+
+  len = values->find(address, generator->get_stack_depth(), &slot, &local);
+
+  if (len == 0) { return 0; }
+
+  if (slot != -1 && generator->dup_stack_slot(slot) == 0) { return len; }
+
+  if (local != -1 && generator->push_integer_local(frame_slot[local]) == 0)
+  {
+    return len;
+  }
+
+  return 0;
+}
+
+// On a 16 bit CPU a compare between two values that are known to be in
+// 0 to 65535 (but not -32768 to 32767) has to be done unsigned.
+static bool is_unsigned_compare(range_info_t *range_info, int address)
+{
+  if (range_info == NULL || range_info[address].reachable == 0) { return false; }
+
+  range_t *a = &range_info[address].operand[1];
+  range_t *b = &range_info[address].operand[0];
+
+  if (range_fits_int16(a) && range_fits_int16(b)) { return false; }
+
+  return range_fits_uint16(a) && range_fits_uint16(b);
+}
+
+// A divide where neither operand can be negative gives the same answer
+// signed or unsigned, and values from 32768 to 65535 only divide right
+// unsigned.
+static bool is_unsigned_divide(range_info_t *range_info, int address)
+{
+  if (range_info == NULL || range_info[address].reachable == 0) { return false; }
+
+  return range_fits_uint16(&range_info[address].operand[1]) &&
+         range_fits_uint16(&range_info[address].operand[0]);
+}
+
+// With a constant divisor only a has to be positive.  The generator
+// knows a / -d is -(a / d) and a % -d is a % d.
+static bool is_unsigned_dividend(range_info_t *range_info, int address)
+{
+  if (range_info == NULL || range_info[address].reachable == 0) { return false; }
+
+  return range_fits_uint16(&range_info[address].operand[1]);
+}
+
+// i2b, i2c and i2s don't change a value that's already in min to max
+static bool is_cast_needed(range_info_t *range_info, int address, int min, int max)
+{
+  if (range_info == NULL || range_info[address].reachable == 0) { return true; }
+
+  range_t *a = &range_info[address].operand[0];
+
+  return a->min < min || a->max > max;
+}
+
+// An ior or ixor of a constant where both are 0 to 255 can be a byte op
+static bool is_byte_operand(range_info_t *range_info, int address, int const_val)
+{
+  if (range_info == NULL || range_info[address].reachable == 0) { return false; }
+
+  range_t *a = &range_info[address].operand[1];
+
+  return const_val >= 0 && const_val <= 0xff && a->min >= 0 && a->max <= 0xff;
+}
+
+// Java int math is 32 bit.  Most instructions give the same low 16 bits
+// either way, but these look at the upper bits so mark them if the range
+// analysis couldn't prove the operands fit.  report_int_size() warns
+// once for the whole method.
+static void check_int_size(range_info_t *range_info, uint8_t *bytes, int pc, int address)
+{
+range_t *a,*b;
+bool fits;
+
+  if (range_info == NULL || range_info[address].reachable == 0) { return; }
+
+  a = &range_info[address].operand[1];
+  b = &range_info[address].operand[0];
+
+  switch(bytes[pc])
+  {
+    case 0x99: // ifeq
+    case 0x9a: // ifne
+      fits = range_fits_int16(b) || range_fits_uint16(b);
+      break;
+    case 0x9b: // iflt
+    case 0x9c: // ifge
+    case 0x9d: // ifgt
+    case 0x9e: // ifle
+      fits = range_fits_int16(b);
+      break;
+    case 0x9f: // if_icmpeq
+    case 0xa0: // if_icmpne
+    case 0xa1: // if_icmplt
+    case 0xa2: // if_icmpge
+    case 0xa3: // if_icmpgt
+    case 0xa4: // if_icmple
+      fits = (range_fits_int16(a) && range_fits_int16(b)) ||
+             is_unsigned_compare(range_info, address);
+      break;
+    case 0x6c: // idiv
+    case 0x70: // irem
+      fits = (range_fits_int16(a) && range_fits_int16(b)) ||
+             is_unsigned_divide(range_info, address);
+      break;
+    case 0x7a: // ishr
+      fits = range_fits_int16(a) && range_fits_int16(b);
+      break;
+    case 0x7c: // iushr
+      fits = range_fits_uint16(a);
+      break;
+    default:
+      return;
+  }
+
+  if (!fits) { range_info[address].overflow = 1; }
+}
+
+static void report_int_size(range_info_t *range_info, char *method_name, uint8_t *bytes, int pc_start, int code_len)
+{
+int address,first = -1;
+int count = 0;
+
+  if (range_info == NULL) { return; }
+
+  for (address = 0; address < code_len; address++)
+  {
+    if (range_info[address].overflow == 0) { continue; }
+    if (first == -1) { first = address; }
+    count++;
+  }
+
+  if (count == 0) { return; }
+
+  range_t *a = &range_info[first].operand[1];
+  range_t *b = &range_info[first].operand[0];
+
+  printf("Warning: %d instruction(s) in '%s' may not fit in 16 bits, first '%s' at %d (%d to %d, %d to %d)\n",
+    count, method_name, table_java_instr[(int)bytes[pc_start + first]].name,
+    first, a->min, a->max, b->min, b->max);
+}
+
+// Sets label to where the branch at address goes and returns the
+// condition.  When the block layout put the branch target right after
+// this block, the branch at invert_address is turned around to go to
+// the fall through block instead.
+static int get_branch(char *label, char *method_name, uint8_t *bytes, int pc, int address, int invert_address, int cond)
+{
+  if (address == invert_address)
+  {
+    sprintf(label, "%s_%d", method_name, address + 3);
+    return invert_cond_table[cond];
+  }
+
+  sprintf(label, "%s_%d", method_name, address + GET_PC_INT16(1));
+
+  return cond;
+}
+
+// Use the profile to pick the order blocks are emitted in.  Returns the
+// number of blocks or 0 to compile in bytecode order.
+static int get_layout(Profile *profile, char *method_name, uint8_t *bytes, int pc_start, int code_len, range_info_t *ranges, uint8_t *label_map, block_t *blocks, int *order)
+{
+int block_count;
+int n;
+
+  if (profile == NULL || !profile->has_method(method_name)) { return 0; }
+
+  block_count = get_blocks(bytes, pc_start, code_len, label_map, blocks);
+  if (block_count <= 1) { return 0; }
+
+  // The generators keep the top of the operand stack in registers so
+  // blocks can only be moved if the stack is empty between them.
+  if (ranges == NULL)
+  {
+    printf("Skipping block layout of '%s'\n", method_name);
+    return 0;
+  }
+
+  for (n = 0; n < block_count; n++)
+  {
+    if (ranges[blocks[n].start].reachable && ranges[blocks[n].start].depth != 0)
+    {
+      printf("Skipping block layout of '%s' (stack not empty at %d)\n", method_name, blocks[n].start);
+      return 0;
+    }
+
+    blocks[n].count = profile->get_count(method_name, blocks[n].start);
+  }
+
+  layout_blocks(blocks, block_count, order);
+
+  // Any block can be jumped to now
+  for (n = 0; n < block_count; n++)
+  {
+    label_map[blocks[n].start / 8] |= 1 << (blocks[n].start % 8);
+  }
+
+  return block_count;
+}
+
+// Decide what the end of a block has to do so its successors are still
+// reached with the blocks in layout order.
+static void start_block(block_t *blocks, int *order, int block_count, int index, uint8_t *bytes, int pc_start, int *invert_address, int *skip_goto_address)
+{
+block_t *block = &blocks[order[index]];
+int following = index + 1 < block_count ? order[index + 1] : -1;
+
+  *invert_address = -1;
+  *skip_goto_address = -1;
+
+  if (block->next != -1 && block->target != -1)
+  {
+    if (block->target == following && block->next != following)
+    {
+      *invert_address = block->last;
+    }
+  }
+    else
+  if (block->target != -1 && block->target == following &&
+      bytes[pc_start + block->last] == 0xa7)
+  {
+    *skip_goto_address = block->last;
+  }
+}
+
+static int end_block(Generator *generator, char *method_name, block_t *blocks, int *order, int block_count, int index, int invert_address, int skip_goto_address)
+{
+block_t *block = &blocks[order[index]];
+int following = index + 1 < block_count ? order[index + 1] : -1;
+char label[128];
+
+  // The branch was turned around so the old target falls through
+  if (invert_address != -1) { return 0; }
+
+  if (block->next != -1 && block->next != following)
+  {
+    sprintf(label, "%s_%d", method_name, blocks[block->next].start);
+    return generator->jump(label);
+  }
+
+  return 0;
+}
+
+// The test at the top of a counted loop becomes the start of the
+// generator's hardware loop.  A count that isn't constant is worked out
+// from the local with the limit.
+static int loop_start(Generator *generator, char *method_name, loop_t *loop, int *frame_slot)
+{
+char label[128];
+int ret;
+
+  sprintf(label, "%s_%d", method_name, loop->end);
+
+  if (loop->count != -1)
+  {
+    return generator->loop_start(label, loop->count);
+  }
+
+  if (loop->inc > 0)
+  {
+    ret = generator->push_integer_local(frame_slot[loop->limit_local]);
+
+    if (ret == 0 && loop->offset != 0)
+    {
+      ret = generator->push_integer(loop->offset);
+      if (ret == 0) { ret = generator->sub_integers(); }
+    }
+  }
+    else
+  {
+    ret = generator->push_integer(loop->offset);
+    if (ret == 0) { ret = generator->push_integer_local(frame_slot[loop->limit_local]); }
+    if (ret == 0) { ret = generator->sub_integers(); }
+  }
+
+  if (ret != 0) { return ret; }
+
+  return generator->loop_start(label);
+}
+
+// x / y and x % y of the same values share one divide.  At the idiv (or
+// irem) at pc with x and y on top of the stack (or y the constant
+// const_val if is_const) this looks for
+//
+//   istore q, <x again>, <y again>, irem (or idiv)
+//
+// where x and y are anything the value numbers show is the same and
+// leaves both results with the one stored to q on top.  Returns how many
+// bytes after pc were used, 0 if they can't be merged or -1 on error.
+static int optimize_div_mod(Generator *generator, uint8_t *bytes, int pc, int pc_end, int address, uint8_t *label_map, ValueTable *values, int *frame_slot, bool is_const, int const_val, bool is_unsigned)
+{
+int depth = generator->get_stack_depth();
+int base = is_const ? depth - 1 : depth - 2;
+int a, b;
+int next, n, len;
+int store;
+
+  if (base < 0 || values == NULL) { return 0; }
+
+  a = values->get_slot(base);
+  b = is_const ? values->get_const(const_val) : values->get_slot(depth - 1);
+
+  if (a == VALUE_NONE || b == VALUE_NONE) { return 0; }
+
+  next = pc + 1;
+
+  if (next < pc_end && bytes[next] >= 0x3b && bytes[next] <= 0x3e)
+  {
+    store = bytes[next] - 0x3b;
+    next++;
+  }
+    else
+  if (next + 1 < pc_end && bytes[next] == 0x36)
+  {
+    store = bytes[next + 1];
+    next += 2;
+  }
+    else
+  {
+    return 0;
+  }
+
+  len = values->find_operands(address + (next - pc), base, a, b, store);
+  if (len == 0) { return 0; }
+  next += len;
+
+  if (next >= pc_end) { return 0; }
+  if (bytes[next] != (bytes[pc] == 0x6c ? 0x70 : 0x6c)) { return 0; }
+
+  // Something can't jump into the middle
+  for (n = address + 1; n <= address + (next - pc); n++)
+  {
+    if ((label_map[n / 8] & (1 << (n % 8))) != 0) { return 0; }
+  }
+
+  if (is_const)
+  {
+    if (generator->div_mod_integers(const_val, bytes[pc] == 0x6c, is_unsigned) != 0)
+    {
+      return 0;
+    }
+  }
+    else
+  {
+    if (generator->div_mod_integers(bytes[pc] == 0x6c, is_unsigned) != 0)
+    {
+      return 0;
+    }
+  }
+
+  if (generator->pop_integer_local(frame_slot[store]) != 0) { return -1; }
+
+  return next - pc;
+}
+
+// A constant shift followed by an and with 2^width - 1 pulls a bit field
+// out.  The field has to be inside the low 16 bits so ishr and iushr
+// give the same answer.  Returns how many bytes after the shift were
+// used, 0 if it's not a bit field.
+static int optimize_bits(Generator *generator, uint8_t *bytes, int pc, int pc_end, int address, uint8_t *label_map, int shift)
+{
+int mask, width;
+int len, n;
+
+  if (shift < 1 || shift > 15 || pc + 1 >= pc_end) { return 0; }
+
+  if (bytes[pc+1] >= 0x02 && bytes[pc+1] <= 0x08) // iconst_x
+  {
+    mask = (int8_t)bytes[pc+1] - 3;
+    len = 1;
+  }
+    else
+  if (bytes[pc+1] == 0x10 && pc + 2 < pc_end) // bipush
+  {
+    mask = (int8_t)bytes[pc+2];
+    len = 2;
+  }
+    else
+  if (bytes[pc+1] == 0x11 && pc + 3 < pc_end) // sipush
+  {
+    mask = GET_PC_INT16(2);
+    len = 3;
+  }
+    else
+  {
+    return 0;
+  }
+
+  if (pc + 1 + len >= pc_end || bytes[pc+1+len] != 0x7e) { return 0; } // iand
+  if (mask <= 0 || (mask & (mask + 1)) != 0) { return 0; }
+
+  for (width = 0; (mask >> width) != 0; width++);
+
+  if (shift + width > 16) { return 0; }
+
+  // Something can't jump to the constant or the iand
+  for (n = address + 1; n <= address + 1 + len; n++)
+  {
+    if ((label_map[n / 8] & (1 << (n % 8))) != 0) { return 0; }
+  }
+
+  if (generator->extract_bits_integer(shift, width) != 0) { return 0; }
+
+  return len + 2;
+}
+
 // FIXME - Too many parameters :(.
-static int optimize_const(JavaClass *java_class, Generator *generator, char *method_name, uint8_t *bytes, int pc, int pc_end, int address, int const_val)
+static int optimize_const(JavaClass *java_class, Generator *generator, char *method_name, uint8_t *bytes, int pc, int pc_end, int address, int const_val, uint8_t *label_map, range_info_t *range_info, ValueTable *values, int *frame_slot, int invert_address, TimeReport *time_report)
 {
 int const_vals[2];
+int ret;
+
+  // Something jumps to the next instruction so the constant can't be
+  // merged into it (c ? 1 : 2 leaves a constant on the stack at a label).
+  if ((label_map[address / 8] & (1 << (address % 8))) != 0) { return 0; }
 
   // istore_x
   if (bytes[pc] >= 0x3b && bytes[pc] <= 0x3e) // istore_x
   {
-    if (generator->set_integer_local(bytes[pc] - 0x3b, const_val) != 0)
+    if (generator->set_integer_local(frame_slot[bytes[pc] - 0x3b], const_val) != 0)
     { return 0; }
     return 1;
   }
@@ -117,7 +561,7 @@ int const_vals[2];
   // istore
   if (pc + 1 < pc_end && bytes[pc] == 0x36)
   {
-    if (generator->set_integer_local(bytes[pc+1], const_val) != 0)
+    if (generator->set_integer_local(frame_slot[bytes[pc+1]], const_val) != 0)
     { return 0; }
     return 2;
   }
@@ -125,7 +569,7 @@ int const_vals[2];
   // istore wide
   if (pc + 2 < pc_end && bytes[pc] == 0xc4 && bytes[pc+1] == 0x36)
   {
-    if (generator->set_integer_local(GET_PC_UINT16(1), const_val) != 0)
+    if (generator->set_integer_local(frame_slot[GET_PC_UINT16(1)], const_val) != 0)
     { return 0; }
     return 3;
   }
@@ -139,18 +583,150 @@ int const_vals[2];
   if (pc + 2 < pc_end && bytes[pc] >= 0x9f && bytes[pc] <= 0xa4)
   {
     char label[128];
-    sprintf(label, "%s_%d", method_name, address + GET_PC_INT16(1));
-    if (generator->jump_cond_integer(label, cond_table[bytes[pc]-159], const_val) == -1)
-    { return 0; }
+    int cond = get_branch(label, method_name, bytes, pc, address, invert_address, cond_table[bytes[pc]-159]);
+    if (is_unsigned_compare(range_info, address))
+    {
+      if (generator->jump_cond_integer_unsigned(label, cond, const_val) == -1)
+      { return 0; }
+    }
+      else
+    {
+      if (generator->jump_cond_integer(label, cond, const_val) == -1)
+      { return 0; }
+    }
+    check_int_size(range_info, bytes, pc, address);
     return 3;
   }
 
+  // imul
+  if (bytes[pc] == 0x68)
+  {
+    if (generator->mul_integers(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 96 (0x60) iadd
+  if (bytes[pc] == 0x60)
+  {
+    if (generator->add_integers(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 100 (0x64) isub
+  if (bytes[pc] == 0x64)
+  {
+    if (generator->sub_integers(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 126 (0x7e) iand
+  if (bytes[pc] == 0x7e)
+  {
+    if (generator->and_integer(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 128 (0x80) ior
+  if (bytes[pc] == 0x80)
+  {
+    if (is_byte_operand(range_info, address, const_val) &&
+        generator->or_integer_byte(const_val) == 0)
+    { return 1; }
+
+    if (generator->or_integer(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 130 (0x82) ixor
+  if (bytes[pc] == 0x82)
+  {
+    if (is_byte_operand(range_info, address, const_val) &&
+        generator->xor_integer_byte(const_val) == 0)
+    { return 1; }
+
+    if (generator->xor_integer(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 120 (0x78) ishl
+  if (bytes[pc] == 0x78)
+  {
+    if (generator->shift_left_integer(const_val) != 0)
+    { return 0; }
+    return 1;
+  }
+
+  // 122 (0x7a) ishr
+  if (bytes[pc] == 0x7a)
+  {
+    ret = optimize_bits(generator, bytes, pc, pc_end, address, label_map, const_val);
+    if (ret > 0) { return ret; }
+
+    if (generator->shift_right_integer(const_val) != 0)
+    { return 0; }
+    check_int_size(range_info, bytes, pc, address);
+    return 1;
+  }
+
+  // 124 (0x7c) iushr
+  if (bytes[pc] == 0x7c)
+  {
+    ret = optimize_bits(generator, bytes, pc, pc_end, address, label_map, const_val);
+    if (ret > 0) { return ret; }
+
+    if (generator->shift_right_uinteger(const_val) != 0)
+    { return 0; }
+    check_int_size(range_info, bytes, pc, address);
+    return 1;
+  }
+
+  // 108 (0x6c) idiv
+  // 112 (0x70) irem
+  if (bytes[pc] == 0x6c || bytes[pc] == 0x70)
+  {
+    bool is_mod = (bytes[pc] == 0x70);
+    bool is_unsigned = is_unsigned_dividend(range_info, address);
+
+    ret = optimize_div_mod(generator, bytes, pc, pc_end, address, label_map, values, frame_slot, true, const_val, is_unsigned);
+    if (ret > 0)
+    {
+      check_int_size(range_info, bytes, pc, address);
+      return ret + 1;
+    }
+
+    ret = -1;
+
+    if (is_unsigned)
+    {
+      if (is_mod) { ret = generator->mod_integers_unsigned(const_val); }
+      else { ret = generator->div_integers_unsigned(const_val); }
+    }
+
+    if (ret == -1)
+    {
+      if (is_mod) { ret = generator->mod_integers(const_val); }
+      else { ret = generator->div_integers(const_val); }
+    }
+
+    if (ret != 0) { return 0; }
+    check_int_size(range_info, bytes, pc, address);
+    return 1;
+  }
+
   // invokestatic with one const
   if (pc + 2 < pc_end && bytes[pc] == 0xb8)
   {
     int ref = GET_PC_UINT16(1);
-    if (invoke_static(java_class, ref, generator, &const_val, 1) != 0)
-    { return 0; }
+    TIME_START(PHASE_INVOKE)
+    ret = invoke_static(java_class, ref, generator, &const_val, 1);
+    TIME_STOP(PHASE_INVOKE)
+    if (ret != 0) { return 0; }
     return 3;
   }
 
@@ -164,13 +740,16 @@ int const_vals[2];
   // 08 (0x08) iconst_5
   if (pc + 3 < pc_end &&
       bytes[pc] >= 0x02 && bytes[pc] <= 0x08 &&
-      bytes[pc+1] == 0xb8)
+      bytes[pc+1] == 0xb8 &&
+      (label_map[(address + 1) / 8] & (1 << ((address + 1) % 8))) == 0)
   {
     const_vals[0] = const_val;
     const_vals[1] = (int8_t)bytes[pc] - 3;
     int ref = GET_PC_UINT16(2);
-    if (invoke_static(java_class, ref, generator, const_vals, 2) != 0)
-    { return 0; }
+    TIME_START(PHASE_INVOKE)
+    ret = invoke_static(java_class, ref, generator, const_vals, 2);
+    TIME_STOP(PHASE_INVOKE)
+    if (ret != 0) { return 0; }
     return 4;
   }
 
@@ -179,7 +758,193 @@ int const_vals[2];
   return 0;
 }
 
-int compile_method(JavaClass *java_class, int method_id, Generator *generator)
+// Adds the high word to a 16 bit value that's going to be used in 32 bit
+// math.  Its range says if it was 0 to 65535 or signed.  If it didn't fit
+// either way its upper bits are already gone.
+static int extend_int32(Generator *generator, range_info_t *info, range_t *range)
+{
+  if (!range_fits_int16(range) && !range_fits_uint16(range))
+  {
+    info->overflow = 1;
+  }
+
+  return generator->extend_integer(!range_fits_int16(range) && range_fits_uint16(range));
+}
+
+// Pushes a constant as 2 words, low word first
+static int push_int32(Generator *generator, int32_t value)
+{
+  if (generator->push_integer(value & 0xffff) != 0) { return -1; }
+
+  return generator->push_integer((value >> 16) & 0xffff);
+}
+
+// Instructions find_int32_values() picked to use 2 words.  Returns how
+// many bytes were used, 0 if the instruction isn't one of them or -1 on
+// error.
+static int compile_int32(JavaClass *java_class, Generator *generator, char *method_name, uint8_t *bytes, int pc, int address, range_info_t *range_info, uint8_t *locals_32, int *high_slot, int *frame_slot, int invert_address)
+{
+range_info_t *info = &range_info[address];
+generic_32bit_t *gen32;
+char label[128];
+int index,opcode,cond,len;
+int value;
+
+  if (info->reachable == 0) { return 0; }
+
+  opcode = bytes[pc] == 0xc4 ? bytes[pc+1] : bytes[pc];
+  index = get_local_index(bytes, pc - address, address);
+  len = get_instr_len(bytes, pc - address, address);
+
+  switch(opcode)
+  {
+    case 0x02: // iconst_m1
+    case 0x03: // iconst_0
+    case 0x04: // iconst_1
+    case 0x05: // iconst_2
+    case 0x06: // iconst_3
+    case 0x07: // iconst_4
+    case 0x08: // iconst_5
+    case 0x10: // bipush
+    case 0x11: // sipush
+    case 0x12: // ldc
+      if (info->result_32 == 0) { return 0; }
+
+      if (opcode == 0x12)
+      {
+        gen32 = (generic_32bit_t *)java_class->get_constant(bytes[pc+1]);
+        value = gen32->value;
+      }
+        else
+      if (opcode == 0x10) { value = (int8_t)bytes[pc+1]; }
+        else
+      if (opcode == 0x11) { value = GET_PC_INT16(1); }
+        else
+      { value = opcode - 3; }
+
+      if (push_int32(generator, value) != 0) { return -1; }
+      return len;
+
+    case 0x15: // iload
+    case 0x1a: // iload_0
+    case 0x1b: // iload_1
+    case 0x1c: // iload_2
+    case 0x1d: // iload_3
+      if (locals_32[index])
+      {
+        if (generator->push_integer_local(frame_slot[index]) != 0) { return -1; }
+        if (info->result_32 == 0) { return len; }
+        if (generator->push_integer_local(high_slot[index]) != 0) { return -1; }
+        return len;
+      }
+
+      if (info->result_32 == 0) { return 0; }
+      if (generator->push_integer_local(frame_slot[index]) != 0) { return -1; }
+      if (extend_int32(generator, info, &info->result) != 0) { return -1; }
+      return len;
+
+    case 0x36: // istore
+    case 0x3b: // istore_0
+    case 0x3c: // istore_1
+    case 0x3d: // istore_2
+    case 0x3e: // istore_3
+      if (!locals_32[index]) { return 0; }
+
+      // Whatever pushed it couldn't be followed so it came as 16 bits
+      if (info->op_32 == 0)
+      {
+        if (extend_int32(generator, info, &info->operand[0]) != 0) { return -1; }
+      }
+
+      if (generator->pop_integer_local(high_slot[index]) != 0) { return -1; }
+      if (generator->pop_integer_local(frame_slot[index]) != 0) { return -1; }
+      return len;
+
+    case 0x84: // iinc
+      if (!locals_32[index]) { return 0; }
+
+      value = bytes[pc] == 0xc4 ? GET_PC_INT16(4) : (int8_t)bytes[pc+2];
+
+      if (generator->push_integer_local(frame_slot[index]) != 0 ||
+          generator->push_integer_local(high_slot[index]) != 0 ||
+          push_int32(generator, value) != 0 ||
+          generator->add_integers_32() != 0 ||
+          generator->pop_integer_local(high_slot[index]) != 0 ||
+          generator->pop_integer_local(frame_slot[index]) != 0)
+      {
+        return -1;
+      }
+      return len;
+
+    case 0x60: // iadd
+    case 0x64: // isub
+      if (info->op_32 == 0) { return 0; }
+
+      if (opcode == 0x60)
+      {
+        if (generator->add_integers_32() != 0) { return -1; }
+      }
+        else
+      {
+        if (generator->sub_integers_32() != 0) { return -1; }
+      }
+
+      // Nothing needs the high word of the result
+      if (info->result_32 == 0)
+      {
+        if (generator->pop() != 0) { return -1; }
+      }
+      return len;
+
+    case 0x99: // ifeq
+    case 0x9a: // ifne
+    case 0x9b: // iflt
+    case 0x9c: // ifge
+    case 0x9d: // ifgt
+    case 0x9e: // ifle
+      if (info->op_32 == 0) { return 0; }
+
+      cond = get_branch(label, method_name, bytes, pc, address, invert_address, cond_table[opcode-153]);
+      if (push_int32(generator, 0) != 0) { return -1; }
+      if (generator->jump_cond_integer_32(label, cond) != 0) { return -1; }
+      return len;
+
+    case 0x9f: // if_icmpeq
+    case 0xa0: // if_icmpne
+    case 0xa1: // if_icmplt
+    case 0xa2: // if_icmpge
+    case 0xa3: // if_icmpgt
+    case 0xa4: // if_icmple
+      if (info->op_32 == 0) { return 0; }
+
+      cond = get_branch(label, method_name, bytes, pc, address, invert_address, cond_table[opcode-159]);
+      if (generator->jump_cond_integer_32(label, cond) != 0) { return -1; }
+      return len;
+
+    default:
+      return 0;
+  }
+}
+
+// Something the normal code compiled (the last instruction of what it
+// merged) pushed a 16 bit value that 32 bit math is going to use.
+static int extend_result(Generator *generator, uint8_t *bytes, int pc_start, int address, int address_end, range_info_t *range_info)
+{
+int len;
+
+  while(1)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (len <= 0 || address + len >= address_end) { break; }
+    address += len;
+  }
+
+  if (range_info[address].result_32 == 0) { return 0; }
+
+  return extend_int32(generator, &range_info[address], &range_info[address].result);
+}
+
+int compile_method(JavaClass *java_class, int method_id, Generator *generator, Profile *profile, TimeReport *time_report)
 {
 struct methods_t *method = java_class->get_method(method_id);
 uint8_t *bytes = method->attributes[0].info;
@@ -191,6 +956,7 @@ int wide = 0;
 int pc_start;
 int max_stack;
 int max_locals;
+int param_count = 0;
 int code_len;
 uint32_t ref;
 struct generic_32bit_t *gen32;
@@ -199,11 +965,35 @@ uint8_t *label_map;
 int ret = 0;
 char label[128];
 char method_name[64];
+char method_sig[64];
 uint16_t *operand_stack;
 uint16_t operand_stack_ptr = 0;
 //uint32_t const_stack[CONST_STACK_SIZE];
 //int const_stack_ptr = 0;
 int const_val;
+range_info_t *ranges = NULL;
+range_info_t *range_info = NULL;
+uint32_t *live = NULL;
+ValueTable *values;
+int *frame_slot;
+int local_count;
+uint8_t *locals_32;
+int *high_slot;
+int int32_count = 0;
+int instr_address;
+block_t *blocks;
+int *order;
+int block_count;
+int block_index = 0;
+int invert_address = -1;
+int skip_goto_address = -1;
+loop_t *loops;
+int loop_count = 0;
+int loop_index = 0;
+bool is_unsigned;
+int bytecode_count = 0;
+int len;
+int n;
 
   if (java_class->get_method_name(method_name, sizeof(method_name), method_id) != 0)
   {
@@ -218,16 +1008,14 @@ int const_val;
     return 0;
   }
 
+  method_sig[0] = 0;
+
   if (strcmp(method_name, "main") != 0)
   {
-    char method_sig[64];
+    int is_void;
     java_class->get_name_constant(method_sig, sizeof(method_sig), method->descriptor_index);
-
-    char *s = method_sig + 1;
-    while(*s != ')' && *s != 0) { s++; }
-    *s = 0;
-    method_sig[0] = '_';
-    if (method_sig[1] != 0 ) { strcat(method_name, method_sig); }
+    get_signature(method_sig, &param_count, &is_void);
+    get_method_label(java_class, method_id, method_name, sizeof(method_name));
     printf("Using method name '%s'\n", method_name);
   }
 
@@ -242,15 +1030,137 @@ int const_val;
              ((int)bytes[code_len+9])) + 8;
   pc = pc_start;
 
-  generator->method_start(max_locals, method_name);
+  if (time_report != NULL)
+  {
+    time_report->method_start(method_name, generator->get_instr_count(), generator->get_spill_count());
+  }
+
+  // Which locals are read after each instruction so calls only save
+  // parameter registers that are still needed and locals that are never
+  // live at the same time can share a slot in the frame
+  live = (uint32_t *)malloc(code_len * sizeof(uint32_t));
+
+  if (live != NULL && compute_liveness(bytes, pc_start, code_len, live) != 0)
+  {
+    printf("Skipping liveness analysis of '%s'\n", method_name);
+    free(live);
+    live = NULL;
+  }
+
+  frame_slot = (int *)alloca((max_locals + 1) * sizeof(int));
+  local_count = share_local_slots(bytes, pc_start, code_len, live, max_locals, param_count, frame_slot);
+
+  // Block layout needs the stack depth everywhere.  The ranges only
+  // pick code (and get checked) on CPUs with 16 bit ints.
+  ranges = (range_info_t *)malloc(code_len * sizeof(range_info_t));
+
+  if (ranges != NULL &&
+      compute_ranges(java_class, method_sig, generator->get_int_size(), bytes, pc_start, code_len, max_locals, max_stack, ranges) != 0)
+  {
+    printf("Skipping range analysis of '%s'\n", method_name);
+    free(ranges);
+    ranges = NULL;
+  }
+
+  if (generator->get_int_size() < 32) { range_info = ranges; }
+
+  // Ints that need 32 bits keep their high word in a slot after the
+  // rest of the locals
+  locals_32 = (uint8_t *)alloca(max_locals + 1);
+  high_slot = (int *)alloca((max_locals + 1) * sizeof(int));
+  memset(locals_32, 0, max_locals + 1);
+
+  if (range_info != NULL)
+  {
+    int32_count = find_int32_values(java_class, bytes, pc_start, code_len, max_locals, max_stack, range_info, locals_32, &n);
+
+    if (int32_count < 0)
+    {
+      printf("Skipping 32 bit values of '%s'\n", method_name);
+      memset(locals_32, 0, max_locals + 1);
+      int32_count = 0;
+    }
+  }
+
+  for (n = 0; n < max_locals; n++)
+  {
+    high_slot[n] = locals_32[n] ? local_count++ : -1;
+  }
+
+  generator->method_start(local_count, param_count, method_name);
   operand_stack = (uint16_t *)alloca(max_stack * sizeof(uint16_t));
 
+  // A parameter that can get bigger than 16 bits needs its high word
+  for (n = 0; n < param_count && n < max_locals; n++)
+  {
+    if (!locals_32[n]) { continue; }
+
+    if (generator->push_integer_local(frame_slot[n]) != 0 ||
+        generator->extend_integer(method_sig[n + 1] == 'C') != 0 ||
+        generator->pop_integer_local(high_slot[n]) != 0 ||
+        generator->pop() != 0)
+    {
+      printf("Error: 32 bit parameters aren't supported on this CPU.\n");
+      if (ranges != NULL) { free(ranges); }
+      if (live != NULL) { free(live); }
+      return -1;
+    }
+  }
+
   int label_map_len = (code_len / 8) + 1;
   label_map = (uint8_t *)alloca(label_map_len);
+  TIME_START(PHASE_LABEL_MAP)
   fill_label_map(label_map, label_map_len, bytes, code_len, pc_start);
+  TIME_STOP(PHASE_LABEL_MAP)
+
+  // Value numbers count stack slots as one register each which isn't
+  // true with 32 bit values on the stack
+  values = NULL;
+
+  if (int32_count == 0)
+  {
+    values = new ValueTable(bytes, pc_start, code_len, max_stack, max_locals, frame_slot, label_map);
+  }
+
+  blocks = (block_t *)alloca(code_len * sizeof(block_t));
+  order = (int *)alloca(code_len * sizeof(int));
+
+  // An instrumented build labels every block so simulate -profile can
+  // count how often each one starts
+  if (generator->get_instrument())
+  {
+    block_count = get_blocks(bytes, pc_start, code_len, label_map, blocks);
+
+    for (n = 0; n < block_count; n++)
+    {
+      label_map[blocks[n].start / 8] |= 1 << (blocks[n].start % 8);
+    }
+  }
+
+  block_count = get_layout(profile, method_name, bytes, pc_start, code_len, ranges, label_map, blocks, order);
+
+  if (block_count != 0)
+  {
+    start_block(blocks, order, block_count, 0, bytes, pc_start, &invert_address, &skip_goto_address);
+  }
+
+  // Counted loops the generator can run with its hardware loops.  Block
+  // layout could move the test at the top so it's one or the other.  An
+  // instrumented build counts the blocks a --profile build will have.
+  if (generator->get_loop_max() != 0 && block_count == 0 &&
+      !generator->get_instrument() && int32_count == 0)
+  {
+    loops = (loop_t *)alloca((code_len / 8 + 1) * sizeof(loop_t));
+    loop_count = find_loops(java_class, bytes, pc_start, code_len, live, range_info, generator->get_loop_max(), loops, code_len / 8 + 1);
+
+    if (loop_count < 0)
+    {
+      printf("Skipping loop analysis of '%s'\n", method_name);
+      loop_count = 0;
+    }
+  }
 
 #ifdef DEBUG
-printf("pc=%d\n", pc);
 printf("max_stack=%d\n", max_stack);
 printf("max_locals=%d\n", max_locals);
 printf("code_len=%d\n", code_len);
@@ -259,15 +1169,70 @@ printf("code_len=%d\n", code_len);
   while(pc - pc_start < code_len)
   {
     int address = pc - pc_start;
-#ifdef DEBUG
-    printf("pc=%d opcode=%d (0x%02x)\n", address, bytes[pc], bytes[pc]);
-#endif
     if ((label_map[address / 8] & (1 << (address % 8))) != 0)
     {
       sprintf(label, "%s_%d", method_name, address);
       generator->label(label);
+
+      // Only what every path into here agrees on is kept
+      if (values != NULL) { values->label(address, generator->get_stack_depth()); }
+    }
+
+    if (wide == 0) { instr_address = address; }
+    bytecode_count++;
+
+    generator->set_live_locals(live != NULL ? live[instr_address] : LIVENESS_ALL);
+
+    // A hardware loop skips the test at the top, the goto at the bottom
+    // and the iinc if nothing reads the counter
+    if (loop_index < loop_count)
+    {
+      if (address == loops[loop_index].head)
+      {
+        ret = loop_start(generator, method_name, &loops[loop_index], frame_slot);
+        if (ret != 0) { break; }
+
+        if (values != NULL) { values->reset(generator->get_stack_depth()); }
+        pc = pc_start + loops[loop_index].body;
+        continue;
+      }
+        else
+      if (address == loops[loop_index].step && !loops[loop_index].uses_counter)
+      {
+        if (values != NULL) { values->reset(generator->get_stack_depth()); }
+        pc += 3;
+        continue;
+      }
+        else
+      if (address == loops[loop_index].end - 3)
+      {
+        ret = generator->loop_end();
+        if (ret != 0) { break; }
+
+        if (values != NULL) { values->reset(generator->get_stack_depth()); }
+        loop_index++;
+        pc += 3;
+        continue;
+      }
+    }
+
+    // An expression that was already computed is copied.  Values that
+    // need 32 bits are done in 2 words.
+    len = 0;
+
+    if (wide == 0 && int32_count != 0)
+    {
+      len = compile_int32(java_class, generator, method_name, bytes, pc, address, range_info, locals_32, high_slot, frame_slot, invert_address);
+      if (len < 0) { ret = -1; break; }
+    }
+      else
+    if (wide == 0 && values != NULL)
+    {
+      len = push_known_value(generator, values, address, frame_slot);
     }
 
+    if (len != 0) { pc += len; }
+      else
     switch(bytes[pc])
     {
       case 0: // nop (0x00)
@@ -287,7 +1252,7 @@ printf("code_len=%d\n", code_len);
       case 7: // iconst_4 (0x07)
       case 8: // iconst_5 (0x08)
         const_val = uint8_t(bytes[pc])-3;
-        ret = optimize_const(java_class, generator, method_name, bytes, pc + 1, pc_start + code_len, address + 1, const_val);
+        ret = optimize_const(java_class, generator, method_name, bytes, pc + 1, pc_start + code_len, address + 1, const_val, label_map, range_info, values, frame_slot, invert_address, time_report);
         if (ret == 0)
         {
           ret = generator->push_integer(const_val);
@@ -334,7 +1299,7 @@ printf("code_len=%d\n", code_len);
       case 16: // bipush (0x10)
         //PUSH_BYTE((char)bytes[pc+1])
         const_val = (int8_t)bytes[pc+1];
-        ret = optimize_const(java_class, generator, method_name, bytes, pc + 2, pc_start + code_len, address + 2, const_val);
+        ret = optimize_const(java_class, generator, method_name, bytes, pc + 2, pc_start + code_len, address + 2, const_val, label_map, range_info, values, frame_slot, invert_address, time_report);
         if (ret == 0)
         {
           // FIXME - I don't think push_byte() is really needed.
@@ -351,7 +1316,7 @@ printf("code_len=%d\n", code_len);
 
       case 17: // sipush (0x11)
         const_val = (int16_t)((bytes[pc+1]<<8)|(bytes[pc+2]));
-        ret = optimize_const(java_class, generator, method_name, bytes, pc + 3, pc_start + code_len, address + 3, const_val);
+        ret = optimize_const(java_class, generator, method_name, bytes, pc + 3, pc_start + code_len, address + 3, const_val, label_map, range_info, values, frame_slot, invert_address, time_report);
         if (ret == 0)
         {
           // FIXME - I don't think push_short() is really needed.
@@ -373,7 +1338,14 @@ printf("code_len=%d\n", code_len);
         {
           //PUSH_INTEGER(gen32->value);
           const_val = gen32->value;
-          ret = optimize_const(java_class, generator, method_name, bytes, pc + 2, pc_start + code_len, address + 2, const_val);
+
+          // Nothing uses the upper bits of this one (see compile_int32())
+          if (range_info != NULL && (const_val < -32768 || const_val > 65535))
+          {
+            const_val = (int16_t)const_val;
+          }
+
+          ret = optimize_const(java_class, generator, method_name, bytes, pc + 2, pc_start + code_len, address + 2, const_val, label_map, range_info, values, frame_slot, invert_address, time_report);
           if (ret == 0)
           {
             ret = generator->push_integer(const_val);
@@ -420,13 +1392,13 @@ printf("code_len=%d\n", code_len);
         if (wide == 1)
         {
           //PUSH_INTEGER(local_vars[GET_PC_UINT16(1)]);
-          ret = generator->push_integer_local(GET_PC_UINT16(1));
+          ret = generator->push_integer_local(frame_slot[GET_PC_UINT16(1)]);
           pc += 3;
         }
           else
         {
           //PUSH_INTEGER(local_vars[bytes[pc+1]]);
-          ret = generator->push_integer_local(bytes[pc+1]);
+          ret = generator->push_integer_local(frame_slot[bytes[pc+1]]);
           pc += 2;
         }
         break;
@@ -490,7 +1462,7 @@ printf("code_len=%d\n", code_len);
       case 28: // iload_2 (0x1c)
       case 29: // iload_3 (0x1d)
         // Push a local integer variable on the stack
-        ret = generator->push_integer_local(bytes[pc]-26);
+        ret = generator->push_integer_local(frame_slot[bytes[pc]-26]);
         pc++;
         break;
 
@@ -611,14 +1583,14 @@ printf("code_len=%d\n", code_len);
       case 54: // istore (0x36)
         if (wide == 1)
         {
-          ret = generator->pop_integer_local(GET_PC_UINT16(1));
+          ret = generator->pop_integer_local(frame_slot[GET_PC_UINT16(1)]);
           //local_vars[GET_PC_UINT16(1)]=POP_INTEGER();
           pc += 3;
         }
           else
         {
           //local_vars[bytes[pc+1]]=POP_INTEGER();
-          ret = generator->pop_integer_local(bytes[pc+1]);
+          ret = generator->pop_integer_local(frame_slot[bytes[pc+1]]);
           pc += 2;
         }
         break;
@@ -676,7 +1648,7 @@ printf("code_len=%d\n", code_len);
       case 61: // istore_2 (0x3d)
       case 62: // istore_3 (0x3e)
         // Pop integer off stack and store in local variable
-        ret = generator->pop_integer_local(bytes[pc]-59);
+        ret = generator->pop_integer_local(frame_slot[bytes[pc]-59]);
         pc++;
         break;
 
@@ -933,7 +1905,20 @@ printf("code_len=%d\n", code_len);
 
       case 108: // idiv (0x6c)
         // Pop top two integers from stack, divide them, push result
-        ret = generator->div_integers();
+        check_int_size(range_info, bytes, pc, address);
+        is_unsigned = is_unsigned_divide(range_info, address);
+        ret = optimize_div_mod(generator, bytes, pc, pc_start + code_len, address, label_map, values, frame_slot, false, 0, is_unsigned);
+        if (ret > 0)
+        {
+          pc += ret;
+          ret = 0;
+        }
+          else
+        if (ret == 0)
+        {
+          ret = is_unsigned ? generator->div_integers_unsigned() : -1;
+          if (ret == -1) { ret = generator->div_integers(); }
+        }
         pc++;
         break;
 
@@ -953,8 +1938,21 @@ printf("code_len=%d\n", code_len);
         break;
 
       case 112: // irem (0x70)
-        // Pop top two integers from stack, divide them, push result
-        ret = generator->mod_integers();
+        // Pop top two integers from stack, divide them, push remainder
+        check_int_size(range_info, bytes, pc, address);
+        is_unsigned = is_unsigned_divide(range_info, address);
+        ret = optimize_div_mod(generator, bytes, pc, pc_start + code_len, address, label_map, values, frame_slot, false, 0, is_unsigned);
+        if (ret > 0)
+        {
+          pc += ret;
+          ret = 0;
+        }
+          else
+        if (ret == 0)
+        {
+          ret = is_unsigned ? generator->mod_integers_unsigned() : -1;
+          if (ret == -1) { ret = generator->mod_integers(); }
+        }
         pc++;
         break;
 
@@ -1012,6 +2010,7 @@ printf("code_len=%d\n", code_len);
       case 122: // ishr (0x7a)
         // Pop two integer values from stack shift right and push result
         // *(stack-1) >> *(stack-0)
+        check_int_size(range_info, bytes, pc, address);
         ret = generator->shift_right_integer();
         pc++;
         break;
@@ -1026,6 +2025,7 @@ printf("code_len=%d\n", code_len);
       case 124: // iushr (0x7c)
         // Pop two unsigned integer values from stack shift left and push result
         // *(stack-1) <<< *(stack-0)
+        check_int_size(range_info, bytes, pc, address);
         ret = generator->shift_right_uinteger();
         pc++;
         break;
@@ -1077,13 +2077,13 @@ printf("code_len=%d\n", code_len);
         if (wide == 1)
         {
           //local_vars[GET_PC_UINT16(1)] += GET_PC_INT16(3);
-          ret = generator->inc_integer(GET_PC_UINT16(1), GET_PC_INT16(3));
+          ret = generator->inc_integer(frame_slot[GET_PC_UINT16(1)], GET_PC_INT16(3));
           pc += 5;
         }
           else
         {
           //local_vars[bytes[pc+1]] += ((char)bytes[pc+2]);
-          ret = generator->inc_integer(bytes[pc+1], bytes[pc+2]);
+          ret = generator->inc_integer(frame_slot[bytes[pc+1]], (int8_t)bytes[pc+2]);
           pc += 3;
         }
         break;
@@ -1162,19 +2162,22 @@ printf("code_len=%d\n", code_len);
 
       case 145: // i2b (0x91)
         // Pop top integer from stack and push as a byte
-        UNIMPL()
+        if (is_cast_needed(range_info, address, -128, 127) &&
+            generator->integer_to_byte() != 0) { UNIMPL() }
         pc++;
         break;
 
       case 146: // i2c (0x92)
         // Pop top integer from stack and push as a char
-        UNIMPL()
+        if (is_cast_needed(range_info, address, 0, 65535) &&
+            generator->integer_to_char() != 0) { UNIMPL() }
         pc++;
         break;
 
       case 147: // i2s (0x93)
         // Pop top integer from stack and push as a short
-        UNIMPL()
+        if (is_cast_needed(range_info, address, -32768, 32767) &&
+            generator->integer_to_short() != 0) { UNIMPL() }
         pc++;
         break;
 
@@ -1209,8 +2212,9 @@ printf("code_len=%d\n", code_len);
       case 156: // ifge (0x9c)
       case 157: // ifgt (0x9d)
       case 158: // ifle (0x9e)
-        sprintf(label, "%s_%d", method_name, address + GET_PC_INT16(1));
-        ret = generator->jump_cond(label, cond_table[bytes[pc]-153]);
+        const_val = get_branch(label, method_name, bytes, pc, address, invert_address, cond_table[bytes[pc]-153]);
+        check_int_size(range_info, bytes, pc, address);
+        ret = generator->jump_cond(label, const_val);
         pc += 3;
         //value1 = POP_INTEGER();
         //if (value1 == 0)
@@ -1225,8 +2229,16 @@ printf("code_len=%d\n", code_len);
       case 162: // if_icmpge (0xa2)
       case 163: // if_icmpgt (0xa3)
       case 164: // if_icmple (0xa4)
-        sprintf(label, "%s_%d", method_name, address + GET_PC_INT16(1));
-        ret = generator->jump_cond_integer(label, cond_table[bytes[pc]-159]);
+        const_val = get_branch(label, method_name, bytes, pc, address, invert_address, cond_table[bytes[pc]-159]);
+        check_int_size(range_info, bytes, pc, address);
+        if (is_unsigned_compare(range_info, address))
+        {
+          ret = generator->jump_cond_integer_unsigned(label, const_val);
+        }
+          else
+        {
+          ret = generator->jump_cond_integer(label, const_val);
+        }
         pc += 3;
 
         //value1 = POP_INTEGER();
@@ -1246,6 +2258,8 @@ printf("code_len=%d\n", code_len);
         break;
 
       case 167: // goto (0xa7)
+        // Block layout put the target right after this
+        if (address == skip_goto_address) { pc += 3; break; }
         sprintf(label, "%s_%d", method_name, address + GET_PC_INT16(1));
         ret = generator->jump(label);
         pc += 3;
@@ -1269,13 +2283,13 @@ printf("code_len=%d\n", code_len);
         if (wide == 1)
         {
           //pc = local_vars[GET_PC_UINT16(1)];
-          ret = generator->return_local(GET_PC_UINT16(1), max_locals);
+          ret = generator->return_local(frame_slot[GET_PC_UINT16(1)], local_count);
           pc += 3;
         }
           else
         {
           //pc = local_vars[bytes[pc+1]];
-          ret = generator->return_local(bytes[pc+1], max_locals);
+          ret = generator->return_local(frame_slot[bytes[pc+1]], local_count);
           pc += 2;
         }
 #endif
@@ -1297,7 +2311,7 @@ printf("code_len=%d\n", code_len);
         //stack_values = java_stack->values;
         //stack_types = java_stack->types;
         //PUSH_INTEGER(value1);
-        ret = generator->return_integer(max_locals);
+        ret = generator->return_integer(local_count);
         pc++;
         break;
 
@@ -1334,7 +2348,7 @@ printf("code_len=%d\n", code_len);
         break;
 
       case 177: // return (0xb1)
-        ret = generator->return_void(max_locals);
+        ret = generator->return_void(local_count);
         pc++;
         break;
 
@@ -1382,7 +2396,9 @@ printf("code_len=%d\n", code_len);
           break;
         }
         
+        TIME_START(PHASE_INVOKE)
         ret = invoke_virtual(java_class, ref, operand_stack[--operand_stack_ptr], generator);
+        TIME_STOP(PHASE_INVOKE)
         pc += 3;
         break;
 
@@ -1392,7 +2408,9 @@ printf("code_len=%d\n", code_len);
 
       case 184: // invokestatic (0xb8)
         ref = GET_PC_UINT16(1);
+        TIME_START(PHASE_INVOKE)
         ret = invoke_static(java_class, ref, generator);
+        TIME_STOP(PHASE_INVOKE)
         pc += 3;
         break;
 
@@ -1546,17 +2564,51 @@ printf("code_len=%d\n", code_len);
 
     if (ret != 0) { break; }
 
+    if (int32_count != 0 && len == 0)
+    {
+      ret = extend_result(generator, bytes, pc_start, instr_address, pc - pc_start, range_info);
+      if (ret != 0) { break; }
+    }
+
+    if (values != NULL)
+    {
+      values->update(instr_address, pc - pc_start, generator->get_stack_depth());
+    }
+
+    if (block_count != 0 && pc - pc_start >= blocks[order[block_index]].end)
+    {
+      ret = end_block(generator, method_name, blocks, order, block_count, block_index, invert_address, skip_goto_address);
+      if (ret != 0) { break; }
+
+      if (++block_index == block_count) { break; }
+
+      start_block(blocks, order, block_count, block_index, bytes, pc_start, &invert_address, &skip_goto_address);
+      pc = pc_start + blocks[order[block_index]].start;
+    }
+
 #ifdef DEBUG
     //stack_dump(stack_values_start, stack_types, stack_ptr);
 #endif
 
-    //printf("pc=%d opcode=%d (0x%02x)\n", pc - pc_start, bytes[pc], bytes[pc]);
     //if (pc - pc_start >= code_len) { break; }
 
     wide = 0;
   }
 
-  generator->method_end(max_locals);
+  generator->method_end(local_count);
+  generator->write_instrs();
+
+  report_int_size(range_info, method_name, bytes, pc_start, code_len);
+
+  delete values;
+
+  if (time_report != NULL)
+  {
+    time_report->method_end(generator->get_instr_count(), bytecode_count, generator->get_spill_count());
+  }
+
+  if (ranges != NULL) { free(ranges); }
+  if (live != NULL) { free(live); }
 
   return ret;
 }
@@ -14,6 +14,8 @@
 
 #include "Generator.h"
 #include "JavaClass.h"
+#include "profile.h"
+#include "time_report.h"
 
 #define GET_PC_INT16(a) ((int16_t)(((uint16_t)bytes[pc+a+0])<<8|bytes[pc+a+1]))
 #define GET_PC_UINT16(a) (((uint16_t)bytes[pc+a+0])<<8|bytes[pc+a+1])
@@ -26,7 +28,8 @@
                          ((uint32_t)bytes[pc+a+2])<<8|\
                           bytes[pc+a+3])
 
-int compile_method(JavaClass *java_class, int method_id, Generator *generator);
+void fill_label_map(uint8_t *label_map, int label_map_len, uint8_t *bytes, int code_len, int pc_start);
+int compile_method(JavaClass *java_class, int method_id, Generator *generator, Profile *profile, TimeReport *time_report);
 
 #endif
 
@@ -0,0 +1,184 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "JavaClass.h"
+#include "call_graph.h"
+#include "compile.h"
+#include "Generator.h"
+#include "time_report.h"
+
+// Compile throughput benchmark.  Class files from scripts/synthclass.py
+// are loaded and compiled the same way java_grinder does it with each
+// phase timed on its own:
+//
+//   parse       reading the class file into a JavaClass and building
+//               its call graph
+//   compile     compile_method() over every method including writing
+//               each method's instruction list to the .asm file
+//   label map   the part of compile spent in fill_label_map(), timed
+//               inside compile_method() so it isn't counted twice
+//   emit        the runtime helpers the generator writes when it's
+//               deleted and flushing the .asm file
+//
+// The .asm output is fully buffered so disk writes land in emit.
+// compile_method() prints a lot to stdout so that goes to /dev/null
+// while the phases run.  A class that doesn't compile gets no numbers.
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024 * 1024)
+
+static double get_time()
+{
+struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int get_code_info(JavaClass *java_class, int index, uint8_t **bytes, int *code_len, int *pc_start)
+{
+struct methods_t *method = java_class->get_method(index);
+
+  if (method->attribute_count == 0) { return -1; }
+
+  *bytes = method->attributes[0].info;
+  *code_len = ((int)(*bytes)[4] << 24) |
+              ((int)(*bytes)[5] << 16) |
+              ((int)(*bytes)[6] << 8) |
+              ((int)(*bytes)[7]);
+  *pc_start = (((int)(*bytes)[*code_len + 8] << 8) |
+               ((int)(*bytes)[*code_len + 9])) + 8;
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+FILE *in;
+Generator *generator;
+JavaClass *java_class;
+CallGraph *call_graph;
+TimeReport *time_report;
+struct rusage usage;
+double start, parse_time, label_time, compile_time, emit_time;
+uint8_t *bytes;
+char *buffer;
+int code_len, pc_start;
+int method_count;
+int bytecodes = 0;
+int saved_stdout;
+int ret = 0;
+int index;
+
+  if (argc != 4)
+  {
+    printf("Usage: %s <class> <outfile> <cpu>\n", argv[0]);
+    exit(0);
+  }
+
+  in = fopen(argv[1], "rb");
+
+  if (in == NULL)
+  {
+    printf("Cannot open classfile %s\n", argv[1]);
+    exit(1);
+  }
+
+  generator = new_generator(argv[3]);
+
+  if (generator == NULL)
+  {
+    printf("Unknown cpu type: %s\n", argv[3]);
+    exit(1);
+  }
+
+  if (generator->open(argv[2]) == -1) { exit(1); }
+
+  buffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+  setvbuf(generator->get_output(), buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+  fflush(stdout);
+  saved_stdout = dup(1);
+  dup2(open("/dev/null", O_WRONLY), 1);
+
+  start = get_time();
+  java_class = new JavaClass(in);
+  call_graph = new CallGraph(java_class, generator->get_int_size());
+  generator->set_call_graph(call_graph);
+  parse_time = get_time() - start;
+
+  method_count = java_class->get_method_count();
+
+  for (index = 0; index < method_count; index++)
+  {
+    if (get_code_info(java_class, index, &bytes, &code_len, &pc_start) != 0) { continue; }
+    bytecodes += code_len;
+  }
+
+  time_report = new TimeReport();
+
+  start = get_time();
+
+  for (index = 0; index < method_count; index++)
+  {
+    if (compile_method(java_class, index, generator, NULL, time_report) != 0)
+    {
+      ret = -1;
+      break;
+    }
+  }
+
+  compile_time = get_time() - start;
+  label_time = time_report->get_phase_time(PHASE_LABEL_MAP);
+
+  start = get_time();
+  delete generator;
+  emit_time = get_time() - start;
+
+  fflush(stdout);
+  dup2(saved_stdout, 1);
+  close(saved_stdout);
+
+  if (ret != 0)
+  {
+    printf("** Error compiling method %d of %d, no numbers.\n", index, method_count);
+  }
+    else
+  {
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("Methods: %d (%d bytes of bytecode)\n", method_count, bytecodes);
+    printf("%-12s %10.3f ms\n", "Parse:", parse_time * 1000);
+    printf("%-12s %10.3f ms  %.0f methods/s\n", "Compile:", compile_time * 1000,
+      compile_time == 0 ? 0 : method_count / compile_time);
+    printf("%-12s %10.3f ms  (part of compile)\n", "Label map:", label_time * 1000);
+    printf("%-12s %10.3f ms\n", "Emit:", emit_time * 1000);
+    printf("%-12s %10ld KB\n", "Peak RSS:", usage.ru_maxrss);
+  }
+
+  delete time_report;
+  delete call_graph;
+  delete java_class;
+  free(buffer);
+  fclose(in);
+
+  return ret;
+}
+
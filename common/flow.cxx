@@ -0,0 +1,100 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "compile.h"
+#include "flow.h"
+#include "table_java_instr.h"
+
+// Returns the length of the instruction at address including a wide
+// prefix, or -1 if the instruction can't be sized (switch tables).
+int get_instr_len(uint8_t *bytes, int pc_start, int address)
+{
+int opcode = bytes[pc_start + address];
+
+  if (opcode == 0xc4)
+  {
+    return table_java_instr[bytes[pc_start + address + 1]].wide + 1;
+  }
+
+  // tableswitch and lookupswitch have variable length
+  if (opcode == 0xaa || opcode == 0xab) { return -1; }
+
+  return table_java_instr[opcode].normal;
+}
+
+// Fills successors[] with the addresses that can execute after the
+// instruction at address.  Returns the count, or -1 if the instruction
+// has a flow the analysis passes don't handle.
+int get_successors(uint8_t *bytes, int pc_start, int code_len, int address, int *successors)
+{
+int pc = pc_start + address;
+int len = get_instr_len(bytes, pc_start, address);
+int count = 0;
+
+  if (len <= 0) { return -1; }
+
+  switch(bytes[pc])
+  {
+    case 0x99:  // ifeq
+    case 0x9a:  // ifne
+    case 0x9b:  // iflt
+    case 0x9c:  // ifge
+    case 0x9d:  // ifgt
+    case 0x9e:  // ifle
+    case 0x9f:  // if_icmpeq
+    case 0xa0:  // if_icmpne
+    case 0xa1:  // if_icmplt
+    case 0xa2:  // if_icmpge
+    case 0xa3:  // if_icmpgt
+    case 0xa4:  // if_icmple
+    case 0xa5:  // if_acmpeq
+    case 0xa6:  // if_acmpne
+    case 0xc6:  // ifnull
+    case 0xc7:  // ifnonnull
+      successors[count++] = address + len;
+      successors[count++] = address + GET_PC_INT16(1);
+      break;
+    case 0xa7:  // goto
+      successors[count++] = address + GET_PC_INT16(1);
+      break;
+    case 0xc8:  // goto_w
+      successors[count++] = address + GET_PC_INT32(1);
+      break;
+    case 0xac:  // ireturn
+    case 0xad:  // lreturn
+    case 0xae:  // freturn
+    case 0xaf:  // dreturn
+    case 0xb0:  // areturn
+    case 0xb1:  // return
+    case 0xbf:  // athrow
+      break;
+    case 0xa8:  // jsr
+    case 0xa9:  // ret
+    case 0xc9:  // jsr_w
+      return -1;
+    default:
+      successors[count++] = address + len;
+      break;
+  }
+
+  for (int n = 0; n < count; n++)
+  {
+    if (successors[n] < 0 || successors[n] >= code_len) { return -1; }
+  }
+
+  return count;
+}
+
@@ -0,0 +1,26 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _FLOW_H
+#define _FLOW_H
+
+#include <stdint.h>
+
+// Helpers for walking the control flow of a method's bytecode.  All
+// addresses are relative to pc_start (the first opcode of the method).
+
+#define FLOW_MAX_SUCCESSORS 2
+
+int get_instr_len(uint8_t *bytes, int pc_start, int address);
+int get_successors(uint8_t *bytes, int pc_start, int code_len, int address, int *successors);
+
+#endif
+
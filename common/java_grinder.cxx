@@ -12,84 +12,187 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
+#include "Assembler.h"
+#include "call_graph.h"
+#include "elf.h"
 #include "JavaClass.h"
 #include "compile.h"
 #include "Generator.h"
-#include "ARM.h"
-#include "DSPIC.h"
-#include "M6502.h"
-#include "MSP430.h"
-#include "MSP430X.h"
+#include "profile.h"
+#include "time_report.h"
 
 #define STACK_LEN 65536
 
+enum
+{
+  OUTPUT_ASM,
+  OUTPUT_HEX,
+  OUTPUT_BIN,
+  OUTPUT_ELF,
+};
+
+// An outfile ending in .hex, .bin or .o is assembled here instead of
+// being left as a .asm for naken_asm
+static int get_output_type(const char *filename)
+{
+int len = strlen(filename);
+
+  if (len > 4 && strcasecmp(filename + len - 4, ".hex") == 0) { return OUTPUT_HEX; }
+  if (len > 4 && strcasecmp(filename + len - 4, ".bin") == 0) { return OUTPUT_BIN; }
+  if (len > 2 && strcasecmp(filename + len - 2, ".o") == 0) { return OUTPUT_ELF; }
+
+  return OUTPUT_ASM;
+}
+
 int main(int argc, char *argv[])
 {
 FILE *in;
 Generator *generator;
+Assembler *assembler = NULL;
 JavaClass *java_class;
+CallGraph *call_graph;
+Profile *profile = NULL;
+TimeReport *time_report = NULL;
+char *time_report_file = NULL;
+char *listing_file = NULL;
+int runtime = RUNTIME_SIZE;
+bool static_frames = false;
+bool instrument = false;
+bool discard = false;
+int output_type;
 int index;
 
-  if (argc != 4)
+  for (index = 4; index < argc; index++)
   {
-    printf("Usage: %s <class> <outfile> <dspic/msp430g2231/msp430g2553/m6502/arm>\n", argv[0]);
-    exit(0);
-  }
+    if (strcmp(argv[index], "--profile") == 0 && index + 1 < argc && profile == NULL)
+    {
+      profile = new Profile();
 
-  in = fopen(argv[1],"rb");
-  if (in == NULL)
-  {
-    printf("Cannot open classfile %s\n", argv[1]);
-    exit(1);
-  }
+      if (profile->load(argv[++index]) != 0) { exit(1); }
+    }
+      else
+    if (strcmp(argv[index], "--time-report") == 0 && index + 1 < argc)
+    {
+      time_report_file = argv[++index];
+    }
+      else
+    if (strcmp(argv[index], "--listing") == 0 && index + 1 < argc)
+    {
+      listing_file = argv[++index];
+    }
+      else
+    if (strcmp(argv[index], "--runtime") == 0 && index + 1 < argc)
+    {
+      index++;
 
-  if (strcasecmp("msp430g2231",argv[3]) == 0)
-  {
-    generator = new MSP430(MSP430G2231);
-  }
-    else
-  if (strcasecmp("msp430g2553",argv[3]) == 0)
-  {
-    generator = new MSP430(MSP430G2553);
+      if (strcmp(argv[index], "size") == 0) { runtime = RUNTIME_SIZE; }
+      else if (strcmp(argv[index], "speed") == 0) { runtime = RUNTIME_SPEED; }
+      else if (strcmp(argv[index], "hwmult") == 0) { runtime = RUNTIME_HWMULT; }
+      else { break; }
+    }
+      else
+    if (strcmp(argv[index], "--static-frames") == 0)
+    {
+      static_frames = true;
+    }
+      else
+    if (strcmp(argv[index], "--instrument") == 0)
+    {
+      instrument = true;
+    }
+      else
+    {
+      break;
+    }
   }
-    else
-  if (strcasecmp("msp430x",argv[3]) == 0)
+
+  if (argc < 4 || index != argc)
   {
-    generator = new MSP430X(0);
+    printf("Usage: %s <class> <outfile> <cpu> [ --profile <file> ] [ --time-report <json file> ] [ --listing <asm file> ] [ --runtime size/speed/hwmult ] [ --static-frames ] [ --instrument ]\n", argv[0]);
+    printf("  cpu is one of dspic30f3012, dspic33fj06gs101a, msp430g2231, msp430g2553,\n");
+    printf("  msp430x (or msp430fr5969), pic32mx250f128b, pic32mx795f512l, m6502 or arm.\n");
+    printf("  An outfile ending in .hex, .bin or .o is assembled to Intel HEX, a binary\n");
+    printf("  or an ELF relocatable object.\n");
+    printf("  --runtime picks small (default) or fast multiply / divide helpers or the\n");
+    printf("  hardware multiplier on MSP430 parts that have one (msp430fr5969).\n");
+    printf("  --static-frames puts locals at fixed addresses (shared by methods that\n");
+    printf("  can't run at the same time) instead of on the stack if nothing recurses.\n");
+    printf("  --instrument labels every basic block so simulate -profile can write a\n");
+    printf("  profile for --profile.\n");
+    exit(0);
   }
-    else
-  if (strcasecmp("dspic30f3012",argv[3]) == 0)
+
+  output_type = get_output_type(argv[2]);
+
+  if (output_type == OUTPUT_ASM)
   {
-    generator = new DSPIC(DSPIC30F3012);
+    listing_file = argv[2];
   }
     else
-  if (strcasecmp("dspic33fj06gs101a",argv[3]) == 0)
   {
-    generator = new DSPIC(DSPIC33FJ06GS101A);
+    assembler = new_assembler(argv[3]);
+
+    if (assembler == NULL)
+    {
+      printf("No assembler for %s, use a .asm outfile\n", argv[3]);
+      exit(1);
+    }
+
+    assembler->set_filename(listing_file != NULL ? listing_file : argv[2]);
+
+    if (output_type == OUTPUT_ELF)
+    {
+      if (assembler->get_elf_machine() == -1)
+      {
+        printf("No ELF output for %s\n", argv[3]);
+        exit(1);
+      }
+
+      assembler->set_relocatable();
+    }
   }
-    else
-  if (strcasecmp("m6502",argv[3]) == 0)
+
+  if (time_report_file != NULL) { time_report = new TimeReport(); }
+
+  in = fopen(argv[1],"rb");
+  if (in == NULL)
   {
-    generator = new M6502();
+    printf("Cannot open classfile %s\n", argv[1]);
+    exit(1);
   }
-    else
-  if (strcasecmp("arm",argv[3]) == 0)
+
+  generator = new_generator(argv[3]);
+
+  if (generator == NULL)
   {
-    generator = new ARM();
+    printf("Unknown cpu type: %s\n", argv[3]);
+    exit(1);
   }
-    else
+
+  if (runtime == RUNTIME_HWMULT && !generator->has_hwmult())
   {
-    printf("Unknown cpu type: %s\n", argv[3]);
+    printf("Error: %s has no hardware multiplier for --runtime hwmult\n", argv[3]);
     exit(1);
   }
 
-  if (generator->open(argv[2]) == -1)
+  generator->set_assembler(assembler);
+  generator->set_runtime(runtime);
+  if (static_frames) { generator->set_static_frames(); }
+  if (instrument) { generator->set_instrument(); }
+  if (output_type == OUTPUT_ELF) { generator->set_relocatable(); }
+
+  if (generator->open(listing_file) == -1)
   {
     exit(1);
   }
 
+  if (time_report != NULL) { time_report->start(PHASE_CLASS_LOAD); }
   java_class = new JavaClass(in);
+  call_graph = new CallGraph(java_class, generator->get_int_size());
+  generator->set_call_graph(call_graph);
+  if (time_report != NULL) { time_report->stop(PHASE_CLASS_LOAD); }
 #ifdef DEBUG
   java_class->print();
 #endif
@@ -98,7 +201,7 @@ int index;
   int ret = 0;
   for (index = 0; index < method_count; index++)
   {
-    if (compile_method(java_class, index, generator) != 0)
+    if (compile_method(java_class, index, generator, profile, time_report) != 0)
     {
       printf("** Error compiling class.\n");
       ret = -1;
@@ -106,12 +209,45 @@ int index;
     }
   }
 
+  // The generator writes its runtime helpers and closes the file (or
+  // assembles everything) here.  Code that doesn't fit isn't left
+  // behind to be flashed.
+  if (time_report != NULL) { time_report->start(PHASE_EMIT); }
+  if (ret == 0 && generator->finish() != 0) { ret = -1; discard = true; }
   delete generator;
+  if (time_report != NULL) { time_report->stop(PHASE_EMIT); }
+
+  if (discard && listing_file != NULL) { remove(listing_file); }
+
+  if (assembler != NULL)
+  {
+    if (ret == 0 && assembler->get_error_count() == 0)
+    {
+      if (output_type == OUTPUT_HEX) { ret = assembler->write_hex(argv[2]); }
+      else if (output_type == OUTPUT_BIN) { ret = assembler->write_bin(argv[2]); }
+      else { ret = write_elf(assembler, argv[2]); }
+    }
+      else
+    {
+      ret = -1;
+    }
+
+    delete assembler;
+  }
+
+  delete call_graph;
   delete java_class;
+  if (profile != NULL) { delete profile; }
+
+  if (time_report != NULL)
+  {
+    time_report->print();
+    if (time_report->write_json(time_report_file) != 0) { ret = -1; }
+    delete time_report;
+  }
 
   fclose(in);
 
   return ret;
 }
 
-
@@ -0,0 +1,152 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "flow.h"
+#include "layout.h"
+
+static bool is_label(uint8_t *label_map, int address)
+{
+  return (label_map[address / 8] & (1 << (address % 8))) != 0;
+}
+
+static int find_block(block_t *blocks, int block_count, int address)
+{
+int n;
+
+  for (n = 0; n < block_count; n++)
+  {
+    if (blocks[n].start == address) { return n; }
+  }
+
+  return -1;
+}
+
+// Fills blocks[] (which needs room for code_len entries) and returns how
+// many there are, or -1 if the method has flow that can't be split up.
+int get_blocks(uint8_t *bytes, int pc_start, int code_len, uint8_t *label_map, block_t *blocks)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int block_count = 0;
+int address,len,count,n;
+bool ends_block = true;
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (len <= 0) { return -1; }
+
+    if (ends_block || is_label(label_map, address))
+    {
+      if (block_count != 0) { blocks[block_count - 1].end = address; }
+
+      blocks[block_count].start = address;
+      blocks[block_count].count = 0;
+      block_count++;
+    }
+
+    blocks[block_count - 1].last = address;
+
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+    if (count < 0) { return -1; }
+
+    ends_block = !(count == 1 && successors[0] == address + len);
+  }
+
+  blocks[block_count - 1].end = code_len;
+
+  for (n = 0; n < block_count; n++)
+  {
+    int opcode;
+
+    address = blocks[n].last;
+    opcode = bytes[pc_start + address];
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+
+    blocks[n].next = -1;
+    blocks[n].target = -1;
+
+    if (count == 2)
+    {
+      blocks[n].next = find_block(blocks, block_count, successors[0]);
+      blocks[n].target = find_block(blocks, block_count, successors[1]);
+    }
+      else
+    if (count == 1)
+    {
+      if (opcode == 0xa7 || opcode == 0xc8)  // goto, goto_w
+      { blocks[n].target = find_block(blocks, block_count, successors[0]); }
+        else
+      { blocks[n].next = find_block(blocks, block_count, successors[0]); }
+    }
+  }
+
+  return block_count;
+}
+
+static uint32_t edge_weight(block_t *blocks, int from, int to)
+{
+  if (to == -1) { return 0; }
+
+  return blocks[from].count < blocks[to].count ? blocks[from].count : blocks[to].count;
+}
+
+// Greedy chaining: after each block place whichever successor ran the
+// most, then the next hot block in the original order.  Blocks that
+// never ran go last so they don't sit in the middle of a hot loop.
+void layout_blocks(block_t *blocks, int block_count, int *order)
+{
+bool *placed = (bool *)alloca(block_count * sizeof(bool));
+int current = 0;
+int n,k;
+
+  memset(placed, 0, block_count * sizeof(bool));
+
+  order[0] = 0;
+  placed[0] = true;
+
+  for (k = 1; k < block_count; k++)
+  {
+    int best = -1;
+    int next = blocks[current].next;
+    int target = blocks[current].target;
+
+    if (next != -1 && !placed[next] && blocks[next].count != 0)
+    {
+      best = next;
+    }
+
+    if (target != -1 && !placed[target] && blocks[target].count != 0 &&
+        (best == -1 || edge_weight(blocks, current, target) > edge_weight(blocks, current, best)))
+    {
+      best = target;
+    }
+
+    for (n = 0; n < block_count && best == -1; n++)
+    {
+      if (!placed[n] && blocks[n].count != 0) { best = n; }
+    }
+
+    for (n = 0; n < block_count && best == -1; n++)
+    {
+      if (!placed[n]) { best = n; }
+    }
+
+    order[k] = best;
+    placed[best] = true;
+    current = best;
+  }
+}
+
@@ -0,0 +1,37 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _LAYOUT_H
+#define _LAYOUT_H
+
+#include <stdint.h>
+
+#include "profile.h"
+
+// Splits a method into basic blocks and, using a profile, picks the
+// order to emit them in so the hot successor of each block falls through
+// and blocks that never ran end up at the end of the method.
+
+struct block_t
+{
+  int start;          // address of the first instruction
+  int end;            // address after the last instruction
+  int last;           // address of the last instruction
+  int next;           // block executed by falling through (or -1)
+  int target;         // block a branch at the end goes to (or -1)
+  uint32_t count;
+};
+
+int get_blocks(uint8_t *bytes, int pc_start, int code_len, uint8_t *label_map, block_t *blocks);
+void layout_blocks(block_t *blocks, int block_count, int *order);
+
+#endif
+
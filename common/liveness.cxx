@@ -0,0 +1,230 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "compile.h"
+#include "flow.h"
+#include "liveness.h"
+
+#define LOCAL_BIT(a) ((a) < 32 ? (1U << (a)) : 0)
+
+// Locals read (use) and written (def) by the instruction at address.
+// Returns -1 for instructions that use a local the analysis can't
+// follow (ret).
+int get_use_def(uint8_t *bytes, int pc_start, int address, uint32_t *use, uint32_t *def)
+{
+int pc = pc_start + address;
+int opcode = bytes[pc];
+int index = -1;
+bool wide = false;
+
+  *use = 0;
+  *def = 0;
+
+  if (opcode == 0xc4)
+  {
+    wide = true;
+    pc++;
+    opcode = bytes[pc];
+  }
+
+  if (opcode >= 0x15 && opcode <= 0x19)        // iload, lload, fload, dload, aload
+  {
+    index = wide ? GET_PC_UINT16(1) : bytes[pc + 1];
+    *use = LOCAL_BIT(index);
+    if (opcode == 0x16 || opcode == 0x18) { *use |= LOCAL_BIT(index + 1); }
+  }
+    else
+  if (opcode >= 0x1a && opcode <= 0x2d)        // iload_0 ... aload_3
+  {
+    index = (opcode - 0x1a) & 3;
+    *use = LOCAL_BIT(index);
+    if (opcode >= 0x1e && opcode <= 0x21) { *use |= LOCAL_BIT(index + 1); }
+    if (opcode >= 0x26 && opcode <= 0x29) { *use |= LOCAL_BIT(index + 1); }
+  }
+    else
+  if (opcode >= 0x36 && opcode <= 0x3a)        // istore, lstore, fstore, dstore, astore
+  {
+    index = wide ? GET_PC_UINT16(1) : bytes[pc + 1];
+    *def = LOCAL_BIT(index);
+    if (opcode == 0x37 || opcode == 0x39) { *def |= LOCAL_BIT(index + 1); }
+  }
+    else
+  if (opcode >= 0x3b && opcode <= 0x4e)        // istore_0 ... astore_3
+  {
+    index = (opcode - 0x3b) & 3;
+    *def = LOCAL_BIT(index);
+    if (opcode >= 0x3f && opcode <= 0x42) { *def |= LOCAL_BIT(index + 1); }
+    if (opcode >= 0x47 && opcode <= 0x4a) { *def |= LOCAL_BIT(index + 1); }
+  }
+    else
+  if (opcode == 0x84)                          // iinc
+  {
+    index = wide ? GET_PC_UINT16(1) : bytes[pc + 1];
+    *use = LOCAL_BIT(index);
+  }
+    else
+  if (opcode == 0xa9)                          // ret
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+bool is_local_live(uint32_t live, int index)
+{
+  if (index >= 32) { return true; }
+
+  return (live & (1U << index)) != 0;
+}
+
+int compute_liveness(uint8_t *bytes, int pc_start, int code_len, uint32_t *live)
+{
+uint32_t *use, *def;
+int *starts;
+int successors[FLOW_MAX_SUCCESSORS];
+uint32_t out;
+int address, count, len, n, i;
+int instr_count = 0;
+int changed;
+int ret = -1;
+
+  use = (uint32_t *)malloc(code_len * sizeof(uint32_t));
+  def = (uint32_t *)malloc(code_len * sizeof(uint32_t));
+  starts = (int *)malloc(code_len * sizeof(int));
+  if (use == NULL || def == NULL || starts == NULL) { goto exit; }
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (len <= 0) { goto exit; }
+    if (get_use_def(bytes, pc_start, address, &use[address], &def[address]) != 0) { goto exit; }
+    starts[instr_count++] = address;
+  }
+
+  memset(live, 0, code_len * sizeof(uint32_t));
+
+  // live[] is what's live after each instruction.  Going backwards most
+  // methods settle in two passes, one more for each nested loop.
+  do
+  {
+    changed = 0;
+
+    for (i = instr_count - 1; i >= 0; i--)
+    {
+      address = starts[i];
+      count = get_successors(bytes, pc_start, code_len, address, successors);
+      if (count < 0) { goto exit; }
+
+      out = 0;
+
+      for (n = 0; n < count; n++)
+      {
+        out |= use[successors[n]] | (live[successors[n]] & ~def[successors[n]]);
+      }
+
+      if (out != live[address])
+      {
+        live[address] = out;
+        changed = 1;
+      }
+    }
+  } while (changed);
+
+  ret = 0;
+
+exit:
+  free(use);
+  free(def);
+  free(starts);
+
+  return ret;
+}
+
+
+// javac gives every variable its own local even when their lifetimes
+// never overlap.  This gives the locals after the params the fewest
+// slots it can (greedy colouring) so locals that are never live at the
+// same time share one.  Two locals can't share if one is written while
+// the other is live.  slots[n] is where local n goes (params keep their
+// own) and the return value is how many slots there are.  With live ==
+// NULL, long / double locals or more than 32 locals every local keeps
+// its own slot.
+int share_local_slots(uint8_t *bytes, int pc_start, int code_len, uint32_t *live, int max_locals, int param_count, int *slots)
+{
+uint32_t interfere[32];
+uint32_t use, def, used;
+int address, len, pc;
+int count = param_count;
+int n, i;
+
+  for (n = 0; n < max_locals; n++) { slots[n] = n; }
+
+  if (live == NULL || max_locals > 32 || param_count >= max_locals)
+  {
+    return max_locals;
+  }
+
+  memset(interfere, 0, sizeof(interfere));
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (len <= 0) { return max_locals; }
+    if (get_use_def(bytes, pc_start, address, &use, &def) != 0) { return max_locals; }
+
+    // Two slot values would have to stay next to each other
+    if ((use & (use - 1)) != 0 || (def & (def - 1)) != 0) { return max_locals; }
+
+    // iinc writes the local it reads
+    pc = pc_start + address;
+    if (bytes[pc] == 0x84 || (bytes[pc] == 0xc4 && bytes[pc + 1] == 0x84))
+    {
+      def = use;
+    }
+
+    if (def == 0) { continue; }
+
+    for (n = 0; n < max_locals; n++)
+    {
+      if ((def & (1U << n)) == 0) { continue; }
+
+      interfere[n] |= live[address] & ~def;
+
+      for (i = 0; i < max_locals; i++)
+      {
+        if ((live[address] & (1U << i)) != 0 && i != n) { interfere[i] |= def; }
+      }
+    }
+  }
+
+  for (n = param_count; n < max_locals; n++)
+  {
+    used = 0;
+
+    for (i = param_count; i < n; i++)
+    {
+      if ((interfere[n] & (1U << i)) != 0) { used |= 1U << (slots[i] - param_count); }
+    }
+
+    for (i = 0; (used & (1U << i)) != 0; i++);
+
+    slots[n] = param_count + i;
+    if (slots[n] + 1 > count) { count = slots[n] + 1; }
+  }
+
+  return count;
+}
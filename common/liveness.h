@@ -0,0 +1,30 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _LIVENESS_H
+#define _LIVENESS_H
+
+#include <stdint.h>
+
+// Local variable liveness.  live[address] has bit n set if local n can
+// be read after the instruction at address runs before something writes
+// it again.  Only the first 32 locals are tracked, anything past that is
+// always live.
+
+#define LIVENESS_ALL 0xffffffff
+
+int get_use_def(uint8_t *bytes, int pc_start, int address, uint32_t *use, uint32_t *def);
+int compute_liveness(uint8_t *bytes, int pc_start, int code_len, uint32_t *live);
+bool is_local_live(uint32_t live, int index);
+int share_local_slots(uint8_t *bytes, int pc_start, int code_len, uint32_t *live, int max_locals, int param_count, int *slots);
+
+#endif
+
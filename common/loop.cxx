@@ -0,0 +1,333 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "compile.h"
+#include "flow.h"
+#include "liveness.h"
+#include "loop.h"
+
+#define LOCAL_BIT(a) (1U << (a))
+
+// Value pushed by iconst, bipush or sipush at address
+static int get_const(uint8_t *bytes, int pc_start, int address, int *value)
+{
+int pc = pc_start + address;
+
+  if (bytes[pc] >= 0x02 && bytes[pc] <= 0x08) { *value = bytes[pc] - 3; return 0; }
+  if (bytes[pc] == 0x10) { *value = (int8_t)bytes[pc + 1]; return 0; }
+  if (bytes[pc] == 0x11) { *value = GET_PC_INT16(1); return 0; }
+
+  return -1;
+}
+
+// Local read by the iload at address or -1
+static int get_iload(uint8_t *bytes, int pc_start, int address)
+{
+int pc = pc_start + address;
+
+  if (bytes[pc] == 0x15) { return bytes[pc + 1]; }
+  if (bytes[pc] >= 0x1a && bytes[pc] <= 0x1d) { return bytes[pc] - 0x1a; }
+
+  return -1;
+}
+
+// Local written by the istore at address or -1
+static int get_istore(uint8_t *bytes, int pc_start, int address)
+{
+int pc = pc_start + address;
+
+  if (bytes[pc] == 0x36) { return bytes[pc + 1]; }
+  if (bytes[pc] >= 0x3b && bytes[pc] <= 0x3e) { return bytes[pc] - 0x3b; }
+
+  return -1;
+}
+
+// Times around a loop that starts the counter at start, adds inc every
+// time and leaves when the if_icmp opcode is true of the counter and
+// limit.  Returns -1 if the counter never gets there.
+static int64_t get_count(int opcode, int start, int limit, int inc)
+{
+int64_t distance = (int64_t)limit - start;
+
+  switch(opcode)
+  {
+    case 0x9f:  // if_icmpeq: i != limit
+      if (distance % inc != 0 || distance / inc < 0) { return -1; }
+      return distance / inc;
+    case 0xa2:  // if_icmpge: i < limit
+      if (inc < 0) { return -1; }
+      return distance <= 0 ? 0 : (distance + inc - 1) / inc;
+    case 0xa3:  // if_icmpgt: i <= limit
+      if (inc < 0) { return -1; }
+      return distance < 0 ? 0 : distance / inc + 1;
+    case 0xa4:  // if_icmple: i > limit
+      if (inc > 0) { return -1; }
+      return distance >= 0 ? 0 : (-distance - inc - 1) / -inc;
+    case 0xa1:  // if_icmplt: i >= limit
+      if (inc > 0) { return -1; }
+      return distance > 0 ? 0 : -distance / -inc + 1;
+  }
+
+  return -1;
+}
+
+// The count of a loop with the limit in a local is limit - offset going
+// up by 1 or offset - limit going down by 1.  With the range the limit
+// can be in it has to be small enough for the hardware and work out the
+// same in 16 bits.
+static int get_count_offset(int opcode, int start, int inc, range_t *range, int loop_max, int *offset)
+{
+int64_t low, high;
+
+  if (!range_fits_int16(range)) { return -1; }
+
+  if (opcode == 0xa2 && inc == 1) { *offset = start; }
+  else if (opcode == 0xa3 && inc == 1 && range->max < 32767) { *offset = start - 1; }
+  else if (opcode == 0xa4 && inc == -1) { *offset = start; }
+  else if (opcode == 0xa1 && inc == -1 && range->min > -32768) { *offset = start + 1; }
+  else { return -1; }
+
+  if (inc == 1)
+  {
+    low = (int64_t)range->min - *offset;
+    high = (int64_t)range->max - *offset;
+  }
+    else
+  {
+    low = *offset - (int64_t)range->max;
+    high = *offset - (int64_t)range->min;
+  }
+
+  if (low < -32768 || high > loop_max) { return -1; }
+
+  return 0;
+}
+
+// The body can only leave the loop by getting to the iinc at the bottom.
+// Calls are out (the method called could have a loop of its own) except
+// the ones to the java_grinder classes and java/lang/Math that are done
+// inline.
+static int check_body(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, loop_t *loop, bool *reads_counter)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+uint32_t use, def, bits;
+char name[128];
+int address, pc, opcode, count, n;
+
+  bits = LOCAL_BIT(loop->local);
+  if (loop->limit_local != -1) { bits |= LOCAL_BIT(loop->limit_local); }
+
+  *reads_counter = false;
+
+  for (address = loop->body; address < loop->step; address += get_instr_len(bytes, pc_start, address))
+  {
+    pc = pc_start + address;
+    opcode = bytes[pc] == 0xc4 ? bytes[pc + 1] : bytes[pc];
+
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+    if (count <= 0) { return -1; }
+
+    for (n = 0; n < count; n++)
+    {
+      if (successors[n] <= address || successors[n] > loop->step) { return -1; }
+    }
+
+    if (opcode >= 0xb6 && opcode <= 0xba)
+    {
+      if (opcode != 0xb8 ||
+          java_class->get_class_name(name, sizeof(name), GET_PC_UINT16(1)) != 0 ||
+          (strncmp(name, "net/mikekohn/java_grinder/", 26) != 0 &&
+           strcmp(name, "java/lang/Math") != 0))
+      {
+        return -1;
+      }
+    }
+
+    if (get_use_def(bytes, pc_start, address, &use, &def) != 0) { return -1; }
+
+    // The counter and the limit can't change and iinc is a write too
+    if ((def & bits) != 0) { return -1; }
+    if (opcode == 0x84 && (use & bits) != 0) { return -1; }
+
+    if ((use & LOCAL_BIT(loop->local)) != 0) { *reads_counter = true; }
+  }
+
+  return 0;
+}
+
+// Nothing outside the loop goes into it other than falling into head
+// from the istore of the counter.
+static int check_entries(uint8_t *bytes, int pc_start, int code_len, loop_t *loop, int init)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int address, count, n;
+
+  for (address = 0; address < code_len; address += get_instr_len(bytes, pc_start, address))
+  {
+    if (address >= loop->head && address < loop->end) { continue; }
+
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+    if (count < 0) { return -1; }
+
+    for (n = 0; n < count; n++)
+    {
+      if (successors[n] == loop->head && address == init) { continue; }
+      if (successors[n] >= loop->head && successors[n] < loop->end) { return -1; }
+    }
+  }
+
+  return 0;
+}
+
+// Checks if the goto at address is the bottom of a counted loop
+static int check_loop(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, int *prev, int address, uint32_t *live, range_info_t *range_info, int loop_max, loop_t *loop)
+{
+int pc = pc_start + address;
+uint32_t use, def;
+bool reads_counter;
+int64_t count;
+int test, init, start, limit = 0, opcode;
+
+  loop->head = address + GET_PC_INT16(1);
+  loop->end = address + 3;
+
+  if (loop->head < 0 || loop->head >= address || loop->end >= code_len) { return -1; }
+  if (prev[loop->head] == -2) { return -1; }
+
+  // iload i, the limit and the if_icmp that leaves the loop
+  loop->local = get_iload(bytes, pc_start, loop->head);
+  if (loop->local == -1 || loop->local >= 32) { return -1; }
+
+  test = loop->head + get_instr_len(bytes, pc_start, loop->head);
+  loop->limit_local = get_iload(bytes, pc_start, test);
+
+  if (loop->limit_local == -1)
+  {
+    if (get_const(bytes, pc_start, test, &limit) != 0) { return -1; }
+  }
+    else
+  if (loop->limit_local >= 32 || loop->limit_local == loop->local)
+  {
+    return -1;
+  }
+
+  test += get_instr_len(bytes, pc_start, test);
+  pc = pc_start + test;
+  opcode = bytes[pc];
+
+  if (opcode < 0x9f || opcode > 0xa4) { return -1; }
+  if (test + GET_PC_INT16(1) != loop->end) { return -1; }
+
+  loop->body = test + 3;
+
+  // iinc i at the bottom
+  loop->step = prev[address];
+  pc = pc_start + loop->step;
+
+  if (loop->step < loop->body || bytes[pc] != 0x84 || bytes[pc + 1] != loop->local)
+  {
+    return -1;
+  }
+
+  loop->inc = (int8_t)bytes[pc + 2];
+  if (loop->inc == 0) { return -1; }
+
+  // The constant the counter starts at is stored right before the loop
+  init = prev[loop->head];
+  if (init < 0 || get_istore(bytes, pc_start, init) != loop->local) { return -1; }
+  if (prev[init] < 0 || get_const(bytes, pc_start, prev[init], &start) != 0) { return -1; }
+
+  if (check_body(java_class, bytes, pc_start, code_len, loop, &reads_counter) != 0) { return -1; }
+  if (check_entries(bytes, pc_start, code_len, loop, init) != 0) { return -1; }
+
+  if (loop->limit_local == -1)
+  {
+    count = get_count(opcode, start, limit, loop->inc);
+
+    // The counter has to stay in 16 bits for the code after the loop
+    if (count < 1 || count > loop_max) { return -1; }
+    if (start + count * loop->inc < -32768 || start + count * loop->inc > 32767) { return -1; }
+
+    loop->count = count;
+    loop->offset = 0;
+  }
+    else
+  {
+    if (range_info == NULL || !range_info[test].reachable) { return -1; }
+
+    if (get_count_offset(opcode, start, loop->inc, &range_info[test].operand[0], loop_max, &loop->offset) != 0)
+    {
+      return -1;
+    }
+
+    loop->count = -1;
+  }
+
+  // What's live going into the code after the loop
+  loop->uses_counter = true;
+
+  if (live != NULL && !reads_counter &&
+      get_use_def(bytes, pc_start, loop->end, &use, &def) == 0)
+  {
+    loop->uses_counter = ((use | (live[loop->end] & ~def)) & LOCAL_BIT(loop->local)) != 0;
+  }
+
+  return 0;
+}
+
+int find_loops(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, uint32_t *live, range_info_t *range_info, int loop_max, loop_t *loops, int max)
+{
+int *prev;
+int address, last, len;
+int count = 0;
+
+  // prev[] is the instruction before each one or -2 inside of one
+  prev = (int *)malloc(code_len * sizeof(int));
+  if (prev == NULL) { return -1; }
+
+  for (address = 0; address < code_len; address++) { prev[address] = -2; }
+
+  last = -1;
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+
+    if (len <= 0)
+    {
+      free(prev);
+      return -1;
+    }
+
+    prev[address] = last;
+    last = address;
+  }
+
+  for (address = 0; address < code_len && count < max; address += get_instr_len(bytes, pc_start, address))
+  {
+    if (bytes[pc_start + address] != 0xa7) { continue; }
+
+    if (check_loop(java_class, bytes, pc_start, code_len, prev, address, live, range_info, loop_max, &loops[count]) == 0)
+    {
+      count++;
+    }
+  }
+
+  free(prev);
+
+  return count;
+}
+
@@ -0,0 +1,50 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _LOOP_H
+#define _LOOP_H
+
+#include <stdint.h>
+
+#include "JavaClass.h"
+#include "range.h"
+
+// Counted loops.  javac turns for (i = k; i < n; i += s) into
+//
+//   head: iload i, <n>, if_icmpge end
+//         <body>
+//         iinc i, s
+//         goto head
+//   end:
+//
+// with k stored to i right before head.  When the number of times
+// around is known before the loop starts (n is a constant or a local the
+// body doesn't change) and nothing jumps into or out of the body, the
+// test at the top can be replaced by a CPU's hardware loop.
+
+struct loop_t
+{
+  int head;          // iload of the counter at the top
+  int body;          // first instruction of the body
+  int step;          // the iinc at the bottom
+  int end;           // after the goto back to head
+  int local;         // the counter
+  int inc;           // what the iinc adds
+  int count;         // times around or -1 if it comes from limit_local
+  int limit_local;   // count is (limit_local - offset) * inc
+  int offset;
+  bool uses_counter; // the body or the code after the loop reads it
+};
+
+int find_loops(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, uint32_t *live, range_info_t *range_info, int loop_max, loop_t *loops, int max);
+
+#endif
+
@@ -0,0 +1,124 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "profile.h"
+
+static int compare_entries(const void *a, const void *b)
+{
+const profile_entry_t *ea = (const profile_entry_t *)a;
+const profile_entry_t *eb = (const profile_entry_t *)b;
+int cmp = strcmp(ea->method, eb->method);
+
+  if (cmp != 0) { return cmp; }
+  if (ea->address == eb->address) { return 0; }
+
+  return ea->address < eb->address ? -1 : 1;
+}
+
+Profile::Profile() : entries(NULL), entry_count(0), entry_max(0)
+{
+}
+
+Profile::~Profile()
+{
+  free(entries);
+}
+
+int Profile::load(const char *filename)
+{
+FILE *in;
+char line[256];
+char method[64];
+int address;
+unsigned int count;
+int line_num = 0;
+
+  in = fopen(filename, "rb");
+
+  if (in == NULL)
+  {
+    printf("Couldn't open profile %s\n", filename);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), in) != NULL)
+  {
+    line_num++;
+
+    char *s = line;
+    while(*s == ' ' || *s == '\t') { s++; }
+    if (*s == '#' || *s == '\n' || *s == '\r' || *s == 0) { continue; }
+
+    if (sscanf(s, "%63s %d %u", method, &address, &count) != 3)
+    {
+      printf("Error: %s:%d bad profile entry\n", filename, line_num);
+      fclose(in);
+      return -1;
+    }
+
+    if (entry_count == entry_max)
+    {
+      entry_max = entry_max == 0 ? 256 : entry_max * 2;
+      entries = (profile_entry_t *)realloc(entries, entry_max * sizeof(profile_entry_t));
+      if (entries == NULL) { fclose(in); return -1; }
+    }
+
+    strcpy(entries[entry_count].method, method);
+    entries[entry_count].address = address;
+    entries[entry_count].count = count;
+    entry_count++;
+  }
+
+  fclose(in);
+
+  qsort(entries, entry_count, sizeof(profile_entry_t), compare_entries);
+
+  printf("Loaded %d profile entries from %s\n", entry_count, filename);
+
+  return 0;
+}
+
+// Lookups are a binary search on method then address
+bool Profile::has_method(const char *method)
+{
+int first = 0, last = entry_count - 1, middle, cmp;
+
+  while (first <= last)
+  {
+    middle = (first + last) / 2;
+    cmp = strcmp(entries[middle].method, method);
+
+    if (cmp == 0) { return true; }
+    if (cmp < 0) { first = middle + 1; }
+    else { last = middle - 1; }
+  }
+
+  return false;
+}
+
+uint32_t Profile::get_count(const char *method, int address)
+{
+profile_entry_t key;
+profile_entry_t *entry;
+
+  strncpy(key.method, method, sizeof(key.method) - 1);
+  key.method[sizeof(key.method) - 1] = 0;
+  key.address = address;
+
+  entry = (profile_entry_t *)bsearch(&key, entries, entry_count, sizeof(profile_entry_t), compare_entries);
+
+  return entry == NULL ? 0 : entry->count;
+}
@@ -0,0 +1,51 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdint.h>
+
+// Execution counts per bytecode offset from an instrumented build or a
+// simulator run.  The file is text, one entry per line:
+//
+//   <method> <offset> <count>
+//
+// where method is the name used in the .asm file (add_nums_II) and
+// offset is the bytecode address in the method.  # starts a comment.
+// simulate -profile writes one from a build made with --instrument.
+// The entries are sorted after loading so lookups are a binary search.
+
+struct profile_entry_t
+{
+  char method[64];
+  int address;
+  uint32_t count;
+};
+
+class Profile
+{
+public:
+  Profile();
+  ~Profile();
+
+  int load(const char *filename);
+  bool has_method(const char *method);
+  uint32_t get_count(const char *method, int address);
+
+private:
+  profile_entry_t *entries;
+  int entry_count;
+  int entry_max;
+};
+
+#endif
+
@@ -0,0 +1,1223 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "JavaClass.h"
+#include "Generator.h"
+#include "compile.h"
+#include "flow.h"
+#include "invoke.h"
+#include "range.h"
+
+// How many times a value can grow at a join before it's widened to the
+// next threshold (keeps loops from iterating 65536 times).
+#define WIDEN_AFTER 3
+#define MAX_PASSES 100
+
+struct state_t
+{
+  int valid;
+  int depth;
+  int visits;
+  range_t *locals;
+  range_t *stack;
+  int *origin;         // local a stack value was loaded from (or -1)
+};
+
+static const range_t range_full = { INT32_MIN, INT32_MAX };
+
+// ifeq..ifle and if_icmpeq..if_icmple in bytecode order
+static const int branch_cond[] =
+{
+  COND_EQUAL,
+  COND_NOT_EQUAL,
+  COND_LESS,
+  COND_GREATER_EQUAL,
+  COND_GREATER,
+  COND_LESS_EQUAL,
+};
+
+static range_t make_range(int64_t min, int64_t max)
+{
+range_t range;
+
+  if (min < INT32_MIN || max > INT32_MAX) { return range_full; }
+
+  range.min = (int32_t)min;
+  range.max = (int32_t)max;
+
+  return range;
+}
+
+static range_t make_const(int32_t value)
+{
+  return make_range(value, value);
+}
+
+// Widening jumps to these instead of straight to the full int range so a
+// loop counter that overflows past INT32_MAX doesn't lose its lower bound.
+static const int32_t thresholds[] =
+{
+  INT32_MIN, -32768, -128, -1, 0, 127, 255, 32767, 65535, INT32_MAX
+};
+
+static int32_t widen_min(int32_t value)
+{
+int n;
+
+  for (n = sizeof(thresholds) / sizeof(int32_t) - 1; n > 0; n--)
+  {
+    if (thresholds[n] <= value) { break; }
+  }
+
+  return thresholds[n];
+}
+
+static int32_t widen_max(int32_t value)
+{
+int n;
+
+  for (n = 0; n < (int)(sizeof(thresholds) / sizeof(int32_t)) - 1; n++)
+  {
+    if (thresholds[n] >= value) { break; }
+  }
+
+  return thresholds[n];
+}
+
+static int64_t max4(int64_t a, int64_t b, int64_t c, int64_t d)
+{
+  if (b > a) { a = b; }
+  if (c > a) { a = c; }
+  if (d > a) { a = d; }
+  return a;
+}
+
+static int64_t min4(int64_t a, int64_t b, int64_t c, int64_t d)
+{
+  if (b < a) { a = b; }
+  if (c < a) { a = c; }
+  if (d < a) { a = d; }
+  return a;
+}
+
+// What a value of a Java type can be once it's in a register.  On a CPU
+// with 16 bit ints anything coming in from outside the method (a
+// parameter, what a call returns, a static field) only has 16 bits so
+// if it didn't fit it was cut down where it was computed.
+static range_t get_type_range(char type, int int_size)
+{
+  switch(type)
+  {
+    case 'Z': return make_range(0, 1);
+    case 'B': return make_range(-128, 127);
+    case 'C': return make_range(0, 65535);
+    case 'S': return make_range(-32768, 32767);
+    case 'I':
+      if (int_size < 32)
+      {
+        return make_range(-((int64_t)1 << (int_size - 1)), ((int64_t)1 << (int_size - 1)) - 1);
+      }
+      break;
+  }
+
+  return range_full;
+}
+
+static int64_t abs64(int64_t a)
+{
+  return a < 0 ? -a : a;
+}
+
+bool range_fits_int16(range_t *range)
+{
+  return range->min >= -32768 && range->max <= 32767;
+}
+
+bool range_fits_uint16(range_t *range)
+{
+  return range->min >= 0 && range->max <= 65535;
+}
+
+// Something that's neither -32768 to 32767 nor 0 to 65535 can't be held
+// in 16 bits.
+static bool needs_32(range_t *range)
+{
+  return !range_fits_int16(range) && !range_fits_uint16(range);
+}
+
+// The opcode at address with a wide prefix skipped
+static int get_opcode(uint8_t *bytes, int pc_start, int address)
+{
+int pc = pc_start + address;
+
+  if (bytes[pc] == 0xc4) { return bytes[pc+1]; }
+
+  return bytes[pc];
+}
+
+// The local an iload, istore or iinc at address uses or -1
+int get_local_index(uint8_t *bytes, int pc_start, int address)
+{
+int pc = pc_start + address;
+int opcode = bytes[pc];
+
+  if (opcode == 0xc4)
+  {
+    pc++;
+    opcode = bytes[pc];
+    if (opcode == 0x15 || opcode == 0x36 || opcode == 0x84) { return GET_PC_UINT16(1); }
+    return -1;
+  }
+
+  if (opcode == 0x15 || opcode == 0x36 || opcode == 0x84) { return bytes[pc+1]; }
+  if (opcode >= 0x1a && opcode <= 0x1d) { return opcode - 0x1a; }
+  if (opcode >= 0x3b && opcode <= 0x3e) { return opcode - 0x3b; }
+
+  return -1;
+}
+
+static void copy_state(state_t *dst, state_t *src, int max_locals, int max_stack)
+{
+  dst->valid = src->valid;
+  dst->depth = src->depth;
+  memcpy(dst->locals, src->locals, max_locals * sizeof(range_t));
+  memcpy(dst->stack, src->stack, max_stack * sizeof(range_t));
+  memcpy(dst->origin, src->origin, max_stack * sizeof(int));
+}
+
+static bool same_state(state_t *a, state_t *b, int max_locals)
+{
+  if (a->valid != b->valid) { return false; }
+  if (a->valid == 0) { return true; }
+  if (a->depth != b->depth) { return false; }
+
+  return memcmp(a->locals, b->locals, max_locals * sizeof(range_t)) == 0 &&
+         memcmp(a->stack, b->stack, a->depth * sizeof(range_t)) == 0;
+}
+
+// Returns 1 if dst changed, 0 if not, -1 if the states can't be joined.
+static int join_state(state_t *dst, state_t *src, int max_locals, bool widen)
+{
+int changed = 0;
+int n;
+
+  if (dst->valid == 0)
+  {
+    copy_state(dst, src, max_locals, src->depth);
+    dst->valid = 1;
+    return 1;
+  }
+
+  if (dst->depth != src->depth) { return -1; }
+
+  for (n = 0; n < max_locals + dst->depth; n++)
+  {
+    range_t *a = n < max_locals ? &dst->locals[n] : &dst->stack[n - max_locals];
+    range_t *b = n < max_locals ? &src->locals[n] : &src->stack[n - max_locals];
+
+    if (b->min < a->min) { a->min = widen ? widen_min(b->min) : b->min; changed = 1; }
+    if (b->max > a->max) { a->max = widen ? widen_max(b->max) : b->max; changed = 1; }
+  }
+
+  for (n = 0; n < dst->depth; n++)
+  {
+    if (dst->origin[n] != src->origin[n] && dst->origin[n] != -1)
+    {
+      dst->origin[n] = -1;
+      changed = 1;
+    }
+  }
+
+  return changed;
+}
+
+static int push(state_t *state, range_t range, int origin, int max_stack)
+{
+  if (state->depth >= max_stack) { return -1; }
+  state->stack[state->depth] = range;
+  state->origin[state->depth] = origin;
+  state->depth++;
+  return 0;
+}
+
+static range_t pop(state_t *state)
+{
+  if (state->depth == 0) { return range_full; }
+  state->depth--;
+  return state->stack[state->depth];
+}
+
+static void store_local(state_t *state, int index, range_t range)
+{
+int n;
+
+  state->locals[index] = range;
+
+  // Anything loaded from this local earlier isn't its value anymore.
+  for (n = 0; n < state->depth; n++)
+  {
+    if (state->origin[n] == index) { state->origin[n] = -1; }
+  }
+}
+
+static range_t alu(int opcode, range_t a, range_t b)
+{
+int64_t m;
+
+  switch(opcode)
+  {
+    case 0x60: // iadd
+      return make_range((int64_t)a.min + b.min, (int64_t)a.max + b.max);
+    case 0x64: // isub
+      return make_range((int64_t)a.min - b.max, (int64_t)a.max - b.min);
+    case 0x68: // imul
+      return make_range(
+        min4((int64_t)a.min * b.min, (int64_t)a.min * b.max,
+             (int64_t)a.max * b.min, (int64_t)a.max * b.max),
+        max4((int64_t)a.min * b.min, (int64_t)a.min * b.max,
+             (int64_t)a.max * b.min, (int64_t)a.max * b.max));
+    case 0x6c: // idiv
+      if (b.min > 0 || b.max < 0)
+      {
+        return make_range(
+          min4((int64_t)a.min / b.min, (int64_t)a.min / b.max,
+               (int64_t)a.max / b.min, (int64_t)a.max / b.max),
+          max4((int64_t)a.min / b.min, (int64_t)a.min / b.max,
+               (int64_t)a.max / b.min, (int64_t)a.max / b.max));
+      }
+      m = abs64(a.min) > abs64(a.max) ? abs64(a.min) : abs64(a.max);
+      return make_range(-m, m);
+    case 0x70: // irem
+      m = abs64(b.min) > abs64(b.max) ? abs64(b.min) : abs64(b.max);
+      if (m == 0) { return range_full; }
+      m = m - 1;
+      if (a.min >= 0) { return make_range(0, a.max < m ? a.max : m); }
+      if (a.max <= 0) { return make_range(a.min > -m ? a.min : -m, 0); }
+      return make_range(-m, m);
+    case 0x78: // ishl
+      if (b.min != b.max) { return range_full; }
+      m = (int64_t)1 << (b.min & 31);
+      return make_range((int64_t)a.min * m, (int64_t)a.max * m);
+    case 0x7a: // ishr
+      if (b.min != b.max)
+      {
+        return make_range(a.min < 0 ? a.min : 0, a.max > 0 ? a.max : 0);
+      }
+      return make_range(a.min >> (b.min & 31), a.max >> (b.min & 31));
+    case 0x7c: // iushr
+      if (b.min != b.max) { return range_full; }
+      if (a.min >= 0)
+      {
+        return make_range(a.min >> (b.min & 31), a.max >> (b.min & 31));
+      }
+      if ((b.min & 31) == 0) { return a; }
+      return make_range(0, 0xffffffffu >> (b.min & 31));
+    case 0x7e: // iand
+      if (a.min >= 0 && b.min >= 0)
+      {
+        return make_range(0, a.max < b.max ? a.max : b.max);
+      }
+      if (a.min >= 0) { return make_range(0, a.max); }
+      if (b.min >= 0) { return make_range(0, b.max); }
+      return range_full;
+    case 0x80: // ior
+    case 0x82: // ixor
+      if (a.min >= 0 && b.min >= 0)
+      {
+        m = 1;
+        while(m <= a.max || m <= b.max) { m = m << 1; }
+        return make_range(0, m - 1);
+      }
+      return range_full;
+    default:
+      return range_full;
+  }
+}
+
+// Narrow a and b knowing that (a cond b) is true.  Returns false if that
+// can't happen.
+static bool refine(range_t *a, range_t *b, int cond)
+{
+  switch(cond)
+  {
+    case COND_EQUAL:
+      if (b->min > a->min) { a->min = b->min; }
+      if (b->max < a->max) { a->max = b->max; }
+      *b = *a;
+      break;
+    case COND_NOT_EQUAL:
+      if (b->min == b->max)
+      {
+        if (a->min == b->min && a->min != INT32_MAX) { a->min++; }
+        else if (a->max == b->min && a->max != INT32_MIN) { a->max--; }
+      }
+      if (a->min == a->max)
+      {
+        if (b->min == a->min && b->min != INT32_MAX) { b->min++; }
+        else if (b->max == a->min && b->max != INT32_MIN) { b->max--; }
+      }
+      break;
+    case COND_LESS:
+      if (b->max == INT32_MIN || a->min == INT32_MAX) { return false; }
+      if (a->max > b->max - 1) { a->max = b->max - 1; }
+      if (b->min < a->min + 1) { b->min = a->min + 1; }
+      break;
+    case COND_LESS_EQUAL:
+      if (a->max > b->max) { a->max = b->max; }
+      if (b->min < a->min) { b->min = a->min; }
+      break;
+    case COND_GREATER:
+      return refine(b, a, COND_LESS);
+    case COND_GREATER_EQUAL:
+      return refine(b, a, COND_LESS_EQUAL);
+  }
+
+  return a->min <= a->max && b->min <= b->max;
+}
+
+static int negate_cond(int cond)
+{
+  switch(cond)
+  {
+    case COND_EQUAL: return COND_NOT_EQUAL;
+    case COND_NOT_EQUAL: return COND_EQUAL;
+    case COND_LESS: return COND_GREATER_EQUAL;
+    case COND_LESS_EQUAL: return COND_GREATER;
+    case COND_GREATER: return COND_LESS_EQUAL;
+    case COND_GREATER_EQUAL: return COND_LESS;
+  }
+
+  return cond;
+}
+
+static int get_call_signature(JavaClass *java_class, int ref, int *params, int *is_void, char *type)
+{
+char name[128];
+char sig[128];
+char *s;
+
+  if (java_class->get_ref_name_type(name, sig, sizeof(name), ref) != 0)
+  {
+    return -1;
+  }
+
+  get_signature(sig, params, is_void);
+
+  s = strchr(sig, ')');
+  *type = s == NULL ? 0 : s[1];
+
+  return 0;
+}
+
+static char get_field_type(JavaClass *java_class, int ref)
+{
+char name[128];
+char type[128];
+
+  if (java_class->get_ref_name_type(name, type, sizeof(name), ref) != 0)
+  {
+    return 0;
+  }
+
+  return type[0];
+}
+
+// Run one instruction over state (in place).  Returns -1 if the
+// instruction isn't something the analysis understands.
+static int transfer(JavaClass *java_class, int int_size, uint8_t *bytes, int pc_start, int address, state_t *state, int max_locals, int max_stack)
+{
+int pc = pc_start + address;
+int opcode = bytes[pc];
+int wide = 0;
+int index,params,is_void;
+char type;
+range_t a,b;
+
+  if (opcode == 0xc4) { wide = 1; pc++; opcode = bytes[pc]; }
+
+  switch(opcode)
+  {
+    case 0x00: // nop
+      return 0;
+    case 0x02: // iconst_m1
+    case 0x03: // iconst_0
+    case 0x04: // iconst_1
+    case 0x05: // iconst_2
+    case 0x06: // iconst_3
+    case 0x07: // iconst_4
+    case 0x08: // iconst_5
+      return push(state, make_const(opcode - 3), -1, max_stack);
+    case 0x10: // bipush
+      return push(state, make_const((int8_t)bytes[pc+1]), -1, max_stack);
+    case 0x11: // sipush
+      return push(state, make_const(GET_PC_INT16(1)), -1, max_stack);
+    case 0x12: // ldc
+    case 0x13: // ldc_w
+    {
+      index = opcode == 0x12 ? bytes[pc+1] : GET_PC_UINT16(1);
+      generic_32bit_t *gen32 = (generic_32bit_t *)java_class->get_constant(index);
+      if (gen32->tag != CONSTANT_INTEGER) { return -1; }
+      return push(state, make_const(gen32->value), -1, max_stack);
+    }
+    case 0x15: // iload
+      index = wide ? GET_PC_UINT16(1) : bytes[pc+1];
+      if (index >= max_locals) { return -1; }
+      return push(state, state->locals[index], index, max_stack);
+    case 0x1a: // iload_0
+    case 0x1b: // iload_1
+    case 0x1c: // iload_2
+    case 0x1d: // iload_3
+      index = opcode - 0x1a;
+      if (index >= max_locals) { return -1; }
+      return push(state, state->locals[index], index, max_stack);
+    case 0x36: // istore
+      index = wide ? GET_PC_UINT16(1) : bytes[pc+1];
+      if (index >= max_locals || state->depth < 1) { return -1; }
+      store_local(state, index, pop(state));
+      return 0;
+    case 0x3b: // istore_0
+    case 0x3c: // istore_1
+    case 0x3d: // istore_2
+    case 0x3e: // istore_3
+      index = opcode - 0x3b;
+      if (index >= max_locals || state->depth < 1) { return -1; }
+      store_local(state, index, pop(state));
+      return 0;
+    case 0x57: // pop
+      if (state->depth < 1) { return -1; }
+      pop(state);
+      return 0;
+    case 0x58: // pop2
+      if (state->depth < 2) { return -1; }
+      pop(state);
+      pop(state);
+      return 0;
+    case 0x59: // dup
+      if (state->depth < 1) { return -1; }
+      return push(state, state->stack[state->depth-1], state->origin[state->depth-1], max_stack);
+    case 0x5f: // swap
+    {
+      if (state->depth < 2) { return -1; }
+      int origin = state->origin[state->depth-1];
+      a = state->stack[state->depth-1];
+      state->stack[state->depth-1] = state->stack[state->depth-2];
+      state->origin[state->depth-1] = state->origin[state->depth-2];
+      state->stack[state->depth-2] = a;
+      state->origin[state->depth-2] = origin;
+      return 0;
+    }
+    case 0x60: // iadd
+    case 0x64: // isub
+    case 0x68: // imul
+    case 0x6c: // idiv
+    case 0x70: // irem
+    case 0x78: // ishl
+    case 0x7a: // ishr
+    case 0x7c: // iushr
+    case 0x7e: // iand
+    case 0x80: // ior
+    case 0x82: // ixor
+      if (state->depth < 2) { return -1; }
+      b = pop(state);
+      a = pop(state);
+      return push(state, alu(opcode, a, b), -1, max_stack);
+    case 0x74: // ineg
+      if (state->depth < 1) { return -1; }
+      a = pop(state);
+      return push(state, make_range(-(int64_t)a.max, -(int64_t)a.min), -1, max_stack);
+    case 0x84: // iinc
+    {
+      index = wide ? GET_PC_UINT16(1) : bytes[pc+1];
+      int inc = wide ? GET_PC_INT16(3) : (int8_t)bytes[pc+2];
+      if (index >= max_locals) { return -1; }
+      a = state->locals[index];
+      store_local(state, index, make_range((int64_t)a.min + inc, (int64_t)a.max + inc));
+      return 0;
+    }
+    case 0x91: // i2b
+      if (state->depth < 1) { return -1; }
+      a = pop(state);
+      if (a.min < -128 || a.max > 127) { a = make_range(-128, 127); }
+      return push(state, a, -1, max_stack);
+    case 0x92: // i2c
+      if (state->depth < 1) { return -1; }
+      a = pop(state);
+      if (a.min < 0 || a.max > 65535) { a = make_range(0, 65535); }
+      return push(state, a, -1, max_stack);
+    case 0x93: // i2s
+      if (state->depth < 1) { return -1; }
+      a = pop(state);
+      if (!range_fits_int16(&a)) { a = make_range(-32768, 32767); }
+      return push(state, a, -1, max_stack);
+    case 0x99: // ifeq
+    case 0x9a: // ifne
+    case 0x9b: // iflt
+    case 0x9c: // ifge
+    case 0x9d: // ifgt
+    case 0x9e: // ifle
+    case 0xac: // ireturn
+      if (state->depth < 1) { return -1; }
+      pop(state);
+      return 0;
+    case 0x9f: // if_icmpeq
+    case 0xa0: // if_icmpne
+    case 0xa1: // if_icmplt
+    case 0xa2: // if_icmpge
+    case 0xa3: // if_icmpgt
+    case 0xa4: // if_icmple
+      if (state->depth < 2) { return -1; }
+      pop(state);
+      pop(state);
+      return 0;
+    case 0xa7: // goto
+    case 0xb1: // return
+    case 0xc8: // goto_w
+      return 0;
+    case 0xb2: // getstatic
+      type = get_field_type(java_class, GET_PC_UINT16(1));
+      return push(state, get_type_range(type, int_size), -1, max_stack);
+    case 0xb6: // invokevirtual
+    case 0xb8: // invokestatic
+      if (get_call_signature(java_class, GET_PC_UINT16(1), &params, &is_void, &type) != 0)
+      {
+        return -1;
+      }
+      if (opcode == 0xb6) { params++; }
+      if (state->depth < params) { return -1; }
+      state->depth -= params;
+      if (!is_void) { return push(state, get_type_range(type, int_size), -1, max_stack); }
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// Refine the state going down one edge of a conditional branch.  Returns
+// false if the edge can't be taken.
+static bool refine_edge(uint8_t *bytes, int pc_start, int address, state_t *before, state_t *after, bool taken)
+{
+int opcode = bytes[pc_start + address];
+int cond;
+range_t a,b;
+int origin_a,origin_b;
+
+  if (opcode >= 0x99 && opcode <= 0x9e)
+  {
+    a = before->stack[before->depth-1];
+    origin_a = before->origin[before->depth-1];
+    b = make_const(0);
+    origin_b = -1;
+    cond = opcode - 0x99;
+  }
+    else
+  if (opcode >= 0x9f && opcode <= 0xa4)
+  {
+    a = before->stack[before->depth-2];
+    origin_a = before->origin[before->depth-2];
+    b = before->stack[before->depth-1];
+    origin_b = before->origin[before->depth-1];
+    cond = opcode - 0x9f;
+  }
+    else
+  {
+    return true;
+  }
+
+  cond = branch_cond[cond];
+
+  if (!taken) { cond = negate_cond(cond); }
+
+  if (!refine(&a, &b, cond)) { return false; }
+
+  if (origin_a != -1) { after->locals[origin_a] = a; }
+  if (origin_b != -1) { after->locals[origin_b] = b; }
+
+  return true;
+}
+
+static int alloc_states(state_t *states, int count, int max_locals, int max_stack)
+{
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    states[n].valid = 0;
+    states[n].depth = 0;
+    states[n].visits = 0;
+    states[n].locals = (range_t *)malloc((max_locals + 1) * sizeof(range_t));
+    states[n].stack = (range_t *)malloc((max_stack + 1) * sizeof(range_t));
+    states[n].origin = (int *)malloc((max_stack + 1) * sizeof(int));
+    if (states[n].locals == NULL || states[n].stack == NULL || states[n].origin == NULL)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static void free_states(state_t *states, int count)
+{
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    free(states[n].locals);
+    free(states[n].stack);
+    free(states[n].origin);
+  }
+}
+
+// Push the state after the instruction at address into each successor.
+// Returns 1 if anything changed, 0 if not, -1 on error.
+static int propagate(JavaClass *java_class, int int_size, uint8_t *bytes, int pc_start, int code_len, int address, state_t *in, state_t *next, state_t *temp, int max_locals, int max_stack, bool widen)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int count,n,changed = 0;
+
+  count = get_successors(bytes, pc_start, code_len, address, successors);
+  if (count < 0) { return -1; }
+
+  for (n = 0; n < count; n++)
+  {
+    copy_state(&temp[0], &in[address], max_locals, max_stack);
+    if (transfer(java_class, int_size, bytes, pc_start, address, &temp[0], max_locals, max_stack) != 0)
+    {
+      return -1;
+    }
+
+    // Conditional branches: successor 0 is fall through, 1 is taken
+    if (count == 2 &&
+        !refine_edge(bytes, pc_start, address, &in[address], &temp[0], n == 1))
+    {
+      continue;
+    }
+
+    // Only loop heads (targets of a backward branch) get widened
+    state_t *dst = &next[successors[n]];
+    bool back_edge = successors[n] <= address;
+    int ret = join_state(dst, &temp[0], max_locals, widen && back_edge && dst->visits > WIDEN_AFTER);
+    if (ret < 0) { return -1; }
+    if (ret > 0) { dst->visits++; changed = 1; }
+  }
+
+  return changed;
+}
+
+int compute_ranges(JavaClass *java_class, char *method_sig, int int_size, uint8_t *bytes, int pc_start, int code_len, int max_locals, int max_stack, range_info_t *info)
+{
+state_t *states;
+state_t *next;
+state_t temp[1];
+int address,pass,n,len;
+int changed;
+int ret = -1;
+
+  memset(info, 0, code_len * sizeof(range_info_t));
+
+  states = (state_t *)malloc(code_len * sizeof(state_t));
+  next = (state_t *)malloc(code_len * sizeof(state_t));
+  if (states == NULL || next == NULL) { free(states); free(next); return -1; }
+
+  if (alloc_states(states, code_len, max_locals, max_stack) != 0 ||
+      alloc_states(next, code_len, max_locals, max_stack) != 0 ||
+      alloc_states(temp, 1, max_locals, max_stack) != 0)
+  {
+    goto exit;
+  }
+
+  // Parameters can be anything their type holds.  The rest of the locals
+  // are written before they're read.
+  states[0].valid = 1;
+  for (n = 0; n < max_locals; n++) { states[0].locals[n] = get_type_range('I', int_size); }
+
+  if (method_sig != NULL && method_sig[0] == '(')
+  {
+    for (n = 0; n < max_locals && method_sig[n + 1] != ')' && method_sig[n + 1] != 0; n++)
+    {
+      states[0].locals[n] = get_type_range(method_sig[n + 1], int_size);
+    }
+  }
+
+  // Find a fixed point, widening anything that keeps growing.
+  for (pass = 0; pass < MAX_PASSES; pass++)
+  {
+    changed = 0;
+
+    for (address = 0; address < code_len; address += len)
+    {
+      len = get_instr_len(bytes, pc_start, address);
+      if (len <= 0) { goto exit; }
+      if (states[address].valid == 0) { continue; }
+
+      int r = propagate(java_class, int_size, bytes, pc_start, code_len, address, states, states, temp, max_locals, max_stack, true);
+      if (r < 0) { goto exit; }
+      changed |= r;
+    }
+
+    if (!changed) { break; }
+  }
+
+  if (pass == MAX_PASSES) { goto exit; }
+
+  // Widening throws away the loop bounds, so recompute every state from
+  // its predecessors until they stop shrinking to get them back.  Every
+  // pass is still a safe answer so it's fine to give up early.
+  for (pass = 0; pass < MAX_PASSES; pass++)
+  {
+    for (address = 0; address < code_len; address++) { next[address].valid = 0; }
+    copy_state(&next[0], &states[0], max_locals, max_stack);
+
+    for (address = 0; address < code_len; address += len)
+    {
+      len = get_instr_len(bytes, pc_start, address);
+      if (states[address].valid == 0) { continue; }
+
+      if (propagate(java_class, int_size, bytes, pc_start, code_len, address, states, next, temp, max_locals, max_stack, false) < 0)
+      {
+        goto exit;
+      }
+    }
+
+    changed = 0;
+
+    for (address = 0; address < code_len; address++)
+    {
+      if (!same_state(&states[address], &next[address], max_locals))
+      {
+        changed = 1;
+        break;
+      }
+    }
+
+    state_t *swap = states;
+    states = next;
+    next = swap;
+
+    if (!changed) { break; }
+  }
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    state_t *state = &states[address];
+    if (state->valid == 0) { continue; }
+
+    info[address].reachable = 1;
+    info[address].depth = state->depth;
+    info[address].operand[0] = state->depth > 0 ? state->stack[state->depth-1] : range_full;
+    info[address].operand[1] = state->depth > 1 ? state->stack[state->depth-2] : range_full;
+
+    copy_state(&temp[0], state, max_locals, max_stack);
+    transfer(java_class, int_size, bytes, pc_start, address, &temp[0], max_locals, max_stack);
+    info[address].result = temp[0].depth > 0 ? temp[0].stack[temp[0].depth-1] : range_full;
+
+    // iinc doesn't push anything so its result is the local it changed
+    n = get_local_index(bytes, pc_start, address);
+    if (n != -1 && get_opcode(bytes, pc_start, address) == 0x84)
+    {
+      info[address].result = temp[0].locals[n];
+    }
+  }
+
+  ret = 0;
+
+exit:
+  free_states(states, code_len);
+  free_states(next, code_len);
+  free_states(temp, 1);
+  free(states);
+  free(next);
+
+  return ret;
+}
+
+
+// How many values the instruction at address pops and pushes.  Only
+// knows what transfer() knows.
+static int get_stack_effect(JavaClass *java_class, uint8_t *bytes, int pc_start, int address, int *pops, int *pushes)
+{
+int pc = pc_start + address;
+int params,is_void;
+char type;
+
+  *pops = 0;
+  *pushes = 0;
+
+  switch(get_opcode(bytes, pc_start, address))
+  {
+    case 0x00: // nop
+    case 0x84: // iinc
+    case 0xa7: // goto
+    case 0xb1: // return
+    case 0xc8: // goto_w
+      return 0;
+    case 0x02: // iconst_m1
+    case 0x03: // iconst_0
+    case 0x04: // iconst_1
+    case 0x05: // iconst_2
+    case 0x06: // iconst_3
+    case 0x07: // iconst_4
+    case 0x08: // iconst_5
+    case 0x10: // bipush
+    case 0x11: // sipush
+    case 0x12: // ldc
+    case 0x13: // ldc_w
+    case 0x15: // iload
+    case 0x1a: // iload_0
+    case 0x1b: // iload_1
+    case 0x1c: // iload_2
+    case 0x1d: // iload_3
+    case 0xb2: // getstatic
+      *pushes = 1;
+      return 0;
+    case 0x36: // istore
+    case 0x3b: // istore_0
+    case 0x3c: // istore_1
+    case 0x3d: // istore_2
+    case 0x3e: // istore_3
+    case 0x57: // pop
+    case 0x99: // ifeq
+    case 0x9a: // ifne
+    case 0x9b: // iflt
+    case 0x9c: // ifge
+    case 0x9d: // ifgt
+    case 0x9e: // ifle
+    case 0xac: // ireturn
+      *pops = 1;
+      return 0;
+    case 0x58: // pop2
+    case 0x9f: // if_icmpeq
+    case 0xa0: // if_icmpne
+    case 0xa1: // if_icmplt
+    case 0xa2: // if_icmpge
+    case 0xa3: // if_icmpgt
+    case 0xa4: // if_icmple
+      *pops = 2;
+      return 0;
+    case 0x59: // dup
+      *pops = 1;
+      *pushes = 2;
+      return 0;
+    case 0x5f: // swap
+      *pops = 2;
+      *pushes = 2;
+      return 0;
+    case 0x60: // iadd
+    case 0x64: // isub
+    case 0x68: // imul
+    case 0x6c: // idiv
+    case 0x70: // irem
+    case 0x78: // ishl
+    case 0x7a: // ishr
+    case 0x7c: // iushr
+    case 0x7e: // iand
+    case 0x80: // ior
+    case 0x82: // ixor
+      *pops = 2;
+      *pushes = 1;
+      return 0;
+    case 0x74: // ineg
+    case 0x91: // i2b
+    case 0x92: // i2c
+    case 0x93: // i2s
+      *pops = 1;
+      *pushes = 1;
+      return 0;
+    case 0xb6: // invokevirtual
+    case 0xb8: // invokestatic
+      if (get_call_signature(java_class, GET_PC_UINT16(1), &params, &is_void, &type) != 0)
+      {
+        return -1;
+      }
+      *pops = bytes[pc] == 0xb6 ? params + 1 : params;
+      *pushes = is_void ? 0 : 1;
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// Picks the values a CPU with 16 bit ints has to keep in 2 words.  Only
+// the upper bits of a value that doesn't fit are missing in 16 bits, so
+// it only needs them where they change the answer: a compare, a store to
+// a local whose upper bits a compare needs later and an iadd / isub whose
+// result goes to one of those.  Anything else gets the low 16 bits as
+// before.
+// Values are only followed inside a block (a value left on the stack at a
+// label stays 16 bits) and not through dup or swap.  Sets op_32 and
+// result_32 in info and locals_32[n] for every local that holds 2 words.
+// stack_32 is how many more words the stack can need.  Returns how many
+// locals and instructions use 32 bits or -1 on error.
+int find_int32_values(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, int max_locals, int max_stack, range_info_t *info, uint8_t *locals_32, int *stack_32)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int *producer;       // instruction that pushed each stack slot or -1
+int *consumer;       // instruction that pops what each instruction pushed
+int *operands;       // producers of each instruction's top 2 operands
+int *order;
+uint8_t *starts;
+uint8_t *wide;       // locals that can get something that doesn't fit
+int address,len,count,depth,pops,pushes;
+int index,opcode,extra,p;
+int total = 0;
+int ret = -1;
+int n,i;
+bool fits,fallthrough,changed;
+
+  memset(locals_32, 0, max_locals);
+  *stack_32 = 0;
+
+  producer = (int *)malloc((max_stack + 1) * sizeof(int));
+  consumer = (int *)malloc(code_len * sizeof(int));
+  operands = (int *)malloc(code_len * 2 * sizeof(int));
+  order = (int *)malloc(code_len * sizeof(int));
+  starts = (uint8_t *)calloc(code_len + 1, 1);
+  wide = (uint8_t *)calloc(max_locals + 1, 1);
+
+  if (producer == NULL || consumer == NULL || operands == NULL ||
+      order == NULL || starts == NULL || wide == NULL)
+  {
+    goto exit;
+  }
+
+  // Anything a branch goes to or that can't be fallen into starts a block
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (len <= 0) { goto exit; }
+
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+    if (count < 0) { goto exit; }
+
+    fallthrough = false;
+
+    for (n = 0; n < count; n++)
+    {
+      if (successors[n] == address + len) { fallthrough = true; }
+      else { starts[successors[n]] = 1; }
+    }
+
+    if (!fallthrough) { starts[address + len] = 1; }
+  }
+
+  // Locals that get something that doesn't fit
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    if (info[address].reachable == 0) { continue; }
+
+    index = get_local_index(bytes, pc_start, address);
+    if (index == -1 || index >= max_locals) { continue; }
+
+    opcode = get_opcode(bytes, pc_start, address);
+
+    if ((opcode == 0x84 && needs_32(&info[address].result)) ||
+        ((opcode == 0x36 || (opcode >= 0x3b && opcode <= 0x3e)) &&
+         needs_32(&info[address].operand[0])))
+    {
+      wide[index] = 1;
+    }
+  }
+
+  // Find which instruction uses each value
+  depth = 0;
+  count = 0;
+
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    consumer[address] = -1;
+    operands[address * 2] = -1;
+    operands[address * 2 + 1] = -1;
+
+    if (info[address].reachable == 0) { continue; }
+
+    order[count++] = address;
+
+    if (starts[address] || depth != info[address].depth)
+    {
+      depth = info[address].depth;
+      for (n = 0; n < depth; n++) { producer[n] = -1; }
+    }
+
+    if (get_stack_effect(java_class, bytes, pc_start, address, &pops, &pushes) != 0 ||
+        pops > depth || depth - pops + pushes > max_stack)
+    {
+      goto exit;
+    }
+
+    for (n = 0; n < pops; n++)
+    {
+      p = producer[depth - 1 - n];
+      if (n < 2) { operands[address * 2 + n] = p; }
+      if (p != -1) { consumer[p] = address; }
+    }
+
+    depth -= pops;
+
+    for (n = 0; n < pushes; n++)
+    {
+      producer[depth++] = pushes == 1 ? address : -1;
+    }
+  }
+
+  // Whoever uses a value comes after it so going backwards every iadd
+  // already knows if its result needs the upper bits.  A local only needs
+  // its high word if it can get one and a load of it needs the upper
+  // bits, which can make more stores and iadds 32 bit so this goes until
+  // nothing changes.
+  do
+  {
+    total = 0;
+
+    for (i = 0; i < count; i++)
+    {
+      info[order[i]].op_32 = 0;
+      info[order[i]].result_32 = 0;
+    }
+
+    for (i = count - 1; i >= 0; i--)
+    {
+      address = order[i];
+      range_t *a = &info[address].operand[1];
+      range_t *b = &info[address].operand[0];
+      bool known_a = operands[address * 2 + 1] != -1;
+      bool known_b = operands[address * 2] != -1;
+
+      opcode = get_opcode(bytes, pc_start, address);
+      index = get_local_index(bytes, pc_start, address);
+
+      switch(opcode)
+      {
+        case 0x60: // iadd
+        case 0x64: // isub
+          n = consumer[address];
+          fits = n == -1 || info[n].op_32 == 0;
+          info[address].op_32 = !fits && known_a && known_b;
+          break;
+        case 0x99: // ifeq
+        case 0x9a: // ifne
+          fits = range_fits_int16(b) || range_fits_uint16(b);
+          info[address].op_32 = !fits && known_b;
+          break;
+        case 0x9b: // iflt
+        case 0x9c: // ifge
+        case 0x9d: // ifgt
+        case 0x9e: // ifle
+          info[address].op_32 = !range_fits_int16(b) && known_b;
+          break;
+        case 0x9f: // if_icmpeq
+        case 0xa0: // if_icmpne
+        case 0xa1: // if_icmplt
+        case 0xa2: // if_icmpge
+        case 0xa3: // if_icmpgt
+        case 0xa4: // if_icmple
+          fits = (range_fits_int16(a) && range_fits_int16(b)) ||
+                 (range_fits_uint16(a) && range_fits_uint16(b));
+          info[address].op_32 = !fits && known_a && known_b;
+          break;
+        case 0x36: // istore
+        case 0x3b: // istore_0
+        case 0x3c: // istore_1
+        case 0x3d: // istore_2
+        case 0x3e: // istore_3
+          info[address].op_32 = index < max_locals && locals_32[index] && known_b;
+          break;
+        case 0x84: // iinc
+          info[address].op_32 = index < max_locals && locals_32[index];
+          break;
+        default:
+          break;
+      }
+
+      if (info[address].op_32 == 0) { continue; }
+
+      total++;
+
+      for (n = 0; n < 2; n++)
+      {
+        p = operands[address * 2 + n];
+        if (p != -1) { info[p].result_32 = 1; }
+      }
+    }
+
+    changed = false;
+
+    for (i = 0; i < count; i++)
+    {
+      address = order[i];
+      if (info[address].result_32 == 0) { continue; }
+
+      opcode = get_opcode(bytes, pc_start, address);
+      if (opcode != 0x15 && (opcode < 0x1a || opcode > 0x1d)) { continue; }
+
+      index = get_local_index(bytes, pc_start, address);
+
+      if (index < max_locals && wide[index] && !locals_32[index])
+      {
+        locals_32[index] = 1;
+        changed = true;
+      }
+    }
+  } while(changed);
+
+  for (n = 0; n < max_locals; n++) { total += locals_32[n]; }
+
+  // Every 32 bit value on the stack is a word more.  iinc of a 32 bit
+  // local and compares with 0 use up to 4 words more while they run.
+  if (total != 0)
+  {
+    for (i = 0; i < count; i++)
+    {
+      address = order[i];
+
+      if (i == 0 || starts[address] || depth != info[address].depth)
+      {
+        depth = info[address].depth;
+        for (n = 0; n < depth; n++) { producer[n] = -1; }
+      }
+
+      extra = 0;
+      for (n = 0; n < depth; n++)
+      {
+        if (producer[n] != -1 && info[producer[n]].result_32) { extra++; }
+      }
+
+      if (extra + 4 > *stack_32) { *stack_32 = extra + 4; }
+
+      get_stack_effect(java_class, bytes, pc_start, address, &pops, &pushes);
+      depth -= pops;
+
+      for (n = 0; n < pushes; n++)
+      {
+        producer[depth++] = pushes == 1 ? address : -1;
+      }
+    }
+  }
+
+  ret = total;
+
+exit:
+  free(producer);
+  free(consumer);
+  free(operands);
+  free(order);
+  free(starts);
+  free(wide);
+
+  return ret;
+}
@@ -0,0 +1,55 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _RANGE_H
+#define _RANGE_H
+
+#include <stdint.h>
+
+#include "JavaClass.h"
+
+// Value range analysis.  Java int is 32 bit, but most of the CPUs this
+// compiles for do their math in 16 bits.  This computes (using Java's
+// 32 bit semantics) the smallest known range of every int value in a
+// method so the compiler can tell when 16 bit code gives the same answer.
+// Parameters, call results and static fields start out as whatever their
+// type holds in a register int_size bits wide.
+//
+// find_int32_values() then picks the values that have to be kept in 32
+// bits (2 words, low word first) because a compare, a store to a local
+// a compare reads later or an iadd / isub feeding one of those needs the
+// upper bits.
+
+struct range_t
+{
+  int32_t min;
+  int32_t max;
+};
+
+struct range_info_t
+{
+  range_t result;      // value pushed by the instruction (the local for iinc)
+  range_t operand[2];  // top of stack [0] and next [1] before it executes
+  uint16_t depth;      // operand stack depth before it executes
+  uint8_t reachable;
+  uint8_t overflow;    // set by the compiler if 16 bit code may be wrong
+  uint8_t op_32;       // does its math on 2 word operands
+  uint8_t result_32;   // its value is used as 2 words
+};
+
+int compute_ranges(JavaClass *java_class, char *method_sig, int int_size, uint8_t *bytes, int pc_start, int code_len, int max_locals, int max_stack, range_info_t *info);
+int find_int32_values(JavaClass *java_class, uint8_t *bytes, int pc_start, int code_len, int max_locals, int max_stack, range_info_t *info, uint8_t *locals_32, int *stack_32);
+int get_local_index(uint8_t *bytes, int pc_start, int address);
+bool range_fits_int16(range_t *range);
+bool range_fits_uint16(range_t *range);
+
+#endif
+
@@ -0,0 +1,180 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "time_report.h"
+
+static const char *phase_names[] =
+{
+  "class load",
+  "label map",
+  "translate",
+  "invoke",
+  "emit",
+};
+
+static double get_time()
+{
+struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+TimeReport::TimeReport() :
+  methods(NULL),
+  method_count(0),
+  method_max(0),
+  method_time(0),
+  method_instrs(0),
+  method_spills(0)
+{
+int n;
+
+  for (n = 0; n < PHASE_COUNT; n++)
+  {
+    phase_time[n] = 0;
+    phase_start[n] = 0;
+    phase_calls[n] = 0;
+  }
+}
+
+TimeReport::~TimeReport()
+{
+  free(methods);
+}
+
+void TimeReport::start(int phase)
+{
+  phase_start[phase] = get_time();
+}
+
+void TimeReport::stop(int phase)
+{
+  phase_time[phase] += get_time() - phase_start[phase];
+  phase_calls[phase]++;
+}
+
+void TimeReport::method_start(const char *name, int instr_count, int spill_count)
+{
+time_report_method_t *method;
+
+  if (method_count == method_max)
+  {
+    method_max = method_max == 0 ? 64 : method_max * 2;
+    methods = (time_report_method_t *)realloc(methods, method_max * sizeof(time_report_method_t));
+  }
+
+  method = &methods[method_count];
+  memset(method, 0, sizeof(time_report_method_t));
+  strncpy(method->name, name, sizeof(method->name) - 1);
+
+  method_instrs = instr_count;
+  method_spills = spill_count;
+  method_time = get_time();
+
+  start(PHASE_TRANSLATE);
+}
+
+void TimeReport::method_end(int instr_count, int bytecodes, int spill_count)
+{
+time_report_method_t *method = &methods[method_count++];
+
+  stop(PHASE_TRANSLATE);
+
+  method->time = get_time() - method_time;
+  method->bytecodes = bytecodes;
+  method->instructions = instr_count - method_instrs;
+  method->spills = spill_count - method_spills;
+}
+
+void TimeReport::print()
+{
+int bytecodes = 0, instructions = 0, spills = 0;
+int n;
+
+  printf("\n%-12s %10s %8s\n", "Phase", "ms", "Calls");
+
+  for (n = 0; n < PHASE_COUNT; n++)
+  {
+    printf("%-12s %10.3f %8d\n", phase_names[n], phase_time[n] * 1000, phase_calls[n]);
+  }
+
+  printf("\n%-32s %10s %9s %12s %7s\n", "Method", "ms", "Bytecodes", "Instructions", "Spills");
+
+  for (n = 0; n < method_count; n++)
+  {
+    printf("%-32s %10.3f %9d %12d %7d\n",
+      methods[n].name,
+      methods[n].time * 1000,
+      methods[n].bytecodes,
+      methods[n].instructions,
+      methods[n].spills);
+
+    bytecodes += methods[n].bytecodes;
+    instructions += methods[n].instructions;
+    spills += methods[n].spills;
+  }
+
+  printf("%-32s %10.3f %9d %12d %7d\n", "Total",
+    phase_time[PHASE_TRANSLATE] * 1000, bytecodes, instructions, spills);
+}
+
+int TimeReport::write_json(const char *filename)
+{
+FILE *out;
+int n;
+
+  out = fopen(filename, "wb");
+
+  if (out == NULL)
+  {
+    printf("Cannot open %s for writing\n", filename);
+    return -1;
+  }
+
+  fprintf(out, "{\n  \"phases\": [\n");
+
+  for (n = 0; n < PHASE_COUNT; n++)
+  {
+    fprintf(out, "    { \"phase\": \"%s\", \"ms\": %.3f, \"calls\": %d }%s\n",
+      phase_names[n],
+      phase_time[n] * 1000,
+      phase_calls[n],
+      n == PHASE_COUNT - 1 ? "" : ",");
+  }
+
+  fprintf(out, "  ],\n  \"methods\": [\n");
+
+  // Method names come from the .asm labels so they don't need escaping
+  for (n = 0; n < method_count; n++)
+  {
+    fprintf(out, "    { \"method\": \"%s\", \"ms\": %.3f, \"bytecodes\": %d, \"instructions\": %d, \"spills\": %d }%s\n",
+      methods[n].name,
+      methods[n].time * 1000,
+      methods[n].bytecodes,
+      methods[n].instructions,
+      methods[n].spills,
+      n == method_count - 1 ? "" : ",");
+  }
+
+  fprintf(out, "  ]\n}\n");
+
+  fclose(out);
+
+  return 0;
+}
+
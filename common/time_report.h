@@ -0,0 +1,68 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _TIME_REPORT_H
+#define _TIME_REPORT_H
+
+#include <stdio.h>
+
+// Wall time and call counts for each phase of a compile plus counters
+// for every method, turned on with java_grinder --time-report.  Phases
+// nest: label map and invoke are part of translate so the times don't
+// add up to the total.
+
+enum
+{
+  PHASE_CLASS_LOAD = 0,
+  PHASE_LABEL_MAP,
+  PHASE_TRANSLATE,
+  PHASE_INVOKE,
+  PHASE_EMIT,
+  PHASE_COUNT
+};
+
+struct time_report_method_t
+{
+  char name[64];
+  double time;
+  int bytecodes;
+  int instructions;
+  int spills;
+};
+
+class TimeReport
+{
+public:
+  TimeReport();
+  ~TimeReport();
+
+  void start(int phase);
+  void stop(int phase);
+  void method_start(const char *name, int instr_count, int spill_count);
+  void method_end(int instr_count, int bytecodes, int spill_count);
+  void print();
+  int write_json(const char *filename);
+  double get_phase_time(int phase) { return phase_time[phase]; }
+
+private:
+  double phase_time[PHASE_COUNT];
+  double phase_start[PHASE_COUNT];
+  int phase_calls[PHASE_COUNT];
+  time_report_method_t *methods;
+  int method_count;
+  int method_max;
+  double method_time;
+  int method_instrs;
+  int method_spills;
+};
+
+#endif
+
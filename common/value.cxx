@@ -0,0 +1,543 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "compile.h"
+#include "flow.h"
+#include "value.h"
+
+ValueTable::ValueTable(uint8_t *bytes, int pc_start, int code_len, int max_stack, int max_locals, int *frame_slot, uint8_t *label_map) :
+  bytes(bytes),
+  pc_start(pc_start),
+  code_len(code_len),
+  max_stack(max_stack),
+  max_locals(max_locals),
+  frame_slot(frame_slot),
+  label_map(label_map),
+  value_count(0),
+  value_max(64),
+  depth(0),
+  joins(true)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int address,len,count,n;
+
+  values = (value_t *)malloc(value_max * sizeof(value_t));
+  slots = (int *)malloc((max_stack + 1) * sizeof(int));
+  temp = (int *)malloc((max_stack + 1) * sizeof(int));
+  locals = (int *)malloc((max_locals + 1) * sizeof(int));
+  preds = (int *)calloc(code_len, sizeof(int));
+  states = (value_state_t *)calloc(code_len, sizeof(value_state_t));
+
+  memset(hash, 0xff, sizeof(hash));
+  reset(0);
+
+  // How many edges go into each address so a label knows when every
+  // path into it was compiled.  A switch or jsr turns this off.
+  for (address = 0; address < code_len; address += len)
+  {
+    len = get_instr_len(bytes, pc_start, address);
+    count = get_successors(bytes, pc_start, code_len, address, successors);
+
+    if (len <= 0 || count < 0) { joins = false; break; }
+
+    for (n = 0; n < count; n++) { preds[successors[n]]++; }
+  }
+}
+
+ValueTable::~ValueTable()
+{
+int n;
+
+  for (n = 0; n < code_len; n++)
+  {
+    if (states[n].slots != NULL) { free(states[n].slots); }
+    if (states[n].locals != NULL) { free(states[n].locals); }
+  }
+
+  free(values);
+  free(slots);
+  free(temp);
+  free(locals);
+  free(preds);
+  free(states);
+}
+
+void ValueTable::reset(int depth)
+{
+int n;
+
+  this->depth = (depth < 0 || depth > max_stack) ? 0 : depth;
+
+  for (n = 0; n <= max_stack; n++) { slots[n] = VALUE_NONE; }
+  for (n = 0; n <= max_locals; n++) { locals[n] = VALUE_NONE; }
+}
+
+void ValueTable::label(int address, int depth)
+{
+value_state_t *state = &states[address];
+
+  // The entry into the method is a path that never gets saved
+  if (!joins || address == 0 || state->count == 0 ||
+      state->count != preds[address] || !state->valid ||
+      state->depth != depth)
+  {
+    reset(depth);
+    return;
+  }
+
+  this->depth = depth;
+  memcpy(slots, state->slots, (max_stack + 1) * sizeof(int));
+  memcpy(locals, state->locals, (max_locals + 1) * sizeof(int));
+}
+
+// Called after the instruction(s) from address to address_end were
+// compiled (more than one if they were merged) with the depth the
+// generator's stack ended up at.
+void ValueTable::update(int address, int address_end, int depth)
+{
+int successors[FLOW_MAX_SUCCESSORS];
+int pc,len,count,n,i;
+int index,value,opcode;
+bool wide;
+
+  for (n = address; n < address_end; n += len)
+  {
+    pc = pc_start + n;
+    len = get_instr_len(bytes, pc_start, n);
+    if (len <= 0) { reset(depth); return; }
+
+    int ret = step(n, slots, &this->depth, true);
+
+    if (ret < 0) { reset(depth); return; }
+
+    if (ret == 0)
+    {
+      opcode = bytes[pc];
+      wide = false;
+
+      if (opcode == 0xc4)
+      {
+        opcode = bytes[pc + 1];
+        wide = true;
+      }
+
+      switch(opcode)
+      {
+        case 0x00: // nop
+        case 0xa7: // goto
+        case 0xc8: // goto_w
+        case 0xb1: // return
+          break;
+        case 0x36: // istore
+        case 0x3b: // istore_0
+        case 0x3c: // istore_1
+        case 0x3d: // istore_2
+        case 0x3e: // istore_3
+          if (this->depth < 1) { reset(depth); return; }
+          if (opcode == 0x36) { index = wide ? GET_PC_UINT16(2) : bytes[pc+1]; }
+          else { index = opcode - 0x3b; }
+          set_local(index, slots[--this->depth]);
+          break;
+        case 0x84: // iinc
+          index = wide ? GET_PC_UINT16(2) : bytes[pc+1];
+          value = get_local(index);
+          if (value != VALUE_NONE)
+          {
+            value = get_value(0x60, value, get_value(0x10, wide ? GET_PC_INT16(4) : (int8_t)bytes[pc+2], 0, true), true);
+          }
+          set_local(index, value);
+          break;
+        case 0x57: // pop
+        case 0x99: // ifeq
+        case 0x9a: // ifne
+        case 0x9b: // iflt
+        case 0x9c: // ifge
+        case 0x9d: // ifgt
+        case 0x9e: // ifle
+        case 0xac: // ireturn
+          if (this->depth < 1) { reset(depth); return; }
+          this->depth--;
+          break;
+        case 0x58: // pop2
+        case 0x9f: // if_icmpeq
+        case 0xa0: // if_icmpne
+        case 0xa1: // if_icmplt
+        case 0xa2: // if_icmpge
+        case 0xa3: // if_icmpgt
+        case 0xa4: // if_icmple
+          if (this->depth < 2) { reset(depth); return; }
+          this->depth -= 2;
+          break;
+        case 0x59: // dup
+          if (this->depth < 1 || this->depth >= max_stack) { reset(depth); return; }
+          slots[this->depth] = slots[this->depth - 1];
+          this->depth++;
+          break;
+        case 0x5f: // swap
+          if (this->depth < 2) { reset(depth); return; }
+          value = slots[this->depth - 1];
+          slots[this->depth - 1] = slots[this->depth - 2];
+          slots[this->depth - 2] = value;
+          break;
+        default:
+          // Anything else (a call, a getstatic) is only followed if it's
+          // the last thing compiled and leaves at most one new value on
+          // top of what it didn't touch.  Other stores forget the locals.
+          if (n + len < address_end || depth - 1 > this->depth ||
+              (opcode >= 0x37 && opcode <= 0x4e))
+          {
+            reset(depth);
+          }
+            else
+          {
+            for (i = depth - 1; i <= max_stack; i++) { slots[i < 0 ? 0 : i] = VALUE_NONE; }
+            this->depth = depth;
+          }
+          break;
+      }
+    }
+
+    count = get_successors(bytes, pc_start, code_len, n, successors);
+
+    for (i = 0; i < count; i++)
+    {
+      if (!is_label(successors[i])) { continue; }
+
+      // Something merged in the middle can't be trusted to have the
+      // right stack so that path doesn't get to keep anything
+      if (n + len < address_end || depth != this->depth)
+      {
+        save(successors[i], false);
+      }
+        else
+      {
+        save(successors[i], true);
+      }
+    }
+  }
+
+  if (this->depth != depth) { reset(depth); }
+}
+
+// Looks at the pure int instructions starting at address for the longest
+// run that leaves one value on the stack that's already in a stack slot
+// or a local.  Returns how many bytes of bytecode that is (0 for none)
+// with slot or local set to where the value can be copied from.
+int ValueTable::find(int address, int depth, int *slot, int *local)
+{
+int temp_depth;
+int address_end = 0;
+int value,len,count,n,i;
+
+  *slot = -1;
+  *local = -1;
+
+  if (depth != this->depth) { return 0; }
+
+  memcpy(temp, slots, depth * sizeof(int));
+  temp_depth = depth;
+
+  for (n = address, count = 0; n < code_len && count < VALUE_MAX_LOOKAHEAD; n += len, count++)
+  {
+    if (n != address && is_label(n)) { break; }
+
+    len = get_instr_len(bytes, pc_start, n);
+    if (len <= 0) { break; }
+
+    if (step(n, temp, &temp_depth, false) != 1) { break; }
+    if (temp_depth <= depth || temp[depth] == VALUE_NONE) { break; }
+    if (temp_depth != depth + 1) { continue; }
+
+    // A constant is as cheap to push as a copy
+    value = temp[depth];
+    if (values[value].op == 0x10) { continue; }
+
+    for (i = depth - 1; i >= 0; i--)
+    {
+      if (slots[i] == value) { break; }
+    }
+
+    if (i >= 0)
+    {
+      *slot = i;
+      *local = -1;
+      address_end = n + len;
+      continue;
+    }
+
+    // A load of a local is as cheap as loading a different one
+    if (count == 0) { continue; }
+
+    for (i = 0; i < max_locals; i++)
+    {
+      if (locals[i] == value) { break; }
+    }
+
+    if (i < max_locals)
+    {
+      *slot = -1;
+      *local = i;
+      address_end = n + len;
+    }
+  }
+
+  return address_end == 0 ? 0 : address_end - address;
+}
+
+// Checks that the pure int instructions starting at address push a and
+// then b on top of the depth values under them without loading local
+// skip_local (something stored to it just before).  Returns how many
+// bytes of bytecode that is or 0 if they don't.
+int ValueTable::find_operands(int address, int depth, int a, int b, int skip_local)
+{
+int temp_depth;
+int len,count,n,pc;
+
+  if (depth < 0 || depth > this->depth) { return 0; }
+
+  memcpy(temp, slots, depth * sizeof(int));
+  temp_depth = depth;
+
+  for (n = address, count = 0; n < code_len && count < VALUE_MAX_LOOKAHEAD; n += len, count++)
+  {
+    if (n != address && is_label(n)) { break; }
+
+    len = get_instr_len(bytes, pc_start, n);
+    if (len <= 0) { break; }
+
+    pc = pc_start + n;
+
+    if ((bytes[pc] == 0x15 && bytes[pc+1] == skip_local) ||
+        (bytes[pc] >= 0x1a && bytes[pc] <= 0x1d && bytes[pc] - 0x1a == skip_local) ||
+        (bytes[pc] == 0xc4 && bytes[pc+1] == 0x15 && GET_PC_UINT16(2) == skip_local))
+    {
+      break;
+    }
+
+    if (step(n, temp, &temp_depth, false) != 1) { break; }
+    if (temp_depth <= depth || temp[depth] == VALUE_NONE) { break; }
+
+    if (temp_depth == depth + 2 && temp[depth] == a && temp[depth + 1] == b)
+    {
+      return n + len - address;
+    }
+  }
+
+  return 0;
+}
+
+int ValueTable::get_local(int index)
+{
+  if (index < 0 || index >= max_locals) { return VALUE_NONE; }
+
+  return locals[index];
+}
+
+int ValueTable::get_value(int op, int a, int b, bool create)
+{
+int n,key;
+
+  if (op != 0x10 && (a == VALUE_NONE || b == VALUE_NONE)) { return VALUE_NONE; }
+
+  // iadd, imul, iand, ior, ixor
+  if ((op == 0x60 || op == 0x68 || op == 0x7e || op == 0x80 || op == 0x82) &&
+      a > b)
+  {
+    n = a;
+    a = b;
+    b = n;
+  }
+
+  key = ((uint32_t)op * 31 + (uint32_t)a * 17 + (uint32_t)b) % VALUE_HASH_SIZE;
+
+  for (n = hash[key]; n != -1; n = values[n].next)
+  {
+    if (values[n].op == op && values[n].a == a && values[n].b == b)
+    {
+      return n;
+    }
+  }
+
+  if (!create) { return VALUE_NONE; }
+
+  if (value_count == value_max)
+  {
+    value_t *grow = (value_t *)realloc(values, value_max * 2 * sizeof(value_t));
+    if (grow == NULL) { return VALUE_NONE; }
+    values = grow;
+    value_max *= 2;
+  }
+
+  values[value_count].op = op;
+  values[value_count].a = a;
+  values[value_count].b = b;
+  values[value_count].next = hash[key];
+  hash[key] = value_count;
+
+  return value_count++;
+}
+
+// A local that was never given a number gets a new one the first time
+// it's loaded.
+int ValueTable::get_local_value(int index, bool create)
+{
+  if (index < 0 || index >= max_locals) { return VALUE_NONE; }
+
+  if (locals[index] == VALUE_NONE && create)
+  {
+    // The serial number keeps it from matching anything else
+    locals[index] = get_value(0x15, index, value_count, true);
+  }
+
+  return locals[index];
+}
+
+// Locals that share a slot in the frame lose their value too.
+void ValueTable::set_local(int index, int value)
+{
+int n;
+
+  if (index < 0 || index >= max_locals) { return; }
+
+  for (n = 0; n < max_locals; n++)
+  {
+    if (frame_slot[n] == frame_slot[index]) { locals[n] = VALUE_NONE; }
+  }
+
+  locals[index] = value;
+}
+
+// Runs the instruction at address on stack if it only computes an int
+// from other ints.  Returns 1 if it did, 0 if it's not that kind of
+// instruction and -1 if the stack doesn't fit.
+int ValueTable::step(int address, int *stack, int *depth, bool create)
+{
+int pc = pc_start + address;
+int opcode = bytes[pc];
+int value;
+
+  switch(opcode)
+  {
+    case 0x02: // iconst_m1
+    case 0x03: // iconst_0
+    case 0x04: // iconst_1
+    case 0x05: // iconst_2
+    case 0x06: // iconst_3
+    case 0x07: // iconst_4
+    case 0x08: // iconst_5
+      value = get_value(0x10, opcode - 0x03, 0, true);
+      break;
+    case 0x10: // bipush
+      value = get_value(0x10, (int8_t)bytes[pc+1], 0, true);
+      break;
+    case 0x11: // sipush
+      value = get_value(0x10, GET_PC_INT16(1), 0, true);
+      break;
+    case 0x15: // iload
+      value = get_local_value(bytes[pc+1], create);
+      break;
+    case 0x1a: // iload_0
+    case 0x1b: // iload_1
+    case 0x1c: // iload_2
+    case 0x1d: // iload_3
+      value = get_local_value(opcode - 0x1a, create);
+      break;
+    case 0xc4: // wide
+      if (bytes[pc+1] != 0x15) { return 0; }
+      value = get_local_value(GET_PC_UINT16(2), create);
+      break;
+    case 0x60: // iadd
+    case 0x64: // isub
+    case 0x68: // imul
+    case 0x6c: // idiv
+    case 0x70: // irem
+    case 0x78: // ishl
+    case 0x7a: // ishr
+    case 0x7c: // iushr
+    case 0x7e: // iand
+    case 0x80: // ior
+    case 0x82: // ixor
+      if (*depth < 2) { return -1; }
+      *depth -= 2;
+      value = get_value(opcode, stack[*depth], stack[*depth + 1], create);
+      break;
+    case 0x74: // ineg
+    case 0x91: // i2b
+    case 0x92: // i2c
+    case 0x93: // i2s
+      if (*depth < 1) { return -1; }
+      *depth -= 1;
+      value = get_value(opcode, stack[*depth], 0, create);
+      break;
+    default:
+      return 0;
+  }
+
+  if (*depth >= max_stack) { return -1; }
+
+  stack[(*depth)++] = value;
+
+  return 1;
+}
+
+// Merges the current stack and locals into what's known at a label.
+void ValueTable::save(int address, bool valid)
+{
+value_state_t *state = &states[address];
+int n;
+
+  state->count++;
+
+  if (!valid) { state->valid = 0; return; }
+
+  if (state->count == 1)
+  {
+    state->slots = (int *)malloc((max_stack + 1) * sizeof(int));
+    state->locals = (int *)malloc((max_locals + 1) * sizeof(int));
+
+    if (state->slots == NULL || state->locals == NULL) { return; }
+
+    state->valid = 1;
+    state->depth = depth;
+    memcpy(state->slots, slots, (max_stack + 1) * sizeof(int));
+    memcpy(state->locals, locals, (max_locals + 1) * sizeof(int));
+    return;
+  }
+
+  if (!state->valid) { return; }
+
+  if (state->depth != depth)
+  {
+    state->valid = 0;
+    return;
+  }
+
+  for (n = 0; n <= max_stack; n++)
+  {
+    if (state->slots[n] != slots[n]) { state->slots[n] = VALUE_NONE; }
+  }
+
+  for (n = 0; n <= max_locals; n++)
+  {
+    if (state->locals[n] != locals[n]) { state->locals[n] = VALUE_NONE; }
+  }
+}
+
+bool ValueTable::is_label(int address)
+{
+  return (label_map[address / 8] & (1 << (address % 8))) != 0;
+}
+
@@ -0,0 +1,90 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _VALUE_H
+#define _VALUE_H
+
+#include <stdint.h>
+
+// Value numbering of the ints a method computes.  Every operand stack
+// slot and local gets the number of the value it holds so an expression
+// that was already computed (x + 23, y / 10) can be copied from a stack
+// register or from a local instead of being computed again.  A store or
+// iinc gives the local a new number.  At a label the numbers every path
+// into it agree on are kept if all of those paths were already compiled,
+// otherwise everything is forgotten.
+
+#define VALUE_NONE -1
+#define VALUE_HASH_SIZE 256
+#define VALUE_MAX_LOOKAHEAD 32
+
+struct value_t
+{
+  int op;              // bytecode, 0x10 for a constant, 0x15 for a local
+  int a;
+  int b;
+  int next;            // next value in the same hash bucket
+};
+
+struct value_state_t
+{
+  int count;           // how many paths into the label were compiled
+  int valid;
+  int depth;
+  int *slots;
+  int *locals;
+};
+
+class ValueTable
+{
+public:
+  ValueTable(uint8_t *bytes, int pc_start, int code_len, int max_stack, int max_locals, int *frame_slot, uint8_t *label_map);
+  ~ValueTable();
+
+  void reset(int depth);
+  void label(int address, int depth);
+  void update(int address, int address_end, int depth);
+  int find(int address, int depth, int *slot, int *local);
+  int find_operands(int address, int depth, int a, int b, int skip_local);
+  int get_const(int n) { return get_value(0x10, n, 0, true); }
+  int get_slot(int n) { return n >= 0 && n < depth ? slots[n] : VALUE_NONE; }
+  int get_local(int index);
+
+private:
+  int get_value(int op, int a, int b, bool create);
+  int get_local_value(int index, bool create);
+  void set_local(int index, int value);
+  int step(int address, int *stack, int *depth, bool create);
+  void save(int address, bool valid);
+  bool is_label(int address);
+
+  uint8_t *bytes;
+  int pc_start;
+  int code_len;
+  int max_stack;
+  int max_locals;
+  int *frame_slot;
+  uint8_t *label_map;
+  value_t *values;
+  int value_count;
+  int value_max;
+  int hash[VALUE_HASH_SIZE];
+  int *slots;
+  int *temp;
+  int depth;
+  int *locals;
+  int *preds;
+  value_state_t *states;
+  bool joins;
+};
+
+#endif
+
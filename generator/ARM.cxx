@@ -46,7 +46,7 @@ void ARM::serial_init()
 }
 #endif
 
-void ARM::method_start(int local_count, const char *name)
+void ARM::method_start(int local_count, int param_count, const char *name)
 {
 }
 
@@ -18,9 +18,10 @@
 #include <inttypes.h>
 
 #include "DSPIC.h"
+#include "liveness.h"
 
 #define REG_STACK(a) (stack_regs[a])
-#define LOCALS(i) (i * 2)
+#define LOCALS(i) ((i) * 2)
 
 // ABI is:
 // w0 temp, return value from method call
@@ -29,31 +30,49 @@
 // w1 ..
 // w2 ..
 // w3 ..
-// w8 ..
-// w9 ..
-// w10 end of stack
+// w8 end of stack
+// w9 first parameter
+// w10 second parameter
+// w12 third parameter
 // w13 temp
-// w14 pointer to locals
+// w14 pointer to locals (or the 7th stack register with static frames)
+//
+// The first 3 params of a method are passed in w9, w10, w12 and stay
+// there as its locals 0 to 2.  The rest are copied above SP into the
+// called method's frame.  Parameter registers are saved by the caller.
+// Methods that never touch w14 skip lnk / ulnk and the rest only do it
+// on the paths that need it (see Generator::place_frame()).
 //
 // Stack on dsPIC moves value to [sp] and then increments sp by 2 (odd).
 
 static const char *cond_str[] = { "z", "nz", "lt", "le", "gt", "ge" };
-static int8_t stack_regs[] = { 5, 4, 11, 2, 3, 8, 9, 10 };
+static const char *ucond_str[] = { "z", "nz", "ltu", "leu", "gtu", "geu" };
+// w14 is only on the stack with static frames
+static int8_t stack_regs[] = { 5, 4, 11, 2, 3, 8, 14 };
+static int8_t arg_regs[] = { 9, 10, 12 };
 
 DSPIC::DSPIC(uint8_t chip_type) :
   reg(0),
-  reg_max(sizeof(stack_regs)),
+  reg_max(sizeof(stack_regs) - 1),
   stack(0),
+  arg_count(0),
+  param_count(0),
+  method_spills(0),
+  frame_base(0),
+  frame_size(0),
   is_main(false),
-  need_stack_set(false)
+  need_stack_set(false),
+  loop_instr(0),
+  loop_label(0),
+  ram_end(0x0900)
 {
   this->chip_type = chip_type;
 }
 
 DSPIC::~DSPIC()
 {
-  fprintf(out, ".org __FICD\n");
-  fprintf(out, "  dc32 0xffcf\n\n");
+  emit(".org __FICD\n");
+  emit("  dc32 0xffcf\n\n");
 }
 
 int DSPIC::open(char *filename)
@@ -61,32 +80,34 @@ int DSPIC::open(char *filename)
   if (Generator::open(filename) != 0) { return -1; }
 
   // For now we only support a specific chip
-  fprintf(out, ".dspic\n");
+  emit(".dspic\n");
 
   switch(chip_type)
   {
     case DSPIC30F3012:
-      fprintf(out, ".include \"p30f3012.inc\"\n\n");
+      emit(".include \"p30f3012.inc\"\n\n");
       flash_start = 0x100;
+      ram_end = 0x1000;
       break;
     case DSPIC33FJ06GS101A:
-      fprintf(out, ".include \"p33fj06gs101a.inc\"\n\n");
+      emit(".include \"p33fj06gs101a.inc\"\n\n");
       flash_start = 0x100;
+      ram_end = 0x0900;
       need_stack_set = true;
       break;
     default:
       printf("Unknown chip type.\n");
   }
 
-  fprintf(out, ".org 0\n");
-  fprintf(out, "  goto start\n\n");
+  emit(".org 0\n");
+  emit("  goto start\n\n");
 
   // Add any set up items (stack, registers, etc).  On some CPU's (dsPICF3012)
   // SP is automatically set but some it's not.  So for now we'll just set it.
   // Also, not sure what to do with SPLIM.
-  fprintf(out, ".org %d\n", flash_start);
-  fprintf(out, "start:\n");
-  if (need_stack_set) { fprintf(out, "  mov #0x800, SP\n\n"); }
+  emit(".org %d\n", flash_start);
+  emit("start:\n");
+  if (need_stack_set) { emit("  mov #0x800, SP\n\n"); }
 
   return 0;
 }
@@ -97,34 +118,57 @@ void DSPIC::serial_init()
 }
 #endif
 
-void DSPIC::method_start(int local_count, const char *name)
+void DSPIC::method_start(int local_count, int param_count, const char *name)
 {
+int start;
+
   reg = 0;
   stack = 0;
 
   is_main = (strcmp(name, "main") == 0) ? true : false;
 
+  this->param_count = param_count;
+  arg_count = param_count;
+  if (arg_count > (int)sizeof(arg_regs)) { arg_count = sizeof(arg_regs); }
+  if (is_main) { arg_count = 0; }
+
+  method_spills = spill_count;
+
   // main() function goes here
-  fprintf(out, "%s:\n", name);
+  emit("%s:\n", name);
+
+  if (static_frames)
+  {
+    frame_base = ram_end - frame_size + call_graph->get_node(call_graph->find(name))->frame_offset;
+    return;
+  }
+
   if (!is_main)
   {
-    //fprintf(out, "  push w14\n");
-    //fprintf(out, "  mov sp, w14\n");
-    //fprintf(out, "  add #0x%x, sp\n", local_count * 2);
-    if (local_count != 0) { fprintf(out, "  lnk #0x%x\n", local_count * 2); }
+    //emit("  push w14\n");
+    //emit("  mov sp, w14\n");
+    //emit("  add #0x%x, sp\n", local_count * 2);
+    start = instr_count;
+    emit("  lnk #0x%x\n", (local_count - arg_count) * 2);
+    mark_prologue(start);
   }
     else
   {
-    fprintf(out, "  mov sp, w14\n");
-    fprintf(out, "  add #0x%x, sp\n", local_count * 2);
+    emit("  mov sp, w14\n");
+    emit("  add #0x%x, sp\n", local_count * 2);
   }
 }
 
 void DSPIC::method_end(int local_count)
 {
-  //fprintf(out, "  add #0x%x, sp\n", local_count * 2);
-  //fprintf(out, "  ret\n\n");
-  fprintf(out, "\n");
+  //emit("  add #0x%x, sp\n", local_count * 2);
+  //emit("  ret\n\n");
+
+  // The frame is set up on entry if anything spilled (ulnk throws the
+  // spills away) or params came in the frame.
+  place_frame(spill_count != method_spills || param_count > arg_count);
+
+  emit("\n");
 }
 
 int DSPIC::push_integer(int32_t n)
@@ -139,14 +183,15 @@ int DSPIC::push_integer(int32_t n)
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov #0x%02x, w%d\n", value, REG_STACK(reg));
+    emit("  mov #0x%02x, w%d\n", value, REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  mov #0x%02x, w0\n", value);
-    fprintf(out, "  push w0\n");
+    emit("  mov #0x%02x, w0\n", value);
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -154,20 +199,31 @@ int DSPIC::push_integer(int32_t n)
 
 int DSPIC::push_integer_local(int index)
 {
+char local[16];
+
+  get_local(local, index);
 
   if (reg < reg_max)
   {
-    //fprintf(out, "  mov [w14+%d], w0\n", LOCALS(index));
-    //fprintf(out, "  mov w0, w%d\n", REG_STACK(reg));
-    fprintf(out, "  mov [w14+%d], w%d\n", LOCALS(index), REG_STACK(reg));
+    emit("  mov %s, w%d\n", local, REG_STACK(reg));
     reg++;
   }
     else
   {
-    //fprintf(out, "  mov [w14+%d], w0\n", LOCALS(index));
-    //fprintf(out, "  push w0\n");
-    fprintf(out, "  push [w14+%d]\n", LOCALS(index));
+    // push only takes a register or a file register so locals in the
+    // frame go through w0
+    if (local[0] == '[')
+    {
+      emit("  mov %s, w0\n", local);
+      emit("  push w0\n");
+    }
+      else
+    {
+      emit("  push %s\n", local);
+    }
+
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -197,14 +253,15 @@ int DSPIC::push_byte(int8_t b)
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov #0x%02x, w%d\n", value, REG_STACK(reg));
+    emit("  mov #0x%02x, w%d\n", value, REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  mov #0x%02x, w0\n", value);
-    fprintf(out, "  push w0\n");
+    emit("  mov #0x%02x, w0\n", value);
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
   return 0;
 }
@@ -215,30 +272,35 @@ int DSPIC::push_short(int16_t s)
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov #0x%02x, w%d\n", value, REG_STACK(reg));
+    emit("  mov #0x%02x, w%d\n", value, REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  mov #0x%02x, w0\n", value);
-    fprintf(out, "  push w0\n");
+    emit("  mov #0x%02x, w0\n", value);
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
   return 0;
 }
 
 int DSPIC::pop_integer_local(int index)
 {
+char local[16];
+
+  get_local(local, index);
+
   if (stack > 0)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov.w w0, [w14+%d]\n", LOCALS(index));
+    emit("  pop w0\n");
+    emit("  mov.w w0, %s\n", local);
     stack--;
   }
     else
   if (reg > 0)
   {
-    fprintf(out, "  mov.w w%d, [w14+%d]\n", REG_STACK(reg-1), LOCALS(index));
+    emit("  mov.w w%d, %s\n", REG_STACK(reg-1), local);
     reg--;
   }
 
@@ -249,7 +311,7 @@ int DSPIC::pop()
 {
   if (stack > 0)
   {
-    fprintf(out, "  pop w0\n");
+    emit("  pop w0\n");
     stack--;
   }
     else
@@ -265,18 +327,42 @@ int DSPIC::dup()
 {
   if (stack > 0)
   {
-    fprintf(out, "  push [SP]\n");
+    // The top of the stack is at [SP-2] which push can't encode
+    emit("  mov.w [SP-2], w0\n");
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
     else
   if (reg == reg_max)
   {
-    fprintf(out, "  push w%d\n", REG_STACK(reg-1));
+    emit("  push w%d\n", REG_STACK(reg-1));
     stack++;
+    spill_count++;
   }
     else
   {
-    fprintf(out, "  mov.w w%d, w%d\n", REG_STACK(reg-1), REG_STACK(reg));
+    emit("  mov.w w%d, w%d\n", REG_STACK(reg-1), REG_STACK(reg));
+    reg++;
+  }
+
+  return 0;
+}
+
+int DSPIC::dup_stack_slot(int slot)
+{
+  // Only slots held in registers can be copied without a memory access
+  if (slot >= reg) { return -1; }
+
+  if (reg == reg_max)
+  {
+    emit("  push w%d\n", REG_STACK(slot));
+    stack++;
+    spill_count++;
+  }
+    else
+  {
+    emit("  mov.w w%d, w%d\n", REG_STACK(slot), REG_STACK(reg));
     reg++;
   }
 
@@ -293,23 +379,23 @@ int DSPIC::swap()
 {
   if (stack == 0)
   {
-    fprintf(out, "  mov.w w%d, w0\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
-    fprintf(out, "  mov.w w0, w%d\n", REG_STACK(reg-2));
+    emit("  mov.w w%d, w0\n", REG_STACK(reg-1));
+    emit("  mov.w w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
+    emit("  mov.w w0, w%d\n", REG_STACK(reg-2));
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  mov.w w%d, w0\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w [SP-2], w%d\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w w0, [SP-2]\n");
+    emit("  mov.w w%d, w0\n", REG_STACK(reg-1));
+    emit("  mov.w [SP-2], w%d\n", REG_STACK(reg-1));
+    emit("  mov.w w0, [SP-2]\n");
   }
     else
   {
-    fprintf(out, "  mov.w [SP-4], w0\n");
-    fprintf(out, "  mov.w [SP-2], w13\n");
-    fprintf(out, "  mov.w w13, [SP-4]\n");
-    fprintf(out, "  mov.w w0, [SP-2]\n");
+    emit("  mov.w [SP-4], w0\n");
+    emit("  mov.w [SP-2], w13\n");
+    emit("  mov.w w13, [SP-4]\n");
+    emit("  mov.w w0, [SP-2]\n");
   }
 
   return 0;
@@ -327,7 +413,44 @@ int DSPIC::sub_integers()
 
 int DSPIC::mul_integers()
 {
-  return stack_alu("mul");
+  // mul.ss writes a 32 bit product to an even / odd register pair so it
+  // goes through w0:w1 and the low word is the Java result.
+  if (stack == 0)
+  {
+    emit("  mul.ss w%d, w%d, w0\n", REG_STACK(reg-2), REG_STACK(reg-1));
+    emit("  mov w0, w%d\n", REG_STACK(reg-2));
+    reg--;
+  }
+    else
+  if (stack == 1)
+  {
+    emit("  pop w0\n");
+    emit("  mul.ss w%d, w0, w0\n", REG_STACK(reg-1));
+    emit("  mov w0, w%d\n", REG_STACK(reg-1));
+    stack--;
+  }
+    else
+  {
+    emit("  pop w0\n");
+    emit("  pop w1\n");
+    emit("  mul.ss w1, w0, w0\n");
+    emit("  push w0\n");
+    stack--;
+  }
+
+  return 0;
+}
+
+int DSPIC::mul_integers(int const_val)
+{
+superopt_t *entry;
+
+  // mul is a single cycle so only take sequences that are no longer than
+  // loading the constant and multiplying.  This also saves a register.
+  entry = find_superopt(table_superopt_dspic, "mul", const_val);
+  if (entry == NULL || entry->count > 2) { return -1; }
+
+  return stack_superopt("mul", const_val);
 }
 
 int DSPIC::div_integers()
@@ -335,8 +458,8 @@ int DSPIC::div_integers()
   stack_alu_div();
 
   // Result of divide is in w0
-  if (stack > 0) { fprintf(out, "  mov.w w0, [SP-2]\n"); }
-  else { fprintf(out, "  mov.w w0, w%d\n", REG_STACK(reg-1)); }
+  if (stack > 0) { emit("  mov.w w0, [SP-2]\n"); }
+  else { emit("  mov.w w0, w%d\n", REG_STACK(reg-1)); }
 
   return 0;
 }
@@ -346,24 +469,39 @@ int DSPIC::mod_integers()
   stack_alu_div();
 
   // Remainder of divide is in w1
-  if (stack > 0) { fprintf(out, "  mov.w w1, [SP-2]\n"); }
-  else { fprintf(out, "  mov.w w1, w%d\n", REG_STACK(reg-1)); }
+  if (stack > 0) { emit("  mov.w w1, [SP-2]\n"); }
+  else { emit("  mov.w w1, w%d\n", REG_STACK(reg-1)); }
 
   return 0;
 }
 
+int DSPIC::integer_to_byte()
+{
+  return stack_superopt("i2b", 0);
+}
+
+int DSPIC::integer_to_short()
+{
+  return stack_superopt("i2s", 0);
+}
+
+int DSPIC::integer_to_char()
+{
+  return stack_superopt("i2c", 0);
+}
+
 int DSPIC::neg_integer()
 {
   if (stack > 0)
   {
-    fprintf(out, "  mov.w [SP-2], w0\n");
-    fprintf(out, "  neg.w w0, w0\n");
-    fprintf(out, "  mov.w w0, [SP-2]\n");
+    emit("  mov.w [SP-2], w0\n");
+    emit("  neg.w w0, w0\n");
+    emit("  mov.w w0, [SP-2]\n");
     stack--;
   }
     else
   {
-    fprintf(out, "  neg.w w%d, w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  neg.w w%d, w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
   }
 
   return 0;
@@ -399,21 +537,37 @@ int DSPIC::xor_integer()
   return stack_alu("xor");
 }
 
+int DSPIC::extract_bits_integer(int shift, int width)
+{
+  return stack_superopt("bits", (shift << 8) | width);
+}
+
 int DSPIC::inc_integer(int index, int num)
 {
 int8_t n = (int8_t)num;
+char local[16];
 
-  fprintf(out, "  mov [w14+%d], w0\n", LOCALS(index));
+  if (index < arg_count)
+  {
+    if (n >= 0) { emit("  add #%d, w%d\n", n, arg_regs[index]); }
+    else { emit("  sub #%d, w%d\n", -n, arg_regs[index]); }
+
+    return 0;
+  }
+
+  get_local(local, index);
+
+  emit("  mov %s, w0\n", local);
   if (n >= 0)
   {
-    fprintf(out, "  add #%d, w0\n", n);
+    emit("  add #%d, w0\n", n);
   }
     else
   {
-    fprintf(out, "  sub #%d, w0\n", -n);
+    emit("  sub #%d, w0\n", -n);
   }
 
-  fprintf(out, "  mov w0, [w14+%d]\n", LOCALS(index));
+  emit("  mov w0, %s\n", local);
 
   return 0;
 }
@@ -422,47 +576,115 @@ int DSPIC::jump_cond(const char *label, int cond)
 {
   if (stack > 0)
   {
-    //fprintf(out, "  mov [SP-2], w0\n");
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  cp0 w0\n");
+    //emit("  mov [SP-2], w0\n");
+    emit("  pop w0\n");
+    emit("  cp0 w0\n");
     stack--;
   }
     else
   {
-    fprintf(out, "  cp0 w%d\n", REG_STACK(reg-1));
+    emit("  cp0 w%d\n", REG_STACK(reg-1));
     reg--;
   }
 
-  fprintf(out, "  bra %s, %s\n", cond_str[cond], label);
+  emit("  bra %s, %s\n", cond_str[cond], label);
   return 0;
 }
 
 int DSPIC::jump_cond_integer(const char *label, int cond)
+{
+  return cmp_integers(label, cond, cond_str);
+}
+
+int DSPIC::jump_cond_integer_unsigned(const char *label, int cond)
+{
+  return cmp_integers(label, cond, ucond_str);
+}
+
+int DSPIC::cmp_integers(const char *label, int cond, const char **cond_table)
 {
   if (stack > 1)
   {
-    fprintf(out, "  mov [SP-2], w0\n");
-    fprintf(out, "  mov [SP-4], w13\n");
-    //fprintf(out, "  cmp.w 2(SP), 4(SP)\n");
-    //fprintf(out, "  cp w0, w13\n");
-    fprintf(out, "  cp w13, w0\n");
+    emit("  mov [SP-2], w0\n");
+    emit("  mov [SP-4], w13\n");
+    //emit("  cmp.w 2(SP), 4(SP)\n");
+    //emit("  cp w0, w13\n");
+    emit("  cp w13, w0\n");
     stack -= 2;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  mov [SP-2], w0\n");
-    fprintf(out, "  cp w%d, w0\n", REG_STACK(reg-1));
+    emit("  mov [SP-2], w0\n");
+    emit("  cp w%d, w0\n", REG_STACK(reg-1));
     stack--;
     reg--;
   }
     else
   {
-    fprintf(out, "  cp w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
+    emit("  cp w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
     reg -= 2;
   }
 
-  fprintf(out, "  bra %s, %s\n", cond_str[cond], label);
+  emit("  bra %s, %s\n", cond_table[cond], label);
+
+  return 0;
+}
+
+int DSPIC::extend_integer(bool is_unsigned)
+{
+  if (is_unsigned) { return push_integer(0); }
+
+  if (stack > 0)
+  {
+    emit("  mov [SP-2], w0\n");
+    emit("  asr w0, #15, w0\n");
+    emit("  push w0\n");
+    stack++;
+    spill_count++;
+  }
+    else
+  if (reg < reg_max)
+  {
+    emit("  asr w%d, #15, w%d\n", REG_STACK(reg-1), REG_STACK(reg));
+    reg++;
+  }
+    else
+  {
+    emit("  asr w%d, #15, w0\n", REG_STACK(reg-1));
+    emit("  push w0\n");
+    stack++;
+    spill_count++;
+  }
+
+  return 0;
+}
+
+int DSPIC::add_integers_32()
+{
+  return stack_alu_32("add", "addc");
+}
+
+int DSPIC::sub_integers_32()
+{
+  return stack_alu_32("sub", "subb");
+}
+
+// subb can only clear Z so after sub / subb of both words all of the
+// branch conditions are right for the 32 bit compare.
+int DSPIC::jump_cond_integer_32(const char *label, int cond)
+{
+char lo[8];
+char hi[8];
+char value_lo[8];
+char value_hi[8];
+
+  pop_reg_32(lo, hi, "w0", "w1");
+  pop_reg_32(value_lo, value_hi, "w6", "w7");
+
+  emit("  sub.w %s, %s, w13\n", value_lo, lo);
+  emit("  subb.w %s, %s, w13\n", value_hi, hi);
+  emit("  bra %s, %s\n", cond_str[cond], label);
 
   return 0;
 }
@@ -470,10 +692,10 @@ int DSPIC::jump_cond_integer(const char *label, int cond)
 int DSPIC::return_local(int index, int local_count)
 {
 #if 0
-  fprintf(out, "  mov [w14-#%d], w0\n", LOCALS(index));
-  //fprintf(out, "  add #0x%x, sp\n", local_count * 2);
-  fprintf(out, "  mov w14, sp\n");
-  fprintf(out, "  ret\n");
+  emit("  mov [w14-#%d], w0\n", LOCALS(index));
+  //emit("  add #0x%x, sp\n", local_count * 2);
+  emit("  mov w14, sp\n");
+  emit("  ret\n");
 
   return 0;
 #endif
@@ -484,114 +706,148 @@ int DSPIC::return_integer(int local_count)
 {
   if (stack > 0)
   {
-    fprintf(out, "  mov [sp-2], w0\n");
+    emit("  mov [sp-2], w0\n");
   }
     else 
   {
-    fprintf(out, "  mov w%d, w0\n", REG_STACK(reg - 1));
+    emit("  mov w%d, w0\n", REG_STACK(reg - 1));
   }
 
-  if (local_count != 0) { fprintf(out, "  ulnk\n"); }
-  //fprintf(out, "  mov w14, sp\n");
-  //if (!is_main) { fprintf(out, "  pop w14\n"); }
-  fprintf(out, "  return\n");
+  frame_end();
+  //emit("  mov w14, sp\n");
+  //if (!is_main) { emit("  pop w14\n"); }
+  emit("  return\n");
   return 0;
 }
 
 int DSPIC::return_void(int local_count)
 {
-  //fprintf(out, "  mov w14, sp\n");
-  //if (!is_main) { fprintf(out, "  pop w14\n"); }
-  if (local_count != 0) { fprintf(out, "  ulnk\n"); }
-  fprintf(out, "  return\n");
+  //emit("  mov w14, sp\n");
+  //if (!is_main) { emit("  pop w14\n"); }
+  frame_end();
+  emit("  return\n");
 
   return 0;
 }
 
 int DSPIC::jump(const char *name)
 {
-  fprintf(out, "  bra %s\n", name);
+  emit("  bra %s\n", name);
   return 0;
 }
 
 int DSPIC::call(const char *name)
 {
-  fprintf(out, "  call %s\n", name);
+  emit("  call %s\n", name);
   return 0;
 }
 
 int DSPIC::invoke_static_method(const char *name, int params, int is_void)
 {
-int local;
-int stack_vars = stack;
-int reg_vars = reg;
-int saved_registers;
+uint32_t clobber = get_clobber(name);
+char src[16];
+int saved[16];
+int saved_count = 0;
+int stack_params;
+int reg_params;
+int frame = 0;
 int n;
 
   printf("invoke_static_method() name=%s params=%d is_void=%d\n", name, params, is_void);
 
-  // Push all used registers on the stack except the ones that are pulled
-  // out for parameters.
-  saved_registers = reg - (params - stack);
-  for (n = 0; n < saved_registers; n++)
+  // The params are the top of the Java stack so any that were spilled
+  // are on the hardware stack and the rest are the last used registers.
+  stack_params = (params < stack) ? params : stack;
+  reg_params = params - stack_params;
+
+  // Push the registers still holding stack values that the called
+  // method can change and this method's own register params if they
+  // are read after the call and the call changes them.
+  for (n = 0; n < reg - reg_params; n++)
+  {
+    if ((clobber & (1 << REG_STACK(n))) == 0) { continue; }
+    saved[saved_count++] = REG_STACK(n);
+  }
+
+  for (n = 0; n < arg_count; n++)
   {
-    fprintf(out, "  push w%d\n", REG_STACK(n));
+    if (!is_local_live(live_locals, n)) { continue; }
+    if (n >= params && (clobber & (1 << arg_regs[n])) == 0) { continue; }
+    saved[saved_count++] = arg_regs[n];
   }
 
-  // Copy parameters onto the stack so they are local variables in
-  // the called method.  Start with -4 because the return address will
-  // be at 0 and w14 will be at 2.
-  local = (params * 2);
-  while(local > 0)
+  for (n = 0; n < saved_count; n++)
   {
-    if (stack_vars > 0)
+    emit("  push w%d\n", saved[n]);
+  }
+
+  // First params go in registers, the rest are copied above SP so they
+  // are local variables in the called method.  Start at +6 because the
+  // return address will be at +0 and w14 at +4.  With static frames they
+  // go straight into the called method's frame.
+  if (static_frames)
+  {
+    frame = ram_end - frame_size + call_graph->get_node(call_graph->find(name))->frame_offset;
+  }
+
+  for (n = 0; n < params; n++)
+  {
+    if (n >= reg_params)
     {
-      fprintf(out, "  mov [SP%d], [SP+%d]\n", stack_vars, local+4);
-      stack_vars--;
+      emit("  mov [SP-%d], w0\n", (params - n + saved_count) * 2);
+      strcpy(src, "w0");
     }
       else
     {
-      fprintf(out, "  mov w%d, [SP+%d]\n", REG_STACK(reg_vars-1), local+4);
-      reg_vars--;
+      sprintf(src, "w%d", REG_STACK(reg - reg_params + n));
     }
 
-    local -= 2;
+    if (n < (int)sizeof(arg_regs))
+    {
+      emit("  mov %s, w%d\n", src, arg_regs[n]);
+    }
+      else
+    if (static_frames)
+    {
+      emit("  mov %s, 0x%04x\n", src, frame + (n - (int)sizeof(arg_regs)) * 2);
+    }
+      else
+    {
+      emit("  mov %s, [SP+%d]\n", src, ((n - (int)sizeof(arg_regs)) * 2) + 6);
+    }
   }
 
   // Make the call
-  fprintf(out, "  call %s\n", name);
+  emit("  call %s\n", name);
 
-  // Pop all used registers off the stack
-  for (n = saved_registers-1; n >= 0; n--)
+  // Pop all saved registers off the stack
+  for (n = saved_count - 1; n >= 0; n--)
   {
-    fprintf(out, "  pop w%d\n", REG_STACK(n));
+    emit("  pop w%d\n", saved[n]);
   }
 
   // Pop all params off the Java stack
-  if ((stack - stack_vars) > 0)
+  if (stack_params > 0)
   {
-    fprintf(out, "  sub #%d, SP\n", (stack - stack_vars) * 2);
-    params -= (stack - stack_vars);
+    emit("  sub #%d, SP\n", stack_params * 2);
+    stack -= stack_params;
   }
 
-  if (params != 0)
-  {
-    reg -= params;
-  }
+  reg -= reg_params;
 
   if (!is_void)
   {
-    // Put r15 on the top of the stack
+    // Put w0 on the top of the stack
     if (reg < reg_max)
     {
-      fprintf(out, "  mov.w w0, w%d\n", REG_STACK(reg));
+      emit("  mov.w w0, w%d\n", REG_STACK(reg));
       reg++;
     }
       else
     {
-      // REVIEW - This looks wrong
-      fprintf(out, "  push w0\n");
+      emit("  push w0\n");
       stack++;
+      spill_count++;
     }
   }
 
@@ -603,6 +859,117 @@ int DSPIC::brk()
   return -1;
 }
 
+// do runs the body count + 1 times.  Where it goes back from is the
+// label loop_end() puts on the last instruction of the body.
+int DSPIC::loop_start(const char *end_label, int count)
+{
+  loop_label = label_count++;
+  loop_instr = instr_count;
+  emit("  do #%d, label_%d\n", count - 1, loop_label);
+
+  return 0;
+}
+
+int DSPIC::loop_start(const char *end_label)
+{
+char count[8];
+
+  pop_reg(count);
+
+  emit("  cp0 %s\n", count);
+  emit("  bra le, %s\n", end_label);
+  emit("  dec %s, w0\n", count);
+
+  loop_label = label_count++;
+  loop_instr = instr_count;
+  emit("  do w0, label_%d\n", loop_label);
+
+  return 0;
+}
+
+// A body of one instruction is run with repeat instead.  Otherwise the
+// last instruction gets the label the do goes back from, with a nop added
+// if the body ends in a label or something that can't end a loop.
+int DSPIC::loop_end()
+{
+machine_instr_t label;
+bool has_label = false;
+char *s;
+int count = 0;
+int last = -1;
+int n;
+
+  for (n = loop_instr + 1; n < instr_count; n++)
+  {
+    if (instrs[n].type == MACHINE_INSTR) { count++; last = n; }
+    if (instrs[n].type == MACHINE_LABEL) { has_label = true; }
+  }
+
+  // An empty loop is a delay so it's kept as a repeated nop
+  if (last == -1)
+  {
+    emit("  nop\n");
+    last = instr_count - 1;
+    count = 1;
+  }
+
+  if (count == 1 && !has_label && can_end_loop(last))
+  {
+    strcpy(instrs[loop_instr].opcode, "repeat");
+    s = strchr(instrs[loop_instr].operands, ',');
+    if (s != NULL) { *s = 0; }
+
+    return 0;
+  }
+
+  if (last != instr_count - 1 || !can_end_loop(last))
+  {
+    emit("  nop\n");
+    last = instr_count - 1;
+  }
+
+  emit("label_%d:\n", loop_label);
+
+  // Move the label in front of the last instruction
+  label = instrs[instr_count - 1];
+  memmove(&instrs[last + 1], &instrs[last], (instr_count - 1 - last) * sizeof(machine_instr_t));
+  instrs[last] = label;
+
+  return 0;
+}
+
+// Instructions that can't be the last one of a do loop or be repeated.
+// Branches and skips are found with get_branch().
+static const char *no_loop_end[] =
+{
+  "call", "rcall", "repeat", "disi", "lnk", "ulnk", "pwrsav", "reset", NULL
+};
+
+bool DSPIC::can_end_loop(int index)
+{
+machine_instr_t *instr = &instrs[index];
+const char *label;
+int n;
+
+  if (get_branch(instr, &label) != BRANCH_NONE) { return false; }
+
+  for (n = 0; no_loop_end[n] != NULL; n++)
+  {
+    if (strcmp(instr->opcode, no_loop_end[n]) == 0) { return false; }
+  }
+
+  // The instruction a repeat runs can't be the end of a loop either
+  for (n = index - 1; n > loop_instr; n--)
+  {
+    if (instrs[n].type == MACHINE_INSTR)
+    {
+      return strcmp(instrs[n].opcode, "repeat") != 0;
+    }
+  }
+
+  return true;
+}
+
 #if 0
 void DSPIC::close()
 {
@@ -625,12 +992,12 @@ int DSPIC::ioport_setPinsAsInput(int port, int const_val)
   int pin = get_pin_number(const_val);
   if (pin == -1)
   {
-    fprintf(out, "  mov #0x%04x, w0\n", const_val);
-    fprintf(out, "  ior %s\n", periph);
+    emit("  mov #0x%04x, w0\n", const_val);
+    emit("  ior %s\n", periph);
     return 0;
   }
 
-  fprintf(out, "  bset %s, #%d\n", periph, pin);
+  emit("  bset %s, #%d\n", periph, pin);
 
   return 0;
 }
@@ -650,12 +1017,12 @@ int DSPIC::ioport_setPinsAsOutput(int port, int const_val)
   int pin = get_pin_number(const_val);
   if (pin == -1)
   {
-    fprintf(out, "  mov #0x%04x, w0\n", const_val^0xffff);
-    fprintf(out, "  and %s\n", periph);
+    emit("  mov #0x%04x, w0\n", const_val^0xffff);
+    emit("  and %s\n", periph);
     return 0;
   }
 
-  fprintf(out, "  bclr %s, #%d\n", periph, pin);
+  emit("  bclr %s, #%d\n", periph, pin);
 
   return 0;
 }
@@ -667,13 +1034,13 @@ int DSPIC::ioport_setPinsValue(int port)
 
   if (stack == 0)
   {
-    fprintf(out, "  mov w%d, %s\n", REG_STACK(reg-1), periph);
+    emit("  mov w%d, %s\n", REG_STACK(reg-1), periph);
     reg--;
   }
     else
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov %s\n", periph);
+    emit("  pop w0\n");
+    emit("  mov %s\n", periph);
     stack--;
   }
 
@@ -695,12 +1062,12 @@ int DSPIC::ioport_setPinsHigh(int port, int const_val)
   int pin = get_pin_number(const_val);
   if (pin == -1)
   {
-    fprintf(out, "  mov #0x%04x, w0\n", const_val);
-    fprintf(out, "  ior %s\n", periph);
+    emit("  mov #0x%04x, w0\n", const_val);
+    emit("  ior %s\n", periph);
     return 0;
   }
 
-  fprintf(out, "  bset %s, #%d\n", periph, pin);
+  emit("  bset %s, #%d\n", periph, pin);
 
   return 0;
 }
@@ -720,12 +1087,12 @@ int DSPIC::ioport_setPinsLow(int port, int const_val)
   int pin = get_pin_number(const_val);
   if (pin == -1)
   {
-    fprintf(out, "  mov #0x%04x, w0\n", const_val^0xffff);
-    fprintf(out, "  and %s\n", periph);
+    emit("  mov #0x%04x, w0\n", const_val^0xffff);
+    emit("  and %s\n", periph);
     return 0;
   }
 
-  fprintf(out, "  bclr %s, #%d\n", periph, pin);
+  emit("  bclr %s, #%d\n", periph, pin);
 
   return 0;
 }
@@ -738,7 +1105,7 @@ int DSPIC::ioport_setPinAsOutput(int port)
 int DSPIC::ioport_setPinAsOutput(int port, int const_val)
 {
   if (const_val < 0 || const_val > 15) { return -1; }
-  fprintf(out, "  bclr TRIS%c, #%d\n", port+'A', const_val);
+  emit("  bclr TRIS%c, #%d\n", port+'A', const_val);
   return 0;
 }
 
@@ -750,7 +1117,7 @@ int DSPIC::ioport_setPinAsInput(int port)
 int DSPIC::ioport_setPinAsInput(int port, int const_val)
 {
   if (const_val < 0 || const_val > 15) { return -1; }
-  fprintf(out, "  bset TRIS%c, #%d\n", port+'A', const_val);
+  emit("  bset TRIS%c, #%d\n", port+'A', const_val);
   return 0;
 }
 
@@ -762,7 +1129,7 @@ int DSPIC::ioport_setPinHigh(int port)
 int DSPIC::ioport_setPinHigh(int port, int const_val)
 {
   if (const_val < 0 || const_val > 15) { return -1; }
-  fprintf(out, "  bset LAT%c, #%d\n", port+'A', const_val);
+  emit("  bset LAT%c, #%d\n", port+'A', const_val);
   return 0;
 }
 
@@ -774,7 +1141,7 @@ int DSPIC::ioport_setPinLow(int port)
 int DSPIC::ioport_setPinLow(int port, int const_val)
 {
   if (const_val < 0 || const_val > 15) { return -1; }
-  fprintf(out, "  bclr LAT%c, #%d\n", port+'A', const_val);
+  emit("  bclr LAT%c, #%d\n", port+'A', const_val);
   return 0;
 }
 
@@ -795,66 +1162,66 @@ char dst[16];
 
   if (port != 0) { return -1; }
 
-  fprintf(out, "  ;; Set up SPI\n");
+  emit("  ;; Set up SPI\n");
   // This chip needs the RP pins set.
   if (chip_type == DSPIC33FJ06GS101A)
   {
-    fprintf(out, "  ; SDI is on RP2\n");
-    fprintf(out, "  mov #SDI1R2, w0\n");
-    fprintf(out, "  mov w0, RPINR20\n");
+    emit("  ; SDI is on RP2\n");
+    emit("  mov #SDI1R2, w0\n");
+    emit("  mov w0, RPINR20\n");
 
-    fprintf(out, "  ; SDO is on RP3\n");
-    fprintf(out, "  mov #(0x7<<8), w0\n");
-    fprintf(out, "  mov w0, RPOR1     ; controls RP2, RP3\n");
+    emit("  ; SDO is on RP3\n");
+    emit("  mov #(0x7<<8), w0\n");
+    emit("  mov w0, RPOR1     ; controls RP2, RP3\n");
 
-    fprintf(out, "  ; SCLK is on RP1\n");
-    fprintf(out, "  mov #(0x8<<8), w0\n");
-    fprintf(out, "  mov w0, RPOR0     ; controls RP0, RP1\n");
+    emit("  ; SCLK is on RP1\n");
+    emit("  mov #(0x8<<8), w0\n");
+    emit("  mov w0, RPOR0     ; controls RP0, RP1\n");
   }
 
-  fprintf(out, "  mov #(1<<MSTEN), w0\n");
-  fprintf(out, "  mov w0, SPI1CON1\n");
+  emit("  mov #(1<<MSTEN), w0\n");
+  emit("  mov w0, SPI1CON1\n");
   pop_reg(dst);
   if (strcmp(dst, "w0") == 0)
   {
-    fprintf(out, "  mov w0, w13\n");
+    emit("  mov w0, w13\n");
     strcpy(dst, "w13");
   }
     else
   {
-    fprintf(out, "  mov %s, w0\n", dst);
+    emit("  mov %s, w0\n", dst);
   }
-  fprintf(out, "  and #2, w0\n");
-  fprintf(out, "  sl w0, #5, w0\n");
-  fprintf(out, "  and #1, %s\n", dst);
-  fprintf(out, "  sl %s, #8, %s\n", dst, dst);
-  fprintf(out, "  ior %s, w0, w0\n", dst);
-  fprintf(out, "  sl %s, #1, %s\n", dst, dst);
-  fprintf(out, "  ior %s, w0, w0\n", dst);
-  fprintf(out, "  ior SPI1CON1\n");
+  emit("  and #2, w0\n");
+  emit("  sl w0, #5, w0\n");
+  emit("  and #1, %s\n", dst);
+  emit("  sl %s, #8, %s\n", dst, dst);
+  emit("  ior %s, w0, w0\n", dst);
+  emit("  sl %s, #1, %s\n", dst, dst);
+  emit("  ior %s, w0, w0\n", dst);
+  emit("  ior SPI1CON1\n");
 
   pop_reg(dst);
-  fprintf(out, "  ; primary_prescale=(div>>1)&0x3\n");
-  fprintf(out, "  ; secondary_prescale=((div&1)&0x7)<<2)\n");
+  emit("  ; primary_prescale=(div>>1)&0x3\n");
+  emit("  ; secondary_prescale=((div&1)&0x7)<<2)\n");
   if (strcmp(dst, "w0") == 0)
   {
-    fprintf(out, "  mov w0, w13\n");
+    emit("  mov w0, w13\n");
     strcpy(dst, "w13");
   }
     else
   {
-    fprintf(out, "  mov %s, w0\n", dst);
+    emit("  mov %s, w0\n", dst);
   }
-  fprintf(out, "  asr w0, #1, w0\n");
-  fprintf(out, "  xor #3, w0\n");
-  fprintf(out, "  and #1, %s\n", dst);
-  fprintf(out, "  xor #7, %s\n", dst);
-  fprintf(out, "  sl %s, #2, %s\n", dst, dst);
-  fprintf(out, "  ior %s, w0, w0\n", dst);
-  fprintf(out, "  ior SPI1CON1\n");
+  emit("  asr w0, #1, w0\n");
+  emit("  xor #3, w0\n");
+  emit("  and #1, %s\n", dst);
+  emit("  xor #7, %s\n", dst);
+  emit("  sl %s, #2, %s\n", dst, dst);
+  emit("  ior %s, w0, w0\n", dst);
+  emit("  ior SPI1CON1\n");
 
-  fprintf(out, "  mov #(1<<SPIEN), w0\n");
-  fprintf(out, "  ior SPI1STAT\n");
+  emit("  mov #(1<<SPIEN), w0\n");
+  emit("  ior SPI1STAT\n");
 
   return 0;
 }
@@ -864,29 +1231,29 @@ int DSPIC::spi_init(int port, int clock_divisor, int mode)
   int spre = (clock_divisor & 1) ^ 0x7;
   int ppre = (clock_divisor >> 1) ^ 0x3;
 
-  fprintf(out, "  ;; Set up SPI\n");
+  emit("  ;; Set up SPI\n");
   // This chip needs the RP pins set.
   if (chip_type == DSPIC33FJ06GS101A)
   {
-    fprintf(out, "  ; SDI is on RP2\n");
-    fprintf(out, "  mov #SDI1R2, w0\n");
-    fprintf(out, "  mov w0, RPINR20\n");
+    emit("  ; SDI is on RP2\n");
+    emit("  mov #SDI1R2, w0\n");
+    emit("  mov w0, RPINR20\n");
 
-    fprintf(out, "  ; SDO is on RP3\n");
-    fprintf(out, "  mov #(0x7<<8), w0\n");
-    fprintf(out, "  mov w0, RPOR1     ; controls RP2, RP3\n");
+    emit("  ; SDO is on RP3\n");
+    emit("  mov #(0x7<<8), w0\n");
+    emit("  mov w0, RPOR1     ; controls RP2, RP3\n");
 
-    fprintf(out, "  ; SCLK is on RP1\n");
-    fprintf(out, "  mov #(0x8<<8), w0\n");
-    fprintf(out, "  mov w0, RPOR0     ; controls RP0, RP1\n");
+    emit("  ; SCLK is on RP1\n");
+    emit("  mov #(0x8<<8), w0\n");
+    emit("  mov w0, RPOR0     ; controls RP0, RP1\n");
   }
-  fprintf(out, "  mov #(1<<MSTEN)|%s%s(%d<<2)|(%d), w0\n",
+  emit("  mov #(1<<MSTEN)|%s%s(%d<<2)|(%d), w0\n",
     (mode & 2) == 0 ? "":"(1<<CKP)|",
     (mode &1) == 0 ? "" : "(1<<CKE)|",
     spre, ppre);
-  fprintf(out, "  mov w0, SPI1CON1\n");
-  fprintf(out, "  mov #(1<<SPIEN), w0\n");
-  fprintf(out, "  mov w0, SPI1STAT\n\n");
+  emit("  mov w0, SPI1CON1\n");
+  emit("  mov #(1<<SPIEN), w0\n");
+  emit("  mov w0, SPI1STAT\n\n");
 
   return 0;
 }
@@ -894,24 +1261,33 @@ int DSPIC::spi_init(int port, int clock_divisor, int mode)
 int DSPIC::spi_send(int port)
 {
 char dst[16];
+int label;
 
   pop_reg(dst);
-  fprintf(out, "  mov %s, SPI1BUF\n", dst);
+  emit("  mov %s, SPI1BUF\n", dst);
 
-  return 0;
+  // send() returns the byte shifted in so wait for it
+  label = label_count++;
+  emit("label_%d:\n", label);
+  emit("  mov SPI1STAT, w0\n");
+  emit("  and #(1<<SPIRBF), w0\n");
+  emit("  bra z, label_%d\n", label);
+
+  return spi_read(port);
 }
 
 int DSPIC::spi_read(int port)
 {
   if (reg < reg_max)
   {
-    fprintf(out, "  mov SPI1BUF, w%d\n", REG_STACK(reg));
+    emit("  mov SPI1BUF, w%d\n", REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  push SPI1BUF\n");
+    emit("  push SPI1BUF\n");
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -921,16 +1297,17 @@ int DSPIC::spi_isDataAvailable(int port)
 {
   if (reg < reg_max)
   {
-    fprintf(out, "  mov SPI1STAT, w%d\n", REG_STACK(reg));
-    fprintf(out, "  and #(1<<SPIRBF), w%d\n", REG_STACK(reg));
+    emit("  mov SPI1STAT, w%d\n", REG_STACK(reg));
+    emit("  and #(1<<SPIRBF), w%d\n", REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  mov SPI1STAT, w0\n");
-    fprintf(out, "  and #(1<<SPIRBF), w0\n");
-    fprintf(out, "  push w0\n");
+    emit("  mov SPI1STAT, w0\n");
+    emit("  and #(1<<SPIRBF), w0\n");
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -940,16 +1317,17 @@ int DSPIC::spi_isBusy(int port)
 {
   if (reg < reg_max)
   {
-    fprintf(out, "  mov SPI1STAT, w%d\n", REG_STACK(reg));
-    fprintf(out, "  and #(1<<SPITBF), w%d\n", REG_STACK(reg));
+    emit("  mov SPI1STAT, w%d\n", REG_STACK(reg));
+    emit("  and #(1<<SPITBF), w%d\n", REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  mov SPI1STAT, w0\n");
-    fprintf(out, "  and #(1<<SPITBF), w0\n");
-    fprintf(out, "  push w0\n");
+    emit("  mov SPI1STAT, w0\n");
+    emit("  and #(1<<SPITBF), w0\n");
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -957,13 +1335,13 @@ int DSPIC::spi_isBusy(int port)
 
 int DSPIC::spi_disable(int port)
 {
-  fprintf(out, "  bclr SPI1STAT, #SPIEN\n");
+  emit("  bclr SPI1STAT, #SPIEN\n");
   return 0;
 }
 
 int DSPIC::spi_enable(int port)
 {
-  fprintf(out, "  bset SPI1STAT, #SPIEN\n");
+  emit("  bset SPI1STAT, #SPIEN\n");
   return 0;
 }
 
@@ -975,7 +1353,7 @@ int DSPIC::cpu_setClock16()
 
 int DSPIC::cpu_nop()
 {
-  fprintf(out, "  nop\n");
+  emit("  nop\n");
   return 0;
 }
 
@@ -985,13 +1363,13 @@ int DSPIC::memory_read8()
 {
   if (stack != 0)
   {
-    fprintf(out, "  mov.w [SP-2], w0\n");
-    fprintf(out, "  mov.b [w0], w0\n");
-    fprintf(out, "  mov.b w0, [SP-2]\n");
+    emit("  mov.w [SP-2], w0\n");
+    emit("  mov.b [w0], w0\n");
+    emit("  mov.b w0, [SP-2]\n");
   }
     else
   {
-    fprintf(out, "  mov.b [w%d], w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  mov.b [w%d], w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
   }
 
   return 0;
@@ -1001,24 +1379,25 @@ int DSPIC::memory_write8()
 {
   if (stack >= 2)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov.w [SP-2], w13\n");
-    fprintf(out, "  mov.b w0, [w13]\n");
-    stack--;
+    emit("  pop w0\n");
+    emit("  pop w13\n");
+    emit("  mov.b w0, [w13]\n");
+    stack -= 2;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov.b w0, [w%d]\n", REG_STACK(reg-1));
+    emit("  pop w0\n");
+    emit("  mov.b w0, [w%d]\n", REG_STACK(reg-1));
+    reg--;
     stack--;
   }
     else
   {
-    //fprintf(out, "  mov.b w%d, w0\n", REG_STACK(reg-1));
-    //fprintf(out, "  mov.b w0, [w%d]\n", REG_STACK(reg-2));
-    fprintf(out, "  mov.b w%d, [w%d]\n", REG_STACK(reg-1), REG_STACK(reg-2));
-    reg--;
+    //emit("  mov.b w%d, w0\n", REG_STACK(reg-1));
+    //emit("  mov.b w0, [w%d]\n", REG_STACK(reg-2));
+    emit("  mov.b w%d, [w%d]\n", REG_STACK(reg-1), REG_STACK(reg-2));
+    reg -= 2;
   }
 
   return 0;
@@ -1028,13 +1407,13 @@ int DSPIC::memory_read16()
 {
   if (stack != 0)
   {
-    fprintf(out, "  mov.w [SP-2], w0\n");
-    fprintf(out, "  mov.w [w0], w0\n");
-    fprintf(out, "  mov.w w0, [SP-2]\n");
+    emit("  mov.w [SP-2], w0\n");
+    emit("  mov.w [w0], w0\n");
+    emit("  mov.w w0, [SP-2]\n");
   }
     else
   {
-    fprintf(out, "  mov.w [w%d], w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  mov.w [w%d], w%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
   }
 
   return 0;
@@ -1044,29 +1423,45 @@ int DSPIC::memory_write16()
 {
   if (stack >= 2)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov.w [SP-2], w13\n");
-    fprintf(out, "  mov.w w0, [w13]\n");
-    stack--;
+    emit("  pop w0\n");
+    emit("  pop w13\n");
+    emit("  mov.w w0, [w13]\n");
+    stack -= 2;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  mov.w w0, [w%d]\n", REG_STACK(reg-1));
+    emit("  pop w0\n");
+    emit("  mov.w w0, [w%d]\n", REG_STACK(reg-1));
+    reg--;
     stack--;
   }
     else
   {
-    //fprintf(out, "  mov.w w%d, w0\n", REG_STACK(reg-1));
-    //fprintf(out, "  mov.w w0, [w%d]\n", REG_STACK(reg-2));
-    fprintf(out, "  mov.w w%d, [w%d]\n", REG_STACK(reg-1), REG_STACK(reg-2));
-    reg--;
+    //emit("  mov.w w%d, w0\n", REG_STACK(reg-1));
+    //emit("  mov.w w0, [w%d]\n", REG_STACK(reg-2));
+    emit("  mov.w w%d, [w%d]\n", REG_STACK(reg-1), REG_STACK(reg-2));
+    reg -= 2;
   }
 
   return 0;
 }
 
+int DSPIC::math_abs()
+{
+  return stack_superopt("abs", 0);
+}
+
+int DSPIC::math_min()
+{
+  return stack_superopt_binary("min");
+}
+
+int DSPIC::math_max()
+{
+  return stack_superopt_binary("max");
+}
+
 // DSP (dsPIC stuff)
 int DSPIC::dsp_getA()
 {
@@ -1110,13 +1505,13 @@ int DSPIC::dsp_getRoundedB()
 
 int DSPIC::dsp_clearA()
 {
-  fprintf(out, "  clr A\n");
+  emit("  clr A\n");
   return 0;
 }
 
 int DSPIC::dsp_clearB()
 {
-  fprintf(out, "  clr B\n");
+  emit("  clr B\n");
   return 0;
 }
 
@@ -1125,7 +1520,7 @@ int DSPIC::dsp_loadA()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  lac %s, A\n", dst);
+  emit("  lac %s, A\n", dst);
   return 0;
 }
 
@@ -1134,43 +1529,43 @@ int DSPIC::dsp_loadB()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  lac %s, B\n", dst);
+  emit("  lac %s, B\n", dst);
   return 0;
 }
 
 int DSPIC::dsp_negA()
 {
-  fprintf(out, "  neg A\n");
+  emit("  neg A\n");
   return 0;
 }
 
 int DSPIC::dsp_negB()
 {
-  fprintf(out, "  neg B\n");
+  emit("  neg B\n");
   return 0;
 }
 
 int DSPIC::dsp_addABAndStoreInA()
 {
-  fprintf(out, "  add A\n");
+  emit("  add A\n");
   return 0;
 }
 
 int DSPIC::dsp_addABAndStoreInB()
 {
-  fprintf(out, "  add B\n");
+  emit("  add B\n");
   return 0;
 }
 
 int DSPIC::dsp_subABAndStoreInA()
 {
-  fprintf(out, "  sub A\n");
+  emit("  sub A\n");
   return 0;
 }
 
 int DSPIC::dsp_subBAAndStoreInB()
 {
-  fprintf(out, "  sub B\n");
+  emit("  sub B\n");
   return 0;
 }
 
@@ -1179,7 +1574,7 @@ int DSPIC::dsp_addToA()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  add %s, A\n", dst);
+  emit("  add %s, A\n", dst);
   return 0;
 }
 
@@ -1188,7 +1583,7 @@ int DSPIC::dsp_addToB()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  add %s, B\n", dst);
+  emit("  add %s, B\n", dst);
   return 0;
 }
 
@@ -1271,7 +1666,7 @@ int DSPIC::dsp_shiftA()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  sftac A, %s\n", dst);
+  emit("  sftac A, %s\n", dst);
   return 0;
 }
 
@@ -1280,7 +1675,7 @@ int DSPIC::dsp_shiftB()
 char dst[16];
 
   pop_reg(dst);
-  fprintf(out, "  sftac B, %s\n", dst);
+  emit("  sftac B, %s\n", dst);
   return 0;
 }
 
@@ -1301,15 +1696,15 @@ int reg_num2 = reg > 1 ? (REG_STACK(reg-2)) : -1;
   if (stack == 0 && reg_num1 == 4 && reg_num2 == 5)
   {
     reg -= 2;
-    fprintf(out, "  %s w%d*w%d, %s\n", instr, reg_num1, reg_num2, accum);
+    emit("  %s w%d*w%d, %s\n", instr, reg_num1, reg_num2, accum);
   }
     else
   {
     pop_reg(dst);
-    fprintf(out, "  mov %s, w7\n", dst);
+    emit("  mov %s, w7\n", dst);
     pop_reg(dst);
-    fprintf(out, "  mov %s, w6\n", dst);
-    fprintf(out, "  %s w6*w7, %s\n", instr, accum);
+    emit("  mov %s, w6\n", dst);
+    emit("  %s w6*w7, %s\n", instr, accum);
   }
 
   return 0;
@@ -1323,13 +1718,13 @@ int reg_num = reg > 0 ? (REG_STACK(reg-1)) : -1;
   if (stack > 0 || reg == -1)
   {
     pop_reg(dst);
-    fprintf(out, "  mov %s, w7\n", dst);
-    fprintf(out, "  %s w7*w7, %s\n", instr, accum);
+    emit("  mov %s, w7\n", dst);
+    emit("  %s w7*w7, %s\n", instr, accum);
   }
     else
   {
     reg--;
-    fprintf(out, "  %s w%d*w%d, %s\n", instr, reg_num, reg_num, accum);
+    emit("  %s w%d*w%d, %s\n", instr, reg_num, reg_num, accum);
   }
 
   return 0;
@@ -1344,25 +1739,175 @@ char shift_str[32];
 
   if (reg < reg_max)
   {
-    fprintf(out, "  %s %s, %sw%d\n", instr, accum, shift_str, REG_STACK(reg));
+    emit("  %s %s, %sw%d\n", instr, accum, shift_str, REG_STACK(reg));
     reg++;
   }
     else
   {
-    fprintf(out, "  %s %s, %sw0\n", instr, accum, shift_str);
-    fprintf(out, "  push w0\n");
+    emit("  %s %s, %sw0\n", instr, accum, shift_str);
+    emit("  push w0\n");
     stack++;
+    spill_count++;
+  }
+
+  return 0;
+}
+
+// Registers a method can change before counting what it calls.  Only
+// the register stack and params matter since the temps (w0, w1, w6,
+// w7, w13) never hold anything across a call.
+uint32_t DSPIC::get_method_clobber(call_graph_node_t *node)
+{
+uint32_t clobber = (1 << 0) | (1 << 1) | (1 << 6) | (1 << 7) | (1 << 13);
+int params;
+int n, i;
+
+  for (n = 0; n < node->max_stack + node->int32_stack && n < reg_max; n++)
+  {
+    clobber |= 1 << REG_STACK(n);
+  }
+
+  for (n = 0; n < node->params && n < (int)sizeof(arg_regs); n++)
+  {
+    if ((node->stored_locals & (1 << n)) != 0) { clobber |= 1 << arg_regs[n]; }
+  }
+
+  for (i = 0; i < node->callee_count; i++)
+  {
+    params = call_graph->get_node(node->callees[i])->params;
+
+    for (n = 0; n < params && n < (int)sizeof(arg_regs); n++)
+    {
+      clobber |= 1 << arg_regs[n];
+    }
+  }
+
+  return clobber;
+}
+
+int DSPIC::get_frame_size(call_graph_node_t *node)
+{
+int size = node->max_locals + node->int32_locals;
+
+  // The first params stay in their registers
+  if (node->params < (int)sizeof(arg_regs)) { size -= node->params; }
+  else { size -= sizeof(arg_regs); }
+
+  return size < 0 ? 0 : size * 2;
+}
+
+// Bytes a method can push with static frames: its 2 word return address
+// and every stack value and register param saved or spilled at once.
+int DSPIC::get_stack_size(call_graph_node_t *node)
+{
+  return 4 + (node->max_stack + node->int32_stack + (int)sizeof(arg_regs)) * 2;
+}
+
+// The stack grows up from the start of RAM so frames go at the end.  w14
+// isn't needed to find them so it becomes the 7th register of the stack.
+int DSPIC::init_static_frames(int size)
+{
+int depth = call_graph->get_stack_depth();
+
+  if (size + depth > ram_end - 0x800)
+  {
+    printf("Static frames need %d bytes and the stack %d but there are only %d bytes of RAM.\n",
+      size, depth, ram_end - 0x800);
+    return -1;
   }
 
+  frame_size = size;
+  reg_max = sizeof(stack_regs);
+
   return 0;
 }
 
+// Tears down the frame before a return.  place_frame() drops it on paths
+// that never set the frame up.
+void DSPIC::frame_end()
+{
+int start = instr_count;
+
+  // Without a frame pointer spills are thrown away by hand
+  if (static_frames)
+  {
+    if (stack > 0) { emit("  sub #%d, SP\n", stack * 2); }
+    return;
+  }
+
+  if (is_main) { return; }
+
+  emit("  ulnk\n");
+  mark_epilogue(start);
+}
+
+int DSPIC::get_branch(machine_instr_t *instr, const char **label)
+{
+const char *s;
+
+  *label = instr->operands;
+
+  if (strncmp(instr->opcode, "ret", 3) == 0) { return BRANCH_RETURN; }
+
+  if (strcmp(instr->opcode, "bra") == 0 || strcmp(instr->opcode, "goto") == 0)
+  {
+    // bra cond, label or a computed jump through a register
+    s = strchr(instr->operands, ',');
+
+    if (s == NULL)
+    {
+      if (instr->operands[0] == 'w') { return BRANCH_UNKNOWN; }
+      return BRANCH_ALWAYS;
+    }
+
+    while (*(++s) == ' ');
+    *label = s;
+
+    return BRANCH_COND;
+  }
+
+  // Skips and hardware loops change the flow in ways blocks can't show
+  if (strncmp(instr->opcode, "cps", 3) == 0 ||
+      strncmp(instr->opcode, "bts", 3) == 0 ||
+      strncmp(instr->opcode, "do", 2) == 0)
+  {
+    return BRANCH_UNKNOWN;
+  }
+
+  return BRANCH_NONE;
+}
+
+bool DSPIC::uses_frame(machine_instr_t *instr)
+{
+  return strstr(instr->operands, "w14") != NULL;
+}
+
+// Operand for local variable index: a parameter register or the frame
+void DSPIC::get_local(char *operand, int index)
+{
+  if (index < arg_count)
+  {
+    sprintf(operand, "w%d", arg_regs[index]);
+  }
+    else
+  {
+    if (static_frames)
+    {
+      sprintf(operand, "0x%04x", frame_base + (index - arg_count) * 2);
+    }
+      else
+    {
+      sprintf(operand, "[w14+%d]", LOCALS(index - arg_count));
+    }
+  }
+}
+
 void DSPIC::pop_reg(char *dst)
 {
   if (stack > 0)
   {
     stack--;
-    fprintf(out, "  pop w0\n");
+    emit("  pop w0\n");
     sprintf(dst, "w0");
   }
     else
@@ -1372,13 +1917,67 @@ void DSPIC::pop_reg(char *dst)
   }
 }
 
+// Pops a 32 bit int.  Spilled words come back in the temp registers,
+// a word in a stack register is used where it is.
+void DSPIC::pop_reg_32(char *lo, char *hi, const char *temp_lo, const char *temp_hi)
+{
+  if (stack > 0)
+  {
+    stack--;
+    emit("  pop %s\n", temp_hi);
+    strcpy(hi, temp_hi);
+  }
+    else
+  {
+    reg--;
+    sprintf(hi, "w%d", REG_STACK(reg));
+  }
+
+  if (stack > 0)
+  {
+    stack--;
+    emit("  pop %s\n", temp_lo);
+    strcpy(lo, temp_lo);
+  }
+    else
+  {
+    reg--;
+    sprintf(lo, "w%d", REG_STACK(reg));
+  }
+}
+
+// Puts back a 32 bit int from pop_reg_32() where it was
+void DSPIC::push_reg_32(const char *lo, const char *hi)
+{
+  if (strcmp(lo, "w6") == 0)
+  {
+    emit("  push w6\n");
+    stack++;
+  }
+    else
+  {
+    reg++;
+  }
+
+  if (strcmp(hi, "w7") == 0)
+  {
+    emit("  push w7\n");
+    stack++;
+  }
+    else
+  {
+    reg++;
+  }
+}
+
 #if 0
 void DSPIC::push_w0()
 {
   if (stack > 0)
   {
-    fprintf(out, "  push w0\n");
+    emit("  push w0\n");
     stack++;
+    spill_count++;
   }
     else
   {
@@ -1392,17 +1991,82 @@ int DSPIC::set_periph(const char *instr, const char *periph, bool reverse)
 {
   if (stack == 0)
   {
-    fprintf(out, "  mov w%d, w0\n", REG_STACK(reg-1));
+    emit("  mov w%d, w0\n", REG_STACK(reg-1));
     reg--;
   }
     else
   {
-    fprintf(out, "  pop w0\n");
+    emit("  pop w0\n");
     stack--;
   }
 
-  if (reverse) { fprintf(out, "  xor #0xff, w0\n"); }
-  fprintf(out, "  %s %s\n", instr, periph);
+  if (reverse) { emit("  xor #0xff, w0\n"); }
+  emit("  %s %s\n", instr, periph);
+
+  return 0;
+}
+
+// Replace the top of the stack with a sequence from the superoptimizer
+// table.  w13 is the scratch register the sequence can use.
+int DSPIC::stack_superopt(const char *idiom, int const_val)
+{
+superopt_t *entry;
+char value[16];
+
+  entry = find_superopt(table_superopt_dspic, idiom, const_val);
+  if (entry == NULL) { return -1; }
+
+  if (entry->count == 0) { return 0; }
+
+  if (stack > 0)
+  {
+    emit("  mov.w [SP-2], w0\n");
+    write_superopt(entry, "w0", "w13");
+    emit("  mov.w w0, [SP-2]\n");
+  }
+    else
+  {
+    sprintf(value, "w%d", REG_STACK(reg-1));
+    write_superopt(entry, value, "w13");
+  }
+
+  return 0;
+}
+
+// Same for min and max.  The top of the stack is %t and the value under
+// it is %r.
+int DSPIC::stack_superopt_binary(const char *idiom)
+{
+superopt_t *entry;
+char value[16];
+char temp[16];
+
+  entry = find_superopt(table_superopt_dspic, idiom, 0);
+  if (entry == NULL) { return -1; }
+
+  if (stack == 0)
+  {
+    sprintf(value, "w%d", REG_STACK(reg-2));
+    sprintf(temp, "w%d", REG_STACK(reg-1));
+    write_superopt(entry, value, temp);
+    reg--;
+  }
+    else
+  if (stack == 1)
+  {
+    emit("  pop w13\n");
+    sprintf(value, "w%d", REG_STACK(reg-1));
+    write_superopt(entry, value, "w13");
+    stack--;
+  }
+    else
+  {
+    emit("  pop w13\n");
+    emit("  mov.w [SP-2], w0\n");
+    write_superopt(entry, "w0", "w13");
+    emit("  mov.w w0, [SP-2]\n");
+    stack--;
+  }
 
   return 0;
 }
@@ -1411,48 +2075,71 @@ int DSPIC::stack_alu(const char *instr)
 {
   if (stack == 0)
   {
-    fprintf(out, "  %s.w w%d, w%d, w%d\n", instr, REG_STACK(reg-2), REG_STACK(reg-1), REG_STACK(reg-2));
+    emit("  %s.w w%d, w%d, w%d\n", instr, REG_STACK(reg-2), REG_STACK(reg-1), REG_STACK(reg-2));
     reg--;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  %s.w w%d, w0, w%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  pop w0\n");
+    emit("  %s.w w%d, w0, w%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-1));
     stack--;
   }
     else
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  pop w1\n");
-    fprintf(out, "  %s.w w1, w0, w0\n", instr);
-    fprintf(out, "  push w0\n");
+    emit("  pop w0\n");
+    emit("  pop w1\n");
+    emit("  %s.w w1, w0, w0\n", instr);
+    emit("  push w0\n");
+    stack--;
   }
 
   return 0;
 }
 
+// The top 2 stack values are a 32 bit int (high word on top) that gets
+// added to or subtracted from the 32 bit int under it.
+int DSPIC::stack_alu_32(const char *instr, const char *instr_carry)
+{
+char lo[8];
+char hi[8];
+char value_lo[8];
+char value_hi[8];
+
+  pop_reg_32(lo, hi, "w0", "w1");
+  pop_reg_32(value_lo, value_hi, "w6", "w7");
+
+  emit("  %s.w %s, %s, %s\n", instr, value_lo, lo, value_lo);
+  emit("  %s.w %s, %s, %s\n", instr_carry, value_hi, hi, value_hi);
+
+  push_reg_32(value_lo, value_hi);
+
+  return 0;
+}
+
 int DSPIC::stack_alu_div()
 {
   if (stack == 0)
   {
-    fprintf(out, "  repeat #17\n");
-    fprintf(out, "  div.s w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
+    emit("  repeat #17\n");
+    emit("  div.s w%d, w%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
     reg--;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  repeat #17\n");
-    fprintf(out, "  div.s w%d, w0\n", REG_STACK(reg-1));
+    emit("  pop w0\n");
+    emit("  repeat #17\n");
+    emit("  div.s w%d, w0\n", REG_STACK(reg-1));
     stack--;
   }
     else
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  repeat #17\n");
-    fprintf(out, "  div.s w0, [SP-2]\n");
+    emit("  pop w0\n");
+    emit("  mov [SP-2], w13\n");
+    emit("  repeat #17\n");
+    emit("  div.s w13, w0\n");
+    stack--;
   }
 
   return 0;
@@ -1462,23 +2149,23 @@ int DSPIC::stack_shift(const char *instr)
 {
   if (stack >= 2)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  pop w13\n");
-    fprintf(out, "  %s w13, w0, w13\n", instr);
-    fprintf(out, "  push w13\n");
+    emit("  pop w0\n");
+    emit("  pop w13\n");
+    emit("  %s w13, w0, w13\n", instr);
+    emit("  push w13\n");
     stack--;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  pop w0\n");
-    fprintf(out, "  %s w%d, w0, w%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  pop w0\n");
+    emit("  %s w%d, w0, w%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-1));
     stack--;
   }
     else
   if (reg > 0)
   {
-    fprintf(out, "  %s w%d, w%d, w%d\n", instr, REG_STACK(reg-2), REG_STACK(reg-1), REG_STACK(reg-2));
+    emit("  %s w%d, w%d, w%d\n", instr, REG_STACK(reg-2), REG_STACK(reg-1), REG_STACK(reg-2));
     reg--;
   }
 
@@ -27,9 +27,10 @@ public:
   virtual ~DSPIC();
 
   virtual int open(char *filename);
+  virtual int get_int_size() { return 16; }
 
   //virtual void serial_init();
-  virtual void method_start(int local_count, const char *name);
+  virtual void method_start(int local_count, int param_count, const char *name);
   virtual void method_end(int local_count);
   virtual int push_integer(int32_t n);
   virtual int push_integer_local(int index);
@@ -42,22 +43,34 @@ public:
   virtual int pop();
   virtual int dup();
   virtual int dup2();
+  virtual int dup_stack_slot(int slot);
+  virtual int get_stack_depth() { return reg + stack; }
   virtual int swap();
   virtual int add_integers();
   virtual int sub_integers();
   virtual int mul_integers();
+  virtual int mul_integers(int const_val);
   virtual int div_integers();
   virtual int mod_integers();
   virtual int neg_integer();
+  virtual int integer_to_byte();
+  virtual int integer_to_short();
+  virtual int integer_to_char();
   virtual int shift_left_integer();
   virtual int shift_right_integer();
   virtual int shift_right_uinteger();
   virtual int and_integer();
   virtual int or_integer();
   virtual int xor_integer();
+  virtual int extract_bits_integer(int shift, int width);
   virtual int inc_integer(int index, int num);
   virtual int jump_cond(const char *label, int cond);
   virtual int jump_cond_integer(const char *label, int cond);
+  virtual int jump_cond_integer_unsigned(const char *label, int cond);
+  virtual int extend_integer(bool is_unsigned);
+  virtual int add_integers_32();
+  virtual int sub_integers_32();
+  virtual int jump_cond_integer_32(const char *label, int cond);
   virtual int return_local(int index, int local_count);
   virtual int return_integer(int local_count);
   virtual int return_void(int local_count);
@@ -66,6 +79,10 @@ public:
   virtual int invoke_static_method(const char *name, int params, int is_void);
   virtual int brk();
   //virtual void close();
+  virtual int get_loop_max() { return 0x4000; }
+  virtual int loop_start(const char *end_label, int count);
+  virtual int loop_start(const char *end_label);
+  virtual int loop_end();
 
   // GPIO functions
   virtual int ioport_setPinsAsInput(int port);
@@ -109,6 +126,11 @@ public:
   virtual int memory_read16();
   virtual int memory_write16();
 
+  // Math
+  virtual int math_abs();
+  virtual int math_min();
+  virtual int math_max();
+
   // DSP (dsPIC stuff)
   virtual int dsp_getA();
   virtual int dsp_getB();
@@ -151,21 +173,44 @@ private:
   int dsp_mul(const char *instr, const char *accum);
   int dsp_square(const char *instr, const char *accum);
   int dsp_store(const char *instr, const char *accum, int shift);
+  void get_local(char *operand, int index);
+  virtual uint32_t get_method_clobber(call_graph_node_t *node);
+  virtual int get_frame_size(call_graph_node_t *node);
+  virtual int get_stack_size(call_graph_node_t *node);
+  virtual int init_static_frames(int size);
+  virtual int get_branch(machine_instr_t *instr, const char **label);
+  virtual bool uses_frame(machine_instr_t *instr);
+  void frame_end();
   void pop_reg(char *dst);
+  void pop_reg_32(char *lo, char *hi, const char *temp_lo, const char *temp_hi);
+  void push_reg_32(const char *lo, const char *hi);
   //void push_w0();
   int set_periph(const char *instr, const char *periph, bool reverse=false);
   int stack_alu(const char *instr);
+  int stack_superopt(const char *idiom, int const_val);
+  int stack_superopt_binary(const char *idiom);
+  int stack_alu_32(const char *instr, const char *instr_carry);
   int stack_alu_div();
+  int cmp_integers(const char *label, int cond, const char **cond_table);
   int stack_shift(const char *instr);
   int get_pin_number(int const_val);
+  bool can_end_loop(int index);
 
   int reg;            // count number of registers are are using as stack
   int reg_max;        // size of register stack 
   int stack;          // count how many things we put on the stack
+  int arg_count;      // locals 0 to arg_count - 1 are in registers
+  int param_count;
+  int method_spills;  // spill_count when the method started
+  int frame_base;     // address of the locals with static frames
+  int frame_size;     // bytes at the end of RAM for static frames
   uint8_t chip_type;
   bool is_main;
   bool need_stack_set;
+  int loop_instr;     // index of the do in instrs
+  int loop_label;     // label_n on the last instruction of the loop
   int flash_start;
+  int ram_end;
 };
 
 #endif
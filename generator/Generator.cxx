@@ -12,22 +12,111 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
 
+#include "ARM.h"
 #include "DSPIC.h"
+#include "M6502.h"
+#include "MIPS.h"
 #include "MSP430.h"
+#include "MSP430X.h"
 #include "Generator.h"
 
-Generator::Generator() : label_count(0)
+// Returns NULL for a cpu_name it doesn't know
+Generator *new_generator(const char *cpu_name)
+{
+  if (strcasecmp("msp430g2231",cpu_name) == 0)
+  {
+    return new MSP430(MSP430G2231);
+  }
+
+  if (strcasecmp("msp430g2553",cpu_name) == 0)
+  {
+    return new MSP430(MSP430G2553);
+  }
+
+  if (strcasecmp("msp430x",cpu_name) == 0 ||
+      strcasecmp("msp430fr5969",cpu_name) == 0)
+  {
+    return new MSP430X(MSP430FR5969);
+  }
+
+  if (strcasecmp("dspic30f3012",cpu_name) == 0)
+  {
+    return new DSPIC(DSPIC30F3012);
+  }
+
+  if (strcasecmp("dspic33fj06gs101a",cpu_name) == 0)
+  {
+    return new DSPIC(DSPIC33FJ06GS101A);
+  }
+
+  if (strcasecmp("pic32mx250f128b",cpu_name) == 0)
+  {
+    return new MIPS(PIC32MX250F128B);
+  }
+
+  if (strcasecmp("pic32mx795f512l",cpu_name) == 0)
+  {
+    return new MIPS(PIC32MX795F512L);
+  }
+
+  if (strcasecmp("m6502",cpu_name) == 0)
+  {
+    return new M6502();
+  }
+
+  if (strcasecmp("arm",cpu_name) == 0)
+  {
+    return new ARM();
+  }
+
+  return NULL;
+}
+
+Generator::Generator() :
+  out(NULL),
+  label_count(0),
+  spill_count(0),
+  instrs(NULL),
+  instr_count(0),
+  instr_max(0),
+  instr_total(0),
+  instr_written(0),
+  assembler(NULL),
+  relocatable(false),
+  static_frames(false),
+  instrument(false),
+  runtime(RUNTIME_SIZE),
+  call_graph(NULL),
+  live_locals(0xffffffff),
+  prologue(-1),
+  prologue_count(0),
+  epilogues(NULL),
+  epilogue_count(0),
+  epilogue_max(0)
 {
 }
 
 Generator::~Generator()
 {
-  fclose(out);
+  // Runtime helpers the subclass destructors added are still in the list
+  write_instrs();
+
+  if (assembler != NULL) { assemble(); }
+
+  free(instrs);
+  free(epilogues);
+
+  if (out != NULL) { fclose(out); }
 }
 
 int Generator::open(char *filename)
 {
+  // Only an assembler gets the output
+  if (filename == NULL) { return 0; }
+
   out = fopen(filename, "wb");
 
   if (out == NULL)
@@ -47,7 +136,763 @@ void Generator::close()
 
 void Generator::label(char *name)
 {
-  fprintf(out, "%s:\n", name);
+  emit("%s:\n", name);
+}
+
+void Generator::write_instrs()
+{
+char line[160];
+int n;
+
+  if (out != NULL)
+  {
+    for (n = instr_written; n < instr_count; n++)
+    {
+      get_line(&instrs[n], line, sizeof(line));
+      fprintf(out, "%s\n", line);
+    }
+  }
+
+  // The assembler needs every line for both of its passes
+  if (assembler != NULL)
+  {
+    instr_written = instr_count;
+    return;
+  }
+
+  instr_count = 0;
+}
+
+void Generator::get_line(machine_instr_t *instr, char *line, int length)
+{
+  if (instr->type == MACHINE_LABEL)
+  {
+    snprintf(line, length, "%s:", instr->operands);
+  }
+    else
+  if (instr->type == MACHINE_TEXT)
+  {
+    snprintf(line, length, "%s", instr->operands);
+  }
+    else
+  if (instr->operands[0] == 0)
+  {
+    snprintf(line, length, "  %s", instr->opcode);
+  }
+    else
+  {
+    snprintf(line, length, "  %s %s", instr->opcode, instr->operands);
+  }
+}
+
+int Generator::assemble()
+{
+char line[160];
+int pass, n;
+
+  for (pass = 1; pass <= 2; pass++)
+  {
+    assembler->begin_pass(pass);
+
+    for (n = 0; n < instr_count; n++)
+    {
+      get_line(&instrs[n], line, sizeof(line));
+      assembler->add_line(line);
+    }
+
+    if (assembler->end_pass() != 0) { return -1; }
+  }
+
+  return 0;
+}
+
+// The format can have more than one line in it.  Every line has to end
+// with a \n.
+void Generator::emit(const char *fmt, ...)
+{
+va_list args;
+char text[512];
+char *line, *next;
+
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+
+  line = text;
+
+  while (*line != 0)
+  {
+    next = strchr(line, '\n');
+    if (next == NULL) { add_line(line); break; }
+
+    *next = 0;
+    add_line(line);
+    line = next + 1;
+  }
+}
+
+void Generator::add_line(const char *line)
+{
+machine_instr_t *instr;
+const char *s = line;
+int len = strlen(line);
+int n;
+
+  if (instr_count == instr_max)
+  {
+    instr_max = instr_max == 0 ? 256 : instr_max * 2;
+    instrs = (machine_instr_t *)realloc(instrs, instr_max * sizeof(machine_instr_t));
+  }
+
+  instr = &instrs[instr_count++];
+  memset(instr, 0, sizeof(machine_instr_t));
+
+  while (*s == ' ' || *s == '\t') { s++; }
+
+  if (s != line && *s != 0 && *s != ';')
+  {
+    instr->type = MACHINE_INSTR;
+
+    for (n = 0; *s != 0 && *s != ' ' && *s != '\t'; n++, s++)
+    {
+      if (n < (int)sizeof(instr->opcode) - 1) { instr->opcode[n] = *s; }
+    }
+
+    while (*s == ' ' || *s == '\t') { s++; }
+    line = s;
+    len = strlen(line);
+
+    instr_total++;
+  }
+    else
+  if (len > 1 && line[len - 1] == ':' && strchr(line, ' ') == NULL)
+  {
+    instr->type = MACHINE_LABEL;
+    len--;
+  }
+    else
+  {
+    instr->type = MACHINE_TEXT;
+  }
+
+  if (len >= (int)sizeof(instr->operands))
+  {
+    printf("Error: line too long '%s'\n", line);
+    len = sizeof(instr->operands) - 1;
+  }
+
+  memcpy(instr->operands, line, len);
+}
+
+superopt_t *Generator::find_superopt(superopt_t *table, const char *idiom, int const_val)
+{
+int n;
+
+  for (n = 0; table[n].idiom != NULL; n++)
+  {
+    if (table[n].const_val == const_val && strcmp(table[n].idiom, idiom) == 0)
+    {
+      return &table[n];
+    }
+  }
+
+  return NULL;
+}
+
+void Generator::write_superopt(superopt_t *entry, const char *reg, const char *temp)
+{
+const char *s;
+char line[128];
+char label[32];
+int n;
+
+  label[0] = 0;
+
+  for (n = 0; entry->instr[n] != NULL; n++)
+  {
+    line[0] = 0;
+
+    for (s = entry->instr[n]; *s != 0; s++)
+    {
+      if (s[0] == '%' && s[1] == 'r') { strcat(line, reg); s++; }
+      else if (s[0] == '%' && s[1] == 't') { strcat(line, temp); s++; }
+      else if (s[0] == '%' && s[1] == 'l')
+      {
+        if (label[0] == 0) { sprintf(label, "superopt_%d", label_count++); }
+        strcat(line, label);
+        s++;
+      }
+      else { strncat(line, s, 1); }
+    }
+
+    if (line[strlen(line) - 1] == ':') { emit("%s\n", line); }
+    else { emit("  %s\n", line); }
+  }
+}
+
+// The helper for the runtime profile that was picked or the next one
+// down if it doesn't have one: hardware multiplier, speed, size.
+runtime_t *Generator::find_runtime(runtime_t *table, const char *name)
+{
+int profile;
+int n;
+
+  for (profile = runtime; profile >= RUNTIME_SIZE; profile--)
+  {
+    for (n = 0; table[n].name != NULL; n++)
+    {
+      if (table[n].profile == profile && strcmp(table[n].name, name) == 0)
+      {
+        return &table[n];
+      }
+    }
+  }
+
+  return NULL;
+}
+
+int Generator::write_runtime(runtime_t *table, const char *name)
+{
+runtime_t *entry = find_runtime(table, name);
+const char *s, *next;
+char line[128];
+int len;
+
+  if (entry == NULL)
+  {
+    printf("Error: No runtime helper %s\n", name);
+    return -1;
+  }
+
+  for (s = entry->code; *s != 0; s = next + 1)
+  {
+    next = strchr(s, '\n');
+    if (next == NULL) { next = s + strlen(s) - 1; len = next - s + 1; }
+    else { len = next - s; }
+
+    if (len > (int)sizeof(line) - 1) { len = sizeof(line) - 1; }
+    memcpy(line, s, len);
+    line[len] = 0;
+
+    add_line(line);
+  }
+
+  return 0;
+}
+
+// Works out the registers every method in the class can change: what
+// the backend says the method itself uses plus everything the methods
+// it calls can change, repeated until nothing grows (recursion).  With
+// static frames asked for the frames are laid out first since the
+// backend gets the frame pointer register back for its stack.
+void Generator::set_call_graph(CallGraph *call_graph)
+{
+call_graph_node_t *node;
+uint32_t clobber;
+int changed;
+int size;
+int n, i;
+
+  this->call_graph = call_graph;
+
+  if (static_frames)
+  {
+    size = 0;
+
+    for (n = 0; n < call_graph->get_count() && size != -1; n++)
+    {
+      node = call_graph->get_node(n);
+      node->frame_size = get_frame_size(node);
+      node->stack_size = get_stack_size(node);
+      if (node->frame_size == -1 || node->stack_size == -1) { size = -1; }
+    }
+
+    if (size == -1)
+    {
+      printf("Static frames aren't supported on this CPU.\n");
+      static_frames = false;
+    }
+      else
+    {
+      size = call_graph->overlay_frames();
+
+      if (size == -1)
+      {
+        printf("Static frames need a program without recursion, locals stay on the stack.\n");
+        static_frames = false;
+      }
+        else
+      if (init_static_frames(size) != 0)
+      {
+        static_frames = false;
+      }
+    }
+  }
+
+  for (n = 0; n < call_graph->get_count(); n++)
+  {
+    node = call_graph->get_node(n);
+
+    if ((node->flags & CALL_GRAPH_UNKNOWN) != 0) { node->clobber = 0xffffffff; }
+    else { node->clobber = get_method_clobber(node); }
+  }
+
+  do
+  {
+    changed = 0;
+
+    for (n = 0; n < call_graph->get_count(); n++)
+    {
+      node = call_graph->get_node(n);
+      clobber = node->clobber;
+
+      for (i = 0; i < node->callee_count; i++)
+      {
+        clobber |= call_graph->get_node(node->callees[i])->clobber;
+      }
+
+      if (clobber != node->clobber)
+      {
+        node->clobber = clobber;
+        changed = 1;
+      }
+    }
+  } while (changed);
+}
+
+// Registers a call to a method in this class can change.  Without a
+// call graph every register can.
+uint32_t Generator::get_clobber(const char *name)
+{
+int index;
+
+  if (call_graph == NULL) { return 0xffffffff; }
+
+  index = call_graph->find(name);
+  if (index == -1) { return 0xffffffff; }
+
+  return call_graph->get_node(index)->clobber;
+}
+
+// method_start() calls this after emitting the frame setup and the
+// return paths call mark_epilogue() after each frame teardown so
+// place_frame() knows which instructions it can move or throw away.
+void Generator::mark_prologue(int start)
+{
+  prologue = start;
+  prologue_count = instr_count - start;
+  epilogue_count = 0;
+}
+
+void Generator::mark_epilogue(int start)
+{
+  if (prologue == -1) { return; }
+
+  if (epilogue_count == epilogue_max)
+  {
+    epilogue_max = epilogue_max == 0 ? 16 : epilogue_max * 2;
+    epilogues = (int *)realloc(epilogues, epilogue_max * 2 * sizeof(int));
+  }
+
+  epilogues[epilogue_count * 2] = start;
+  epilogues[epilogue_count * 2 + 1] = instr_count - start;
+  epilogue_count++;
+}
+
+struct frame_block_t
+{
+  int start;
+  int end;
+  int succ[2];
+  int succ_count;
+  int idom;
+  int order;         // reverse post order or -1 if it can't be reached
+  bool uses;
+  bool epilogue;
+};
+
+static int intersect_blocks(frame_block_t *blocks, int a, int b)
+{
+  while (a != b)
+  {
+    while (blocks[a].order > blocks[b].order) { a = blocks[a].idom; }
+    while (blocks[b].order > blocks[a].order) { b = blocks[b].idom; }
+  }
+
+  return a;
+}
+
+static bool dominates(frame_block_t *blocks, int a, int b)
+{
+  while (b != a && b != 0) { b = blocks[b].idom; }
+
+  return b == a;
+}
+
+// Marks every block that can be reached from the successors of start
+static void reach_blocks(frame_block_t *blocks, int block_count, int start, uint8_t *reach, int *work)
+{
+int count = 0;
+int b, n;
+
+  memset(reach, 0, block_count);
+
+  for (n = 0; n < blocks[start].succ_count; n++)
+  {
+    b = blocks[start].succ[n];
+    if (reach[b] == 0) { reach[b] = 1; work[count++] = b; }
+  }
+
+  while (count > 0)
+  {
+    b = work[--count];
+
+    for (n = 0; n < blocks[b].succ_count; n++)
+    {
+      if (reach[blocks[b].succ[n]] == 0)
+      {
+        reach[blocks[b].succ[n]] = 1;
+        work[count++] = blocks[b].succ[n];
+      }
+    }
+  }
 }
 
+// Called from method_end() once the whole method is in the list.  With
+// nothing in the method touching the frame the prologue and epilogues
+// are dropped.  Otherwise this shrink-wraps: the prologue moves down to
+// the block that dominates every use of the frame if that block isn't in
+// a loop and every return it can reach is one it dominates.  Those
+// returns keep their epilogue and the rest (early exits) lose it.  The
+// backend passes pinned when the frame has to be set up on entry anyway
+// (spills that the epilogue throws away, params passed in the frame).
+void Generator::place_frame(bool pinned)
+{
+frame_block_t *blocks;
+machine_instr_t *list;
+uint8_t *drop;
+int *block_of;
+int count, block_count, insert, save;
+int n, i;
+bool used;
+
+  if (prologue == -1 || pinned) { prologue = -1; return; }
+
+  count = instr_count - prologue;
+  list = instrs + prologue;
+
+  drop = (uint8_t *)calloc(count, 1);
+
+  for (n = 0; n < prologue_count; n++) { drop[n] = 1; }
+
+  for (n = 0; n < epilogue_count; n++)
+  {
+    for (i = 0; i < epilogues[n * 2 + 1]; i++)
+    {
+      drop[epilogues[n * 2] - prologue + i] = 1;
+    }
+  }
+
+  used = false;
+
+  for (n = 0; n < count; n++)
+  {
+    if (drop[n] == 0 && list[n].type == MACHINE_INSTR && uses_frame(&list[n]))
+    {
+      used = true;
+      break;
+    }
+  }
+
+  insert = -1;
+
+  if (used)
+  {
+    block_of = (int *)malloc(count * sizeof(int));
+    blocks = (frame_block_t *)malloc(count * sizeof(frame_block_t));
 
+    block_count = build_blocks(list, count, drop, blocks, block_of);
+    save = -1;
+
+    if (block_count > 0) { save = find_frame_block(blocks, block_count); }
+
+    if (save > 0)
+    {
+      // Early exits that never see the frame don't tear it down
+      for (n = 0; n < epilogue_count; n++)
+      {
+        if (dominates(blocks, save, block_of[epilogues[n * 2] - prologue]))
+        {
+          for (i = 0; i < epilogues[n * 2 + 1]; i++)
+          {
+            drop[epilogues[n * 2] - prologue + i] = 0;
+          }
+        }
+      }
+
+      insert = blocks[save].start;
+
+      while (insert < blocks[save].end && list[insert].type == MACHINE_LABEL)
+      {
+        insert++;
+      }
+    }
+      else
+    {
+      // The frame stays on entry
+      memset(drop, 0, count);
+    }
+
+    free(blocks);
+    free(block_of);
+  }
+
+  list = (machine_instr_t *)malloc(instr_max * sizeof(machine_instr_t));
+  memcpy(list, instrs, prologue * sizeof(machine_instr_t));
+  i = prologue;
+
+  for (n = 0; n <= count; n++)
+  {
+    if (n == insert)
+    {
+      memcpy(list + i, instrs + prologue, prologue_count * sizeof(machine_instr_t));
+      i += prologue_count;
+    }
+
+    if (n < count && drop[n] == 0) { list[i++] = instrs[prologue + n]; }
+  }
+
+  instr_total -= instr_count - i;
+
+  free(instrs);
+  instrs = list;
+  instr_count = i;
+
+  free(drop);
+
+  prologue = -1;
+}
+
+// Basic blocks start at labels and after anything that branches.
+// Returns the number of blocks or -1 if the control flow can't be
+// followed.
+int Generator::build_blocks(machine_instr_t *list, int count, uint8_t *drop, frame_block_t *blocks, int *block_of)
+{
+const char *label;
+int block_count = 0;
+int type, b, n, i;
+
+  for (n = 0; n < count; n++)
+  {
+    if (n == 0 || list[n].type == MACHINE_LABEL ||
+       (list[n - 1].type == MACHINE_INSTR &&
+        get_branch(&list[n - 1], &label) != BRANCH_NONE))
+    {
+      if (block_count != 0) { blocks[block_count - 1].end = n; }
+      memset(&blocks[block_count], 0, sizeof(frame_block_t));
+      blocks[block_count].start = n;
+      block_count++;
+    }
+
+    block_of[n] = block_count - 1;
+
+    if (list[n].type != MACHINE_INSTR) { continue; }
+
+    if (drop[n] == 1)
+    {
+      if (n >= prologue_count) { blocks[block_count - 1].epilogue = true; }
+    }
+      else
+    if (uses_frame(&list[n]))
+    {
+      blocks[block_count - 1].uses = true;
+    }
+  }
+
+  blocks[block_count - 1].end = count;
+
+  for (b = 0; b < block_count; b++)
+  {
+    for (n = blocks[b].end - 1; n >= blocks[b].start; n--)
+    {
+      if (list[n].type == MACHINE_INSTR) { break; }
+    }
+
+    type = n < blocks[b].start ? BRANCH_NONE : get_branch(&list[n], &label);
+
+    if (type == BRANCH_UNKNOWN) { return -1; }
+
+    if (type == BRANCH_COND || type == BRANCH_ALWAYS)
+    {
+      for (i = 0; i < count; i++)
+      {
+        if (list[i].type == MACHINE_LABEL && strcmp(list[i].operands, label) == 0)
+        {
+          break;
+        }
+      }
+
+      // Jumping out of the method isn't something this can follow
+      if (i == count) { return -1; }
+
+      blocks[b].succ[blocks[b].succ_count++] = block_of[i];
+    }
+
+    if ((type == BRANCH_NONE || type == BRANCH_COND) && b + 1 < block_count)
+    {
+      blocks[b].succ[blocks[b].succ_count++] = b + 1;
+    }
+  }
+
+  return block_count;
+}
+
+// Returns the block the prologue can go at the start of (0 is the entry).
+int Generator::find_frame_block(frame_block_t *blocks, int block_count)
+{
+uint8_t *reach;
+int *work, *preds, *pred_start;
+int reached, save, b, n, p, i;
+bool changed;
+
+  work = (int *)malloc(block_count * 2 * sizeof(int));
+  reach = (uint8_t *)calloc(block_count, 1);
+  preds = (int *)malloc(block_count * 2 * sizeof(int));
+  pred_start = (int *)calloc(block_count + 1, sizeof(int));
+
+  // Post order from an iterative depth first search.  work holds
+  // block, next successor pairs.
+  for (b = 0; b < block_count; b++) { blocks[b].order = -1; blocks[b].idom = -1; }
+
+  reached = 0;
+  n = 0;
+  work[n++] = 0;
+  work[n++] = 0;
+  reach[0] = 1;
+
+  while (n > 0)
+  {
+    b = work[n - 2];
+
+    if (work[n - 1] < blocks[b].succ_count)
+    {
+      p = blocks[b].succ[work[n - 1]++];
+
+      if (reach[p] == 0)
+      {
+        reach[p] = 1;
+        work[n++] = p;
+        work[n++] = 0;
+      }
+    }
+      else
+    {
+      blocks[b].order = reached++;
+      n -= 2;
+    }
+  }
+
+  save = 0;
+
+  for (b = 0; b < block_count; b++)
+  {
+    if (blocks[b].order == -1)
+    {
+      // Something the CFG says can't run uses the frame: don't guess
+      if (blocks[b].uses || blocks[b].epilogue) { save = -1; }
+      continue;
+    }
+
+    // Reverse post order so the entry is 0
+    blocks[b].order = reached - 1 - blocks[b].order;
+    work[blocks[b].order] = b;
+  }
+
+  for (b = 0; b < block_count; b++)
+  {
+    for (n = 0; n < blocks[b].succ_count; n++)
+    {
+      pred_start[blocks[b].succ[n] + 1]++;
+    }
+  }
+
+  for (b = 0; b < block_count; b++) { pred_start[b + 1] += pred_start[b]; }
+
+  memcpy(work + block_count, pred_start, block_count * sizeof(int));
+
+  for (b = 0; b < block_count; b++)
+  {
+    for (n = 0; n < blocks[b].succ_count; n++)
+    {
+      preds[work[block_count + blocks[b].succ[n]]++] = b;
+    }
+  }
+
+  // Dominators as in Cooper, Harvey and Kennedy, visiting the blocks in
+  // reverse post order
+  blocks[0].idom = 0;
+  changed = save == 0;
+
+  while (changed)
+  {
+    changed = false;
+
+    for (i = 1; i < reached; i++)
+    {
+      b = work[i];
+      p = -1;
+
+      for (n = pred_start[b]; n < pred_start[b + 1]; n++)
+      {
+        if (blocks[preds[n]].idom == -1) { continue; }
+        p = p == -1 ? preds[n] : intersect_blocks(blocks, preds[n], p);
+      }
+
+      if (p != blocks[b].idom)
+      {
+        blocks[b].idom = p;
+        changed = true;
+      }
+    }
+  }
+
+  // The prologue has to go somewhere that dominates every use
+  if (save == 0)
+  {
+    save = -1;
+
+    for (b = 0; b < block_count; b++)
+    {
+      if (!blocks[b].uses) { continue; }
+      save = save == -1 ? b : intersect_blocks(blocks, b, save);
+    }
+  }
+
+  // Move up while it's in a loop or a return it can reach could also be
+  // reached without going through it
+  while (save > 0)
+  {
+    reach_blocks(blocks, block_count, save, reach, work);
+
+    changed = reach[save] == 1;
+
+    for (b = 0; b < block_count && !changed; b++)
+    {
+      if (blocks[b].epilogue && reach[b] == 1 && !dominates(blocks, save, b))
+      {
+        changed = true;
+      }
+    }
+
+    if (!changed) { break; }
+
+    save = blocks[save].idom;
+  }
+
+  free(work);
+  free(reach);
+  free(preds);
+  free(pred_start);
+
+  return save;
+}
@@ -13,6 +13,47 @@
 #define _GENERATOR_H
 
 #include <stdio.h>
+#include <stdint.h>
+
+#include "Assembler.h"
+#include "call_graph.h"
+#include "table_runtime.h"
+#include "table_superopt.h"
+
+// Backends add the lines of a function to a list with emit() instead of
+// writing them to the .asm file.  write_instrs() prints the list once
+// the function is done so anything in between can look at it, change it
+// or throw parts of it away.  With an assembler set the list is kept
+// and encoded when the generator is deleted so the .asm file is only a
+// listing (or not written at all if open() was given NULL).  Lines that
+// start with whitespace are instructions, name: is a label and
+// everything else (directives, comments, blank lines) is kept as text.
+
+enum
+{
+  MACHINE_INSTR = 0,
+  MACHINE_LABEL,
+  MACHINE_TEXT,
+};
+
+struct machine_instr_t
+{
+  uint8_t type;
+  char opcode[16];
+  char operands[128];      // label name or the line for MACHINE_TEXT
+};
+
+// What an instruction does to control flow for place_frame()
+enum
+{
+  BRANCH_NONE = 0,
+  BRANCH_COND,
+  BRANCH_ALWAYS,
+  BRANCH_RETURN,
+  BRANCH_UNKNOWN,
+};
+
+struct frame_block_t;
 
 class Generator
 {
@@ -21,11 +62,27 @@ public:
   virtual ~Generator();
 
   virtual int open(char *filename);
-  void label(char *name);
+  virtual int finish() { return 0; }
+  FILE *get_output() { return out; }
+  int get_spill_count() { return spill_count; }
+  int get_instr_count() { return instr_total; }
+  machine_instr_t *get_instrs(int *count) { *count = instr_count; return instrs; }
+  void write_instrs();
+  void set_assembler(Assembler *assembler) { this->assembler = assembler; }
+  void set_relocatable() { relocatable = true; }
+  void set_static_frames() { static_frames = true; }
+  void set_instrument() { instrument = true; }
+  bool get_instrument() { return instrument; }
+  void set_runtime(int runtime) { this->runtime = runtime; }
+  void set_call_graph(CallGraph *call_graph);
+  void set_live_locals(uint32_t live_locals) { this->live_locals = live_locals; }
+  virtual void label(char *name);
+  virtual int get_int_size() { return 32; }
+  virtual bool has_hwmult() { return true; }
 
   //virtual int init() = 0;
   //virtual void serial_init() = 0;
-  virtual void method_start(int local_count, const char *name) = 0;
+  virtual void method_start(int local_count, int param_count, const char *name) = 0;
   virtual void method_end(int local_count) = 0;
   virtual int push_integer(int32_t n) = 0;
   virtual int push_integer_local(int index) = 0;
@@ -39,23 +96,58 @@ public:
   virtual int pop() = 0;
   virtual int dup() = 0;
   virtual int dup2() = 0;
+  virtual int dup_stack_slot(int slot) { return -1; }
+  virtual int get_stack_depth() { return -1; }
   virtual int swap() = 0;
   virtual int add_integers() = 0;
+  virtual int add_integers(int const_val) { return -1; }
   virtual int sub_integers() = 0;
+  virtual int sub_integers(int const_val) { return -1; }
   virtual int mul_integers() = 0;
+  virtual int mul_integers(int const_val) { return -1; }
   virtual int div_integers() = 0;
+  virtual int div_integers(int const_val) { return -1; }
+  virtual int div_integers_unsigned() { return -1; }
+  virtual int div_integers_unsigned(int const_val) { return -1; }
   virtual int mod_integers() = 0;
+  virtual int mod_integers(int const_val) { return -1; }
+  virtual int mod_integers_unsigned() { return -1; }
+  virtual int mod_integers_unsigned(int const_val) { return -1; }
+  virtual int div_mod_integers(bool div_first, bool is_unsigned) { return -1; }
+  virtual int div_mod_integers(int const_val, bool div_first, bool is_unsigned) { return -1; }
   virtual int neg_integer() = 0;
+  virtual int integer_to_byte() { return -1; }
+  virtual int integer_to_short() { return -1; }
+  virtual int integer_to_char() { return -1; }
   virtual int shift_left_integer() = 0;
+  virtual int shift_left_integer(int const_val) { return -1; }
   virtual int shift_right_integer() = 0;
+  virtual int shift_right_integer(int const_val) { return -1; }
   virtual int shift_right_uinteger() = 0;
+  virtual int shift_right_uinteger(int const_val) { return -1; }
   virtual int and_integer() = 0;
+  virtual int and_integer(int const_val) { return -1; }
   virtual int or_integer() = 0;
+  virtual int or_integer(int const_val) { return -1; }
   virtual int xor_integer() = 0;
+  virtual int xor_integer(int const_val) { return -1; }
+  virtual int or_integer_byte(int const_val) { return -1; }
+  virtual int xor_integer_byte(int const_val) { return -1; }
+  virtual int extract_bits_integer(int shift, int width) { return -1; }
   virtual int inc_integer(int index, int num) = 0;
   virtual int jump_cond(const char *label, int cond) = 0;
   virtual int jump_cond_integer(const char *label, int cond) = 0;
   virtual int jump_cond_integer(const char *label, int cond, int const_val) { return -1; } 
+  virtual int jump_cond_integer_unsigned(const char *label, int cond) { return -1; }
+  virtual int jump_cond_integer_unsigned(const char *label, int cond, int const_val) { return -1; }
+
+  // Ints that may not fit in a 16 bit int_size are 2 stack values, the
+  // low word first and the high word on top (see find_int32_values()).
+  virtual int extend_integer(bool is_unsigned) { return -1; }
+  virtual int add_integers_32() { return -1; }
+  virtual int sub_integers_32() { return -1; }
+  virtual int jump_cond_integer_32(const char *label, int cond) { return -1; }
+
   virtual int return_local(int index, int local_count) = 0;
   virtual int return_integer(int local_count) = 0;
   virtual int return_void(int local_count) = 0;
@@ -65,6 +157,15 @@ public:
   virtual int brk() = 0;
   //virtual void close() = 0;
 
+  // Hardware counted loops (see loop.h).  get_loop_max() is the most
+  // times around a loop the CPU can count or 0 if it can't.  The count
+  // is given or popped off the stack, and when it's 0 or less the loop
+  // is skipped by going to end_label.  loop_end() comes after the body.
+  virtual int get_loop_max() { return 0; }
+  virtual int loop_start(const char *end_label, int count) { return -1; }
+  virtual int loop_start(const char *end_label) { return -1; }
+  virtual int loop_end() { return -1; }
+
   // GPIO functions
   virtual int ioport_setPinsAsInput(int port) { return -1; }
   virtual int ioport_setPinsAsInput(int port, int const_val) { return -1; }
@@ -115,6 +216,11 @@ public:
   virtual int memory_read16() { return -1; }
   virtual int memory_write16() { return -1; }
 
+  // Math
+  virtual int math_abs() { return -1; }
+  virtual int math_min() { return -1; }
+  virtual int math_max() { return -1; }
+
   // DSP (dsPIC stuff)
   virtual int dsp_getA() { return -1; }
   virtual int dsp_getB() { return -1; }
@@ -154,8 +260,47 @@ public:
   virtual int dsp_shiftB() { return -1; }
 
 protected:
+  void emit(const char *fmt, ...);
+  void add_line(const char *line);
+  void get_line(machine_instr_t *instr, char *line, int length);
+  int assemble();
+  superopt_t *find_superopt(superopt_t *table, const char *idiom, int const_val);
+  void write_superopt(superopt_t *entry, const char *reg, const char *temp);
+  runtime_t *find_runtime(runtime_t *table, const char *name);
+  int write_runtime(runtime_t *table, const char *name);
+  virtual uint32_t get_method_clobber(call_graph_node_t *node) { return 0xffffffff; }
+  uint32_t get_clobber(const char *name);
+  virtual int get_frame_size(call_graph_node_t *node) { return -1; }
+  virtual int get_stack_size(call_graph_node_t *node) { return -1; }
+  virtual int init_static_frames(int size) { return -1; }
+  void mark_prologue(int start);
+  void mark_epilogue(int start);
+  void place_frame(bool pinned);
+  int build_blocks(machine_instr_t *list, int count, uint8_t *drop, frame_block_t *blocks, int *block_of);
+  int find_frame_block(frame_block_t *blocks, int block_count);
+  virtual int get_branch(machine_instr_t *instr, const char **label) { return BRANCH_UNKNOWN; }
+  virtual bool uses_frame(machine_instr_t *instr) { return true; }
+
   FILE *out;
   int label_count;
+  int spill_count;
+  machine_instr_t *instrs;
+  int instr_count;
+  int instr_max;
+  int instr_total;
+  int instr_written;
+  Assembler *assembler;
+  bool relocatable;     // no .org, reset code or vectors: the linker does it
+  bool static_frames;   // locals at fixed addresses from the call graph
+  bool instrument;      // a label on every basic block for simulate -profile
+  int runtime;          // RUNTIME_SIZE, RUNTIME_SPEED or RUNTIME_HWMULT
+  CallGraph *call_graph;
+  uint32_t live_locals; // locals read after the current instruction
+  int prologue;         // index of the current method's frame setup or -1
+  int prologue_count;
+  int *epilogues;       // index, count pairs of each frame teardown
+  int epilogue_count;
+  int epilogue_max;
 };
 
 enum
@@ -168,6 +313,8 @@ enum
   COND_GREATER_EQUAL,
 };
 
+Generator *new_generator(const char *cpu_name);
+
 #if 0
 enum
 {
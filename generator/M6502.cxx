@@ -41,7 +41,7 @@ void M6502::serial_init()
 }
 #endif
 
-void M6502::method_start(int local_count, const char *name)
+void M6502::method_start(int local_count, int param_count, const char *name)
 {
 }
 
@@ -23,7 +23,7 @@ public:
   virtual int open(char *filename);
 
   //virtual void serial_init();
-  virtual void method_start(int local_count, const char *name);
+  virtual void method_start(int local_count, int param_count, const char *name);
   virtual void method_end(int local_count);
   virtual int push_integer(int32_t n);
   virtual int push_integer_local(int index);
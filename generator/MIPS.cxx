@@ -11,217 +11,802 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
 
 #include "MIPS.h"
 
 // ABI is:
-// r4
-// r5
-// r6
-// r7
-// r8
-// r9
-// r10
-// r11
+// t0 - t9: top of stack (10 registers, then spill to memory at sp)
+// v0: return value
+// v1, a0, a1: temp
+// fp: pointer to local variables (local i is at -(i*4+12)(fp))
+// The caller writes parameters below sp where the callee's locals will
+// be, same as the MSP430 code.
 
-MIPS::MIPS()
+#define REG_ZERO 0
+#define REG_V0 2
+#define REG_V1 3
+#define REG_A0 4
+#define REG_A1 5
+#define REG_SP 29
+#define REG_FP 30
+#define REG_RA 31
+#define REG_HILO 32
+
+#define R(a) ((uint64_t)1 << (a))
+#define REG_STACK(a) (stack_regs[a])
+#define LOCALS(i) (-(((i) * 4) + 12))
+#define NAME(a) (reg_names[a])
+
+// Used to order instructions in the scheduler
+#define INSTR_LOAD 1
+#define INSTR_STORE 2
+#define INSTR_VOLATILE 4     // peripheral access, never reordered
+#define INSTR_BRANCH 8       // has a delay slot, ends the block
+#define INSTR_BARRIER 16     // nothing moves across it
+
+#define PORT_TRIS 0x00
+#define PORT_PORT 0x10
+#define PORT_LAT 0x20
+#define PORT_CLR 0x04
+#define PORT_SET 0x08
+
+// SPI1 is at the same address on both chips.  CON, STAT, BUF and BRG
+// are 0x10 apart with the same CLR / SET registers as the ports.
+#define SPI1_UPPER 0xbf80
+#define SPI1CON 0x5800
+#define SPI1STAT 0x5810
+#define SPI1BUF 0x5820
+#define SPI1BRG 0x5830
+#define SPI_ON 0x8000
+#define SPI_CKE 0x0100
+#define SPI_CKP 0x0040
+#define SPI_MSTEN 0x0020
+#define SPIBUSY 0x0800
+#define SPIRBF 0x0001
+
+static const char *reg_names[] =
 {
+  "0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+  "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+  "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+static int8_t stack_regs[] = { 8, 9, 10, 11, 12, 13, 14, 15, 24, 25 };
 
+MIPS::MIPS(uint8_t chip_type) :
+  block_len(0),
+  reg(0),
+  reg_max(sizeof(stack_regs)),
+  stack(0)
+{
+  this->chip_type = chip_type;
+
+  switch(chip_type)
+  {
+    case PIC32MX250F128B:
+      port_base = 0xbf886010;
+      port_stride = 0x100;
+      ram_top = 0x80008000;
+      devcfg1 = 0xbfc00bf8;
+      break;
+    case PIC32MX795F512L:
+    default:
+      port_base = 0xbf886000;
+      port_stride = 0x40;
+      ram_top = 0x80020000;
+      devcfg1 = 0xbfc02ff8;
+      break;
+  }
 }
 
 MIPS::~MIPS()
 {
+  flush();
 
+  // Everything is left erased (1) except FWDTEN so the watchdog is off
+  emit(".org 0x%08x\n", devcfg1);
+  emit("  dc32 0xff7fffff\n\n");
 }
 
 int MIPS::open(char *filename)
 {
+  if (Generator::open(filename) != 0) { return -1; }
+
+  emit(".mips32\n\n");
+
+  // The reset vector is in boot flash.  Set up the stack at the top of
+  // RAM and call main() in program flash (kseg0 so it runs cached).
+  emit(".org 0xbfc00000\n");
+  emit("start:\n");
+  emit("  lui $sp, 0x%04x\n", ram_top >> 16);
+  emit("  ori $sp, $sp, 0x%04x\n", ram_top & 0xffff);
+  emit("  la $t0, main\n");
+  emit("  jalr $t0\n");
+  emit("  nop\n");
+  emit("halt:\n");
+  emit("  beq $0, $0, halt\n");
+  emit("  nop\n\n");
+
+  emit(".org 0x9d000000\n");
+
   return 0;
 }
 
+void MIPS::label(char *name)
+{
+  flush();
+  Generator::label(name);
+}
+
+void MIPS::add_instr(int flags, uint64_t uses, uint64_t defs, const char *fmt, ...)
+{
+va_list args;
+mips_instr_t *instr;
+
+  if (block_len == MIPS_MAX_BLOCK) { flush(); }
+
+  instr = &block[block_len++];
+
+  va_start(args, fmt);
+  vsnprintf(instr->text, sizeof(instr->text), fmt, args);
+  va_end(args);
+
+  // Writes to $0 are thrown away so they don't order anything
+  instr->uses = uses & ~R(REG_ZERO);
+  instr->defs = defs & ~R(REG_ZERO);
+  instr->flags = flags;
+
+  if ((flags & INSTR_BRANCH) != 0) { flush(); }
+}
+
+static bool depends(mips_instr_t *a, mips_instr_t *b)
+{
+  if ((a->flags & INSTR_BARRIER) != 0 || (b->flags & INSTR_BARRIER) != 0)
+  {
+    return true;
+  }
+
+  if ((a->defs & b->uses) != 0) { return true; }
+  if ((a->uses & b->defs) != 0) { return true; }
+  if ((a->defs & b->defs) != 0) { return true; }
+
+  int a_mem = a->flags & (INSTR_LOAD | INSTR_STORE);
+  int b_mem = b->flags & (INSTR_LOAD | INSTR_STORE);
+
+  if (a_mem != 0 && b_mem != 0)
+  {
+    if (((a->flags | b->flags) & (INSTR_STORE | INSTR_VOLATILE)) != 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// List schedule the instructions in the current block: move loads away
+// from the instructions that use them and fill the branch delay slot
+// with an instruction the branch doesn't depend on.
+void MIPS::flush()
+{
+uint64_t preds[MIPS_MAX_BLOCK];
+int height[MIPS_MAX_BLOCK];
+int order[MIPS_MAX_BLOCK];
+uint64_t done = 0;
+mips_instr_t *branch = NULL;
+int count = block_len;
+int delay_slot = -1;
+int last = -1;
+int i,j,k;
+
+  if (block_len == 0) { return; }
+
+  if ((block[count - 1].flags & INSTR_BRANCH) != 0)
+  {
+    branch = &block[count - 1];
+    count--;
+  }
+
+  for (j = 0; j < count; j++)
+  {
+    preds[j] = 0;
+    for (i = 0; i < j; i++)
+    {
+      if (depends(&block[i], &block[j])) { preds[j] |= R(i); }
+    }
+  }
+
+  // Length of the longest chain of dependent instructions starting at
+  // each instruction (loads count as 2 since the result is a cycle late).
+  for (i = count - 1; i >= 0; i--)
+  {
+    int latency = (block[i].flags & INSTR_LOAD) != 0 ? 2 : 1;
+    height[i] = latency;
+
+    for (j = i + 1; j < count; j++)
+    {
+      if ((preds[j] & R(i)) != 0 && height[j] + latency > height[i])
+      {
+        height[i] = height[j] + latency;
+      }
+    }
+  }
+
+  for (k = 0; k < count; k++)
+  {
+    int best = -1;
+    bool best_stalls = true;
+
+    for (i = 0; i < count; i++)
+    {
+      if ((done & R(i)) != 0 || (preds[i] & ~done) != 0) { continue; }
+
+      bool stalls = last != -1 &&
+                    (block[last].flags & INSTR_LOAD) != 0 &&
+                    (block[last].defs & block[i].uses) != 0;
+
+      if (best == -1 ||
+          (best_stalls && !stalls) ||
+          (best_stalls == stalls && height[i] > height[best]))
+      {
+        best = i;
+        best_stalls = stalls;
+      }
+    }
+
+    order[k] = best;
+    done |= R(best);
+    last = best;
+  }
+
+  // The delay slot can take any instruction that nothing after it
+  // depends on and that doesn't touch the registers the branch uses.
+  // Prefer one that doesn't leave a load right before the branch that
+  // reads it.
+  if (branch != NULL)
+  {
+    for (k = count - 1; k >= 0; k--)
+    {
+      i = order[k];
+
+      if ((block[i].flags & INSTR_BARRIER) != 0) { continue; }
+      if ((block[i].defs & (branch->uses | branch->defs)) != 0) { continue; }
+      if ((block[i].uses & branch->defs) != 0) { continue; }
+
+      for (j = 0; j < count; j++)
+      {
+        if ((preds[j] & R(i)) != 0) { break; }
+      }
+
+      if (j != count) { continue; }
+
+      int before = (k == count - 1) ? count - 2 : count - 1;
+      bool stalls = before >= 0 &&
+                    (block[order[before]].flags & INSTR_LOAD) != 0 &&
+                    (block[order[before]].defs & branch->uses) != 0;
+
+      if (delay_slot == -1) { delay_slot = k; }
+      if (!stalls) { delay_slot = k; break; }
+    }
+  }
+
+  for (k = 0; k < count; k++)
+  {
+    if (k == delay_slot) { continue; }
+    emit("  %s\n", block[order[k]].text);
+  }
+
+  if (branch != NULL)
+  {
+    emit("  %s\n", branch->text);
+
+    if (delay_slot != -1)
+    { emit("  %s\n", block[order[delay_slot]].text); }
+      else
+    { emit("  nop\n"); }
+  }
+
+  block_len = 0;
+}
+
 #if 0
 void MIPS::serial_init()
 {
 }
 #endif
 
-void MIPS::method_start(int local_count, const char *name)
+void MIPS::method_start(int local_count, int param_count, const char *name)
 {
+  flush();
+
+  reg = 0;
+  stack = 0;
+
+  emit("%s:\n", name);
+
+  add_instr(INSTR_STORE, R(REG_SP) | R(REG_RA), 0, "sw $ra, -4($sp)");
+  add_instr(INSTR_STORE, R(REG_SP) | R(REG_FP), 0, "sw $fp, -8($sp)");
+  add_instr(0, R(REG_SP), R(REG_FP), "move $fp, $sp");
+  // Marked as a store so locals aren't written before sp covers them
+  add_instr(INSTR_STORE, R(REG_SP), R(REG_SP), "addiu $sp, $sp, -%d", (local_count * 4) + 8);
 }
 
 void MIPS::method_end(int local_count)
 {
+  flush();
+  emit("\n");
 }
 
 int MIPS::push_integer(int32_t n)
 {
-  return -1;
+int r = get_push_reg(REG_A0);
+
+  load_const(r, n);
+  push_reg(r);
+
+  return 0;
 }
 
 int MIPS::push_integer_local(int index)
 {
-  return -1;
+int r = get_push_reg(REG_A0);
+
+  add_instr(INSTR_LOAD, R(REG_FP), R(r), "lw $%s, %d($fp)", NAME(r), LOCALS(index));
+  push_reg(r);
+
+  return 0;
+}
+
+int MIPS::set_integer_local(int index, int value)
+{
+  if (value == 0)
+  {
+    add_instr(INSTR_STORE, R(REG_FP), 0, "sw $0, %d($fp)", LOCALS(index));
+  }
+    else
+  {
+    load_const(REG_A0, value);
+    add_instr(INSTR_STORE, R(REG_FP) | R(REG_A0), 0, "sw $a0, %d($fp)", LOCALS(index));
+  }
+
+  return 0;
 }
 
 int MIPS::push_long(int64_t n)
 {
+  printf("long is not supported right now\n");
   return -1;
 }
 
 int MIPS::push_float(float f)
 {
+  printf("float is not supported right now\n");
   return -1;
 }
 
 int MIPS::push_double(double f)
 {
+  printf("double is not supported right now\n");
   return -1;
 }
 
 int MIPS::push_byte(int8_t b)
 {
-  return -1;
+  return push_integer(b);
 }
 
 int MIPS::push_short(int16_t s)
 {
-  return -1;
+  return push_integer(s);
 }
 
 int MIPS::pop_integer_local(int index)
 {
-  return -1;
+int r = pop_reg(REG_A0);
+
+  add_instr(INSTR_STORE, R(REG_FP) | R(r), 0, "sw $%s, %d($fp)", NAME(r), LOCALS(index));
+
+  return 0;
 }
 
 int MIPS::pop()
 {
-  return -1;
+  if (stack > 0)
+  {
+    add_instr(0, R(REG_SP), R(REG_SP), "addiu $sp, $sp, 4");
+    stack--;
+  }
+    else
+  {
+    reg--;
+  }
+
+  return 0;
 }
 
 int MIPS::dup()
 {
-  return -1;
+  if (stack > 0)
+  {
+    add_instr(INSTR_LOAD, R(REG_SP), R(REG_A0), "lw $a0, 0($sp)");
+    push_reg(REG_A0);
+  }
+    else
+  {
+    return dup_stack_slot(reg - 1);
+  }
+
+  return 0;
 }
 
 int MIPS::dup2()
 {
+  printf("Need to implement dup2()\n");
   return -1;
 }
 
+int MIPS::dup_stack_slot(int slot)
+{
+  // Only slots held in registers can be copied without a memory access
+  if (slot >= reg) { return -1; }
+
+  int r = get_push_reg(REG_A0);
+  add_instr(0, R(REG_STACK(slot)), R(r), "move $%s, $%s", NAME(r), NAME(REG_STACK(slot)));
+  push_reg(r);
+
+  return 0;
+}
+
 int MIPS::swap()
 {
-  return -1;
+  if (stack == 0)
+  {
+    int a = REG_STACK(reg - 1);
+    int b = REG_STACK(reg - 2);
+
+    add_instr(0, R(a), R(REG_A0), "move $a0, $%s", NAME(a));
+    add_instr(0, R(b), R(a), "move $%s, $%s", NAME(a), NAME(b));
+    add_instr(0, R(REG_A0), R(b), "move $%s, $a0", NAME(b));
+  }
+    else
+  if (stack == 1)
+  {
+    int a = REG_STACK(reg - 1);
+
+    add_instr(INSTR_LOAD, R(REG_SP), R(REG_A0), "lw $a0, 0($sp)");
+    add_instr(INSTR_STORE, R(REG_SP) | R(a), 0, "sw $%s, 0($sp)", NAME(a));
+    add_instr(0, R(REG_A0), R(a), "move $%s, $a0", NAME(a));
+  }
+    else
+  {
+    add_instr(INSTR_LOAD, R(REG_SP), R(REG_A0), "lw $a0, 0($sp)");
+    add_instr(INSTR_LOAD, R(REG_SP), R(REG_A1), "lw $a1, 4($sp)");
+    add_instr(INSTR_STORE, R(REG_SP) | R(REG_A0), 0, "sw $a0, 4($sp)");
+    add_instr(INSTR_STORE, R(REG_SP) | R(REG_A1), 0, "sw $a1, 0($sp)");
+  }
+
+  return 0;
 }
 
 int MIPS::add_integers()
 {
-  return -1;
+  return stack_alu("addu", 0);
 }
 
 int MIPS::sub_integers()
 {
-  return -1;
+  return stack_alu("subu", 0);
 }
 
 int MIPS::mul_integers()
 {
-  return -1;
+  // mul leaves hi and lo unpredictable
+  return stack_alu("mul", R(REG_HILO));
 }
 
 int MIPS::div_integers()
 {
-  return -1;
+  return stack_div("mflo");
 }
 
 int MIPS::mod_integers()
 {
-  return -1;
+  return stack_div("mfhi");
 }
 
 int MIPS::neg_integer()
 {
-  return -1;
+int r = pop_reg(REG_A0);
+int rd = get_push_reg(REG_A0);
+
+  add_instr(0, R(r), R(rd), "subu $%s, $0, $%s", NAME(rd), NAME(r));
+  push_reg(rd);
+
+  return 0;
+}
+
+// seb and seh are MIPS32 release 2 which the M4K core has
+int MIPS::integer_to_byte()
+{
+  return stack_unary("seb", NULL);
+}
+
+int MIPS::integer_to_short()
+{
+  return stack_unary("seh", NULL);
+}
+
+int MIPS::integer_to_char()
+{
+  return stack_unary("andi", "0xffff");
 }
 
 int MIPS::shift_left_integer()
 {
-  return -1;
+  return stack_alu("sllv", 0);
+}
+
+// Java only uses the low 5 bits of the count, same as the sa field
+int MIPS::shift_left_integer(int const_val)
+{
+char count[8];
+
+  sprintf(count, "%d", const_val & 0x1f);
+
+  return stack_unary("sll", count);
 }
 
 int MIPS::shift_right_integer()
 {
-  return -1;
+  return stack_alu("srav", 0);
+}
+
+int MIPS::shift_right_integer(int const_val)
+{
+char count[8];
+
+  sprintf(count, "%d", const_val & 0x1f);
+
+  return stack_unary("sra", count);
 }
 
 int MIPS::shift_right_uinteger()
 {
-  return -1;
+  return stack_alu("srlv", 0);
+}
+
+int MIPS::shift_right_uinteger(int const_val)
+{
+char count[8];
+
+  sprintf(count, "%d", const_val & 0x1f);
+
+  return stack_unary("srl", count);
 }
 
 int MIPS::and_integer()
 {
-  return -1;
+  return stack_alu("and", 0);
 }
 
 int MIPS::or_integer()
 {
-  return -1;
+  return stack_alu("or", 0);
 }
 
 int MIPS::xor_integer()
 {
-  return -1;
+  return stack_alu("xor", 0);
 }
 
 int MIPS::inc_integer(int index, int num)
 {
-  return -1;
+  add_instr(INSTR_LOAD, R(REG_FP), R(REG_A0), "lw $a0, %d($fp)", LOCALS(index));
+  add_instr(0, R(REG_A0), R(REG_A0), "addiu $a0, $a0, %d", num);
+  add_instr(INSTR_STORE, R(REG_FP) | R(REG_A0), 0, "sw $a0, %d($fp)", LOCALS(index));
+
+  return 0;
 }
 
 int MIPS::jump_cond(const char *label, int cond)
 {
+int r = pop_reg(REG_A0);
+
+  switch(cond)
+  {
+    case COND_EQUAL: return branch("beq", r, REG_ZERO, label);
+    case COND_NOT_EQUAL: return branch("bne", r, REG_ZERO, label);
+    case COND_LESS: return branch("bltz", r, -1, label);
+    case COND_LESS_EQUAL: return branch("blez", r, -1, label);
+    case COND_GREATER: return branch("bgtz", r, -1, label);
+    case COND_GREATER_EQUAL: return branch("bgez", r, -1, label);
+  }
+
   return -1;
 }
 
 int MIPS::jump_cond_integer(const char *label, int cond)
 {
+int rt = pop_reg(REG_A1);
+int rs = pop_reg(REG_A0);
+
+  switch(cond)
+  {
+    case COND_EQUAL:
+      return branch("beq", rs, rt, label);
+    case COND_NOT_EQUAL:
+      return branch("bne", rs, rt, label);
+    case COND_LESS:
+      add_instr(0, R(rs) | R(rt), R(REG_V1), "slt $v1, $%s, $%s", NAME(rs), NAME(rt));
+      return branch("bne", REG_V1, REG_ZERO, label);
+    case COND_GREATER_EQUAL:
+      add_instr(0, R(rs) | R(rt), R(REG_V1), "slt $v1, $%s, $%s", NAME(rs), NAME(rt));
+      return branch("beq", REG_V1, REG_ZERO, label);
+    case COND_GREATER:
+      add_instr(0, R(rs) | R(rt), R(REG_V1), "slt $v1, $%s, $%s", NAME(rt), NAME(rs));
+      return branch("bne", REG_V1, REG_ZERO, label);
+    case COND_LESS_EQUAL:
+      add_instr(0, R(rs) | R(rt), R(REG_V1), "slt $v1, $%s, $%s", NAME(rt), NAME(rs));
+      return branch("beq", REG_V1, REG_ZERO, label);
+  }
+
   return -1;
 }
 
-int MIPS::return_local(int index, int local_count)
+int MIPS::jump_cond_integer(const char *label, int cond, int const_val)
 {
+int rs;
+
+  // Comparing with 0 is the same as the if<cond> instructions
+  if (const_val == 0) { return jump_cond(label, cond); }
+
+  // a > c is the same as !(a < c + 1) and a <= c is a < c + 1
+  if (cond == COND_GREATER || cond == COND_LESS_EQUAL) { const_val++; }
+
+  if (const_val < -32768 || const_val > 32767) { return -1; }
+
+  rs = pop_reg(REG_A0);
+
+  switch(cond)
+  {
+    case COND_EQUAL:
+    case COND_NOT_EQUAL:
+      load_const(REG_V1, const_val);
+      return branch(cond == COND_EQUAL ? "beq" : "bne", rs, REG_V1, label);
+    case COND_LESS:
+    case COND_LESS_EQUAL:
+      add_instr(0, R(rs), R(REG_V1), "slti $v1, $%s, %d", NAME(rs), const_val);
+      return branch("bne", REG_V1, REG_ZERO, label);
+    case COND_GREATER_EQUAL:
+    case COND_GREATER:
+      add_instr(0, R(rs), R(REG_V1), "slti $v1, $%s, %d", NAME(rs), const_val);
+      return branch("beq", REG_V1, REG_ZERO, label);
+  }
+
   return -1;
 }
 
+int MIPS::return_local(int index, int local_count)
+{
+  add_instr(INSTR_LOAD, R(REG_FP), R(REG_V0), "lw $v0, %d($fp)", LOCALS(index));
+  method_return();
+
+  return 0;
+}
+
 int MIPS::return_integer(int local_count)
 {
-  return -1;
+int r = pop_reg(REG_A0);
+
+  add_instr(0, R(r), R(REG_V0), "move $v0, $%s", NAME(r));
+  method_return();
+
+  return 0;
 }
 
 int MIPS::return_void(int local_count)
 {
-  return -1;
+  method_return();
+
+  return 0;
 }
 
 int MIPS::jump(const char *name)
 {
-  return -1;
+  add_instr(INSTR_BRANCH, 0, 0, "j %s", name);
+  return 0;
 }
 
 int MIPS::call(const char *name)
 {
-  return -1;
+  add_instr(INSTR_BRANCH, 0, R(REG_RA), "jal %s", name);
+  return 0;
 }
 
 int MIPS::invoke_static_method(const char *name, int params, int is_void)
 {
-  return -1;
+int depth = reg + stack;
+int saved_registers;
+int reg_params;
+int stack_params;
+int n;
+
+  printf("invoke_static_method() name=%s params=%d is_void=%d\n", name, params, is_void);
+
+  // Parameters are the top of the stack.  Any of them that spilled are
+  // in memory (the top being at 0(sp)), the rest are in registers.
+  stack_params = params < stack ? params : stack;
+  reg_params = params - stack_params;
+  saved_registers = reg - reg_params;
+
+  // Save the registers the called method could trash
+  if (saved_registers > 0)
+  {
+    add_instr(0, R(REG_SP), R(REG_SP), "addiu $sp, $sp, -%d", saved_registers * 4);
+
+    for (n = 0; n < saved_registers; n++)
+    {
+      add_instr(INSTR_STORE, R(REG_SP) | R(REG_STACK(n)), 0, "sw $%s, %d($sp)", NAME(REG_STACK(n)), n * 4);
+    }
+  }
+
+  // Copy parameters to where the called method's local variables will
+  // be.  Parameter 0 is the deepest one on the stack.
+  for (n = 0; n < params; n++)
+  {
+    int slot = depth - params + n;
+    int dst = LOCALS(n);
+
+    if (slot < reg)
+    {
+      int r = REG_STACK(slot);
+      add_instr(INSTR_STORE, R(REG_SP) | R(r), 0, "sw $%s, %d($sp)", NAME(r), dst);
+    }
+      else
+    {
+      int src = ((depth - 1 - slot) * 4) + (saved_registers * 4);
+      add_instr(INSTR_LOAD, R(REG_SP), R(REG_A0), "lw $a0, %d($sp)", src);
+      add_instr(INSTR_STORE, R(REG_SP) | R(REG_A0), 0, "sw $a0, %d($sp)", dst);
+    }
+  }
+
+  // Everything the called method could look at or change is done
+  add_instr(INSTR_BRANCH | INSTR_STORE | INSTR_LOAD, R(REG_SP), R(REG_RA) | R(REG_V0), "jal %s", name);
+
+  if (saved_registers > 0)
+  {
+    for (n = 0; n < saved_registers; n++)
+    {
+      add_instr(INSTR_LOAD, R(REG_SP), R(REG_STACK(n)), "lw $%s, %d($sp)", NAME(REG_STACK(n)), n * 4);
+    }
+  }
+
+  if (saved_registers > 0 || stack_params > 0)
+  {
+    add_instr(0, R(REG_SP), R(REG_SP), "addiu $sp, $sp, %d", (saved_registers + stack_params) * 4);
+  }
+
+  stack -= stack_params;
+  reg -= reg_params;
+
+  if (!is_void)
+  {
+    int r = get_push_reg(REG_A0);
+    add_instr(0, R(REG_V0), R(r), "move $%s, $v0", NAME(r));
+    push_reg(r);
+  }
+
+  return 0;
 }
 
 int MIPS::brk()
 {
-  return -1;
+  add_instr(INSTR_BARRIER, 0, 0, "break");
+  return 0;
 }
 
 #if 0
@@ -231,16 +816,491 @@ void MIPS::close()
 #endif
 
 // GPIO functions
-int MIPS::ioport_setPinsAsInput(int port) { return -1; }
-int MIPS::ioport_setPinsAsOutput(int port) { return -1; }
-int MIPS::ioport_setPinsValue(int port) { return -1; }
-int MIPS::ioport_setPinsHigh(int port) { return -1; }
-int MIPS::ioport_setPinsLow(int port) { return -1; }
-int MIPS::ioport_setPinAsOutput(int port) { return -1; }
-int MIPS::ioport_setPinAsInput(int port) { return -1; }
-int MIPS::ioport_setPinHigh(int port) { return -1; }
-int MIPS::ioport_setPinLow(int port) { return -1; }
-int MIPS::ioport_isPinInputHigh(int port) { return -1; }
-int MIPS::ioport_getPortInputValue(int port) { return -1; }
+int MIPS::ioport_setPinsAsInput(int port)
+{
+  return set_periph(port, PORT_TRIS + PORT_SET);
+}
+
+int MIPS::ioport_setPinsAsInput(int port, int const_val)
+{
+  return set_periph(port, PORT_TRIS + PORT_SET, const_val);
+}
+
+int MIPS::ioport_setPinsAsOutput(int port)
+{
+  return set_periph(port, PORT_TRIS + PORT_CLR);
+}
+
+int MIPS::ioport_setPinsAsOutput(int port, int const_val)
+{
+  return set_periph(port, PORT_TRIS + PORT_CLR, const_val);
+}
+
+int MIPS::ioport_setPinsValue(int port)
+{
+  return set_periph(port, PORT_LAT);
+}
+
+int MIPS::ioport_setPinsValue(int port, int const_val)
+{
+  return set_periph(port, PORT_LAT, const_val);
+}
+
+int MIPS::ioport_setPinsHigh(int port)
+{
+  return set_periph(port, PORT_LAT + PORT_SET);
+}
+
+int MIPS::ioport_setPinsHigh(int port, int const_val)
+{
+  return set_periph(port, PORT_LAT + PORT_SET, const_val);
+}
+
+int MIPS::ioport_setPinsLow(int port)
+{
+  return set_periph(port, PORT_LAT + PORT_CLR);
+}
+
+int MIPS::ioport_setPinsLow(int port, int const_val)
+{
+  return set_periph(port, PORT_LAT + PORT_CLR, const_val);
+}
+
+int MIPS::ioport_setPinAsOutput(int port)
+{
+  return set_periph_pin(port, PORT_TRIS + PORT_CLR);
+}
+
+int MIPS::ioport_setPinAsOutput(int port, int const_val)
+{
+  if (const_val < 0 || const_val > 15) { return -1; }
+  return set_periph(port, PORT_TRIS + PORT_CLR, 1 << const_val);
+}
+
+int MIPS::ioport_setPinAsInput(int port)
+{
+  return set_periph_pin(port, PORT_TRIS + PORT_SET);
+}
+
+int MIPS::ioport_setPinAsInput(int port, int const_val)
+{
+  if (const_val < 0 || const_val > 15) { return -1; }
+  return set_periph(port, PORT_TRIS + PORT_SET, 1 << const_val);
+}
+
+int MIPS::ioport_setPinHigh(int port)
+{
+  return set_periph_pin(port, PORT_LAT + PORT_SET);
+}
+
+int MIPS::ioport_setPinHigh(int port, int const_val)
+{
+  if (const_val < 0 || const_val > 15) { return -1; }
+  return set_periph(port, PORT_LAT + PORT_SET, 1 << const_val);
+}
+
+int MIPS::ioport_setPinLow(int port)
+{
+  return set_periph_pin(port, PORT_LAT + PORT_CLR);
+}
+
+int MIPS::ioport_setPinLow(int port, int const_val)
+{
+  if (const_val < 0 || const_val > 15) { return -1; }
+  return set_periph(port, PORT_LAT + PORT_CLR, 1 << const_val);
+}
+
+int MIPS::ioport_isPinInputHigh(int port)
+{
+int pin = pop_reg(REG_A1);
+int offset = get_port_address(port, PORT_PORT);
+int r = get_push_reg(REG_A0);
+
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(r), "lw $%s, %d($v1)", NAME(r), offset);
+  add_instr(0, R(r) | R(pin), R(r), "srlv $%s, $%s, $%s", NAME(r), NAME(r), NAME(pin));
+  add_instr(0, R(r), R(r), "andi $%s, $%s, 1", NAME(r), NAME(r));
+  push_reg(r);
+
+  return 0;
+}
+
+int MIPS::ioport_getPortInputValue(int port)
+{
+int offset = get_port_address(port, PORT_PORT);
+int r = get_push_reg(REG_A0);
+
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(r), "lw $%s, %d($v1)", NAME(r), offset);
+  push_reg(r);
+
+  return 0;
+}
+
 //int MIPS::ioport_setPortOutputValue(int port) { return -1; }
 
+// SPI functions.  SCK1 is a fixed pin but on the PIC32MX250 SDI1 and
+// SDO1 go through peripheral pin select which is left to the program.
+// The clock is PBCLK / (2 * (BRG + 1)) so DIVn is BRG = (n - 1) / 2
+// (DIV1 runs at DIV2).  CKE is set for CPHA=0 since it means data
+// changes going back to the idle clock level.
+int MIPS::spi_init(int port)
+{
+int mode;
+int div;
+
+  if (port != 0) { return -1; }
+
+  mode = pop_reg(REG_A1);
+  div = pop_reg(REG_A0);
+
+  // BRG = ((1 << div) - 1) >> 1
+  add_instr(0, 0, R(REG_V1), "addiu $v1, $0, 1");
+  add_instr(0, R(REG_V1) | R(div), R(REG_V1), "sllv $v1, $v1, $%s", NAME(div));
+  add_instr(0, R(REG_V1), R(REG_V1), "addiu $v1, $v1, -1");
+  add_instr(0, R(REG_V1), R(div), "srl $%s, $v1, 1", NAME(div));
+
+  // CON = ON | MSTEN | CKP from bit 1 of the mode | CKE from !bit 0
+  add_instr(0, R(mode), R(REG_V1), "andi $v1, $%s, 2", NAME(mode));
+  add_instr(0, R(REG_V1), R(REG_V1), "sll $v1, $v1, 5");
+  add_instr(0, R(mode), R(mode), "xori $%s, $%s, 1", NAME(mode), NAME(mode));
+  add_instr(0, R(mode), R(mode), "andi $%s, $%s, 1", NAME(mode), NAME(mode));
+  add_instr(0, R(mode), R(mode), "sll $%s, $%s, 8", NAME(mode), NAME(mode));
+  add_instr(0, R(mode) | R(REG_V1), R(mode), "or $%s, $%s, $v1", NAME(mode), NAME(mode));
+  add_instr(0, R(mode), R(mode), "ori $%s, $%s, 0x%04x", NAME(mode), NAME(mode), SPI_ON | SPI_MSTEN);
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1), 0, "sw $0, %d($v1)", SPI1CON);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(div), 0, "sw $%s, %d($v1)", NAME(div), SPI1BRG);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(mode), 0, "sw $%s, %d($v1)", NAME(mode), SPI1CON);
+
+  return 0;
+}
+
+int MIPS::spi_init(int port, int clock_divisor, int mode)
+{
+int con = SPI_ON | SPI_MSTEN;
+
+  if (port != 0) { return -1; }
+
+  if ((mode & 2) != 0) { con |= SPI_CKP; }
+  if ((mode & 1) == 0) { con |= SPI_CKE; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1), 0, "sw $0, %d($v1)", SPI1CON);
+  load_const(REG_A0, ((1 << (clock_divisor & 7)) - 1) >> 1);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A0), 0, "sw $a0, %d($v1)", SPI1BRG);
+  load_const(REG_A1, con);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A1), 0, "sw $a1, %d($v1)", SPI1CON);
+
+  return 0;
+}
+
+// send() returns the byte shifted in so it waits for it
+int MIPS::spi_send(int port)
+{
+int r;
+int label;
+
+  if (port != 0) { return -1; }
+
+  r = pop_reg(REG_A0);
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(r), 0, "sw $%s, %d($v1)", NAME(r), SPI1BUF);
+
+  label = label_count++;
+  flush();
+  emit("label_%d:\n", label);
+
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(REG_A0), "lw $a0, %d($v1)", SPI1STAT);
+  add_instr(0, R(REG_A0), R(REG_A0), "andi $a0, $a0, %d", SPIRBF);
+  add_instr(INSTR_BRANCH, R(REG_A0), 0, "beq $a0, $0, label_%d", label);
+
+  return spi_read(port);
+}
+
+int MIPS::spi_read(int port)
+{
+int rd = get_push_reg(REG_A0);
+
+  if (port != 0) { return -1; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(rd), "lw $%s, %d($v1)", NAME(rd), SPI1BUF);
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::spi_isDataAvailable(int port)
+{
+int rd = get_push_reg(REG_A0);
+
+  if (port != 0) { return -1; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(rd), "lw $%s, %d($v1)", NAME(rd), SPI1STAT);
+  add_instr(0, R(rd), R(rd), "andi $%s, $%s, 0x%04x", NAME(rd), NAME(rd), SPIRBF);
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::spi_isBusy(int port)
+{
+int rd = get_push_reg(REG_A0);
+
+  if (port != 0) { return -1; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(REG_V1), R(rd), "lw $%s, %d($v1)", NAME(rd), SPI1STAT);
+  add_instr(0, R(rd), R(rd), "andi $%s, $%s, 0x%04x", NAME(rd), NAME(rd), SPIBUSY);
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::spi_disable(int port)
+{
+  if (port != 0) { return -1; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  load_const(REG_A0, SPI_ON);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A0), 0, "sw $a0, %d($v1)", SPI1CON + PORT_CLR);
+
+  return 0;
+}
+
+int MIPS::spi_enable(int port)
+{
+  if (port != 0) { return -1; }
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", SPI1_UPPER);
+  load_const(REG_A0, SPI_ON);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A0), 0, "sw $a0, %d($v1)", SPI1CON + PORT_SET);
+
+  return 0;
+}
+
+// CPU functions
+int MIPS::cpu_nop()
+{
+  add_instr(INSTR_BARRIER, 0, 0, "nop");
+  return 0;
+}
+
+// Memory.  read8() and read16() return a byte and a short.
+int MIPS::memory_read8()
+{
+  return memory_read("lb");
+}
+
+int MIPS::memory_write8()
+{
+  return memory_write("sb");
+}
+
+int MIPS::memory_read16()
+{
+  return memory_read("lh");
+}
+
+int MIPS::memory_write16()
+{
+  return memory_write("sh");
+}
+
+int MIPS::pop_reg(int temp)
+{
+  if (stack > 0)
+  {
+    add_instr(INSTR_LOAD, R(REG_SP), R(temp), "lw $%s, 0($sp)", NAME(temp));
+    add_instr(0, R(REG_SP), R(REG_SP), "addiu $sp, $sp, 4");
+    stack--;
+    return temp;
+  }
+
+  reg--;
+
+  return REG_STACK(reg);
+}
+
+// Returns the register a value being pushed should be put in.  If the
+// register stack is full it goes in temp and push_reg() spills it.
+int MIPS::get_push_reg(int temp)
+{
+  if (reg < reg_max) { return REG_STACK(reg); }
+
+  return temp;
+}
+
+void MIPS::push_reg(int r)
+{
+  if (reg < reg_max && r == REG_STACK(reg))
+  {
+    reg++;
+    return;
+  }
+
+  add_instr(0, R(REG_SP), R(REG_SP), "addiu $sp, $sp, -4");
+  add_instr(INSTR_STORE, R(REG_SP) | R(r), 0, "sw $%s, 0($sp)", NAME(r));
+  stack++;
+  spill_count++;
+}
+
+void MIPS::load_const(int r, int32_t n)
+{
+  if (n >= -32768 && n <= 32767)
+  {
+    add_instr(0, 0, R(r), "addiu $%s, $0, %d", NAME(r), n);
+  }
+    else
+  if (n >= 0 && n <= 65535)
+  {
+    add_instr(0, 0, R(r), "ori $%s, $0, 0x%04x", NAME(r), n);
+  }
+    else
+  {
+    add_instr(0, 0, R(r), "lui $%s, 0x%04x", NAME(r), ((uint32_t)n) >> 16);
+
+    if ((n & 0xffff) != 0)
+    {
+      add_instr(0, R(r), R(r), "ori $%s, $%s, 0x%04x", NAME(r), NAME(r), n & 0xffff);
+    }
+  }
+}
+
+int MIPS::stack_alu(const char *instr, uint64_t defs)
+{
+int rt = pop_reg(REG_A1);
+int rs = pop_reg(REG_A0);
+int rd = get_push_reg(REG_A0);
+
+  // For the shifts the operand order works out to be value, count too
+  add_instr(0, R(rs) | R(rt), R(rd) | defs, "%s $%s, $%s, $%s", instr, NAME(rd), NAME(rs), NAME(rt));
+  push_reg(rd);
+
+  return 0;
+}
+
+// Replaces the top of the stack with instr rd, rs[, operand]
+int MIPS::stack_unary(const char *instr, const char *operand)
+{
+int rs = pop_reg(REG_A0);
+int rd = get_push_reg(REG_A0);
+
+  if (operand == NULL)
+  {
+    add_instr(0, R(rs), R(rd), "%s $%s, $%s", instr, NAME(rd), NAME(rs));
+  }
+    else
+  {
+    add_instr(0, R(rs), R(rd), "%s $%s, $%s, %s", instr, NAME(rd), NAME(rs), operand);
+  }
+
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::stack_div(const char *instr)
+{
+int rt = pop_reg(REG_A1);
+int rs = pop_reg(REG_A0);
+int rd = get_push_reg(REG_A0);
+
+  add_instr(0, R(rs) | R(rt), R(REG_HILO), "div $%s, $%s", NAME(rs), NAME(rt));
+  add_instr(0, R(REG_HILO), R(rd), "%s $%s", instr, NAME(rd));
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::branch(const char *instr, int rs, int rt, const char *label)
+{
+  if (rt == -1)
+  {
+    add_instr(INSTR_BRANCH, R(rs), 0, "%s $%s, %s", instr, NAME(rs), label);
+  }
+    else
+  {
+    add_instr(INSTR_BRANCH, R(rs) | R(rt), 0, "%s $%s, $%s, %s", instr, NAME(rs), NAME(rt), label);
+  }
+
+  return 0;
+}
+
+void MIPS::method_return()
+{
+  // Everything is relative to fp so the scheduler can load ra first and
+  // put the fp restore in the delay slot.
+  add_instr(INSTR_LOAD, R(REG_FP), R(REG_RA), "lw $ra, -4($fp)");
+  add_instr(0, R(REG_FP), R(REG_SP), "move $sp, $fp");
+  add_instr(INSTR_LOAD, R(REG_FP), R(REG_FP), "lw $fp, -8($fp)");
+  add_instr(INSTR_BRANCH, R(REG_RA) | R(REG_V0), 0, "jr $ra");
+}
+
+// Puts the upper half of the address of a port register in v1 and
+// returns the offset to use with it.
+int MIPS::get_port_address(int port, int reg_offset)
+{
+uint32_t address = port_base + (port * port_stride) + reg_offset;
+int16_t offset = address & 0xffff;
+
+  add_instr(0, 0, R(REG_V1), "lui $v1, 0x%04x", (address - offset) >> 16);
+
+  return offset;
+}
+
+int MIPS::set_periph(int port, int reg_offset)
+{
+int r = pop_reg(REG_A0);
+int offset = get_port_address(port, reg_offset);
+
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(r), 0, "sw $%s, %d($v1)", NAME(r), offset);
+
+  return 0;
+}
+
+int MIPS::set_periph(int port, int reg_offset, int const_val)
+{
+int offset = get_port_address(port, reg_offset);
+
+  load_const(REG_A0, const_val);
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A0), 0, "sw $a0, %d($v1)", offset);
+
+  return 0;
+}
+
+int MIPS::set_periph_pin(int port, int reg_offset)
+{
+int pin = pop_reg(REG_A1);
+int offset = get_port_address(port, reg_offset);
+
+  add_instr(0, 0, R(REG_A0), "addiu $a0, $0, 1");
+  add_instr(0, R(REG_A0) | R(pin), R(REG_A0), "sllv $a0, $a0, $%s", NAME(pin));
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(REG_V1) | R(REG_A0), 0, "sw $a0, %d($v1)", offset);
+
+  return 0;
+}
+
+int MIPS::memory_read(const char *instr)
+{
+int r = pop_reg(REG_A0);
+int rd = get_push_reg(REG_A0);
+
+  add_instr(INSTR_LOAD | INSTR_VOLATILE, R(r), R(rd), "%s $%s, 0($%s)", instr, NAME(rd), NAME(r));
+  push_reg(rd);
+
+  return 0;
+}
+
+int MIPS::memory_write(const char *instr)
+{
+int value = pop_reg(REG_A1);
+int address = pop_reg(REG_A0);
+
+  add_instr(INSTR_STORE | INSTR_VOLATILE, R(value) | R(address), 0, "%s $%s, 0($%s)", instr, NAME(value), NAME(address));
+
+  return 0;
+}
+
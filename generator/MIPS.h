@@ -14,19 +14,37 @@
 
 #include "Generator.h"
 
+enum
+{
+  PIC32MX250F128B,
+  PIC32MX795F512L,
+};
+
+#define MIPS_MAX_BLOCK 64
+
+struct mips_instr_t
+{
+  char text[64];
+  uint64_t uses;      // bit n is register n, bit 32 is hi/lo
+  uint64_t defs;
+  int flags;
+};
+
 class MIPS : public Generator
 {
 public:
-  MIPS();
+  MIPS(uint8_t chip_type);
   virtual ~MIPS();
 
   virtual int open(char *filename);
+  virtual void label(char *name);
 
   //virtual void serial_init();
-  virtual void method_start(int local_count, const char *name);
+  virtual void method_start(int local_count, int param_count, const char *name);
   virtual void method_end(int local_count);
   virtual int push_integer(int32_t n);
   virtual int push_integer_local(int index);
+  virtual int set_integer_local(int index, int value);
   virtual int push_long(int64_t n);
   virtual int push_float(float f);
   virtual int push_double(double f);
@@ -36,6 +54,8 @@ public:
   virtual int pop();
   virtual int dup();
   virtual int dup2();
+  virtual int dup_stack_slot(int slot);
+  virtual int get_stack_depth() { return reg + stack; }
   virtual int swap();
   virtual int add_integers();
   virtual int sub_integers();
@@ -43,15 +63,22 @@ public:
   virtual int div_integers();
   virtual int mod_integers();
   virtual int neg_integer();
+  virtual int integer_to_byte();
+  virtual int integer_to_short();
+  virtual int integer_to_char();
   virtual int shift_left_integer();
+  virtual int shift_left_integer(int const_val);
   virtual int shift_right_integer();
+  virtual int shift_right_integer(int const_val);
   virtual int shift_right_uinteger();
+  virtual int shift_right_uinteger(int const_val);
   virtual int and_integer();
   virtual int or_integer();
   virtual int xor_integer();
   virtual int inc_integer(int index, int num);
   virtual int jump_cond(const char *label, int cond);
   virtual int jump_cond_integer(const char *label, int cond);
+  virtual int jump_cond_integer(const char *label, int cond, int const_val);
   virtual int return_local(int index, int local_count);
   virtual int return_integer(int local_count);
   virtual int return_void(int local_count);
@@ -63,17 +90,75 @@ public:
 
   // GPIO functions
   virtual int ioport_setPinsAsInput(int port);
+  virtual int ioport_setPinsAsInput(int port, int const_val);
   virtual int ioport_setPinsAsOutput(int port);
+  virtual int ioport_setPinsAsOutput(int port, int const_val);
   virtual int ioport_setPinsValue(int port);
+  virtual int ioport_setPinsValue(int port, int const_val);
   virtual int ioport_setPinsHigh(int port);
+  virtual int ioport_setPinsHigh(int port, int const_val);
   virtual int ioport_setPinsLow(int port);
+  virtual int ioport_setPinsLow(int port, int const_val);
   virtual int ioport_setPinAsOutput(int port);
+  virtual int ioport_setPinAsOutput(int port, int const_val);
   virtual int ioport_setPinAsInput(int port);
+  virtual int ioport_setPinAsInput(int port, int const_val);
   virtual int ioport_setPinHigh(int port);
+  virtual int ioport_setPinHigh(int port, int const_val);
   virtual int ioport_setPinLow(int port);
+  virtual int ioport_setPinLow(int port, int const_val);
   virtual int ioport_isPinInputHigh(int port);
   virtual int ioport_getPortInputValue(int port);
   //virtual int ioport_setPortOutputValue(int port);
+
+  // SPI functions
+  virtual int spi_init(int port);
+  virtual int spi_init(int port, int clock_divisor, int mode);
+  virtual int spi_send(int port);
+  virtual int spi_read(int port);
+  virtual int spi_isDataAvailable(int port);
+  virtual int spi_isBusy(int port);
+  virtual int spi_disable(int port);
+  virtual int spi_enable(int port);
+
+  // CPU functions
+  virtual int cpu_nop();
+
+  // Memory
+  virtual int memory_read8();
+  virtual int memory_write8();
+  virtual int memory_read16();
+  virtual int memory_write16();
+
+private:
+  void add_instr(int flags, uint64_t uses, uint64_t defs, const char *fmt, ...);
+  void flush();
+  int pop_reg(int temp);
+  int get_push_reg(int temp);
+  void push_reg(int r);
+  void load_const(int r, int32_t n);
+  int stack_alu(const char *instr, uint64_t defs);
+  int stack_unary(const char *instr, const char *operand);
+  int stack_div(const char *instr);
+  int branch(const char *instr, int rs, int rt, const char *label);
+  void method_return();
+  int get_port_address(int port, int reg_offset);
+  int set_periph(int port, int reg_offset);
+  int set_periph(int port, int reg_offset, int const_val);
+  int set_periph_pin(int port, int reg_offset);
+  int memory_read(const char *instr);
+  int memory_write(const char *instr);
+
+  mips_instr_t block[MIPS_MAX_BLOCK];
+  int block_len;
+  int reg;            // count number of registers are are using as stack
+  int reg_max;        // size of register stack
+  int stack;          // count how many things we put on the stack
+  uint8_t chip_type;
+  uint32_t port_base;
+  uint32_t port_stride;
+  uint32_t ram_top;
+  uint32_t devcfg1;
 };
 
 #endif
@@ -15,6 +15,7 @@
 #include <stdint.h>
 
 #include "MSP430.h"
+#include "liveness.h"
 
 // ABI is:
 // r4 top of stack
@@ -22,40 +23,66 @@
 // r6
 // r7
 // r8
-// r9
-// r10
-// r11 top of stack
-// r12 points to locals
+// r9 end of stack
+// r10 first parameter
+// r11 second parameter
+// r12 points to locals (or is the 7th stack register with static frames)
+// r13 third parameter
 // r15 is temp
 
 // Function calls:
-// Push params left to right:  add_nums(a,b) =
+// The first 3 params go in r10, r11, r13 and stay there as the called
+// method's locals 0 to 2.  The rest are copied below SP into the called
+// method's frame:  add_nums(a,b,c,d,e) =
 //
-// [   ] <-- SP
+// [ e ] -4(r12)
+// [ d ] -2(r12) (a, b and c are in r10, r11 and r13)
+// [r12] <-- r12
 // [ret]
 //  ...   (push used registers :( )
-// [ b ]
-// [ a ]
 //
-// ret value is r15
+// r10, r11 and r13 are saved by the caller.  ret value is r15
+//
+// The MSP430X large model calls with calla and returns with reta so code
+// can be anywhere in the 20 bit address space.  The return address is 2
+// words on the stack.  Everything else (data, the stack, the frame) is
+// still in the first 64k so the rest of the code doesn't change.
+//
+// Methods that never touch r12 don't set up a frame and the rest only do
+// it on the paths that need it (see Generator::place_frame()).
 
-#define REG_STACK(a) (a + 4)
-#define LOCALS(a) ((a * 2) + 2)
+#define REG_STACK(a) (stack_regs[a])
+#define LOCALS(a) (((a) * 2) + 2)
 
 // FIXME - This isn't quite right
 //                                EQ    NE     LESS  LESS EQ GR   GR E
 static const char *cond_str[] = { "jz", "jnz", "jl", "jle", "jg", "jge" };
 //                                                    rev    rev
+static const char *ucond_str[] = { "jz", "jnz", "jlo", "jls", "jhi", "jhs" };
+//                                                      rev    rev
+static int8_t arg_regs[] = { 10, 11, 13 };
+// r12 is only on the stack with static frames
+static int8_t stack_regs[] = { 4, 5, 6, 7, 8, 9, 12 };
 
 MSP430::MSP430(uint8_t chip_type) :
   reg(0),
   reg_max(6),
   stack(0),
   label_count(0),
+  arg_count(0),
+  param_count(0),
+  method_spills(0),
+  frame_base(0),
+  frames_start(0),
   need_read_spi(0),
   need_mul_integers(0),
   need_div_integers(0),
-  is_main(0)
+  need_div_uintegers(0),
+  is_main(0),
+  large_model(0),
+  has_mpy(0),
+  include_file("msp430x2xx.inc"),
+  read_spi("_read_spi")
 {
   switch(chip_type)
   {
@@ -67,101 +94,47 @@ MSP430::MSP430(uint8_t chip_type) :
       flash_start = 0xc000;
       stack_start = 0x0400;
       break;
+    case MSP430FR5969:
+      flash_start = 0x4400;
+      stack_start = 0x2400;
+      has_mpy = 1;
+      break;
     default:
       flash_start = 0xf800;
       stack_start = 0x0280;
   }
+
+  ram_start = chip_type == MSP430FR5969 ? 0x1c00 : 0x0200;
 }
 
 MSP430::~MSP430()
 {
-  if (need_read_spi)
-  {
-    fprintf(out, "; _read_spi(r15)\n");
-    fprintf(out, "_read_spi:\n");
-    fprintf(out, "  mov.b r15, &USISRL\n");
-    fprintf(out, "  mov.b #8, &USICNT\n");
-    fprintf(out, "_read_spi_wait:\n");
-    fprintf(out, "  bit.b #USIIFG, &USICTL1\n");
-    fprintf(out, "  jz _read_spi_wait\n");
-    fprintf(out, "  mov.b &USISRL, r15\n");
-    fprintf(out, "  ret\n\n");
-  }
-  if (need_mul_integers)
-  {
-    fprintf(out, "; _mul a * b\n");
-    fprintf(out, "_mul_integers:\n");
-    fprintf(out, "  clr r7\n");
-    fprintf(out, "  mov r7, r15\n");
-    fprintf(out, "  mov r7, r6\n");
-    fprintf(out, "  tst r4\n");
-    fprintf(out, "  jge _mul2\n");
-    fprintf(out, "  mov #-1, r6\n");
-    fprintf(out, "  jmp _mul2\n");
-    fprintf(out, "_mul6:\n");
-    fprintf(out, "  add r4, r15\n");
-    fprintf(out, "  addc r6, r7\n");
-    fprintf(out, "_mul1:\n");
-    fprintf(out, "  rla r4\n");
-    fprintf(out, "  rlc r6\n");
-    fprintf(out, "_mul2:\n");
-    fprintf(out, "  rra r5\n");
-    fprintf(out, "  jc _mul5\n");
-    fprintf(out, "  jne _mul1\n");
-    fprintf(out, "  jmp _mul4\n");
-    fprintf(out, "_mul5:\n");
-    fprintf(out, "  sub r4, r15\n");
-    fprintf(out, "  subc r6, r7\n");
-    fprintf(out, "_mul3:\n");
-    fprintf(out, "  rla r4\n");
-    fprintf(out, "  rlc r6\n");
-    fprintf(out, "  rra r5\n");
-    fprintf(out, "  jnc _mul6\n");
-    fprintf(out, "  cmp #0FFFFh, r5\n");
-    fprintf(out, "  jne _mul3\n");
-    fprintf(out, "_mul4:\n");
-    fprintf(out, "  mov r15, r4\n");
-    fprintf(out, "  ret\n\n");
-  }
-
-  if (need_div_integers)
-  {
-    fprintf(out, "; _div a / b (remainder in r7)\n");
-    fprintf(out, "_div_integers:\n");
-    fprintf(out, "  mov #16, r6\n");
-    fprintf(out, "  clr r7\n");
-    fprintf(out, "_div1:\n");
-    fprintf(out, "  rla r4\n");
-    fprintf(out, "  rlc r7\n");
-    fprintf(out, "  bis #1, r4\n");
-    fprintf(out, "  sub r5, r7\n");
-    fprintf(out, "  jge _div2\n");
-    fprintf(out, "  add r5, r7\n");
-    fprintf(out, "  bic #1, r4\n");
-    fprintf(out, "_div2:\n");
-    fprintf(out, "  dec r6\n");
-    fprintf(out, "  jnz _div1\n");
-    fprintf(out, "  ret\n");
-  }
-
-  fprintf(out, ".org 0xfffe\n");
-  fprintf(out, "  dw start\n\n");
+  write_helpers();
+
+  if (!relocatable)
+  {
+    emit(".org 0xfffe\n");
+    emit("  dw start\n\n");
+  }
 }
 
 int MSP430::open(char *filename)
 {
   if (Generator::open(filename) != 0) { return -1; }
 
-  // For now we only support a specific chip
-  fprintf(out, ".msp430\n");
-  fprintf(out, ".include \"msp430x2xx.inc\"\n\n");
+  emit(".msp430\n");
+  emit(".include \"%s\"\n\n", include_file);
+
+  // Startup code is the linker's job for an object file
+  if (relocatable) { return 0; }
 
   // Add any set up items (stack, registers, etc)
-  fprintf(out, ".org 0x%04x\n", flash_start);
-  fprintf(out, "start:\n");
-  fprintf(out, "  mov.w #(WDTPW|WDTHOLD), &WDTCTL\n");
-  fprintf(out, "  mov.w #0x%04x, SP\n", stack_start);
-  fprintf(out, "  jmp main\n\n");
+  emit(".org 0x%04x\n", flash_start);
+  emit("start:\n");
+  emit("  mov.w #(WDTPW|WDTHOLD), &WDTCTL\n");
+  emit("  mov.w #0x%04x, SP\n", stack_start);
+  write_init();
+  emit(large_model ? "  bra #main\n\n" : "  jmp main\n\n");
 
   return 0;
 }
@@ -172,27 +145,125 @@ void MSP430::serial_init()
 }
 #endif
 
-void MSP430::method_start(int local_count, const char *name)
+void MSP430::method_start(int local_count, int param_count, const char *name)
 {
+int start;
+
   reg = 0;
   stack = 0;
 
   is_main = (strcmp(name, "main") == 0) ? 1 : 0;
 
+  this->param_count = param_count;
+  arg_count = param_count;
+  if (arg_count > (int)sizeof(arg_regs)) { arg_count = sizeof(arg_regs); }
+  if (is_main) { arg_count = 0; }
+
+  method_spills = spill_count;
+
+  if (relocatable) { write_c_entry(name, param_count); }
+
   // main() function goes here
-  fprintf(out, "%s:\n", name);
-  if (!is_main) { fprintf(out, "  push r12\n"); }
-  fprintf(out, "  mov.w SP, r12\n");
-  fprintf(out, "  sub.w #0x%x, SP\n", local_count * 2);
+  emit("%s:\n", name);
+
+  if (static_frames)
+  {
+    frame_base = frames_start + call_graph->get_node(call_graph->find(name))->frame_offset;
+    return;
+  }
+
+  start = instr_count;
+  if (!is_main) { emit("  push r12\n"); }
+  emit("  mov.w SP, r12\n");
+  if (local_count > arg_count)
+  {
+    emit("  sub.w #0x%x, SP\n", (local_count - arg_count) * 2);
+  }
+  mark_prologue(start);
+}
+
+// C code passes params in r12 to r15 and then on the stack, wants the
+// result in r12 and expects r4 to r10 to be kept.  Java methods take
+// them in r10, r11, r13 and below SP, return in r15 and change any of
+// r4 to r11, so in an object file each one gets a java_<name> entry
+// point for C to call.
+void MSP430::write_c_entry(const char *name, int param_count)
+{
+uint32_t clobber = get_clobber(name);
+int ret = large_model ? 4 : 2;
+int saved = 0;
+int n;
+
+  emit(".global java_%s\n", name);
+  emit("java_%s:\n", name);
+
+  // C keeps 20 bit pointers in them with the large model
+  if (large_model)
+  {
+    emit("  pushm.a #7, r10\n");
+    saved = 7 * 4;
+  }
+    else
+  {
+    for (n = 4; n <= 10; n++)
+    {
+      if ((clobber & (1 << n)) == 0) { continue; }
+      emit("  push r%d\n", n);
+      saved += 2;
+    }
+  }
+
+  // r13 goes to r11 before r14 goes to r13.  Params past arg_regs go
+  // where invoke_static_method() would put them.
+  for (n = 0; n < param_count; n++)
+  {
+    if (n < (int)sizeof(arg_regs))
+    {
+      emit("  mov.w r%d, r%d\n", 12 + n, arg_regs[n]);
+    }
+      else
+    if (n < 4)
+    {
+      emit("  mov.w r%d, -%d(SP)\n", 12 + n, ((n - (int)sizeof(arg_regs)) * 2) + ret + 4);
+    }
+      else
+    {
+      emit("  mov.w %d(SP), -%d(SP)\n", ret + saved + ((n - 4) * 2), ((n - (int)sizeof(arg_regs)) * 2) + ret + 4);
+    }
+  }
+
+  emit("  %s #%s\n", large_model ? "calla" : "call", name);
+  emit("  mov.w r15, r12\n");
+
+  if (large_model)
+  {
+    emit("  popm.a #7, r10\n");
+  }
+    else
+  {
+    for (n = 10; n >= 4; n--)
+    {
+      if ((clobber & (1 << n)) == 0) { continue; }
+      emit("  pop r%d\n", n);
+    }
+  }
+
+  emit("  %s\n\n", large_model ? "reta" : "ret");
 }
 
 void MSP430::method_end(int local_count)
 {
-  fprintf(out, "\n");
+  // The frame is set up on entry if anything spilled (returns throw the
+  // spills away by restoring SP from r12) or params came in the frame.
+  place_frame(is_main || spill_count != method_spills || param_count > arg_count);
+
+  emit("\n");
 }
 
 int MSP430::push_integer(int32_t n)
 {
+char dst[16];
+
   if (n > 65535 || n < -32768)
   {
     printf("Error: literal value %d bigger than 16 bit.\n", n);
@@ -203,13 +274,15 @@ int MSP430::push_integer(int32_t n)
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov.w #0x%02x, r%d\n", value, REG_STACK(reg));
+    sprintf(dst, "r%d", REG_STACK(reg));
+    write_immediate("mov", 'w', value, dst);
     reg++;
   }
     else
   {
-    fprintf(out, "  push #0x%02x\n", value);
+    emit("  push #0x%02x\n", value);
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -217,20 +290,20 @@ int MSP430::push_integer(int32_t n)
 
 int MSP430::push_integer_local(int index)
 {
-  //fprintf(out, "  mov.w r12, r15\n");
-  //fprintf(out, "  sub.w #0x%02x, r15\n", LOCALS(index));
+char local[16];
+
+  get_local(local, index);
 
   if (reg < reg_max)
   {
-    //fprintf(out, "  mov.w @r15, r%d\n", REG_STACK(reg));
-    fprintf(out, "  mov.w -%d(r12), r%d\n", LOCALS(index), REG_STACK(reg));
+    emit("  mov.w %s, r%d\n", local, REG_STACK(reg));
     reg++;
   }
     else
   {
-    //fprintf(out, "  push @r15\n");
-    fprintf(out, "  push -%d(r12)\n", LOCALS(index));
+    emit("  push %s\n", local);
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -256,18 +329,21 @@ int MSP430::push_double(double f)
 
 int MSP430::push_byte(int8_t b)
 {
+  char dst[16];
   int16_t n = b;
   uint16_t value = (n & 0xffff);
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov #0x%02x, r%d\n", value, REG_STACK(reg));
+    sprintf(dst, "r%d", REG_STACK(reg));
+    write_immediate("mov", 'w', value, dst);
     reg++;
   }
     else
   {
-    fprintf(out, "  push #0x%02x\n", value);
+    emit("  push #0x%02x\n", value);
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -275,17 +351,20 @@ int MSP430::push_byte(int8_t b)
 
 int MSP430::push_short(int16_t s)
 {
+  char dst[16];
   uint16_t value = (s & 0xffff);
 
   if (reg < reg_max)
   {
-    fprintf(out, "  mov #0x%02x, r%d\n", value, REG_STACK(reg));
+    sprintf(dst, "r%d", REG_STACK(reg));
+    write_immediate("mov", 'w', value, dst);
     reg++;
   }
     else
   {
-    fprintf(out, "  push #0x%02x\n", value);
+    emit("  push #0x%02x\n", value);
     stack++;
+    spill_count++;
   }
 
   return 0;
@@ -293,15 +372,19 @@ int MSP430::push_short(int16_t s)
 
 int MSP430::pop_integer_local(int index)
 {
+char local[16];
+
+  get_local(local, index);
+
   if (stack > 0)
   {
-    fprintf(out, "  pop -%d(r12)\n", LOCALS(index));
+    emit("  pop %s\n", local);
     stack--;
   }
     else
   if (reg > 0)
   {
-    fprintf(out, "  mov.w r%d, -%d(r12)\n", REG_STACK(reg-1), LOCALS(index));
+    emit("  mov.w r%d, %s\n", REG_STACK(reg-1), local);
     reg--;
   }
 
@@ -310,9 +393,12 @@ int MSP430::pop_integer_local(int index)
 
 int MSP430::set_integer_local(int index, int value)
 {
+char local[16];
+
   // Optimization to remove Java stack operations
   if (value < -32768 || value > 0xffff) { return -1; }
-  fprintf(out, "  mov.w #%d, -%d(r12)\n", value, LOCALS(index));
+  get_local(local, index);
+  write_immediate("mov", 'w', value, local);
 
   return 0;
 }
@@ -321,7 +407,7 @@ int MSP430::pop()
 {
   if (stack > 0)
   {
-    fprintf(out, "  pop r15\n");
+    emit("  pop r15\n");
     stack--;
   }
     else
@@ -337,20 +423,42 @@ int MSP430::dup()
 {
   if (stack > 0)
   {
-    fprintf(out, "  push @SP\n");
+    emit("  push @SP\n");
+    stack++;
+    spill_count++;
+  }
+    else
+  if (reg == reg_max)
+  {
+    emit("  push r%d\n", REG_STACK(reg-1));
     stack++;
+    spill_count++;
   }
     else
+  {
+    emit("  mov.w r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg));
+    reg++;
+  }
+  return 0;
+}
+
+int MSP430::dup_stack_slot(int slot)
+{
+  // Only slots held in registers can be copied without a memory access
+  if (slot >= reg) { return -1; }
+
   if (reg == reg_max)
   {
-    fprintf(out, "  push r%d\n", REG_STACK(reg-1));
+    emit("  push r%d\n", REG_STACK(slot));
     stack++;
+    spill_count++;
   }
     else
   {
-    fprintf(out, "  mov.w r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg));
+    emit("  mov.w r%d, r%d\n", REG_STACK(slot), REG_STACK(reg));
     reg++;
   }
+
   return 0;
 }
 
@@ -364,22 +472,22 @@ int MSP430::swap()
 {
   if (stack == 0)
   {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w r%d, r%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
-    fprintf(out, "  mov.w r15, r%d\n", REG_STACK(reg-2));
+    emit("  mov.w r%d, r15\n", REG_STACK(reg-1));
+    emit("  mov.w r%d, r%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
+    emit("  mov.w r15, r%d\n", REG_STACK(reg-2));
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w @SP, r%d\n", REG_STACK(reg-1));
-    fprintf(out, "  mov.w r15, 0(SP)\n");
+    emit("  mov.w r%d, r15\n", REG_STACK(reg-1));
+    emit("  mov.w @SP, r%d\n", REG_STACK(reg-1));
+    emit("  mov.w r15, 0(SP)\n");
   }
     else
   {
-    fprintf(out, "  mov.w (2)SP, r15\n");
-    fprintf(out, "  mov.w @SP, 2(SP)\n");
-    fprintf(out, "  mov.w r15, 0(SP)\n");
+    emit("  mov.w (2)SP, r15\n");
+    emit("  mov.w @SP, 2(SP)\n");
+    emit("  mov.w r15, 0(SP)\n");
   }
 
   return 0;
@@ -390,237 +498,180 @@ int MSP430::add_integers()
   return stack_alu("add");
 }
 
+int MSP430::add_integers(int const_val)
+{
+  return stack_alu("add", const_val);
+}
+
 int MSP430::sub_integers()
 {
   return stack_alu("sub");
 }
 
-int MSP430::mul_integers()
+int MSP430::sub_integers(int const_val)
 {
-int n;
-int saved_registers;
+  return stack_alu("sub", const_val);
+}
 
-  saved_registers = reg;
+int MSP430::mul_integers()
+{
+  need_mul_integers = 1;
 
-  if(saved_registers != 2)
-  {
-    for (n = 0; n < reg; n++)
-    {
-      fprintf(out, "  push r%d\n", REG_STACK(n));
-    }
-  }
+  return stack_helper("_mul_integers", 4, -1);
+}
 
-  if (stack == 0)
-  {
-    if(saved_registers != 2)
-    {
-      fprintf(out, "  mov r%d, r5\n", REG_STACK(reg-1));
-      fprintf(out, "  mov r%d, r4\n", REG_STACK(reg-2));
-    }
-    fprintf(out, "  call #_mul_integers\n");
-    reg--;
-  }
-    else
-  if (stack == 1)
-  {
-    fprintf(out, "  mov r15, r5\n");
-    fprintf(out, "  mov r%d, r4\n", REG_STACK(reg-1));
-    fprintf(out, "  call #_mul_integers\n");
-    stack--;
-  }
-    else
-  {
-    fprintf(out, "  mov r15, r5\n");
-    fprintf(out, "  mov @SP, r4\n");
-    fprintf(out, "  call #_mul_integers\n");
-  }
+int MSP430::mul_integers(int const_val)
+{
+  return stack_superopt("mul", const_val);
+}
 
-  if(saved_registers != 2)
-  {
-    for (n = saved_registers-1; n >= 0; n--)
-    {
-      fprintf(out, "  pop r%d\n", REG_STACK(n));
-    }
-  }
+int MSP430::div_integers()
+{
+  need_div_integers = 1;
 
-  need_mul_integers = 1;
+  return stack_helper("_div_integers", 4, -1);
+}
 
-  return 0;
+int MSP430::div_integers(int const_val)
+{
+  return stack_div_const(const_val, false, false);
 }
 
-int MSP430::div_integers()
+int MSP430::div_integers_unsigned()
 {
-int n;
-int saved_registers;
+  need_div_uintegers = 1;
 
-  saved_registers = reg;
+  return stack_helper("_div_uintegers", 4, -1);
+}
 
-  if(saved_registers != 2)
-  {
-    for (n = 0; n < saved_registers; n++)
-    {
-      fprintf(out, "  push r%d\n", REG_STACK(n));
-    }
-  }
+int MSP430::div_integers_unsigned(int const_val)
+{
+  return stack_div_const(const_val, false, true);
+}
 
-  if (stack == 0)
-  {
-    if(saved_registers != 2)
-    {
-      fprintf(out, "  mov r%d, r5\n", REG_STACK(reg-1));
-      fprintf(out, "  mov r%d, r4\n", REG_STACK(reg-2));
-    }
-    fprintf(out, "  call #_div_integers\n");
-    reg--;
-  }
-    else
-  if (stack == 1)
-  {
-    fprintf(out, "  mov r15, r5\n");
-    fprintf(out, "  mov r%d, r4\n", REG_STACK(reg-1));
-    fprintf(out, "  call #_div_integers\n");
-    stack--;
-  }
-    else
-  {
-    fprintf(out, "  mov r15, r5\n");
-    fprintf(out, "  mov @SP, r4\n");
-    fprintf(out, "  call #_div_integers\n");
-  }
+int MSP430::mod_integers()
+{
+  need_div_integers = 1;
 
-  if(saved_registers != 2)
-  {
-    for (n = saved_registers-1; n >= 0; n--)
-    {
-      fprintf(out, "  pop r%d\n", REG_STACK(n));
-    }
-  }
+  return stack_helper("_div_integers", 7, -1);
+}
 
-  need_div_integers = 1;
+int MSP430::mod_integers(int const_val)
+{
+  return stack_div_const(const_val, true, false);
+}
 
-  return 0;
+int MSP430::mod_integers_unsigned()
+{
+  need_div_uintegers = 1;
+
+  return stack_helper("_div_uintegers", 7, -1);
 }
 
-int MSP430::mod_integers()
+int MSP430::mod_integers_unsigned(int const_val)
 {
-  return -1;
+  return stack_div_const(const_val, true, true);
 }
 
-int MSP430::neg_integer()
+int MSP430::div_mod_integers(bool div_first, bool is_unsigned)
 {
-  if (stack > 0)
-  {
-    fprintf(out, "  neg.w @SP\n");
-    stack--;
-  }
-    else
-  {
-    fprintf(out, "  neg.w r%d\n", REG_STACK(reg-1));
-  }
+  if (is_unsigned) { need_div_uintegers = 1; }
+  else { need_div_integers = 1; }
 
-  return 0;
+  // The one that's used first goes on top
+  return stack_helper(is_unsigned ? "_div_uintegers" : "_div_integers",
+    div_first ? 7 : 4, div_first ? 4 : 7);
 }
 
-int MSP430::shift_left_integer()
+// a / d and a % d from one reciprocal multiply.  A power of 2 is cheap
+// enough to do twice.
+int MSP430::div_mod_integers(int const_val, bool div_first, bool is_unsigned)
 {
-  // FIXME - for MSP430x, this can be sped up
-  if (stack > 0)
-  {
-    fprintf(out, "  pop r15\n");
-    stack--;
-  }
-    else
-  if (reg > 0)
-  {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
-  }
+char dst[16];
+int divisor = const_val < 0 ? -const_val : const_val;
 
-  fprintf(out, "label_%d:\n", label_count);
+  if (divisor == 0 || divisor > 0x8000) { return -1; }
+  if ((divisor & (divisor - 1)) == 0) { return -1; }
 
-  if (stack > 0)
-  {
-    fprintf(out, "  rla.w @SP\n");
-  }
-    else
+  if (stack > 0) { strcpy(dst, "0(SP)"); }
+  else { sprintf(dst, "r%d", REG_STACK(reg-1)); }
+
+  if (write_quotient(dst, divisor, is_unsigned) != 0) { return -1; }
+
+  emit("  mov.w r15, r14\n");
+  write_sub_product(dst, divisor);
+
+  if (const_val < 0)
   {
-    fprintf(out, "  rla.w r%d\n", REG_STACK(reg-1));
+    emit("  inv.w r14\n");
+    emit("  inc.w r14\n");
   }
 
-  fprintf(out, "  dec.w r15\n");
-  fprintf(out, "  jnz label_%d\n", label_count);
+  push_reg("r14");
 
-  label_count++;
+  // The one that's used first goes on top
+  if (!div_first) { return swap(); }
 
   return 0;
 }
 
-int MSP430::shift_right_integer()
+// There is no neg instruction, -a is ~a + 1
+int MSP430::neg_integer()
 {
-  // FIXME - for MSP430x, this can be sped up
-  if (stack > 0)
-  {
-    fprintf(out, "  pop r15\n");
-    stack--;
-  }
-    else
-  if (reg > 0)
-  {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
-  }
+char dst[16];
 
-  fprintf(out, "label_%d:\n", label_count);
+  if (stack > 0) { strcpy(dst, "0(SP)"); }
+  else { sprintf(dst, "r%d", REG_STACK(reg-1)); }
 
-  if (stack > 0)
-  {
-    fprintf(out, "  rra.w @SP\n");
-  }
-    else
-  {
-    fprintf(out, "  rra.w r%d\n", REG_STACK(reg-1));
-  }
+  emit("  inv.w %s\n", dst);
+  emit("  inc.w %s\n", dst);
 
-  fprintf(out, "  dec.w r15\n");
-  fprintf(out, "  jnz label_%d\n", label_count);
+  return 0;
+}
 
-  label_count++;
+int MSP430::integer_to_byte()
+{
+  return stack_superopt("i2b", 0);
+}
 
-  return 0;
+int MSP430::integer_to_short()
+{
+  return stack_superopt("i2s", 0);
 }
 
-int MSP430::shift_right_uinteger()
+int MSP430::integer_to_char()
 {
-  // FIXME - for MSP430x, this can be sped up
-  if (stack > 0)
-  {
-    fprintf(out, "  pop r15\n");
-    stack--;
-  }
-    else
-  if (reg > 0)
-  {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
-  }
+  return stack_superopt("i2c", 0);
+}
 
-  fprintf(out, "label_%d:\n", label_count);
+int MSP430::shift_left_integer()
+{
+  return stack_shift("rla");
+}
 
-  if (stack > 0)
-  {
-    fprintf(out, "  rra.w @SP\n");
-  }
-    else
-  {
-    fprintf(out, "  rra.w r%d\n", REG_STACK(reg-1));
-  }
+int MSP430::shift_left_integer(int const_val)
+{
+  return stack_shift_const("rla", const_val);
+}
+
+int MSP430::shift_right_integer()
+{
+  return stack_shift("rra");
+}
 
-  fprintf(out, "  dec.w r15\n");
-  fprintf(out, "  jnz label_%d\n", label_count);
+int MSP430::shift_right_integer(int const_val)
+{
+  return stack_shift_const("rra", const_val);
+}
 
-  label_count++;
+int MSP430::shift_right_uinteger()
+{
+  return stack_shift("rru");
+}
 
-  return 0;
+int MSP430::shift_right_uinteger(int const_val)
+{
+  return stack_shift_const("rru", const_val);
 }
 
 int MSP430::and_integer()
@@ -628,9 +679,26 @@ int MSP430::and_integer()
   return stack_alu("and");
 }
 
+int MSP430::and_integer(int const_val)
+{
+  // A byte op on a register clears the upper byte so a mask of 0xff or
+  // less can be and.b (0xff is just mov.b and 0xfe is bic.b #1).
+  if (stack == 0 && const_val >= 0 && const_val <= 0xff)
+  {
+    return stack_alu_byte("and", const_val);
+  }
+
+  return stack_alu("and", const_val);
+}
+
 int MSP430::or_integer()
 {
-  return stack_alu("or");
+  return stack_alu("bis");
+}
+
+int MSP430::or_integer(int const_val)
+{
+  return stack_alu("bis", const_val);
 }
 
 int MSP430::xor_integer()
@@ -638,53 +706,83 @@ int MSP430::xor_integer()
   return stack_alu("xor");
 }
 
-int MSP430::inc_integer(int index, int num)
+int MSP430::xor_integer(int const_val)
 {
-  fprintf(out, "  add.w #%d, -%d(r12)\n", num, LOCALS(index));
-  return 0;
+  return stack_alu("xor", const_val);
 }
 
-int MSP430::jump_cond(const char *label, int cond)
+int MSP430::or_integer_byte(int const_val)
 {
-bool reverse = false;
+  return stack_alu_byte("bis", const_val);
+}
 
-  // MSP430 doesn't have LESS_EQUAL or GREATER so change them
-  if (cond == COND_LESS_EQUAL)
-  {
-    reverse = true;
-    cond = COND_GREATER_EQUAL;
-    fprintf(out, "  mov.w #0, r15\n");
-  }
-    else
-  if (cond == COND_GREATER)
-  {
-    reverse = true;
-    cond = COND_LESS;
-    fprintf(out, "  mov.w #0, r15\n");
-  }
+int MSP430::xor_integer_byte(int const_val)
+{
+  return stack_alu_byte("xor", const_val);
+}
 
-  if (stack > 0)
+int MSP430::extract_bits_integer(int shift, int width)
+{
+  return stack_superopt("bits", (shift << 8) | width);
+}
+
+int MSP430::inc_integer(int index, int num)
+{
+char local[16];
+
+  get_local(local, index);
+  write_immediate("add", 'w', num, local);
+  return 0;
+}
+
+int MSP430::jump_cond(const char *label, int cond)
+{
+char dst[16];
+int value = 0;
+
+  // MSP430 doesn't have LESS_EQUAL or GREATER so compare with 1 instead
+  // of 0 (x <= 0 is x < 1).  1 comes from the constant generator.
+  if (cond == COND_LESS_EQUAL)
   {
-    fprintf(out, "  add.w #2, SP\n");
-    if (reverse == false) { fprintf(out, "  cmp.w #0, -2(SP)\n"); }
-    else { fprintf(out, "  cmp.w -2(SP), r15\n"); }
-    stack--;
+    cond = COND_LESS;
+    value = 1;
   }
     else
+  if (cond == COND_GREATER)
   {
-    if (reverse == false)
-    { fprintf(out, "  cmp.w #0, r%d\n", REG_STACK(reg-1));}
-      else
-    { fprintf(out, "  cmp.w r%d, r15\n", REG_STACK(reg-1));}
-    reg--;
+    cond = COND_GREATER_EQUAL;
+    value = 1;
   }
 
-  fprintf(out, "  %s %s\n", cond_str[cond], label);
+  pop_reg(dst);
+  write_immediate("cmp", 'w', value, dst);
+
+  emit("  %s %s\n", cond_str[cond], label);
 
   return 0;
 }
 
 int MSP430::jump_cond_integer(const char *label, int cond)
+{
+  return cmp_integers(label, cond, cond_str);
+}
+
+int MSP430::jump_cond_integer(const char *label, int cond, int const_val)
+{
+  return cmp_integers(label, cond, const_val, cond_str);
+}
+
+int MSP430::jump_cond_integer_unsigned(const char *label, int cond)
+{
+  return cmp_integers(label, cond, ucond_str);
+}
+
+int MSP430::jump_cond_integer_unsigned(const char *label, int cond, int const_val)
+{
+  return cmp_integers(label, cond, const_val, ucond_str);
+}
+
+int MSP430::cmp_integers(const char *label, int cond, const char **cond_table)
 {
 bool reverse = false;
 
@@ -703,21 +801,21 @@ bool reverse = false;
 
   if (stack > 1)
   {
-    fprintf(out, "  add.w #4, SP\n");
+    emit("  add.w #4, SP\n");
 
-    if (reverse == false) { fprintf(out, "  cmp.w -4(SP), -2(SP)\n"); }
-    else { fprintf(out, "  cmp.w -2(SP), -4(SP)\n"); }
+    if (reverse == false) { emit("  cmp.w -4(SP), -2(SP)\n"); }
+    else { emit("  cmp.w -2(SP), -4(SP)\n"); }
 
     stack -= 2;
   }
     else
   if (stack == 1)
   {
-    fprintf(out, "  add.w #2, SP\n");
+    emit("  add.w #2, SP\n");
     if (reverse == false)
-    { fprintf(out, "  cmp.w -2(SP), r%d\n", REG_STACK(reg-1)); }
+    { emit("  cmp.w -2(SP), r%d\n", REG_STACK(reg-1)); }
       else
-    { fprintf(out, "  cmp.w r%d, -2(SP)\n", REG_STACK(reg-1)); }
+    { emit("  cmp.w r%d, -2(SP)\n", REG_STACK(reg-1)); }
 
     stack--;
     reg--;
@@ -726,69 +824,161 @@ bool reverse = false;
   {
     if (reverse == false)
     {
-      fprintf(out, "  cmp.w r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-2));
+      emit("  cmp.w r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-2));
     }
       else
     {
-      fprintf(out, "  cmp.w r%d, r%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
+      emit("  cmp.w r%d, r%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
     }
 
     reg -= 2;
   }
 
-  fprintf(out, "  %s %s\n", cond_str[cond], label);
+  emit("  %s %s\n", cond_table[cond], label);
 
   return 0;
 }
 
-int MSP430::jump_cond_integer(const char *label, int cond, int const_val)
+int MSP430::cmp_integers(const char *label, int cond, int const_val, const char **cond_table)
 {
-bool reverse = false;
+char dst[16];
+int min = (cond_table == ucond_str) ? 0 : -32768;
+int max = (cond_table == ucond_str) ? 0xffff : 32767;
 
-  // MSP430 doesn't have LESS_EQUAL or GREATER so change them
-  if (cond == COND_LESS_EQUAL)
+  if (const_val < min || const_val > max) { return -1; }
+
+  // MSP430 doesn't have LESS_EQUAL or GREATER so compare with the next
+  // constant instead (x <= 7 is x < 8)
+  if (cond == COND_LESS_EQUAL || cond == COND_GREATER)
   {
-    reverse = true;
-    cond = COND_GREATER_EQUAL;
+    if (const_val == max) { return -1; }
+    cond = (cond == COND_LESS_EQUAL) ? COND_LESS : COND_GREATER_EQUAL;
+    const_val++;
+  }
+
+  pop_reg(dst);
+  write_immediate("cmp", 'w', const_val, dst);
+
+  emit("  %s %s\n", cond_table[cond], label);
+
+  return 0;
+}
+
+int MSP430::extend_integer(bool is_unsigned)
+{
+char value[16];
+char dst[16];
+
+  if (is_unsigned) { return push_integer(0); }
+
+  get_stack_operand(value, 0);
+
+  if (reg < reg_max)
+  {
+    sprintf(dst, "r%d", REG_STACK(reg));
   }
     else
-  if (cond == COND_GREATER)
   {
-    reverse = true;
-    cond = COND_LESS;
+    strcpy(dst, "r15");
   }
 
-  if (stack >= 1)
+  // rla puts the sign in carry and subc of a register from itself gives
+  // -1 when carry is clear, so inverting that is 0 or -1 from the sign.
+  emit("  mov.w %s, %s\n", value, dst);
+  emit("  rla.w %s\n", dst);
+  emit("  subc.w %s, %s\n", dst, dst);
+  emit("  inv.w %s\n", dst);
+
+  if (reg < reg_max)
   {
-    return -1;
+    reg++;
   }
     else
   {
-    if (reverse == false)
+    emit("  push r15\n");
+    stack++;
+    spill_count++;
+  }
+
+  return 0;
+}
+
+int MSP430::add_integers_32()
+{
+  return stack_alu_32("add", "addc");
+}
+
+int MSP430::sub_integers_32()
+{
+  return stack_alu_32("sub", "subc");
+}
+
+int MSP430::jump_cond_integer_32(const char *label, int cond)
+{
+char lo[16];
+char hi[16];
+char value_lo[16];
+char value_hi[16];
+int n;
+
+  pop_reg_32(lo, hi);
+  get_stack_operand(value_hi, 0);
+  get_stack_operand(value_lo, 1);
+
+  // The flags from sub / subc of all 32 bits give jl and jge.  For
+  // LESS_EQUAL and GREATER the subtract is done the other way around.
+  switch(cond)
+  {
+    case COND_EQUAL:
+    case COND_NOT_EQUAL:
+      emit("  xor.w %s, %s\n", value_lo, lo);
+      emit("  xor.w %s, %s\n", value_hi, hi);
+      emit("  bis.w %s, %s\n", lo, hi);
+      emit("  tst.w %s\n", hi);
+      break;
+    case COND_LESS:
+    case COND_GREATER_EQUAL:
+      emit("  sub.w %s, %s\n", lo, value_lo);
+      emit("  subc.w %s, %s\n", hi, value_hi);
+      break;
+    case COND_LESS_EQUAL:
+    case COND_GREATER:
+      emit("  sub.w %s, %s\n", value_lo, lo);
+      emit("  subc.w %s, %s\n", value_hi, hi);
+      cond = (cond == COND_GREATER) ? COND_LESS : COND_GREATER_EQUAL;
+      break;
+    default:
+      return -1;
+  }
+
+  // pop doesn't change the flags
+  for (n = 0; n < 2; n++)
+  {
+    if (stack > 0)
     {
-      fprintf(out, "  cmp.w #%d, r%d\n", const_val, REG_STACK(reg-1));
+      emit("  pop r15\n");
+      stack--;
     }
       else
     {
-      //fprintf(out, "  cmp.w r%d, r%d\n", REG_STACK(reg-2), REG_STACK(reg-1));
-      return -1;
+      reg--;
     }
-
-    reg -= 1;
   }
 
-  fprintf(out, "  %s %s\n", cond_str[cond], label);
+  emit("  %s %s\n", cond_str[cond], label);
 
   return 0;
 }
 
 int MSP430::return_local(int index, int local_count)
 {
-  fprintf(out, "  mov.w -%d(w12), r15\n", LOCALS(index));
+char local[16];
+
+  get_local(local, index);
+  emit("  mov.w %s, r15\n", local);
 
-  fprintf(out, "  mov.w r12, SP\n");
-  if (!is_main) { fprintf(out, "  pop r12\n"); }
-  fprintf(out, "  ret\n");
+  frame_end();
+  emit("  %s\n", large_model ? "reta" : "ret");
 
   return 0;
 }
@@ -797,34 +987,32 @@ int MSP430::return_integer(int local_count)
 {
   if (stack > 0)
   {
-    fprintf(out, "  pop.w @SP, r15\n");
+    emit("  pop r15\n");
     stack--;
   }
     else
   {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg - 1));
+    emit("  mov.w r%d, r15\n", REG_STACK(reg - 1));
     reg--;
   }
 
-  fprintf(out, "  mov.w r12, SP\n");
-  if (!is_main) { fprintf(out, "  pop r12\n"); }
-  fprintf(out, "  ret\n");
+  frame_end();
+  emit("  %s\n", large_model ? "reta" : "ret");
 
   return 0;
 }
 
 int MSP430::return_void(int local_count)
 {
-  fprintf(out, "  mov r12, SP\n");
-  if (!is_main) { fprintf(out, "  pop r12\n"); }
-  fprintf(out, "  ret\n");
+  frame_end();
+  emit("  %s\n", large_model ? "reta" : "ret");
 
   return 0;
 }
 
 int MSP430::jump(const char *name)
 {
-  fprintf(out, "  jmp %s\n", name);
+  emit("  jmp %s\n", name);
   return 0;
 }
 
@@ -832,89 +1020,111 @@ int MSP430::call(const char *name)
 {
   // FIXME - do we need to push the register stack?
   // This is for the Java instruction jsr.
-  fprintf(out, "  call #%s\n", name);
+  emit("  %s #%s\n", large_model ? "calla" : "call", name);
   return 0;
 }
 
 int MSP430::invoke_static_method(const char *name, int params, int is_void)
 {
-int local;
-int stack_vars = stack;
-int reg_vars = reg;
-int saved_registers;
+uint32_t clobber = get_clobber(name);
+char src[16];
+int saved[16];
+int saved_count = 0;
+int stack_params;
+int reg_params;
+int frame = 0;
 int n;
 
   printf("invoke_static_method() name=%s params=%d is_void=%d\n", name, params, is_void);
 
-  // Push all used registers on the stack except the ones that are pulled
-  // out for parameters.
-  saved_registers = reg - (params - stack);
-  for (n = 0; n < saved_registers; n++)
+  // The params are the top of the Java stack so any that were spilled
+  // are on the hardware stack and the rest are the last used registers.
+  stack_params = (params < stack) ? params : stack;
+  reg_params = params - stack_params;
+
+  // Push the registers still holding stack values that the called
+  // method can change.  This method's own register params are pushed if
+  // they are read again after the call and the call changes them (either
+  // the called method does or they're loaded with its params).
+  for (n = 0; n < reg - reg_params; n++)
+  {
+    if ((clobber & (1 << REG_STACK(n))) == 0) { continue; }
+    saved[saved_count++] = REG_STACK(n);
+  }
+
+  for (n = 0; n < arg_count; n++)
   {
-    fprintf(out, "  push r%d\n", REG_STACK(n));
+    if (!is_local_live(live_locals, n)) { continue; }
+    if (n >= params && (clobber & (1 << arg_regs[n])) == 0) { continue; }
+    saved[saved_count++] = arg_regs[n];
   }
 
-  // Push pointer to local variables to the stack because the called
-  // method will trash it.
-  //fprintf(out, "  push r12\n");
+  push_regs(saved, saved_count);
+
+  // First params go in registers, the rest are copied below SP so they
+  // are local variables in the called method.  Start at -6 because the
+  // return address will be at -2 and r12 at -4 (-8 with the 2 word
+  // return address of calla).  With static frames they go straight into
+  // the called method's frame.
+  if (static_frames)
+  {
+    frame = frames_start + call_graph->get_node(call_graph->find(name))->frame_offset;
+  }
 
-  // Copy parameters onto the stack so they are local variables in
-  // the called method.  Start with -4 because the return address will
-  // be at 0 and r12 will be at 2.
-  local = (params * -2);
-  while(local != 0)
+  for (n = 0; n < params; n++)
   {
-    if (stack_vars > 0)
+    if (n >= reg_params)
     {
-      fprintf(out, "  mov.w %d(SP), %d(SP)\n", stack_vars, local-4);
-      stack_vars--;
+      sprintf(src, "%d(SP)", (params - 1 - n + saved_count) * 2);
     }
       else
     {
-      fprintf(out, "  mov.w r%d, %d(SP)\n", REG_STACK(reg_vars-1), local-4);
-      reg_vars--;
+      sprintf(src, "r%d", REG_STACK(reg - reg_params + n));
     }
 
-    local += 2;
+    if (n < (int)sizeof(arg_regs))
+    {
+      emit("  mov.w %s, r%d\n", src, arg_regs[n]);
+    }
+      else
+    if (static_frames)
+    {
+      emit("  mov.w %s, &0x%04x\n", src, frame + (n - (int)sizeof(arg_regs)) * 2);
+    }
+      else
+    {
+      emit("  mov.w %s, -%d(SP)\n", src, ((n - (int)sizeof(arg_regs)) * 2) + (large_model ? 8 : 6));
+    }
   }
 
   // Make the call
-  fprintf(out, "  call #%s\n", name);
-
-  // Pop the local variables pointer
-  //fprintf(out, "  pop r12\n");
+  emit("  %s #%s\n", large_model ? "calla" : "call", name);
 
-  // Pop all used registers off the stack
-  for (n = saved_registers-1; n >= 0; n--)
-  {
-    fprintf(out, "  pop r%d\n", REG_STACK(n));
-  }
+  // Pop all saved registers off the stack
+  pop_regs(saved, saved_count);
 
   // Pop all params off the Java stack
-  if ((stack - stack_vars) > 0)
+  if (stack_params > 0)
   {
-    fprintf(out, "  sub.w #%d, SP\n", (stack - stack_vars) * 2);
-    params -= (stack - stack_vars);
+    emit("  add.w #%d, SP\n", stack_params * 2);
+    stack -= stack_params;
   }
 
-  if (params != 0)
-  {
-    reg -= params;
-  }
+  reg -= reg_params;
 
   if (!is_void)
   {
     // Put r15 on the top of the stack
     if (reg < reg_max)
     {
-      fprintf(out, "  mov.w r15, r%d\n", REG_STACK(reg));
+      emit("  mov.w r15, r%d\n", REG_STACK(reg));
       reg++;
     }
       else
     {
-      // REVIEW - This looks wrong
-      fprintf(out, "  push r15\n");
+      emit("  push r15\n");
       stack++;
+      spill_count++;
     }
   }
 
@@ -929,8 +1139,8 @@ int MSP430::brk()
 #if 0
 void MSP430::close()
 {
-  fprintf(out, "    .org 0xfffe\n");
-  fprintf(out, "    dw start\n");
+  emit("    .org 0xfffe\n");
+  emit("    dw start\n");
 }
 #endif
 
@@ -945,8 +1155,8 @@ int MSP430::ioport_setPinsAsInput(int port)
 int MSP430::ioport_setPinsAsInput(int port, int const_val)
 {
   char periph[32];
-  sprintf(periph, "P%dDIR", port+1);
-  fprintf(out, "  bic.b #%d, &%s\n", const_val, periph);
+  sprintf(periph, "&P%dDIR", port+1);
+  write_immediate("bic", 'b', const_val, periph);
   return 0;
 }
 
@@ -960,8 +1170,8 @@ int MSP430::ioport_setPinsAsOutput(int port)
 int MSP430::ioport_setPinsAsOutput(int port, int const_val)
 {
   char periph[32];
-  sprintf(periph, "P%dDIR", port+1);
-  fprintf(out, "  bis.b #%d, &%s\n", const_val, periph);
+  sprintf(periph, "&P%dDIR", port+1);
+  write_immediate("bis", 'b', const_val, periph);
   return 0;
 }
 
@@ -975,8 +1185,8 @@ int MSP430::ioport_setPinsValue(int port)
 int MSP430::ioport_setPinsValue(int port, int const_val)
 {
   char periph[32];
-  sprintf(periph, "P%dOUT", port+1);
-  fprintf(out, "  mov.b #%d, &%s\n", const_val, periph);
+  sprintf(periph, "&P%dOUT", port+1);
+  write_immediate("mov", 'b', const_val, periph);
   return 0;
 }
 
@@ -987,6 +1197,14 @@ int MSP430::ioport_setPinsHigh(int port)
   return set_periph("bis", periph);
 }
 
+int MSP430::ioport_setPinsHigh(int port, int const_val)
+{
+  char periph[32];
+  sprintf(periph, "&P%dOUT", port+1);
+  write_immediate("bis", 'b', const_val, periph);
+  return 0;
+}
+
 int MSP430::ioport_setPinsLow(int port)
 {
   char periph[32];
@@ -994,6 +1212,14 @@ int MSP430::ioport_setPinsLow(int port)
   return set_periph("bic", periph);
 }
 
+int MSP430::ioport_setPinsLow(int port, int const_val)
+{
+  char periph[32];
+  sprintf(periph, "&P%dOUT", port+1);
+  write_immediate("bic", 'b', const_val, periph);
+  return 0;
+}
+
 int MSP430::ioport_setPinAsOutput(int port)
 {
   return -1;
@@ -1029,13 +1255,13 @@ int MSP430::ioport_setPortOutputValue(int port)
 {
   if (stack == 0)
   {
-    fprintf(out, "  mov.b r%d, &P%dOUT\n", REG_STACK(reg-1), port+1);
+    emit("  mov.b r%d, &P%dOUT\n", REG_STACK(reg-1), port+1);
     reg--;
   }
     else
   {
-    fprintf(out, "  pop.w r15\n");
-    fprintf(out, "  mov.b r15, &P%dOUT\n", port+1);
+    emit("  pop.w r15\n");
+    emit("  mov.b r15, &P%dOUT\n", port+1);
     stack--;
   }
 
@@ -1075,49 +1301,49 @@ int MSP430::spi_init(int port)
   if (port != 0) { return -1; }
 
   char dst[16];
-  fprintf(out, "  ;; Set up SPI\n");
-  fprintf(out, "  mov.b #(USIPE7|USIPE6|USIPE5|USIMST|USIOE|USISWRST), &USICTL0\n");
+  emit("  ;; Set up SPI\n");
+  emit("  mov.b #(USIPE7|USIPE6|USIPE5|USIMST|USIOE|USISWRST), &USICTL0\n");
   pop_reg(dst);
-  fprintf(out, "  mov.b %s, r14\n", dst);
-  fprintf(out, "  rrc.b r14\n");
-  fprintf(out, "  rrc.b r14\n");
-  fprintf(out, "  and.b #0x80, r14 ; CPHA/USICKPH\n");
-  //fprintf(out, "  mov.b #USICKPH, &USICTL1\n");
-  fprintf(out, "  mov.b r14, &USICTL1\n");
-  //fprintf(out, "  mov.b #(USIDIV_7|USISSEL_2), &USICKCTL ; div 128, SMCLK\n");
-  fprintf(out, "  mov.b %s, r14\n", dst);
-  fprintf(out, "  and.b #0x02, r14\n");
+  emit("  mov.b %s, r14\n", dst);
+  emit("  rrc.b r14\n");
+  emit("  rrc.b r14\n");
+  emit("  and.b #0x80, r14 ; CPHA/USICKPH\n");
+  //emit("  mov.b #USICKPH, &USICTL1\n");
+  emit("  mov.b r14, &USICTL1\n");
+  //emit("  mov.b #(USIDIV_7|USISSEL_2), &USICKCTL ; div 128, SMCLK\n");
+  emit("  mov.b %s, r14\n", dst);
+  emit("  and.b #0x02, r14\n");
   pop_reg(dst);
   // If this came off the stack, let's put it in a register, if not let's
   // just use the register.
   if (dst[0] != 'r')
   {
-    fprintf(out, "  mov.b %s, r15\n", dst);
+    emit("  mov.b %s, r15\n", dst);
     strcpy(dst, "r15");
   }
-  fprintf(out, "  rrc.b %s\n", dst);
-  fprintf(out, "  rrc.b %s\n", dst);
-  fprintf(out, "  rrc.b %s\n", dst);
-  fprintf(out, "  rrc.b %s\n", dst);
-  fprintf(out, "  and.b #0xe0, %s\n", dst);
-  fprintf(out, "  bis.b %s, r14\n", dst);
-  fprintf(out, "  bis.b #USISSEL_2, r14\n");
-  fprintf(out, "  mov.b r14, &USICKCTL ; DIV and CPOL/USICKPL\n");
-  fprintf(out, "  bic.b #USISWRST, &USICTL0      ; clear reset\n\n");
+  emit("  rrc.b %s\n", dst);
+  emit("  rrc.b %s\n", dst);
+  emit("  rrc.b %s\n", dst);
+  emit("  rrc.b %s\n", dst);
+  emit("  and.b #0xe0, %s\n", dst);
+  emit("  bis.b %s, r14\n", dst);
+  emit("  bis.b #USISSEL_2, r14\n");
+  emit("  mov.b r14, &USICKCTL ; DIV and CPOL/USICKPL\n");
+  emit("  bic.b #USISWRST, &USICTL0      ; clear reset\n\n");
 
   return 0;
 }
 
 int MSP430::spi_init(int port, int clock_divisor, int mode)
 {
-  fprintf(out, "  ;; Set up SPI\n");
-  fprintf(out, "  mov.b #(USIPE7|USIPE6|USIPE5|USIMST|USIOE|USISWRST), &USICTL0\n");
-  fprintf(out, "  mov.b #%s, &USICTL1\n",
-    (mode & 1) == 0 ? "0":"|USICKPH");
-  fprintf(out, "  mov.b #USIDIV_%d|USISSEL_2%s, &USICKCTL\n",
+  emit("  ;; Set up SPI\n");
+  emit("  mov.b #(USIPE7|USIPE6|USIPE5|USIMST|USIOE|USISWRST), &USICTL0\n");
+  if ((mode & 1) == 0) { emit("  clr.b &USICTL1\n"); }
+  else { emit("  mov.b #USICKPH, &USICTL1\n"); }
+  emit("  mov.b #USIDIV_%d|USISSEL_2%s, &USICKCTL\n",
     clock_divisor,
     (mode & 2) == 0 ? "":"|USICKPL");
-  fprintf(out, "  bic.b #USISWRST, &USICTL0      ; clear reset\n\n");
+  emit("  bic.b #USISWRST, &USICTL0      ; clear reset\n\n");
 
   return 0;
 }
@@ -1129,8 +1355,8 @@ int MSP430::spi_send(int port)
   char dst[16];
   pop_reg(dst);
 
-  fprintf(out, "  mov.b %s, r15\n", dst);
-  fprintf(out, "  call #_read_spi\n");
+  emit("  mov.b %s, r15\n", dst);
+  emit("  %s #_read_spi\n", large_model ? "calla" : "call");
   push_reg("r15");
 
   need_read_spi = 1;
@@ -1142,7 +1368,7 @@ int MSP430::spi_read(int port)
 {
   if (port != 0) { return -1; }
 
-  fprintf(out, "  call #_read_spi\n");
+  emit("  %s #_read_spi\n", large_model ? "calla" : "call");
   push_reg("r15");
 
   need_read_spi = 1;
@@ -1154,8 +1380,8 @@ int MSP430::spi_isDataAvailable(int port)
 {
   if (port != 0) { return -1; }
 
-  fprintf(out, "  mov.b &USICTL1, r15\n");
-  fprintf(out, "  and.b #USIIFG, r15\n");
+  emit("  mov.b &USICTL1, r15\n");
+  emit("  and.b #USIIFG, r15\n");
   push_reg("r15");
 
   return 0;
@@ -1170,7 +1396,7 @@ int MSP430::spi_disable(int port)
 {
   if (port != 0) { return -1; }
 
-  fprintf(out, "  bic.b #USIPE7|USIPE6|USIPE5, &USICTL0\n");
+  emit("  bic.b #USIPE7|USIPE6|USIPE5, &USICTL0\n");
 
   return 0;
 }
@@ -1179,7 +1405,7 @@ int MSP430::spi_enable(int port)
 {
   if (port != 0) { return -1; }
 
-  fprintf(out, "  bis.b #USIPE7|USIPE6|USIPE5, &USICTL0\n");
+  emit("  bis.b #USIPE7|USIPE6|USIPE5, &USICTL0\n");
 
   return 0;
 }
@@ -1187,17 +1413,17 @@ int MSP430::spi_enable(int port)
 // CPU functions
 int MSP430::cpu_setClock16()
 {
-  fprintf(out, "  ;; Set MCLK to 16 MHz with DCO\n");
-  fprintf(out, "  mov.b #DCO_4, &DCOCTL\n");
-  fprintf(out, "  mov.b #RSEL_15, &BCSCTL1\n");
-  fprintf(out, "  mov.b #0, &BCSCTL2\n\n");
+  emit("  ;; Set MCLK to 16 MHz with DCO\n");
+  emit("  mov.b #DCO_4, &DCOCTL\n");
+  emit("  mov.b #RSEL_15, &BCSCTL1\n");
+  emit("  clr.b &BCSCTL2\n\n");
 
   return 0;
 }
 
 int MSP430::cpu_nop()
 {
-  fprintf(out, "  nop\n");
+  emit("  nop\n");
 
   return 0;
 }
@@ -1207,11 +1433,11 @@ int MSP430::memory_read8()
 {
   if (stack != 0)
   {
-    fprintf(out, "  mov.b @SP, 0(SP)\n");
+    emit("  mov.b @SP, 0(SP)\n");
   }
     else
   {
-    fprintf(out, "  mov.b @r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  mov.b @r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
   }
 
   return 0;
@@ -1221,22 +1447,22 @@ int MSP430::memory_write8()
 {
   if (stack >= 2)
   {
-    fprintf(out, "  mov.w 2(SP), r15\n");
-    fprintf(out, "  mov.b @SP, 0(r15)\n");
-    fprintf(out, "  sub.w #4, SP\n");
+    emit("  mov.w 2(SP), r15\n");
+    emit("  mov.b @SP, 0(r15)\n");
+    emit("  add.w #4, SP\n");
     stack -= 2;
   }
     else
   if (stack == 1)
   {
-    //fprintf(out, "  mov.w @SP, 0(r%d)\n\n", REG_STACK(reg-1));
-    fprintf(out, "  pop.b 0(r%d)\n", REG_STACK(reg-1));
+    //emit("  mov.w @SP, 0(r%d)\n\n", REG_STACK(reg-1));
+    emit("  pop.b 0(r%d)\n", REG_STACK(reg-1));
     reg--;
     stack--;
   }
     else
   {
-    fprintf(out, "  mov.b r%d, 0(r%d)\n", REG_STACK(reg-1), REG_STACK(reg-2));
+    emit("  mov.b r%d, 0(r%d)\n", REG_STACK(reg-1), REG_STACK(reg-2));
     reg -= 2;
   }
 
@@ -1247,11 +1473,11 @@ int MSP430::memory_read16()
 {
   if (stack != 0)
   {
-    fprintf(out, "  mov.w @SP, 0(SP)\n");
+    emit("  mov.w @SP, 0(SP)\n");
   }
     else
   {
-    fprintf(out, "  mov.w @r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
+    emit("  mov.w @r%d, r%d\n", REG_STACK(reg-1), REG_STACK(reg-1));
   }
 
   return 0;
@@ -1261,96 +1487,1073 @@ int MSP430::memory_write16()
 {
   if (stack >= 2)
   {
-    fprintf(out, "  mov.w 2(SP), r15\n");
-    fprintf(out, "  mov.w @SP, 0(r15)\n");
-    fprintf(out, "  sub.w #4, SP\n");
+    emit("  mov.w 2(SP), r15\n");
+    emit("  mov.w @SP, 0(r15)\n");
+    emit("  add.w #4, SP\n");
     stack -= 2;
   }
     else
   if (stack == 1)
   {
-    //fprintf(out, "  mov.w @SP, 0(r%d)\n\n", REG_STACK(reg-1));
-    fprintf(out, "  pop 0(r%d)\n", REG_STACK(reg-1));
+    //emit("  mov.w @SP, 0(r%d)\n\n", REG_STACK(reg-1));
+    emit("  pop 0(r%d)\n", REG_STACK(reg-1));
     reg--;
     stack--;
   }
     else
   {
-    fprintf(out, "  mov.w r%d, 0(r%d)\n", REG_STACK(reg-1), REG_STACK(reg-2));
+    emit("  mov.w r%d, 0(r%d)\n", REG_STACK(reg-1), REG_STACK(reg-2));
     reg -= 2;
   }
 
   return 0;
 }
 
+int MSP430::math_abs()
+{
+  return stack_superopt("abs", 0);
+}
+
+int MSP430::math_min()
+{
+  return stack_superopt_binary("min");
+}
+
+int MSP430::math_max()
+{
+  return stack_superopt_binary("max");
+}
+
 // Protected functions
-void MSP430::push_reg(const char *dst)
+
+// Registers a method can change before counting what it calls: the
+// temps, as much of the register stack as its operand stack gets deep,
+// the multiply and divide helpers it calls, params it writes and the
+// registers it loads params into for the methods it calls.
+uint32_t MSP430::get_method_clobber(call_graph_node_t *node)
 {
-  if (reg < reg_max)
+uint32_t clobber = (1 << 14) | (1 << 15);
+runtime_t *entry;
+int params;
+int n, i;
+
+  for (n = 0; n < node->max_stack + node->int32_stack && n < reg_max; n++)
   {
-    fprintf(out, "  mov.w %s, r%d\n", dst, REG_STACK(reg));
-    reg++;
+    clobber |= 1 << REG_STACK(n);
   }
-    else
+
+  if ((node->flags & CALL_GRAPH_MUL) != 0)
   {
-    fprintf(out, "  push %s\n", dst);
-    stack++;
+    entry = find_runtime(table_runtime_msp430, "_mul_integers");
+    if (entry != NULL) { clobber |= entry->clobber; }
   }
-}
 
-void MSP430::pop_reg(char *dst)
-{
-  if (stack > 0)
+  if ((node->flags & CALL_GRAPH_DIV) != 0)
   {
-    stack--;
-    fprintf(out, "  pop r15\n");
-    sprintf(dst, "r15");
+    entry = find_runtime(table_runtime_msp430, "_div_integers");
+    if (entry != NULL) { clobber |= entry->clobber; }
+    entry = find_runtime(table_runtime_msp430, "_div_uintegers");
+    if (entry != NULL) { clobber |= entry->clobber; }
   }
-    else
+
+  for (n = 0; n < node->params && n < (int)sizeof(arg_regs); n++)
   {
-    reg--;
-    sprintf(dst, "r%d", REG_STACK(reg));
+    if ((node->stored_locals & (1 << n)) != 0) { clobber |= 1 << arg_regs[n]; }
+  }
+
+  for (i = 0; i < node->callee_count; i++)
+  {
+    params = call_graph->get_node(node->callees[i])->params;
+
+    for (n = 0; n < params && n < (int)sizeof(arg_regs); n++)
+    {
+      clobber |= 1 << arg_regs[n];
+    }
   }
+
+  return clobber;
 }
 
-int MSP430::set_periph(const char *instr, const char *periph)
+// Calls a runtime helper with the next value on the stack in r4 and the
+// top in r5 and replaces both with the result it leaves in register
+// result.  If result2 isn't -1 that register is pushed on top after it
+// (the quotient and remainder from one divide).  Only registers still
+// holding stack values that the helper changes are saved.
+int MSP430::stack_helper(const char *name, int result, int result2)
 {
+runtime_t *entry = find_runtime(table_runtime_msp430, name);
+uint32_t clobber = (1 << 4) | (1 << 5);
+char a[16];
+char b[16];
+char dst[16];
+int saved[16];
+int saved_count = 0;
+int live;
+int n;
+
+  clobber |= (entry != NULL) ? entry->clobber : 0xffff;
+
+  // Get the operands out from under anything that gets pushed
   if (stack == 0)
   {
-    fprintf(out, "  %s.b r%d, &%s\n", instr, REG_STACK(reg-1), periph);
-    reg--;
+    sprintf(a, "r%d", REG_STACK(reg-2));
+    sprintf(b, "r%d", REG_STACK(reg-1));
+    strcpy(dst, a);
+    live = reg - 2;
   }
     else
+  if (stack == 1)
   {
-    fprintf(out, "  pop.w r15\n");
-    fprintf(out, "  %s.b r15, &%s\n", instr, periph);
-    stack--;
+    emit("  pop r15\n");
+    sprintf(a, "r%d", REG_STACK(reg-1));
+    strcpy(b, "r15");
+    strcpy(dst, a);
+    live = reg - 1;
+  }
+    else
+  {
+    emit("  pop r15\n");
+    emit("  mov.w @SP, r14\n");
+    strcpy(a, "r14");
+    strcpy(b, "r15");
+    strcpy(dst, "0(SP)");
+    live = reg;
+  }
+
+  for (n = 0; n < live; n++)
+  {
+    if ((clobber & (1 << REG_STACK(n))) == 0) { continue; }
+    saved[saved_count++] = REG_STACK(n);
+  }
+
+  push_regs(saved, saved_count);
+
+  if (strcmp(a, "r4") != 0) { emit("  mov %s, r4\n", a); }
+  if (strcmp(b, "r5") != 0) { emit("  mov %s, r5\n", b); }
+  emit("  %s #%s\n", large_model ? "calla" : "call", name);
+
+  // r14 isn't on the register stack so nothing below can overwrite it
+  if (result2 != -1) { emit("  mov r%d, r14\n", result2); }
+
+  if (saved_count == 0)
+  {
+    sprintf(a, "r%d", result);
+    if (strcmp(dst, a) != 0) { emit("  mov %s, %s\n", a, dst); }
+  }
+    else
+  {
+    emit("  mov r%d, r15\n", result);
+    pop_regs(saved, saved_count);
+
+    emit("  mov r15, %s\n", dst);
   }
 
+  if (stack == 0) { reg--; }
+  else { stack--; }
+
+  if (result2 != -1) { push_reg("r14"); }
+
   return 0;
 }
 
-int MSP430::stack_alu(const char *instr)
+// a / d is the high word of a * magic shifted right where magic is
+// 2^(16 + shift) / d rounded up (Hacker's Delight chapter 10).  A signed
+// quotient also gets 1 added when a is negative so it rounds towards 0.
+// A magic number too big for the multiplier is used as magic - 2^16
+// with a added back in after.  Each one is checked against every 16 bit
+// a before it's used.
+static int32_t get_div_magic_quotient(int32_t a, int magic, int shift, bool is_unsigned)
 {
-  if (stack == 0)
+int32_t t;
+
+  if (is_unsigned)
   {
-    fprintf(out, "  %s.w r%d, r%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-2));
-    reg--;
+    if (magic <= 0xffff) { return ((uint32_t)a * magic) >> (16 + shift); }
+
+    t = ((uint32_t)a * (magic - 0x10000)) >> 16;
+    return (((a - t) >> 1) + t) >> (shift - 1);
   }
-    else
-  if (stack == 1)
+
+  if (magic <= 0x7fff) { t = (a * magic) >> 16; }
+  else { t = ((a * (magic - 0x10000)) >> 16) + a; }
+
+  return (t >> shift) + (a < 0 ? 1 : 0);
+}
+
+static int get_div_magic(int divisor, bool is_unsigned, int *magic, int *shift)
+{
+int32_t a, a_min, a_max;
+int m, s;
+
+  a_min = is_unsigned ? 0 : -0x8000;
+  a_max = is_unsigned ? 0xffff : 0x7fff;
+
+  for (s = 0; s < 16; s++)
   {
-    fprintf(out, "  pop r15\n");
-    fprintf(out, "  %s.w r15, r%d\n", instr, REG_STACK(reg-1));
-    stack--;
+    m = (1 << (16 + s)) / divisor + 1;
+
+    if (m > (is_unsigned ? 0x1ffff : 0xffff)) { return -1; }
+    if (is_unsigned && m > 0xffff && s == 0) { continue; }
+
+    for (a = a_min; a <= a_max; a++)
+    {
+      if (get_div_magic_quotient(a, m, s, is_unsigned) != a / divisor) { break; }
+    }
+
+    if (a > a_max)
+    {
+      *magic = m;
+      *shift = s;
+      return 0;
+    }
   }
-    else
+
+  return -1;
+}
+
+// Without the multiplier a / d is a * 2^(16 + shift) / d rounded up,
+// shifted back down, for an a from 0 to a_max (magic can be 17 bits).
+// The smallest shift keeps the multiply loop in write_quotient() short.
+static int get_div_reciprocal(int divisor, int a_max, int *magic, int *shift)
+{
+uint64_t m;
+int a, s;
+
+  for (s = 0; s <= 16; s++)
   {
-    fprintf(out, "  pop r15\n");
-    fprintf(out, "  %s.w r15, @SP\n", instr);
+    m = ((uint64_t)1 << (16 + s)) / divisor + 1;
+
+    if (m > 0x1ffff) { return -1; }
+
+    for (a = 0; a <= a_max; a++)
+    {
+      if ((int)(((uint64_t)a * m) >> (16 + s)) != a / divisor) { break; }
+    }
+
+    if (a > a_max)
+    {
+      *magic = (int)m;
+      *shift = s;
+      return 0;
+    }
   }
 
-  return 0;
+  return -1;
+}
+
+// Division by a constant power of 2 is a shift and the remainder is a
+// mask.  Java rounds the quotient towards 0 and gives the remainder the
+// sign of a so a negative a has 2^k - 1 added before the shift and its
+// remainder is masked from -a.  Other constants multiply by a reciprocal
+// (write_quotient()) and the remainder is a - q * d.  A negative d works
+// the same on -d since a / -d is -(a / d) and a % -d is a % d.
+int MSP430::stack_div_const(int const_val, bool is_mod, bool is_unsigned)
+{
+char dst[16];
+int divisor = const_val < 0 ? -const_val : const_val;
+int shift;
+
+  if (divisor == 0 || divisor > 0x8000) { return -1; }
+
+  if (stack > 0) { strcpy(dst, "0(SP)"); }
+  else { sprintf(dst, "r%d", REG_STACK(reg-1)); }
+
+  if ((divisor & (divisor - 1)) != 0)
+  {
+    if (write_quotient(dst, divisor, is_unsigned) != 0) { return -1; }
+
+    if (is_mod)
+    {
+      write_sub_product(dst, divisor);
+      return 0;
+    }
+
+    if (const_val < 0)
+    {
+      emit("  inv.w r15\n");
+      emit("  inc.w r15\n");
+    }
+
+    emit("  mov.w r15, %s\n", dst);
+    return 0;
+  }
+
+  for (shift = 0; (1 << shift) < divisor; shift++);
+
+  if (is_mod)
+  {
+    if (is_unsigned || divisor == 1)
+    {
+      write_immediate("and", 'w', divisor - 1, dst);
+      return 0;
+    }
+
+    emit("  tst %s\n", dst);
+    emit("  jge label_%d\n", label_count);
+    emit("  inv %s\n", dst);
+    emit("  inc %s\n", dst);
+    write_immediate("and", 'w', divisor - 1, dst);
+    emit("  inv %s\n", dst);
+    emit("  inc %s\n", dst);
+    emit("  jmp label_%d\n", label_count + 1);
+    emit("label_%d:\n", label_count);
+    write_immediate("and", 'w', divisor - 1, dst);
+    emit("label_%d:\n", label_count + 1);
+    label_count += 2;
+
+    return 0;
+  }
+
+  if (!is_unsigned && shift != 0)
+  {
+    emit("  tst %s\n", dst);
+    emit("  jge label_%d\n", label_count);
+    write_immediate("add", 'w', divisor - 1, dst);
+    emit("label_%d:\n", label_count);
+    label_count++;
+  }
+
+  write_shift_right(dst, shift, is_unsigned);
+
+  if (const_val < 0)
+  {
+    emit("  inv %s\n", dst);
+    emit("  inc %s\n", dst);
+  }
+
+  return 0;
+}
+
+// Leaves a / d rounded towards 0 in r15 with a (dst) left alone.  With
+// the multiplier it's the high word of a * magic.  Without it the same
+// product is built a bit at a time from the bottom of magic: a is added
+// in for each bit that's set and the sum shifted right through carry so
+// only the high word is ever kept.  That's around 30 cycles next to 200
+// or so for _div_integers.  A signed a is done as |a| with the sign put
+// back after.
+int MSP430::write_quotient(const char *dst, int divisor, bool is_unsigned)
+{
+const char *mpy = is_unsigned ? "&MPY" : "&MPYS";
+int magic, shift;
+int first, zeros, n;
+
+  if (runtime == RUNTIME_HWMULT &&
+      get_div_magic(divisor, is_unsigned, &magic, &shift) == 0)
+  {
+    emit("  mov.w %s, %s\n", dst, mpy);
+    emit("  mov.w #%d, &OP2\n", (int16_t)magic);
+    emit("  mov.w &RESHI, r15\n");
+
+    if (is_unsigned && magic > 0xffff)
+    {
+      // q = (((a - t) >> 1) + t) >> (shift - 1) so a - t can't overflow
+      emit("  mov.w %s, r14\n", dst);
+      emit("  sub.w r15, r14\n");
+      write_shift_right("r14", 1, true);
+      emit("  add.w r14, r15\n");
+      shift--;
+    }
+      else
+    if (!is_unsigned && magic > 0x7fff)
+    {
+      emit("  add.w %s, r15\n", dst);
+    }
+
+    write_shift_right("r15", shift, is_unsigned);
+
+    if (!is_unsigned)
+    {
+      // rla moves the sign of a into carry
+      emit("  mov.w %s, r14\n", dst);
+      emit("  rla.w r14\n");
+      emit("  adc.w r15\n");
+    }
+
+    return 0;
+  }
+
+  if (get_div_reciprocal(divisor, is_unsigned ? 0xffff : 0x8000, &magic, &shift) != 0)
+  {
+    return -1;
+  }
+
+  emit("  mov.w %s, r14\n", dst);
+
+  if (!is_unsigned)
+  {
+    emit("  tst.w r14\n");
+    emit("  jge label_%d\n", label_count);
+    emit("  inv.w r14\n");
+    emit("  inc.w r14\n");
+    emit("label_%d:\n", label_count);
+    label_count++;
+  }
+
+  for (first = 0; (magic & (1 << first)) == 0; first++);
+
+  // Each bit's shift is only done when the next bit that's set is added
+  // in so a run of 0 bits is one logical shift
+  emit("  mov.w r14, r15\n");
+  zeros = 1;
+
+  for (n = first + 1; n < 16 + shift; n++)
+  {
+    if ((magic & (1 << n)) == 0) { zeros++; continue; }
+
+    write_shift_right("r15", zeros, true);
+    emit("  add.w r14, r15\n");
+    emit("  rrc.w r15\n");
+    zeros = 0;
+  }
+
+  write_shift_right("r15", zeros, true);
+
+  if (!is_unsigned)
+  {
+    emit("  tst.w %s\n", dst);
+    emit("  jge label_%d\n", label_count);
+    emit("  inv.w r15\n");
+    emit("  inc.w r15\n");
+    emit("label_%d:\n", label_count);
+    label_count++;
+  }
+
+  return 0;
+}
+
+// dst -= r15 * divisor for the remainder.  Without the multiplier r15 is
+// shifted up to each bit of divisor that's set so it's lost.
+void MSP430::write_sub_product(const char *dst, int divisor)
+{
+int shift = 0;
+int n;
+
+  if (runtime == RUNTIME_HWMULT)
+  {
+    emit("  mov.w r15, &MPY\n");
+    emit("  mov.w #%d, &OP2\n", divisor);
+    emit("  sub.w &RESLO, %s\n", dst);
+    return;
+  }
+
+  for (n = 0; n < 16; n++)
+  {
+    if ((divisor & (1 << n)) == 0) { continue; }
+
+    write_rotate("rla", "r15", n - shift);
+    emit("  sub.w r15, %s\n", dst);
+    shift = n;
+  }
+}
+
+// Shifts the top of the stack by the count under it.  Java only uses
+// the low 5 bits of the count.  Anything from 16 to 31 shifts every bit
+// out so looping that many times still gives the right answer.
+int MSP430::stack_shift(const char *instr)
+{
+char dst[16];
+
+  if (stack > 0)
+  {
+    emit("  pop r15\n");
+    stack--;
+  }
+    else
+  {
+    emit("  mov.w r%d, r15\n", REG_STACK(reg-1));
+    reg--;
+  }
+
+  if (stack > 0) { strcpy(dst, "0(SP)"); }
+  else { sprintf(dst, "r%d", REG_STACK(reg-1)); }
+
+  emit("  and.w #0x1f, r15\n");
+  emit("  jz label_%d\n", label_count + 1);
+  emit("label_%d:\n", label_count);
+  write_rotate(instr, dst, 1);
+  emit("  dec.w r15\n");
+  emit("  jnz label_%d\n", label_count);
+  emit("label_%d:\n", label_count + 1);
+
+  label_count += 2;
+
+  return 0;
+}
+
+int MSP430::stack_shift_const(const char *instr, int const_val)
+{
+char dst[16];
+int count = const_val & 0x1f;
+
+  if (stack > 0) { strcpy(dst, "0(SP)"); }
+  else { sprintf(dst, "r%d", REG_STACK(reg-1)); }
+
+  if (count == 0) { return 0; }
+
+  if (strcmp(instr, "rla") == 0)
+  {
+    if (count >= 16) { emit("  clr.w %s\n", dst); }
+    else { write_shift_left(dst, count); }
+  }
+    else
+  if (strcmp(instr, "rra") == 0)
+  {
+    write_shift_right(dst, count >= 16 ? 15 : count, false);
+  }
+    else
+  {
+    if (count >= 16) { emit("  clr.w %s\n", dst); }
+    else { write_shift_right(dst, count, true); }
+  }
+
+  return 0;
+}
+
+// 8 or more starts with swpb which moves the low byte up in one
+// instruction.  A byte mov to a register clears the high byte.
+void MSP430::write_shift_left(const char *dst, int count)
+{
+  if (count >= 8)
+  {
+    if (dst[0] == 'r')
+    {
+      emit("  mov.b %s, %s\n", dst, dst);
+      emit("  swpb %s\n", dst);
+    }
+      else
+    {
+      emit("  swpb %s\n", dst);
+      emit("  clr.b %s\n", dst);
+    }
+
+    count -= 8;
+  }
+
+  write_rotate("rla", dst, count);
+}
+
+// Shifts dst right by a constant count.  8 or more starts with swpb
+// which moves the high byte down in one instruction.  Once the top bit
+// is 0 rra shifts in 0s so unsigned is the same as signed after that.
+void MSP430::write_shift_right(const char *dst, int count, bool is_unsigned)
+{
+  if (count >= 8)
+  {
+    emit("  swpb %s\n", dst);
+
+    if (!is_unsigned) { emit("  sxt %s\n", dst); }
+    else if (dst[0] == 'r') { emit("  mov.b %s, %s\n", dst, dst); }
+    else { emit("  and.w #0xff, %s\n", dst); }
+
+    write_rotate("rra", dst, count - 8);
+    return;
+  }
+
+  write_rotate(is_unsigned ? "rru" : "rra", dst, count);
+}
+
+// rla or rra count times.  rru is a logical shift right:  clrc and rrc
+// for the first bit then rra.
+void MSP430::write_rotate(const char *instr, const char *dst, int count)
+{
+int n;
+
+  if (count == 0) { return; }
+
+  if (strcmp(instr, "rru") == 0)
+  {
+    emit("  clrc\n");
+    emit("  rrc.w %s\n", dst);
+    instr = "rra";
+    count--;
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    emit("  %s.w %s\n", instr, dst);
+  }
+}
+
+int MSP430::get_frame_size(call_graph_node_t *node)
+{
+int size = node->max_locals + node->int32_locals;
+
+  // The first params stay in their registers
+  if (node->params < (int)sizeof(arg_regs)) { size -= node->params; }
+  else { size -= sizeof(arg_regs); }
+
+  return size < 0 ? 0 : size * 2;
+}
+
+// Bytes a method can push with static frames: its return address, every
+// stack value and register param saved or spilled at once, and the return
+// addresses of a runtime helper calling another (_div_integers).
+int MSP430::get_stack_size(call_graph_node_t *node)
+{
+int ret = large_model ? 4 : 2;
+
+  return (ret * 3) + (node->max_stack + node->int32_stack + (int)sizeof(arg_regs)) * 2;
+}
+
+// Frames go right below the deepest the stack can get so the start of
+// RAM is left for Memory.  r12 isn't needed to find them so it becomes
+// the 7th register of the stack.
+int MSP430::init_static_frames(int size)
+{
+int depth = call_graph->get_stack_depth();
+
+  if (relocatable)
+  {
+    printf("Static frames can't be used in an object file.\n");
+    return -1;
+  }
+
+  if (size + depth > stack_start - ram_start)
+  {
+    printf("Static frames need %d bytes and the stack %d but there are only %d bytes of RAM.\n",
+      size, depth, stack_start - ram_start);
+    return -1;
+  }
+
+  frames_start = stack_start - depth - size;
+
+  reg_max = sizeof(stack_regs);
+
+  return 0;
+}
+
+// Tears down the frame before a ret.  place_frame() drops it on paths
+// that never set the frame up.
+void MSP430::frame_end()
+{
+int start = instr_count;
+
+  // Without a frame pointer spills are thrown away by hand
+  if (static_frames)
+  {
+    if (stack > 0) { emit("  add.w #%d, SP\n", stack * 2); }
+    return;
+  }
+
+  emit("  mov.w r12, SP\n");
+  if (!is_main) { emit("  pop r12\n"); }
+  mark_epilogue(start);
+}
+
+int MSP430::get_branch(machine_instr_t *instr, const char **label)
+{
+int len = strlen(instr->operands);
+
+  *label = instr->operands;
+
+  if (strcmp(instr->opcode, "ret") == 0) { return BRANCH_RETURN; }
+  if (strcmp(instr->opcode, "reta") == 0) { return BRANCH_RETURN; }
+  if (strcmp(instr->opcode, "reti") == 0) { return BRANCH_RETURN; }
+  if (strcmp(instr->opcode, "jmp") == 0) { return BRANCH_ALWAYS; }
+  if (instr->opcode[0] == 'j') { return BRANCH_COND; }
+  if (strncmp(instr->opcode, "br", 2) == 0) { return BRANCH_UNKNOWN; }
+
+  // Anything else that writes PC is a computed jump
+  if (len >= 2 && strcmp(instr->operands + len - 2, "PC") == 0)
+  {
+    return BRANCH_UNKNOWN;
+  }
+
+  if (len >= 3 && strcmp(instr->operands + len - 3, " r0") == 0)
+  {
+    return BRANCH_UNKNOWN;
+  }
+
+  return BRANCH_NONE;
+}
+
+bool MSP430::uses_frame(machine_instr_t *instr)
+{
+  return strstr(instr->operands, "r12") != NULL;
+}
+
+// Operand for local variable index: a parameter register or the frame
+void MSP430::get_local(char *operand, int index)
+{
+  if (index < arg_count)
+  {
+    sprintf(operand, "r%d", arg_regs[index]);
+  }
+    else
+  {
+    if (static_frames)
+    {
+      sprintf(operand, "&0x%04x", frame_base + (index - arg_count) * 2);
+    }
+      else
+    {
+      sprintf(operand, "-%d(r12)", LOCALS(index - arg_count));
+    }
+  }
+}
+
+// Saves registers around a call.  pop_regs() restores them in reverse.
+void MSP430::push_regs(int *regs, int count)
+{
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    emit("  push r%d\n", regs[n]);
+  }
+}
+
+void MSP430::pop_regs(int *regs, int count)
+{
+int n;
+
+  for (n = count - 1; n >= 0; n--)
+  {
+    emit("  pop r%d\n", regs[n]);
+  }
+}
+
+// The helpers are written with call and ret.  In the large model those
+// are changed to calla and reta.  Each need_ flag is cleared as its
+// helper is written so calling this again writes nothing.
+void MSP430::write_helpers()
+{
+int start = instr_count;
+int n;
+
+  if (need_read_spi) { write_runtime(table_runtime_msp430, read_spi); }
+  if (need_mul_integers) { write_runtime(table_runtime_msp430, "_mul_integers"); }
+  if (need_div_integers) { write_runtime(table_runtime_msp430, "_div_integers"); }
+
+  // _div_integers calls this one
+  if (need_div_integers || need_div_uintegers)
+  {
+    write_runtime(table_runtime_msp430, "_div_uintegers");
+  }
+
+  need_read_spi = 0;
+  need_mul_integers = 0;
+  need_div_integers = 0;
+  need_div_uintegers = 0;
+
+  if (!large_model) { return; }
+
+  for (n = start; n < instr_count; n++)
+  {
+    if (instrs[n].type != MACHINE_INSTR) { continue; }
+
+    if (strcmp(instrs[n].opcode, "call") == 0) { strcpy(instrs[n].opcode, "calla"); }
+    else if (strcmp(instrs[n].opcode, "ret") == 0) { strcpy(instrs[n].opcode, "reta"); }
+  }
+}
+
+void MSP430::push_reg(const char *dst)
+{
+  if (reg < reg_max)
+  {
+    emit("  mov.w %s, r%d\n", dst, REG_STACK(reg));
+    reg++;
+  }
+    else
+  {
+    emit("  push %s\n", dst);
+    stack++;
+    spill_count++;
+  }
+}
+
+void MSP430::pop_reg(char *dst)
+{
+  if (stack > 0)
+  {
+    stack--;
+    emit("  pop r15\n");
+    sprintf(dst, "r15");
+  }
+    else
+  {
+    reg--;
+    sprintf(dst, "r%d", REG_STACK(reg));
+  }
+}
+
+// Pops a 32 bit int.  Spilled words come back in r14 (low) and r15
+// (high), a word in a stack register is used where it is.
+void MSP430::pop_reg_32(char *lo, char *hi)
+{
+  if (stack > 0)
+  {
+    stack--;
+    emit("  pop r15\n");
+    strcpy(hi, "r15");
+  }
+    else
+  {
+    reg--;
+    sprintf(hi, "r%d", REG_STACK(reg));
+  }
+
+  if (stack > 0)
+  {
+    stack--;
+    emit("  pop r14\n");
+    strcpy(lo, "r14");
+  }
+    else
+  {
+    reg--;
+    sprintf(lo, "r%d", REG_STACK(reg));
+  }
+}
+
+// Operand for the stack value n below the top
+void MSP430::get_stack_operand(char *operand, int n)
+{
+  if (n < stack)
+  {
+    sprintf(operand, "%d(SP)", n * 2);
+  }
+    else
+  {
+    sprintf(operand, "r%d", REG_STACK(reg - 1 - (n - stack)));
+  }
+}
+
+int MSP430::set_periph(const char *instr, const char *periph)
+{
+  if (stack == 0)
+  {
+    emit("  %s.b r%d, &%s\n", instr, REG_STACK(reg-1), periph);
+    reg--;
+  }
+    else
+  {
+    emit("  pop.w r15\n");
+    emit("  %s.b r15, &%s\n", instr, periph);
+    stack--;
+  }
+
+  return 0;
+}
+
+// Replace the top of the stack with a sequence from the superoptimizer
+// table.  r15 is the scratch register the sequence can use.
+int MSP430::stack_superopt(const char *idiom, int const_val)
+{
+superopt_t *entry;
+char value[16];
+
+  entry = find_superopt(table_superopt_msp430, idiom, const_val);
+  if (entry == NULL) { return -1; }
+
+  if (entry->count == 0) { return 0; }
+
+  if (stack > 0)
+  {
+    emit("  mov.w @SP, r14\n");
+    write_superopt(entry, "r14", "r15");
+    emit("  mov.w r14, 0(SP)\n");
+  }
+    else
+  {
+    sprintf(value, "r%d", REG_STACK(reg-1));
+    write_superopt(entry, value, "r15");
+  }
+
+  return 0;
+}
+
+// Same for min and max.  The top of the stack is %t and the value under
+// it is %r.
+int MSP430::stack_superopt_binary(const char *idiom)
+{
+superopt_t *entry;
+char value[16];
+char temp[16];
+
+  entry = find_superopt(table_superopt_msp430, idiom, 0);
+  if (entry == NULL) { return -1; }
+
+  if (stack == 0)
+  {
+    sprintf(value, "r%d", REG_STACK(reg-2));
+    sprintf(temp, "r%d", REG_STACK(reg-1));
+    write_superopt(entry, value, temp);
+    reg--;
+  }
+    else
+  if (stack == 1)
+  {
+    emit("  pop r15\n");
+    sprintf(value, "r%d", REG_STACK(reg-1));
+    write_superopt(entry, value, "r15");
+    stack--;
+  }
+    else
+  {
+    emit("  pop r15\n");
+    emit("  mov.w @SP, r14\n");
+    write_superopt(entry, "r14", "r15");
+    emit("  mov.w r14, 0(SP)\n");
+    stack--;
+  }
+
+  return 0;
+}
+
+int MSP430::stack_alu(const char *instr)
+{
+  if (stack == 0)
+  {
+    emit("  %s.w r%d, r%d\n", instr, REG_STACK(reg-1), REG_STACK(reg-2));
+    reg--;
+  }
+    else
+  if (stack == 1)
+  {
+    emit("  pop r15\n");
+    emit("  %s.w r15, r%d\n", instr, REG_STACK(reg-1));
+    stack--;
+  }
+    else
+  {
+    emit("  pop r15\n");
+    emit("  %s.w r15, 0(SP)\n", instr);
+    stack--;
+  }
+
+  return 0;
+}
+
+int MSP430::stack_alu(const char *instr, int const_val)
+{
+char dst[16];
+
+  if (const_val < -32768 || const_val > 0xffff) { return -1; }
+
+  if (stack > 0)
+  {
+    strcpy(dst, "0(SP)");
+  }
+    else
+  {
+    sprintf(dst, "r%d", REG_STACK(reg-1));
+  }
+
+  write_immediate(instr, 'w', const_val, dst);
+
+  return 0;
+}
+
+// instr.b with a constant on the top of the stack where both are 0 to
+// 255.  In a register the upper byte is cleared and on the stack it's
+// already 0.
+int MSP430::stack_alu_byte(const char *instr, int const_val)
+{
+char dst[16];
+
+  if (const_val < 0 || const_val > 0xff) { return -1; }
+
+  get_stack_operand(dst, 0);
+
+  // write_immediate() drops and #-1 since it wouldn't change a word
+  if (strcmp(instr, "and") == 0 && const_val == 0xff)
+  {
+    emit("  mov.b %s, %s\n", dst, dst);
+    return 0;
+  }
+
+  write_immediate(instr, 'b', const_val, dst);
+
+  return 0;
+}
+
+// The top 2 stack values are a 32 bit int (high word on top) that gets
+// added to or subtracted from the 32 bit int under it where it is.
+int MSP430::stack_alu_32(const char *instr, const char *instr_carry)
+{
+char lo[16];
+char hi[16];
+char value[16];
+
+  pop_reg_32(lo, hi);
+
+  get_stack_operand(value, 1);
+  emit("  %s.w %s, %s\n", instr, lo, value);
+  get_stack_operand(value, 0);
+  emit("  %s.w %s, %s\n", instr_carry, hi, value);
+
+  return 0;
+}
+
+// Writes "instr.size #value, dst" in its shortest form.  The constant
+// generators (r2 and r3) give 0, 1, 2, 4, 8 and -1 without an extension
+// word so a constant that's one of those negated or inverted gets the
+// instruction that can use it flipped (add #-2 is decd, and #0xfffe is
+// bic #1).  Other than cmp, only the result is kept and not the flags.
+void MSP430::write_immediate(const char *instr, char size, int value, const char *dst)
+{
+int inverted;
+
+  value = (size == 'b') ? (int8_t)value : (int16_t)value;
+  inverted = (size == 'b') ? (int8_t)~value : (int16_t)~value;
+
+  if (strcmp(instr, "sub") == 0)
+  {
+    instr = "add";
+    value = (size == 'b') ? (int8_t)-value : (int16_t)-value;
+  }
+
+  if (strcmp(instr, "add") == 0)
+  {
+    switch(value)
+    {
+      case 0: return;
+      case 1: emit("  inc.%c %s\n", size, dst); return;
+      case 2: emit("  incd.%c %s\n", size, dst); return;
+      case -1: emit("  dec.%c %s\n", size, dst); return;
+      case -2: emit("  decd.%c %s\n", size, dst); return;
+      case -4:
+      case -8: emit("  sub.%c #%d, %s\n", size, -value, dst); return;
+    }
+  }
+    else
+  if (strcmp(instr, "and") == 0)
+  {
+    if (value == -1) { return; }
+    if (value == 0) { emit("  clr.%c %s\n", size, dst); return; }
+
+    switch(inverted)
+    {
+      case 1:
+      case 2:
+      case 4:
+      case 8: emit("  bic.%c #%d, %s\n", size, inverted, dst); return;
+    }
+  }
+    else
+  if (strcmp(instr, "bis") == 0 || strcmp(instr, "bic") == 0)
+  {
+    if (value == 0) { return; }
+  }
+    else
+  if (strcmp(instr, "xor") == 0)
+  {
+    if (value == 0) { return; }
+    if (value == -1) { emit("  inv.%c %s\n", size, dst); return; }
+  }
+    else
+  if (strcmp(instr, "mov") == 0)
+  {
+    if (value == 0) { emit("  clr.%c %s\n", size, dst); return; }
+  }
+    else
+  if (strcmp(instr, "cmp") == 0)
+  {
+    if (value == 0) { emit("  tst.%c %s\n", size, dst); return; }
+  }
+
+  emit("  %s.%c #%d, %s\n", instr, size, value, dst);
 }
 
 
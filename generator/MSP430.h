@@ -18,6 +18,7 @@ enum
 {
   MSP430G2231,
   MSP430G2553,
+  MSP430FR5969,
 };
 
 class MSP430 : public Generator
@@ -27,9 +28,11 @@ public:
   virtual ~MSP430();
 
   virtual int open(char *filename);
+  virtual int get_int_size() { return 16; }
+  virtual bool has_hwmult() { return has_mpy; }
 
   //virtual void serial_init();
-  virtual void method_start(int local_count, const char *name);
+  virtual void method_start(int local_count, int param_count, const char *name);
   virtual void method_end(int local_count);
   virtual int push_integer(int32_t n);
   virtual int push_integer_local(int index);
@@ -43,23 +46,54 @@ public:
   virtual int pop();
   virtual int dup();
   virtual int dup2();
+  virtual int dup_stack_slot(int slot);
+  virtual int get_stack_depth() { return reg + stack; }
   virtual int swap();
   virtual int add_integers();
+  virtual int add_integers(int const_val);
   virtual int sub_integers();
+  virtual int sub_integers(int const_val);
   virtual int mul_integers();
+  virtual int mul_integers(int const_val);
   virtual int div_integers();
+  virtual int div_integers(int const_val);
+  virtual int div_integers_unsigned();
+  virtual int div_integers_unsigned(int const_val);
   virtual int mod_integers();
+  virtual int mod_integers(int const_val);
+  virtual int mod_integers_unsigned();
+  virtual int mod_integers_unsigned(int const_val);
+  virtual int div_mod_integers(bool div_first, bool is_unsigned);
+  virtual int div_mod_integers(int const_val, bool div_first, bool is_unsigned);
   virtual int neg_integer();
+  virtual int integer_to_byte();
+  virtual int integer_to_short();
+  virtual int integer_to_char();
   virtual int shift_left_integer();
+  virtual int shift_left_integer(int const_val);
   virtual int shift_right_integer();
+  virtual int shift_right_integer(int const_val);
   virtual int shift_right_uinteger();
+  virtual int shift_right_uinteger(int const_val);
   virtual int and_integer();
+  virtual int and_integer(int const_val);
   virtual int or_integer();
+  virtual int or_integer(int const_val);
   virtual int xor_integer();
+  virtual int xor_integer(int const_val);
+  virtual int or_integer_byte(int const_val);
+  virtual int xor_integer_byte(int const_val);
+  virtual int extract_bits_integer(int shift, int width);
   virtual int inc_integer(int index, int num);
   virtual int jump_cond(const char *label, int cond);
   virtual int jump_cond_integer(const char *label, int cond);
   virtual int jump_cond_integer(const char *label, int cond, int const_val);
+  virtual int jump_cond_integer_unsigned(const char *label, int cond);
+  virtual int jump_cond_integer_unsigned(const char *label, int cond, int const_val);
+  virtual int extend_integer(bool is_unsigned);
+  virtual int add_integers_32();
+  virtual int sub_integers_32();
+  virtual int jump_cond_integer_32(const char *label, int cond);
   virtual int return_local(int index, int local_count);
   virtual int return_integer(int local_count);
   virtual int return_void(int local_count);
@@ -77,7 +111,9 @@ public:
   virtual int ioport_setPinsValue(int port);
   virtual int ioport_setPinsValue(int port, int const_val);
   virtual int ioport_setPinsHigh(int port);
+  virtual int ioport_setPinsHigh(int port, int const_val);
   virtual int ioport_setPinsLow(int port);
+  virtual int ioport_setPinsLow(int port, int const_val);
   virtual int ioport_setPinAsOutput(int port);
   virtual int ioport_setPinAsInput(int port);
   virtual int ioport_setPinHigh(int port);
@@ -113,21 +149,69 @@ public:
   virtual int memory_read16();
   virtual int memory_write16();
 
+  // Math
+  virtual int math_abs();
+  virtual int math_min();
+  virtual int math_max();
+
 protected:
   int set_periph(const char *instr, const char *periph);
+  int cmp_integers(const char *label, int cond, const char **cond_table);
+  int cmp_integers(const char *label, int cond, int const_val, const char **cond_table);
   int stack_alu(const char *instr);
+  int stack_alu(const char *instr, int const_val);
+  int stack_alu_byte(const char *instr, int const_val);
+  int stack_alu_32(const char *instr, const char *instr_carry);
+  void write_immediate(const char *instr, char size, int value, const char *dst);
+  int stack_superopt(const char *idiom, int const_val);
+  int stack_superopt_binary(const char *idiom);
+  int stack_helper(const char *name, int result, int result2);
+  int stack_div_const(int const_val, bool is_mod, bool is_unsigned);
+  int write_quotient(const char *dst, int divisor, bool is_unsigned);
+  void write_sub_product(const char *dst, int divisor);
+  int stack_shift(const char *instr);
+  int stack_shift_const(const char *instr, int const_val);
+  void write_shift_left(const char *dst, int count);
+  void write_shift_right(const char *dst, int count, bool is_unsigned);
+  virtual void write_rotate(const char *instr, const char *dst, int count);
+  virtual uint32_t get_method_clobber(call_graph_node_t *node);
+  virtual int get_frame_size(call_graph_node_t *node);
+  virtual int get_stack_size(call_graph_node_t *node);
+  virtual int init_static_frames(int size);
+  virtual int get_branch(machine_instr_t *instr, const char **label);
+  virtual bool uses_frame(machine_instr_t *instr);
+  void frame_end();
+  void write_c_entry(const char *name, int param_count);
+  void get_local(char *operand, int index);
   void push_reg(const char *reg);
   void pop_reg(char *reg);
+  void pop_reg_32(char *lo, char *hi);
+  void get_stack_operand(char *operand, int n);
+  virtual void push_regs(int *regs, int count);
+  virtual void pop_regs(int *regs, int count);
+  virtual void write_init() { }
+  void write_helpers();
   int reg;
   int reg_max;
   int stack;
   int label_count;
+  int arg_count;        // locals 0 to arg_count - 1 are in registers
+  int param_count;
+  int method_spills;    // spill_count when the method started
+  int frame_base;       // address of the locals with static frames
+  int frames_start;     // where the static frames start (below the stack)
   bool need_read_spi:1;
   bool need_mul_integers:1;
   bool need_div_integers:1;
+  bool need_div_uintegers:1;
   bool is_main:1;
+  bool large_model:1;   // MSP430X calla / reta with code above 64k
+  bool has_mpy:1;       // MPY / MPY32 is there for --runtime hwmult
   int stack_start;
   int flash_start;
+  int ram_start;
+  const char *include_file;   // symbol map for the chip's peripherals
+  const char *read_spi;       // runtime helper that does an SPI transfer
 };
 
 #endif
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 
 #include "MSP430X.h"
@@ -21,107 +22,336 @@
 // r6
 // r7
 // r8
-// r9
-// r10
-// r11 top of stack
-// r12 points to locals
+// r9 end of stack
+// r10 first parameter
+// r11 second parameter
+// r12 points to locals (or is the 7th stack register with static frames)
+// r13 third parameter
 // r15 is temp
+//
+// This is the large model (see MSP430.cxx):  calls are calla / reta and
+// a method that would run into the interrupt vectors at the top of the
+// first 64k starts at 0x10000 instead.
 
-#define REG_STACK(a) (a + 4)
-#define LOCALS(a) ((a * 2) + 2)
+#define VECTORS 0xff80
+#define FRAM_END 0x13fff
 
-MSP430X::MSP430X(uint8_t chip_type) : MSP430(chip_type)
+// Upper bound of an instruction's size.  Any operand other than a
+// register, @Rn, @Rn+ or a constant generator value takes a word.
+static int get_instr_size(machine_instr_t *instr)
 {
+const char *s = instr->operands;
+char *end;
+int size = 2;
+long value;
 
+  if (instr->type != MACHINE_INSTR) { return 0; }
+
+  // Jumps have the offset and these have the count in the opcode
+  if (instr->opcode[0] == 'j' ||
+      strncmp(instr->opcode, "pushm", 5) == 0 ||
+      strncmp(instr->opcode, "popm", 4) == 0 ||
+      strcmp(instr->opcode, "rpt") == 0 ||
+      strcmp(instr->opcode, "repeat") == 0 ||
+      strncmp(instr->opcode, "rlam", 4) == 0 ||
+      strncmp(instr->opcode, "rram", 4) == 0 ||
+      strncmp(instr->opcode, "rrum", 4) == 0 ||
+      strncmp(instr->opcode, "rrcm", 4) == 0)
+  {
+    return 2;
+  }
+
+  while (*s != 0)
+  {
+    while (*s == ' ') { s++; }
+
+    if (*s == '#')
+    {
+      value = strtol(s + 1, &end, 0);
+
+      if (end == s + 1 || (*end != ',' && *end != 0) ||
+          (value != 0 && value != 1 && value != 2 &&
+           value != 4 && value != 8 && value != -1))
+      {
+        size += 2;
+      }
+    }
+      else
+    if (*s != '@' && *s != 'r' && strncmp(s, "SP", 2) != 0 &&
+        strncmp(s, "PC", 2) != 0 && strncmp(s, "SR", 2) != 0)
+    {
+      size += 2;
+    }
+
+    while (*s != ',' && *s != 0) { s++; }
+    if (*s == ',') { s++; }
+  }
+
+  return size;
+}
+
+MSP430X::MSP430X(uint8_t chip_type) :
+  MSP430(chip_type),
+  code_address(0),
+  method_first(0),
+  code_overflow(false)
+{
+  large_model = 1;
+  include_file = "msp430fr5969.inc";
+  read_spi = "_read_spi_eusci";
 }
 
 MSP430X::~MSP430X()
 {
+  finish();
+}
+
+// MSP430::~MSP430() would write the helpers too late to be placed
+int MSP430X::finish()
+{
+int start = instr_count;
+
+  write_helpers();
+  place_code(start);
+
+  return code_overflow ? -1 : 0;
+}
+
+int MSP430X::open(char *filename)
+{
+  if (MSP430::open(filename) != 0) { return -1; }
 
+  code_address = flash_start;
+  place_code(0);
+
+  return 0;
 }
 
-int MSP430X::shift_left_integer()
+// The pins stay in high impedance after reset until LOCKLPM5 is cleared
+void MSP430X::write_init()
 {
-  if (stack > 0)
+  emit("  bic.w #LOCKLPM5, &PM5CTL0\n");
+}
+
+void MSP430X::method_start(int local_count, int param_count, const char *name)
+{
+  method_first = instr_count;
+
+  MSP430::method_start(local_count, param_count, name);
+}
+
+void MSP430X::method_end(int local_count)
+{
+  MSP430::method_end(local_count);
+
+  place_code(method_first);
+}
+
+// Code from instrs[start] on is checked against the interrupt vectors
+// and moved to 0x10000 with an .org if it would run into them.  Returns
+// -1 if it could go past the end of FRAM.
+int MSP430X::place_code(int start)
+{
+machine_instr_t org;
+int size = 0;
+int n;
+
+  if (relocatable) { return 0; }
+
+  for (n = start; n < instr_count; n++)
   {
-    fprintf(out, "  pop r15\n");
-    stack--;
+    size += get_instr_size(&instrs[n]);
   }
-    else
-  if (reg > 0)
+
+  if (code_address <= VECTORS && code_address + size > VECTORS)
   {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
+    add_line(".org 0x10000");
+    org = instrs[instr_count - 1];
+    memmove(instrs + start + 1, instrs + start, (instr_count - 1 - start) * sizeof(machine_instr_t));
+    instrs[start] = org;
+    code_address = 0x10000;
   }
 
-  fprintf(out, "  repeat r15\n");
+  code_address += size;
 
-  if (stack > 0)
-  {
-    fprintf(out, "  rlam.w #1, @sp\n");
-  }
-    else
+  if (code_address - 1 > FRAM_END)
   {
-    fprintf(out, "  rlam.w #1, r%d\n", REG_STACK(reg-1));
+    if (!code_overflow)
+    {
+      printf("Error: code could run to 0x%05x, past the end of FRAM at 0x%05x\n",
+        code_address - 1, FRAM_END);
+    }
+
+    code_overflow = true;
+    return -1;
   }
 
   return 0;
 }
 
-int MSP430X::shift_right_integer()
+// pushm / popm save a run of registers in one instruction.  The runs
+// have to be in the same order for both.
+void MSP430X::push_regs(int *regs, int count)
 {
-  if (stack > 0)
+int n, len;
+
+  for (n = 0; n < count; n += len)
   {
-    fprintf(out, "  pop r15\n");
-    stack--;
+    for (len = 1; n + len < count && regs[n + len] == regs[n] + len; len++);
+
+    if (len == 1) { emit("  push r%d\n", regs[n]); }
+    else { emit("  pushm.w #%d, r%d\n", len, regs[n + len - 1]); }
   }
-    else
-  if (reg > 0)
+}
+
+void MSP430X::pop_regs(int *regs, int count)
+{
+int n, len;
+
+  for (n = count; n > 0; n -= len)
   {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
+    for (len = 1; n - len > 0 && regs[n - len - 1] == regs[n - 1] - len; len++);
+
+    if (len == 1) { emit("  pop r%d\n", regs[n - 1]); }
+    else { emit("  popm.w #%d, r%d\n", len, regs[n - 1]); }
   }
+}
 
-  fprintf(out, "  repeat r15\n");
+// MSP430X shifts a register up to 4 bits in one rlam / rram / rrum.
+// More than that is rpt and the X form of rla / rra which the rpt
+// repeats.  Indexed operands can't be repeated so they go the MSP430 way.
+void MSP430X::write_rotate(const char *instr, const char *dst, int count)
+{
+  if (count <= 1 || dst[0] != 'r')
+  {
+    MSP430::write_rotate(instr, dst, count);
+    return;
+  }
 
-  if (stack > 0)
+  if (count <= 4)
   {
-    fprintf(out, "  rram.w #1, @sp\n");
+    emit("  %sm.w #%d, %s\n", instr, count, dst);
+    return;
   }
-    else
+
+  // rrum once makes the top bit 0 so rrax can do the rest
+  if (strcmp(instr, "rru") == 0)
   {
-    fprintf(out, "  rram.w #1, r%d\n", REG_STACK(reg-1));
+    emit("  rrum.w #1, %s\n", dst);
+    instr = "rra";
+    count--;
   }
 
+  emit("  rpt #%d\n", count);
+  emit("  %sx.w %s\n", instr, dst);
+}
+
+// SPI is eUSCI_B0 with SIMO / SOMI on P1.6 / P1.7 and the clock on P2.2.
+// Bit 0 of the mode is CPHA and bit 1 CPOL like on the USI parts and the
+// clock is SMCLK / 2^divisor.
+int MSP430X::spi_init(int port)
+{
+char dst[16];
+
+  if (port != 0) { return -1; }
+
+  emit("  ;; Set up SPI\n");
+  emit("  mov.w #UCSWRST, &UCB0CTLW0\n");
+  pop_reg(dst);
+  emit("  mov.w #(UCMST|UCSYNC|UCMSB|UCSSEL__SMCLK|UCSWRST), r14\n");
+  emit("  bit.w #1, %s\n", dst);
+  emit("  jz label_%d\n", label_count);
+  emit("  bis.w #UCCKPH, r14\n");
+  emit("label_%d:\n", label_count);
+  emit("  bit.w #2, %s\n", dst);
+  emit("  jz label_%d\n", label_count + 1);
+  emit("  bis.w #UCCKPL, r14\n");
+  emit("label_%d:\n", label_count + 1);
+  emit("  mov.w r14, &UCB0CTLW0\n");
+  pop_reg(dst);
+  if (strcmp(dst, "r15") != 0) { emit("  mov.w %s, r15\n", dst); }
+  emit("  mov.w #1, r14\n");
+  emit("label_%d:\n", label_count + 2);
+  emit("  dec.w r15\n");
+  emit("  jn label_%d\n", label_count + 3);
+  emit("  rla.w r14\n");
+  emit("  jmp label_%d\n", label_count + 2);
+  emit("label_%d:\n", label_count + 3);
+  emit("  mov.w r14, &UCB0BRW\n");
+  emit("  bis.b #0xc0, &P1SEL1\n");
+  emit("  bis.b #0x04, &P2SEL1\n");
+  emit("  bic.w #UCSWRST, &UCB0CTLW0      ; clear reset\n\n");
+  label_count += 4;
+
   return 0;
 }
 
-int MSP430X::shift_right_uinteger()
+int MSP430X::spi_init(int port, int clock_divisor, int mode)
 {
-  if (stack > 0)
-  {
-    fprintf(out, "  pop r15\n");
-    stack--;
-  }
-    else
-  if (reg > 0)
-  {
-    fprintf(out, "  mov.w r%d, r15\n", REG_STACK(reg-1));
-    reg--;
-  }
+  if (port != 0) { return -1; }
 
-  fprintf(out, "  repeat r15\n");
+  emit("  ;; Set up SPI\n");
+  emit("  mov.w #UCSWRST, &UCB0CTLW0\n");
+  emit("  mov.w #(UCMST|UCSYNC|UCMSB|UCSSEL__SMCLK|UCSWRST%s%s), &UCB0CTLW0\n",
+    (mode & 1) == 0 ? "":"|UCCKPH",
+    (mode & 2) == 0 ? "":"|UCCKPL");
+  emit("  mov.w #%d, &UCB0BRW\n", 1 << clock_divisor);
+  emit("  bis.b #0xc0, &P1SEL1\n");
+  emit("  bis.b #0x04, &P2SEL1\n");
+  emit("  bic.w #UCSWRST, &UCB0CTLW0      ; clear reset\n\n");
 
-  if (stack > 0)
-  {
-    fprintf(out, "  rrum.w #1, @sp\n");
-  }
-    else
-  {
-    fprintf(out, "  rrum.w #1, r%d\n", REG_STACK(reg-1));
-  }
+  return 0;
+}
+
+int MSP430X::spi_isDataAvailable(int port)
+{
+  if (port != 0) { return -1; }
+
+  emit("  mov.w &UCB0IFG, r15\n");
+  emit("  and.w #UCRXIFG, r15\n");
+  push_reg("r15");
+
+  return 0;
+}
+
+int MSP430X::spi_isBusy(int port)
+{
+  if (port != 0) { return -1; }
+
+  emit("  mov.w &UCB0STATW, r15\n");
+  emit("  and.w #UCBUSY, r15\n");
+  push_reg("r15");
 
   return 0;
 }
 
+int MSP430X::spi_disable(int port)
+{
+  if (port != 0) { return -1; }
+
+  emit("  bis.w #UCSWRST, &UCB0CTLW0\n");
+
+  return 0;
+}
+
+int MSP430X::spi_enable(int port)
+{
+  if (port != 0) { return -1; }
+
+  emit("  bic.w #UCSWRST, &UCB0CTLW0\n");
+
+  return 0;
+}
+
+// Above 8 MHz the FRAM needs a wait state
+int MSP430X::cpu_setClock16()
+{
+  emit("  ;; Set MCLK to 16 MHz with DCO\n");
+  emit("  mov.w #(FRCTLPW|NWAITS_1), &FRCTL0\n");
+  emit("  mov.w #CSKEY, &CSCTL0\n");
+  emit("  mov.w #(DCORSEL|DCOFSEL_4), &CSCTL1\n");
+  emit("  clr.w &CSCTL3\n\n");
+
+  return 0;
+}
 
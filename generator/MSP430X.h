@@ -21,9 +21,32 @@ public:
   MSP430X(uint8_t chip_type);
   virtual ~MSP430X();
 
-  virtual int shift_left_integer();
-  virtual int shift_right_integer();
-  virtual int shift_right_uinteger();
+  virtual int open(char *filename);
+  virtual int finish();
+  virtual void method_start(int local_count, int param_count, const char *name);
+  virtual void method_end(int local_count);
+
+  // SPI functions
+  virtual int spi_init(int port);
+  virtual int spi_init(int port, int clock_divisor, int mode);
+  virtual int spi_isDataAvailable(int port);
+  virtual int spi_isBusy(int port);
+  virtual int spi_disable(int port);
+  virtual int spi_enable(int port);
+
+  // CPU functions
+  virtual int cpu_setClock16();
+
+protected:
+  virtual void write_init();
+  virtual void push_regs(int *regs, int count);
+  virtual void pop_regs(int *regs, int count);
+  virtual void write_rotate(const char *instr, const char *dst, int count);
+  int place_code(int start);
+
+  uint32_t code_address;  // where the next method starts (upper bound)
+  int method_first;       // instrs index of the current method's label
+  bool code_overflow;     // ran past the end of FRAM (already reported)
 };
 
 #endif
@@ -0,0 +1,201 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdlib.h>
+
+#include "table_runtime.h"
+
+// MSP430 helpers.  Arguments come in r4 and r5 and the result goes back
+// in r4.  The divides leave the remainder in r7.  Labels inside a
+// helper are _<name><digit> so the assembler knows they're local.
+
+runtime_t table_runtime_msp430[] =
+{
+  { "_read_spi", RUNTIME_SIZE, 0x8000,
+    "; _read_spi(r15)\n"
+    "_read_spi:\n"
+    "  mov.b r15, &USISRL\n"
+    "  mov.b #8, &USICNT\n"
+    "_read_spi_wait:\n"
+    "  bit.b #USIIFG, &USICTL1\n"
+    "  jz _read_spi_wait\n"
+    "  mov.b &USISRL, r15\n"
+    "  ret\n\n"
+  },
+
+  // FR5xx parts do SPI on eUSCI_B0.  Same label so the callers don't
+  // care which one they get.
+  { "_read_spi_eusci", RUNTIME_SIZE, 0x8000,
+    "; _read_spi(r15)\n"
+    "_read_spi:\n"
+    "  mov.b r15, &UCB0TXBUF\n"
+    "_read_spi_wait:\n"
+    "  bit.w #UCRXIFG, &UCB0IFG\n"
+    "  jz _read_spi_wait\n"
+    "  mov.b &UCB0RXBUF, r15\n"
+    "  ret\n\n"
+  },
+
+  // Shift and add that stops once the rest of b is all 0 or all 1 bits
+  { "_mul_integers", RUNTIME_SIZE, 0x80f0,
+    "; _mul a * b\n"
+    "_mul_integers:\n"
+    "  clr r7\n"
+    "  mov r7, r15\n"
+    "  mov r7, r6\n"
+    "  tst r4\n"
+    "  jge _mul2\n"
+    "  mov #-1, r6\n"
+    "  jmp _mul2\n"
+    "_mul6:\n"
+    "  add r4, r15\n"
+    "  addc r6, r7\n"
+    "_mul1:\n"
+    "  rla r4\n"
+    "  rlc r6\n"
+    "_mul2:\n"
+    "  rra r5\n"
+    "  jc _mul5\n"
+    "  jne _mul1\n"
+    "  jmp _mul4\n"
+    "_mul5:\n"
+    "  sub r4, r15\n"
+    "  subc r6, r7\n"
+    "_mul3:\n"
+    "  rla r4\n"
+    "  rlc r6\n"
+    "  rra r5\n"
+    "  jnc _mul6\n"
+    "  cmp #0FFFFh, r5\n"
+    "  jne _mul3\n"
+    "_mul4:\n"
+    "  mov r15, r4\n"
+    "  ret\n\n"
+  },
+
+  // Only the low 16 bits are kept so signed and unsigned are the same.
+  // Every bit of b is done without a loop counter, 5 or 6 cycles each.
+  { "_mul_integers", RUNTIME_SPEED, 0x8030,
+    "; _mul a * b (unrolled)\n"
+    "_mul_integers:\n"
+    "  clr r15\n"
+    "  rrc r5\n  jnc _mul0\n  add r4, r15\n_mul0:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul1\n  add r4, r15\n_mul1:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul2\n  add r4, r15\n_mul2:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul3\n  add r4, r15\n_mul3:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul4\n  add r4, r15\n_mul4:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul5\n  add r4, r15\n_mul5:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul6\n  add r4, r15\n_mul6:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul7\n  add r4, r15\n_mul7:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul8\n  add r4, r15\n_mul8:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul9\n  add r4, r15\n_mul9:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul10\n  add r4, r15\n_mul10:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul11\n  add r4, r15\n_mul11:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul12\n  add r4, r15\n_mul12:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul13\n  add r4, r15\n_mul13:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul14\n  add r4, r15\n_mul14:\n  rla r4\n"
+    "  rrc r5\n  jnc _mul15\n  add r4, r15\n_mul15:\n"
+    "  mov r15, r4\n"
+    "  ret\n\n"
+  },
+
+  // MPY peripheral on parts that have one (not the G2xx value line)
+  { "_mul_integers", RUNTIME_HWMULT, 0x0010,
+    "; _mul a * b (hardware multiplier)\n"
+    "_mul_integers:\n"
+    "  mov r4, &MPYS\n"
+    "  mov r5, &OP2\n"
+    "  mov &RESLO, r4\n"
+    "  ret\n\n"
+  },
+
+  // Unsigned restoring divide.  The remainder can grow past 16 bits
+  // for a moment when b is above 0x8000 so the carry out of it counts.
+  { "_div_uintegers", RUNTIME_SIZE, 0x00d0,
+    "; _div a / b unsigned (remainder in r7)\n"
+    "_div_uintegers:\n"
+    "  mov #16, r6\n"
+    "  clr r7\n"
+    "_div1:\n"
+    "  rla r4\n"
+    "  rlc r7\n"
+    "  jc _div2\n"
+    "  cmp r5, r7\n"
+    "  jlo _div3\n"
+    "_div2:\n"
+    "  sub r5, r7\n"
+    "  inc r4\n"
+    "_div3:\n"
+    "  dec r6\n"
+    "  jnz _div1\n"
+    "  ret\n\n"
+  },
+
+  // The same restoring divide with the loop unrolled 4 times
+  { "_div_uintegers", RUNTIME_SPEED, 0x00d0,
+    "; _div a / b unsigned (remainder in r7, unrolled)\n"
+    "_div_uintegers:\n"
+    "  mov #4, r6\n"
+    "  clr r7\n"
+    "_div1:\n"
+    "  rla r4\n  rlc r7\n  jc _div2\n  cmp r5, r7\n  jlo _div3\n"
+    "_div2:\n  sub r5, r7\n  inc r4\n"
+    "_div3:\n"
+    "  rla r4\n  rlc r7\n  jc _div4\n  cmp r5, r7\n  jlo _div5\n"
+    "_div4:\n  sub r5, r7\n  inc r4\n"
+    "_div5:\n"
+    "  rla r4\n  rlc r7\n  jc _div6\n  cmp r5, r7\n  jlo _div7\n"
+    "_div6:\n  sub r5, r7\n  inc r4\n"
+    "_div7:\n"
+    "  rla r4\n  rlc r7\n  jc _div8\n  cmp r5, r7\n  jlo _div9\n"
+    "_div8:\n  sub r5, r7\n  inc r4\n"
+    "_div9:\n"
+    "  dec r6\n"
+    "  jnz _div1\n"
+    "  ret\n\n"
+  },
+
+  // Java rounds the quotient towards 0 and the remainder has the sign of
+  // a.  Both are worked out from the unsigned divide with r14 keeping
+  // which ones need to be negated after.
+  { "_div_integers", RUNTIME_SIZE, 0x40f0,
+    "; _div a / b signed (remainder in r7)\n"
+    "_div_integers:\n"
+    "  clr r14\n"
+    "  tst r4\n"
+    "  jge _divs1\n"
+    "  inv r4\n"
+    "  inc r4\n"
+    "  mov #3, r14\n"
+    "_divs1:\n"
+    "  tst r5\n"
+    "  jge _divs2\n"
+    "  inv r5\n"
+    "  inc r5\n"
+    "  xor #1, r14\n"
+    "_divs2:\n"
+    "  call #_div_uintegers\n"
+    "  bit #1, r14\n"
+    "  jz _divs3\n"
+    "  inv r4\n"
+    "  inc r4\n"
+    "_divs3:\n"
+    "  bit #2, r14\n"
+    "  jz _divs4\n"
+    "  inv r7\n"
+    "  inc r7\n"
+    "_divs4:\n"
+    "  ret\n\n"
+  },
+
+  { NULL, 0, 0, NULL }
+};
+
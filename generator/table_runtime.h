@@ -0,0 +1,42 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _TABLE_RUNTIME_H
+#define _TABLE_RUNTIME_H
+
+#include <stdint.h>
+
+// Runtime helpers the generators call for things the CPU can't do in a
+// few instructions.  A helper can have a version for each profile and
+// is only written to the output if something called it.  When there's
+// no version for the profile asked for the hardware one falls back to
+// speed and speed falls back to size.  Callers use the clobber mask to
+// save only the registers the helper really changes.
+
+enum
+{
+  RUNTIME_SIZE = 0,
+  RUNTIME_SPEED,
+  RUNTIME_HWMULT,
+};
+
+struct runtime_t
+{
+  const char *name;
+  int profile;
+  uint32_t clobber;     // bit n set if the helper changes register n
+  const char *code;     // lines passed to the generator as they are
+};
+
+extern runtime_t table_runtime_msp430[];
+
+#endif
+
@@ -0,0 +1,321 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+// Generated by scripts/superopt.py.  Don't edit.
+
+#include <stdlib.h>
+
+#include "table_superopt.h"
+
+superopt_t table_superopt_msp430[] =
+{
+  { "i2b", 0, 1, { "sxt %r", NULL } },
+  { "i2s", 0, 0, { NULL } },
+  { "i2c", 0, 0, { NULL } },
+  { "mul", -16, 6, { "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "inv.w %r", "inc.w %r", NULL } },
+  { "mul", -15, 6, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -14, 6, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", "add.w %r, %r", NULL } },
+  { "mul", -13, 7, { "mov.w %r, %t", "add.w %r, %r", "add.w %t, %r", "add.w %r, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -12, 6, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", "add.w %r, %r", "add.w %r, %r", NULL } },
+  { "mul", -11, 6, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -10, 6, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -9, 6, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "add.w %r, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -8, 5, { "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "inv.w %r", "inc.w %r", NULL } },
+  { "mul", -7, 5, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -6, 5, { "mov.w %r, %t", "add.w %t, %t", "add.w %t, %t", "sub.w %t, %r", "add.w %r, %r", NULL } },
+  { "mul", -5, 5, { "mov.w %r, %t", "add.w %t, %t", "add.w %r, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -4, 4, { "add.w %r, %r", "add.w %r, %r", "inv.w %r", "inc.w %r", NULL } },
+  { "mul", -3, 4, { "mov.w %r, %t", "add.w %r, %t", "add.w %t, %t", "sub.w %t, %r", NULL } },
+  { "mul", -2, 3, { "add.w %r, %r", "inv.w %r", "inc.w %r", NULL } },
+  { "mul", -1, 2, { "inv.w %r", "inc.w %r", NULL } },
+  { "mul", 0, 1, { "sub.w %r, %r", NULL } },
+  { "mul", 1, 0, { NULL } },
+  { "mul", 2, 1, { "add.w %r, %r", NULL } },
+  { "mul", 3, 3, { "mov.w %r, %t", "add.w %r, %r", "add.w %t, %r", NULL } },
+  { "mul", 4, 2, { "add.w %r, %r", "add.w %r, %r", NULL } },
+  { "mul", 5, 4, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %t, %r", NULL } },
+  { "mul", 6, 4, { "mov.w %r, %t", "add.w %r, %r", "add.w %t, %r", "add.w %r, %r", NULL } },
+  { "mul", 7, 5, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "sub.w %t, %r", NULL } },
+  { "mul", 8, 3, { "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", NULL } },
+  { "mul", 9, 5, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %t, %r", NULL } },
+  { "mul", 10, 5, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %t, %r", "add.w %r, %r", NULL } },
+  { "mul", 11, 6, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %t, %r", "add.w %r, %r", "add.w %t, %r", NULL } },
+  { "mul", 12, 5, { "mov.w %r, %t", "add.w %r, %r", "add.w %t, %r", "add.w %r, %r", "add.w %r, %r", NULL } },
+  { "mul", 13, 6, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %t", "add.w %r, %r", "add.w %t, %r", NULL } },
+  { "mul", 14, 6, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "sub.w %t, %r", "add.w %r, %r", NULL } },
+  { "mul", 15, 6, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "sub.w %t, %r", NULL } },
+  { "mul", 16, 4, { "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", NULL } },
+  { "mul", 100, 9, { "mov.w %r, %t", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %r, %r", "add.w %r, %t", "add.w %t, %t", "add.w %t, %r", "add.w %r, %r", NULL } },
+  { "bits", 257, 2, { "rra.w %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 258, 2, { "rra.w %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 259, 2, { "rra.w %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 260, 2, { "rra.w %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 261, 2, { "rra.w %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 262, 2, { "rra.w %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 263, 2, { "rra.w %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 264, 2, { "rra.w %r", "mov.b %r, %r", NULL } },
+  { "bits", 265, 2, { "rra.w %r", "and.w #0x01ff, %r", NULL } },
+  { "bits", 266, 2, { "rra.w %r", "and.w #0x03ff, %r", NULL } },
+  { "bits", 267, 2, { "rra.w %r", "and.w #0x07ff, %r", NULL } },
+  { "bits", 268, 2, { "rra.w %r", "and.w #0x0fff, %r", NULL } },
+  { "bits", 269, 2, { "rra.w %r", "and.w #0x1fff, %r", NULL } },
+  { "bits", 270, 2, { "rra.w %r", "and.w #0x3fff, %r", NULL } },
+  { "bits", 271, 2, { "xor.w %t, %t", "rrc.w %r", NULL } },
+  { "bits", 513, 3, { "rra.w %r", "rra.w %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 514, 3, { "rra.w %r", "rra.w %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 515, 3, { "rra.w %r", "rra.w %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 516, 3, { "rra.w %r", "rra.w %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 517, 3, { "rra.w %r", "rra.w %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 518, 3, { "rra.w %r", "rra.w %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 519, 3, { "rra.w %r", "rra.w %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 520, 3, { "rra.w %r", "rra.w %r", "mov.b %r, %r", NULL } },
+  { "bits", 521, 3, { "rra.w %r", "rra.w %r", "and.w #0x01ff, %r", NULL } },
+  { "bits", 522, 3, { "rra.w %r", "rra.w %r", "and.w #0x03ff, %r", NULL } },
+  { "bits", 523, 3, { "rra.w %r", "rra.w %r", "and.w #0x07ff, %r", NULL } },
+  { "bits", 524, 3, { "rra.w %r", "rra.w %r", "and.w #0x0fff, %r", NULL } },
+  { "bits", 525, 3, { "rra.w %r", "rra.w %r", "and.w #0x1fff, %r", NULL } },
+  { "bits", 526, 3, { "xor.w %t, %t", "rrc.w %r", "rra.w %r", NULL } },
+  { "bits", 769, 3, { "and.w #0x0008, %r", "addc.w %r, %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 770, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 771, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 772, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 773, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 774, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 775, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 776, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "mov.b %r, %r", NULL } },
+  { "bits", 777, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x01ff, %r", NULL } },
+  { "bits", 778, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x03ff, %r", NULL } },
+  { "bits", 779, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x07ff, %r", NULL } },
+  { "bits", 780, 4, { "rra.w %r", "rra.w %r", "rra.w %r", "and.w #0x0fff, %r", NULL } },
+  { "bits", 781, 4, { "xor.w %t, %t", "rrc.w %r", "rra.w %r", "rra.w %r", NULL } },
+  { "bits", 1025, 3, { "and.w #0x0010, %r", "addc.w %r, %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 1281, 3, { "and.w #0x0020, %r", "addc.w %r, %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 1537, 3, { "and.w #0x0040, %r", "addc.w %r, %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 1538, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 1539, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 1540, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 1541, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 1542, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 1543, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 1544, 4, { "add.w %r, %r", "add.w %r, %r", "swpb %r", "mov.b %r, %r", NULL } },
+  { "bits", 1793, 3, { "add.w %r, %r", "swpb %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 1794, 3, { "add.w %r, %r", "swpb %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 1795, 3, { "add.w %r, %r", "swpb %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 1796, 3, { "add.w %r, %r", "swpb %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 1797, 3, { "add.w %r, %r", "swpb %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 1798, 3, { "add.w %r, %r", "swpb %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 1799, 3, { "add.w %r, %r", "swpb %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 1800, 3, { "add.w %r, %r", "swpb %r", "mov.b %r, %r", NULL } },
+  { "bits", 2049, 2, { "swpb %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 2050, 2, { "swpb %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 2051, 2, { "swpb %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 2052, 2, { "swpb %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 2053, 2, { "swpb %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 2054, 2, { "swpb %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 2055, 2, { "swpb %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 2056, 2, { "swpb %r", "mov.b %r, %r", NULL } },
+  { "bits", 2305, 3, { "rra.w %r", "swpb %r", "and.w #0x0001, %r", NULL } },
+  { "bits", 2306, 3, { "rra.w %r", "swpb %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 2307, 3, { "rra.w %r", "swpb %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 2308, 3, { "rra.w %r", "swpb %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 2309, 3, { "rra.w %r", "swpb %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 2310, 3, { "rra.w %r", "swpb %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 2311, 3, { "rra.w %r", "swpb %r", "and.w #0x007f, %r", NULL } },
+  { "bits", 2561, 3, { "and.w #0x0400, %r", "addc.w %r, %r", "mov.b %r, %r", NULL } },
+  { "bits", 2562, 4, { "rra.w %r", "rra.w %r", "swpb %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 2563, 4, { "rra.w %r", "rra.w %r", "swpb %r", "and.w #0x0007, %r", NULL } },
+  { "bits", 2564, 4, { "rra.w %r", "rra.w %r", "swpb %r", "and.w #0x000f, %r", NULL } },
+  { "bits", 2565, 4, { "rra.w %r", "rra.w %r", "swpb %r", "and.w #0x001f, %r", NULL } },
+  { "bits", 2566, 4, { "rra.w %r", "rra.w %r", "swpb %r", "and.w #0x003f, %r", NULL } },
+  { "bits", 2817, 3, { "and.w #0x0800, %r", "addc.w %r, %r", "mov.b %r, %r", NULL } },
+  { "bits", 3073, 3, { "and.w #0x1000, %r", "addc.w %r, %r", "mov.b %r, %r", NULL } },
+  { "bits", 3329, 3, { "and.w #0x2000, %r", "addc.w %r, %r", "mov.b %r, %r", NULL } },
+  { "bits", 3585, 3, { "add.w %r, %r", "and.w #0x8000, %r", "addc.w %r, %r", NULL } },
+  { "bits", 3586, 4, { "add.w %r, %r", "addc.w %r, %r", "addc.w %r, %r", "and.w #0x0003, %r", NULL } },
+  { "bits", 3841, 2, { "and.w #0x8000, %r", "addc.w %r, %r", NULL } },
+  { "abs", 0, 4, { "mov.w %r, %t", "add.w %r, %t", "jge %l", "sub.w %t, %r", "%l:", NULL } },
+  { "min", 0, 3, { "sub.w %r, %t", "jge %l", "add.w %t, %r", "%l:", NULL } },
+  { "max", 0, 3, { "sub.w %r, %t", "jl %l", "add.w %t, %r", "%l:", NULL } },
+  { NULL, 0, 0, { NULL } }
+};
+
+superopt_t table_superopt_dspic[] =
+{
+  { "i2b", 0, 1, { "se %r, %r", NULL } },
+  { "i2s", 0, 0, { NULL } },
+  { "i2c", 0, 0, { NULL } },
+  { "mul", -64, 2, { "neg %r, %r", "sl %r, #6, %r", NULL } },
+  { "mul", -63, 2, { "sl %r, #6, %t", "sub %r, %t, %r", NULL } },
+  { "mul", -32, 2, { "neg %r, %r", "sl %r, #5, %r", NULL } },
+  { "mul", -31, 2, { "sl %r, #5, %t", "sub %r, %t, %r", NULL } },
+  { "mul", -16, 2, { "neg %r, %r", "sl %r, #4, %r", NULL } },
+  { "mul", -15, 2, { "sl %r, #4, %t", "sub %r, %t, %r", NULL } },
+  { "mul", -8, 2, { "neg %r, %r", "sl %r, #3, %r", NULL } },
+  { "mul", -7, 2, { "sl %r, #3, %t", "sub %r, %t, %r", NULL } },
+  { "mul", -4, 2, { "neg %r, %r", "sl %r, #2, %r", NULL } },
+  { "mul", -3, 2, { "sl %r, #2, %t", "sub %r, %t, %r", NULL } },
+  { "mul", -2, 2, { "neg %r, %r", "sl %r, #1, %r", NULL } },
+  { "mul", -1, 1, { "neg %r, %r", NULL } },
+  { "mul", 0, 1, { "sub %r, %r, %r", NULL } },
+  { "mul", 1, 0, { NULL } },
+  { "mul", 2, 1, { "sl %r, #1, %r", NULL } },
+  { "mul", 3, 2, { "sl %r, #1, %t", "add %r, %t, %r", NULL } },
+  { "mul", 4, 1, { "sl %r, #2, %r", NULL } },
+  { "mul", 5, 2, { "sl %r, #2, %t", "add %r, %t, %r", NULL } },
+  { "mul", 7, 2, { "sl %r, #3, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 8, 1, { "sl %r, #3, %r", NULL } },
+  { "mul", 9, 2, { "sl %r, #3, %t", "add %r, %t, %r", NULL } },
+  { "mul", 15, 2, { "sl %r, #4, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 16, 1, { "sl %r, #4, %r", NULL } },
+  { "mul", 17, 2, { "sl %r, #4, %t", "add %r, %t, %r", NULL } },
+  { "mul", 31, 2, { "sl %r, #5, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 32, 1, { "sl %r, #5, %r", NULL } },
+  { "mul", 33, 2, { "sl %r, #5, %t", "add %r, %t, %r", NULL } },
+  { "mul", 63, 2, { "sl %r, #6, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 64, 1, { "sl %r, #6, %r", NULL } },
+  { "mul", 65, 2, { "sl %r, #6, %t", "add %r, %t, %r", NULL } },
+  { "mul", 127, 2, { "sl %r, #7, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 128, 1, { "sl %r, #7, %r", NULL } },
+  { "mul", 129, 2, { "sl %r, #7, %t", "add %r, %t, %r", NULL } },
+  { "mul", 255, 2, { "sl %r, #8, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 256, 1, { "sl %r, #8, %r", NULL } },
+  { "mul", 257, 2, { "sl %r, #8, %t", "add %r, %t, %r", NULL } },
+  { "mul", 511, 2, { "sl %r, #9, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 512, 1, { "sl %r, #9, %r", NULL } },
+  { "mul", 513, 2, { "sl %r, #9, %t", "add %r, %t, %r", NULL } },
+  { "mul", 1023, 2, { "sl %r, #10, %t", "sub %t, %r, %r", NULL } },
+  { "mul", 1024, 1, { "sl %r, #10, %r", NULL } },
+  { "bits", 257, 2, { "sl %r, #14, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 258, 2, { "sl %r, #13, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 259, 2, { "sl %r, #12, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 260, 2, { "sl %r, #11, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 261, 2, { "sl %r, #10, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 262, 2, { "sl %r, #9, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 263, 2, { "ze %r, %r", "asr %r, #1, %r", NULL } },
+  { "bits", 264, 2, { "asr %r, #1, %r", "ze %r, %r", NULL } },
+  { "bits", 265, 2, { "sl %r, #6, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 266, 2, { "sl %r, #5, %r", "lsr %r, #6, %r", NULL } },
+  { "bits", 267, 2, { "sl %r, #4, %r", "lsr %r, #5, %r", NULL } },
+  { "bits", 268, 2, { "sl %r, #3, %r", "lsr %r, #4, %r", NULL } },
+  { "bits", 269, 2, { "sl %r, #2, %r", "lsr %r, #3, %r", NULL } },
+  { "bits", 270, 2, { "sl %r, #1, %r", "lsr %r, #2, %r", NULL } },
+  { "bits", 271, 1, { "lsr %r, #1, %r", NULL } },
+  { "bits", 513, 2, { "sl %r, #13, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 514, 2, { "sl %r, #12, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 515, 2, { "sl %r, #11, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 516, 2, { "sl %r, #10, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 517, 2, { "sl %r, #9, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 518, 2, { "ze %r, %r", "asr %r, #2, %r", NULL } },
+  { "bits", 519, 2, { "sl %r, #7, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 520, 2, { "asr %r, #2, %r", "ze %r, %r", NULL } },
+  { "bits", 521, 2, { "sl %r, #5, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 522, 2, { "sl %r, #4, %r", "lsr %r, #6, %r", NULL } },
+  { "bits", 523, 2, { "sl %r, #3, %r", "lsr %r, #5, %r", NULL } },
+  { "bits", 524, 2, { "sl %r, #2, %r", "lsr %r, #4, %r", NULL } },
+  { "bits", 525, 2, { "sl %r, #1, %r", "lsr %r, #3, %r", NULL } },
+  { "bits", 526, 1, { "lsr %r, #2, %r", NULL } },
+  { "bits", 769, 2, { "sl %r, #12, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 770, 2, { "sl %r, #11, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 771, 2, { "sl %r, #10, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 772, 2, { "sl %r, #9, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 773, 2, { "ze %r, %r", "asr %r, #3, %r", NULL } },
+  { "bits", 774, 2, { "sl %r, #7, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 775, 2, { "sl %r, #6, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 776, 2, { "asr %r, #3, %r", "ze %r, %r", NULL } },
+  { "bits", 777, 2, { "sl %r, #4, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 778, 2, { "sl %r, #3, %r", "lsr %r, #6, %r", NULL } },
+  { "bits", 779, 2, { "sl %r, #2, %r", "lsr %r, #5, %r", NULL } },
+  { "bits", 780, 2, { "sl %r, #1, %r", "lsr %r, #4, %r", NULL } },
+  { "bits", 781, 1, { "lsr %r, #3, %r", NULL } },
+  { "bits", 1025, 2, { "sl %r, #11, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 1026, 2, { "sl %r, #10, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 1027, 2, { "sl %r, #9, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 1028, 2, { "ze %r, %r", "asr %r, #4, %r", NULL } },
+  { "bits", 1029, 2, { "sl %r, #7, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 1030, 2, { "sl %r, #6, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 1031, 2, { "sl %r, #5, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 1032, 2, { "sl %r, #4, %r", "lsr %r, #8, %r", NULL } },
+  { "bits", 1033, 2, { "sl %r, #3, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 1034, 2, { "sl %r, #2, %r", "lsr %r, #6, %r", NULL } },
+  { "bits", 1035, 2, { "sl %r, #1, %r", "lsr %r, #5, %r", NULL } },
+  { "bits", 1036, 1, { "lsr %r, #4, %r", NULL } },
+  { "bits", 1281, 2, { "sl %r, #10, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 1282, 2, { "sl %r, #9, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 1283, 2, { "ze %r, %r", "asr %r, #5, %r", NULL } },
+  { "bits", 1284, 2, { "sl %r, #7, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 1285, 2, { "sl %r, #6, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 1286, 2, { "sl %r, #5, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 1287, 2, { "sl %r, #4, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 1288, 2, { "sl %r, #3, %r", "lsr %r, #8, %r", NULL } },
+  { "bits", 1289, 2, { "sl %r, #2, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 1290, 2, { "sl %r, #1, %r", "lsr %r, #6, %r", NULL } },
+  { "bits", 1291, 1, { "lsr %r, #5, %r", NULL } },
+  { "bits", 1537, 2, { "sl %r, #9, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 1538, 2, { "ze %r, %r", "asr %r, #6, %r", NULL } },
+  { "bits", 1539, 2, { "sl %r, #7, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 1540, 2, { "sl %r, #6, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 1541, 2, { "sl %r, #5, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 1542, 2, { "sl %r, #4, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 1543, 2, { "sl %r, #3, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 1544, 2, { "sl %r, #2, %r", "lsr %r, #8, %r", NULL } },
+  { "bits", 1545, 2, { "sl %r, #1, %r", "lsr %r, #7, %r", NULL } },
+  { "bits", 1546, 1, { "lsr %r, #6, %r", NULL } },
+  { "bits", 1793, 2, { "se %r, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 1794, 2, { "sl %r, #7, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 1795, 2, { "sl %r, #6, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 1796, 2, { "sl %r, #5, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 1797, 2, { "sl %r, #4, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 1798, 2, { "sl %r, #3, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 1799, 2, { "sl %r, #2, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 1800, 2, { "sl %r, #1, %r", "lsr %r, #8, %r", NULL } },
+  { "bits", 1801, 1, { "lsr %r, #7, %r", NULL } },
+  { "bits", 2049, 2, { "sl %r, #7, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 2050, 2, { "sl %r, #6, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 2051, 2, { "sl %r, #5, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 2052, 2, { "sl %r, #4, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 2053, 2, { "sl %r, #3, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 2054, 2, { "sl %r, #2, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 2055, 2, { "sl %r, #1, %r", "lsr %r, #9, %r", NULL } },
+  { "bits", 2056, 1, { "lsr %r, #8, %r", NULL } },
+  { "bits", 2305, 2, { "sl %r, #6, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 2306, 2, { "sl %r, #5, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 2307, 2, { "sl %r, #4, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 2308, 2, { "sl %r, #3, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 2309, 2, { "sl %r, #2, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 2310, 2, { "sl %r, #1, %r", "lsr %r, #10, %r", NULL } },
+  { "bits", 2311, 1, { "lsr %r, #9, %r", NULL } },
+  { "bits", 2561, 2, { "sl %r, #5, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 2562, 2, { "sl %r, #4, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 2563, 2, { "sl %r, #3, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 2564, 2, { "sl %r, #2, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 2565, 2, { "sl %r, #1, %r", "lsr %r, #11, %r", NULL } },
+  { "bits", 2566, 1, { "lsr %r, #10, %r", NULL } },
+  { "bits", 2817, 2, { "sl %r, #4, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 2818, 2, { "sl %r, #3, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 2819, 2, { "sl %r, #2, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 2820, 2, { "sl %r, #1, %r", "lsr %r, #12, %r", NULL } },
+  { "bits", 2821, 1, { "lsr %r, #11, %r", NULL } },
+  { "bits", 3073, 2, { "sl %r, #3, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 3074, 2, { "sl %r, #2, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 3075, 2, { "sl %r, #1, %r", "lsr %r, #13, %r", NULL } },
+  { "bits", 3076, 1, { "lsr %r, #12, %r", NULL } },
+  { "bits", 3329, 2, { "sl %r, #2, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 3330, 2, { "sl %r, #1, %r", "lsr %r, #14, %r", NULL } },
+  { "bits", 3331, 1, { "lsr %r, #13, %r", NULL } },
+  { "bits", 3585, 2, { "sl %r, #1, %r", "lsr %r, #15, %r", NULL } },
+  { "bits", 3586, 1, { "lsr %r, #14, %r", NULL } },
+  { "bits", 3841, 1, { "lsr %r, #15, %r", NULL } },
+  { "abs", 0, 3, { "cp0 %r", "bra ge, %l", "neg %r, %r", "%l:", NULL } },
+  { "min", 0, 3, { "sub %r, %t, %t", "bra lt, %l", "sub %r, %t, %r", "%l:", NULL } },
+  { "max", 0, 3, { "sub %r, %t, %t", "bra ge, %l", "sub %r, %t, %r", "%l:", NULL } },
+  { NULL, 0, 0, { NULL } }
+};
+
@@ -0,0 +1,36 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _TABLE_SUPEROPT_H
+#define _TABLE_SUPEROPT_H
+
+#include <stdint.h>
+
+// Instruction sequences found by scripts/superopt.py.  In the text %r is
+// the register holding the value and %t is a scratch register, or the
+// second operand for min and max.  %l is a label local to the sequence
+// and "%l:" is where it goes.
+
+#define SUPEROPT_MAX_INSTR 10
+
+struct superopt_t
+{
+  const char *idiom;   // "mul", "bits", "abs", "min", "max", "i2b", ..
+  int const_val;       // for bits (shift << 8) | width
+  uint8_t count;       // instructions, not counting the label
+  const char *instr[SUPEROPT_MAX_INSTR + 1];
+};
+
+extern superopt_t table_superopt_msp430[];
+extern superopt_t table_superopt_dspic[];
+
+#endif
+
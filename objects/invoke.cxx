@@ -23,6 +23,7 @@
 #include "memory.h"
 #include "spi.h"
 #include "uart.h"
+#include "java_lang_math.h"
 #include "java_lang_system.h"
 
 #define CHECK_WITH_PORT(a,b,c) \
@@ -96,7 +97,7 @@ int ptr = 0;
   //sprintf(function, "%s_%s_%s_%s", field_class, field_name, method_name, method_sig);
 }
 
-static void get_signature(char *signature, int *params, int *is_void)
+void get_signature(char *signature, int *params, int *is_void)
 {
   *params = 0;
   *is_void = 0;
@@ -121,7 +122,7 @@ static void get_signature(char *signature, int *params, int *is_void)
   }
 }
 
-static void get_static_function(char *function, char *method_name, char *method_sig)
+void get_static_function(char *function, char *method_name, char *method_sig)
 {
 char *s;
 int ptr = 0;
@@ -233,6 +234,11 @@ char function[256];
     {}
   }
     else
+  if (strcmp(method_class, "java/lang/Math") == 0)
+  {
+    ret = java_lang_math(java_class, generator, function);
+  }
+    else
   {
     if (strcmp(method_class, java_class->class_name) == 0)
     {
@@ -15,6 +15,8 @@
 #include "Generator.h"
 #include "JavaClass.h"
 
+void get_signature(char *signature, int *params, int *is_void);
+void get_static_function(char *function, char *method_name, char *method_sig);
 int invoke_virtual(JavaClass *java_class, int method_id, int field_id, Generator *generator);
 int invoke_static(JavaClass *java_class, int method_id, Generator *generator);
 int invoke_static(JavaClass *java_class, int method_id, Generator *generator, int *const_vals, int const_count);
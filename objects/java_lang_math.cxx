@@ -0,0 +1,51 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "JavaClass.h"
+#include "compile.h"
+#include "java_lang_math.h"
+
+// Only the int versions.  These are inlined instead of being calls.
+#define CHECK_FUNC(funct) \
+  if (strcmp(#funct, function) == 0) \
+  { \
+    return math_##funct(java_class, generator); \
+  }
+
+static int math_abs_I(JavaClass *java_class, Generator *generator)
+{
+  return generator->math_abs();
+}
+
+static int math_min_II(JavaClass *java_class, Generator *generator)
+{
+  return generator->math_min();
+}
+
+static int math_max_II(JavaClass *java_class, Generator *generator)
+{
+  return generator->math_max();
+}
+
+int java_lang_math(JavaClass *java_class, Generator *generator, char *function)
+{
+  CHECK_FUNC(abs_I)
+  CHECK_FUNC(min_II)
+  CHECK_FUNC(max_II)
+
+  return -1;
+}
+
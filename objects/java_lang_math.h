@@ -0,0 +1,21 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _JAVA_LANG_MATH_H
+#define _JAVA_LANG_MATH_H
+
+#include "Generator.h"
+#include "JavaClass.h"
+
+int java_lang_math(JavaClass *java_class, Generator *generator, char *function);
+
+#endif
+
@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+
+# Cycle and code size scoreboard for the kernels in testing/bench:
+#
+#   make && make sim && make java && make -C testing/bench
+#   python scripts/bench.py [ -update ]
+#
+# Every kernel is ground for every CPU with a simulator and run until
+# main() gets to its final while(true).  Cycles are the total for the
+# run and bytes are the code of every method that ran, both compared
+# with testing/bench/baseline.txt.  The result test() returned is shown
+# too so a change in it (a miscompile) stands out with a !.  -update
+# writes the new numbers to the baseline.
+#
+# Kernels with buffers are compiled once per CPU against a BenchRam
+# class that says where RAM is so the class files are in
+# testing/bench/<dir>.
+
+import subprocess
+import sys
+
+BENCH_DIR = "testing/bench"
+BASELINE = BENCH_DIR + "/baseline.txt"
+OUT_DIR = "/tmp"
+
+kernels = [
+  "BenchCrc16",
+  "BenchFir",
+  "BenchSort",
+  "BenchSqrt",
+  "BenchSpi",
+  "BenchMatrix",
+  "BenchRing",
+  "BenchProtocol",
+]
+
+# cpu, directory the kernels were compiled to
+cpus = [
+  ("msp430g2553", "msp430"),
+  ("msp430fr5969", "msp430fr"),
+  ("dspic30f3012", "dspic"),
+  ("pic32mx250f128b", "pic32"),
+]
+
+def run(command):
+  p = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+  output = p.communicate()[0].decode("latin-1")
+  return p.returncode, output.splitlines()
+
+def grind(kernel, cpu, directory):
+  asm = "%s/bench_%s_%s.asm" % (OUT_DIR, kernel, cpu)
+
+  code, lines = run([ "./java_grinder",
+    "%s/%s/%s.class" % (BENCH_DIR, directory, kernel), asm, cpu ])
+
+  if code != 0: return "java_grinder failed"
+
+  code, lines = run([ "./simulate", asm, cpu, "-result", "test" ])
+
+  cycles = None
+  result = None
+  stopped = None
+  size = 0
+  methods = False
+
+  for line in lines:
+    if line.startswith("Stopped: "):
+      stopped = line[9:]
+    elif line.startswith("Total cycles: "):
+      cycles = int(line[14:])
+    elif line.startswith("Result: "):
+      result = int(line[8:])
+    elif line.startswith("Method "):
+      methods = True
+    elif methods and len(line.split()) == 5:
+      size += int(line.split()[4])
+    elif line.startswith("Error"):
+      return line
+
+  if stopped != "halted": return "Stopped: %s" % stopped
+  if result == None: return "test() never returned"
+
+  return (cycles, size, result)
+
+def read_baseline():
+  baseline = {}
+
+  try:
+    for line in open(BASELINE):
+      if line.startswith("#"): continue
+      fields = line.split()
+      baseline[(fields[0], fields[1])] = (int(fields[2]), int(fields[3]), int(fields[4]))
+  except IOError:
+    pass
+
+  return baseline
+
+def delta(new, old):
+  if old == None or old == 0: return "-"
+  return "%+.1f%%" % ((new - old) * 100.0 / old)
+
+# ------------------------------------------------------------------ main
+update = len(sys.argv) == 2 and sys.argv[1] == "-update"
+
+if len(sys.argv) != 1 and not update:
+  print("Usage: python %s [ -update ]" % sys.argv[0])
+  sys.exit(1)
+
+baseline = read_baseline()
+results = {}
+failed = 0
+
+print("%-14s %-18s %9s %9s %8s %6s %6s %8s %7s" %
+  ("Kernel", "CPU", "Cycles", "Baseline", "Delta", "Bytes", "Base", "Delta", "Result"))
+
+for kernel in kernels:
+  for cpu, directory in cpus:
+    r = grind(kernel, cpu, directory)
+
+    if not isinstance(r, tuple):
+      print("%-14s %-18s %s" % (kernel, cpu, r))
+      failed += 1
+      continue
+
+    results[(kernel, cpu)] = r
+    old = baseline.get((kernel, cpu), (None, None, None))
+
+    print("%-14s %-18s %9d %9s %8s %6d %6s %8s %6d%s" %
+      (kernel, cpu,
+       r[0], old[0] if old[0] != None else "-", delta(r[0], old[0]),
+       r[1], old[1] if old[1] != None else "-", delta(r[1], old[1]),
+       r[2], "!" if old[2] != None and old[2] != r[2] else " "))
+
+if update:
+  out = open(BASELINE, "w")
+  out.write("# kernel cpu cycles bytes result\n")
+  for kernel in kernels:
+    for cpu, directory in cpus:
+      if (kernel, cpu) in results:
+        r = results[(kernel, cpu)]
+        out.write("%s %s %d %d %d\n" % (kernel, cpu, r[0], r[1], r[2]))
+  out.close()
+
+sys.exit(1 if failed != 0 else 0)
@@ -0,0 +1,299 @@
+#!/usr/bin/env python
+
+# Differential test of java_grinder's output against the host JVM.  Each
+# program in testing/harness/tests.txt is run on the JVM with the
+# recording stubs from testing/harness/stubs and on the simulator for
+# every CPU listed next to it (with +option for a java_grinder --option):
+#
+#   make && make sim && make java && make -C testing/harness
+#   python scripts/harness.py [ -threshold <percent> ] [ -update ]
+#
+# The return value of test(), the IOPort / SPI events and the final
+# value of every byte written with Memory have to match.  int is 16 bit
+# on the MSP430 and dsPIC so only the low 16 bits of the result are
+# compared.
+# UART events are listed but not compared since the simulators don't
+# model a UART yet.
+#
+# Cycles and code size of every method go into testing/harness/results.txt.
+# Anything that got slower or bigger than testing/harness/baseline.txt by
+# more than the threshold is a failure and so is a method the baseline
+# has no numbers for.  -update copies the results over the baseline.
+# testing/harness/sample.txt has the output of a run next to the raw
+# simulator traces it was normalized from.
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+HARNESS_DIR = "testing/harness"
+TESTS = HARNESS_DIR + "/tests.txt"
+RESULTS = HARNESS_DIR + "/results.txt"
+BASELINE = HARNESS_DIR + "/baseline.txt"
+CLASSPATH = HARNESS_DIR + "/stubs:" + HARNESS_DIR + ":build/JavaGrinder.jar"
+OUT_DIR = "/tmp"
+
+# Width of an I/O port and how the simulator names port registers
+cpus = {
+  "msp430g2231": { "port_mask": 0xff },
+  "msp430g2553": { "port_mask": 0xff },
+  "msp430fr5969": { "port_mask": 0xff },
+  "dspic30f3012": { "port_mask": 0xffff },
+  "dspic33fj06gs101a": { "port_mask": 0xffff },
+  "pic32mx250f128b": { "port_mask": 0xffff },
+}
+
+def sign16(a):
+  a &= 0xffff
+  return a - 0x10000 if a & 0x8000 else a
+
+def run(command):
+  p = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+  output = p.communicate()[0].decode("latin-1")
+  return p.returncode, output.splitlines()
+
+def collapse(events):
+  # Targets can write the same value twice in a row where the host
+  # only does it once (or the other way around).
+  result = []
+  for event in events:
+    if len(result) == 0 or result[-1] != event:
+      result.append(event)
+  return result
+
+# Host events are PORT<n> DIR=0x.., PORT<n> OUT=0x.., SPI<n> 0x..,
+# UART<n> 0x.. and Memory 0x.... = 0x...
+def run_host(name, cpu):
+  code, lines = run([ "java", "-cp", CLASSPATH, "Harness", name ])
+
+  host = { "events": [], "uart": [], "memory": [], "result": None }
+
+  if code != 0:
+    host["error"] = "\n".join(lines)
+    return host
+
+  for line in lines:
+    m = re.match(r"PORT(\d) (DIR|OUT)=0x([0-9a-f]+)$", line)
+    if m:
+      value = int(m.group(3), 16) & cpus[cpu]["port_mask"]
+      host["events"].append("PORT%s %s=0x%04x" % (m.group(1), m.group(2), value))
+      continue
+
+    m = re.match(r"SPI(\d) 0x([0-9a-f]+)$", line)
+    if m:
+      host["events"].append("SPI%s 0x%02x" % (m.group(1), int(m.group(2), 16)))
+      continue
+
+    if line.startswith("UART"):
+      host["uart"].append(line)
+    elif line.startswith("Memory"):
+      host["memory"].append(line)
+    elif line.startswith("Result: "):
+      host["result"] = sign16(int(line[8:]))
+    else:
+      host["error"] = "unknown line from the stubs: " + line
+      return host
+
+  host["events"] = collapse(host["events"])
+
+  return host
+
+# Memory dumps are asked for in runs of consecutive addresses
+def dump_options(memory):
+  addresses = [ int(line.split()[1], 16) for line in memory ]
+  options = []
+  n = 0
+  while n < len(addresses):
+    start = n
+    while n + 1 < len(addresses) and addresses[n + 1] == addresses[n] + 1:
+      n += 1
+    options += [ "-dump", "0x%04x" % addresses[start], str(n - start + 1) ]
+    n += 1
+  return options
+
+# The MSP430 names ports P1, P2.. and the dsPIC and PIC32 A, B.. with
+# TRIS bits set for inputs.  dsPIC and PIC32 SPI1 is the Java SPI0.
+def normalize(line, cpu):
+  m = re.match(r"\d+: P(\d)(DIR|OUT)=0x([0-9a-f]+)$", line)
+  if m:
+    return "PORT%d %s=0x%04x" % (int(m.group(1)) - 1, m.group(2), int(m.group(3), 16))
+
+  m = re.match(r"\d+: (TRIS|LAT)([A-Z])=0x([0-9a-f]+)$", line)
+  if m:
+    value = int(m.group(3), 16)
+    if m.group(1) == "TRIS":
+      return "PORT%d DIR=0x%04x" % (ord(m.group(2)) - ord('A'), value ^ 0xffff)
+    return "PORT%d OUT=0x%04x" % (ord(m.group(2)) - ord('A'), value)
+
+  m = re.match(r"\d+: SPI(\d) 0x([0-9a-f]+)$", line)
+  if m:
+    index = int(m.group(1))
+    if cpu.startswith("dspic") or cpu.startswith("pic32"): index -= 1
+    return "SPI%d 0x%02x" % (index, int(m.group(2), 16) & 0xff)
+
+  return None
+
+# A CPU can have java_grinder options after it: msp430g2553+static-frames
+# is ground with --static-frames.
+def run_target(name, cpu, memory):
+  asm = "%s/harness_%s_%s.asm" % (OUT_DIR, name, cpu)
+  options = [ "--" + option for option in cpu.split("+")[1:] ]
+  cpu = cpu.split("+")[0]
+
+  target = { "events": [], "memory": [], "result": None, "methods": [] }
+
+  code, lines = run([ "./java_grinder", "%s/%s.class" % (HARNESS_DIR, name), asm, cpu ] +
+    options)
+
+  if code != 0:
+    target["error"] = "java_grinder failed\n" + "\n".join(lines)
+    return target
+
+  code, lines = run([ "./simulate", asm, cpu, "-trace", "-result", "test" ] +
+    dump_options(memory))
+
+  methods = False
+
+  for line in lines:
+    event = normalize(line, cpu)
+    if event != None:
+      target["events"].append(event)
+    elif re.match(r"\d+: ", line):
+      target["error"] = "unknown trace line: " + line
+    elif line.startswith("Stopped: "):
+      target["stopped"] = line[9:]
+    elif line.startswith("Result: "):
+      target["result"] = sign16(int(line[8:]))
+    elif line.startswith("Memory"):
+      target["memory"].append(line)
+    elif line.startswith("Method "):
+      methods = True
+    elif methods and len(line.split()) == 5:
+      target["methods"].append(line.split())
+    elif line.startswith("Error"):
+      target["error"] = line
+
+  if not "error" in target and target.get("stopped") != "halted":
+    target["error"] = "Stopped: %s" % target.get("stopped")
+
+  target["events"] = collapse(target["events"])
+
+  return target
+
+def compare(what, host, target):
+  if host == target: return []
+
+  errors = [ "%s differs:" % what ]
+  for n in range(max(len(host), len(target))):
+    h = host[n] if n < len(host) else "-"
+    t = target[n] if n < len(target) else "-"
+    errors.append("  %s %-24s %s" % ("*" if h != t else " ", h, t))
+  return errors
+
+def read_results(filename):
+  results = {}
+  if not os.path.exists(filename): return results
+
+  for line in open(filename):
+    if line.startswith("#"): continue
+    fields = line.split()
+    results[(fields[0], fields[1], fields[2])] = (int(fields[5]), int(fields[6]))
+  return results
+
+def check_regressions(results, baseline, threshold):
+  errors = []
+
+  for key in sorted(results.keys()):
+    if not key in baseline:
+      errors.append("%s %s %s: not in %s" % (key[0], key[1], key[2], BASELINE))
+      continue
+
+    for n, what in [ (0, "cycles"), (1, "bytes") ]:
+      old = baseline[key][n]
+      new = results[key][n]
+      if new > old * (1 + threshold / 100.0):
+        errors.append("%s %s %s: %d %s, was %d" %
+          (key[0], key[1], key[2], new, what, old))
+
+  return errors
+
+# ------------------------------------------------------------------ main
+threshold = 5.0
+update = False
+
+n = 1
+while n < len(sys.argv):
+  if sys.argv[n] == "-threshold" and n + 1 < len(sys.argv):
+    threshold = float(sys.argv[n + 1])
+    n += 1
+  elif sys.argv[n] == "-update":
+    update = True
+  else:
+    print("Usage: python %s [ -threshold <percent> ] [ -update ]" % sys.argv[0])
+    sys.exit(1)
+  n += 1
+
+failed = 0
+results = {}
+out = open(RESULTS, "w")
+out.write("# program cpu method calls cycles inclusive size\n")
+
+for line in open(TESTS):
+  if line.startswith("#") or line.strip() == "": continue
+
+  fields = line.split()
+  name = fields[0]
+
+  for cpu in fields[1:]:
+    host = run_host(name, cpu)
+
+    if "error" in host:
+      print("%s %s: FAIL on JVM\n%s" % (name, cpu, host["error"]))
+      failed += 1
+      continue
+
+    target = run_target(name, cpu, host["memory"])
+
+    errors = []
+
+    if "error" in target:
+      errors.append(target["error"])
+
+    if host["result"] != target["result"]:
+      errors.append("result differs: JVM %s, %s %s" % (host["result"], cpu, target["result"]))
+
+    errors += compare("I/O trace", host["events"], target["events"])
+    errors += compare("memory", host["memory"], target["memory"])
+
+    for row in target["methods"]:
+      out.write("%s %s %s\n" % (name, cpu, " ".join(row)))
+      results[(name, cpu, row[0])] = (int(row[3]), int(row[4]))
+
+    if len(errors) == 0:
+      print("%s %s: ok" % (name, cpu))
+    else:
+      print("%s %s: FAIL" % (name, cpu))
+      for error in errors: print("  " + error)
+      failed += 1
+
+    if len(host["uart"]) != 0:
+      print("  %d UART events not compared" % len(host["uart"]))
+
+out.close()
+
+errors = []
+
+if not update:
+  errors = check_regressions(results, read_results(BASELINE), threshold)
+
+if len(errors) != 0:
+  print("Performance regressions over %.1f%% or no baseline:" % threshold)
+  for error in errors: print("  " + error)
+  failed += 1
+
+if update:
+  shutil.copyfile(RESULTS, BASELINE)
+
+sys.exit(1 if failed != 0 else 0)
@@ -0,0 +1,576 @@
+#!/usr/bin/env python
+
+# Superoptimizer for short constant operand sequences on the MSP430 and
+# dsPIC.  Every sequence of up to 4 register instructions is run on
+# a bit accurate model of the CPU and the shortest one computing each
+# idiom is kept.  Candidates are then checked against all 65536 inputs
+# before being written out as generator/table_superopt.cxx:
+#
+#   python scripts/superopt.py > generator/table_superopt.cxx
+#
+# The value being worked on is in register %r and %t is a scratch
+# register that holds garbage on entry.  min and max take their second
+# operand in %t.  %l is a label the sequence jumps to.  Since int is 16
+# bit on both CPUs the results only have to match in the low 16 bits.
+#
+# Idioms:
+#
+#   i2b, i2s, i2c   casts
+#   mul c           x * c
+#   bits c          (x >> (c >> 8)) & ((1 << (c & 0xff)) - 1)
+#   abs             Math.abs(x)
+#   min, max        Math.min(x, y), Math.max(x, y)
+
+import random
+import sys
+
+MASK = 0xffff
+
+MUL_MIN = -64
+MUL_MAX = 1024
+
+# Constants that get a multiply even when nothing 4 instructions long
+# was found.  These are built from shifts and adds instead.
+MUL_CHAIN = list(range(-16, 17)) + [ 10, 100 ]
+
+random.seed(1)
+
+tests = [ 0, 1, 2, 3, 0x7f, 0x80, 0xff, 0x100, 0x7fff, 0x8000, 0xffff ]
+tests += [ random.randint(0, MASK) for i in range(21) ]
+garbage = [ random.randint(0, MASK) for i in range(len(tests)) ]
+carry = [ random.randint(0, 1) for i in range(len(tests)) ]
+
+# Pairs for min and max.  Overflow in the compare is what usually
+# breaks them so there are plenty of values near the ends.
+edges = [ 0, 1, 2, 0x7ffe, 0x7fff, 0x8000, 0x8001, 0xfffe, 0xffff ]
+tests2 = [ (x, y) for x in edges for y in edges ]
+tests2 += [ (random.randint(0, MASK), random.randint(0, MASK)) for i in range(23) ]
+
+def sign16(a):
+  return a - 0x10000 if a & 0x8000 else a
+
+def sxt8(a):
+  return (a | 0xff00) & MASK if a & 0x80 else a & 0xff
+
+# ------------------------------------------------------------- MSP430
+# state is (r, t, c).  Every instruction here is register mode or uses
+# the constant generator so each one is a single cycle.  There is no
+# hardware multiplier on the G2xx parts so anything found here beats
+# calling _mul_integers.
+
+MSP430_MAX_LEN = 4
+MSP430_MAX_CHAIN = 10
+
+def msp430_add(d, s, c):
+  v = d + s + c
+  return v & MASK, v >> 16
+
+def msp430_ops():
+  ops = []
+  regs = [ ("%r", 0), ("%t", 1) ]
+
+  def two(name, fn):
+    for sname, s in regs:
+      for dname, d in regs:
+        ops.append(("%s %s, %s" % (name, sname, dname), fn, s, d))
+
+  def one(name, fn):
+    for dname, d in regs:
+      ops.append(("%s %s" % (name, dname), fn, d, d))
+
+  two("mov.w", lambda d, s, c: (s, c))
+  two("add.w", lambda d, s, c: msp430_add(d, s, 0))
+  two("addc.w", lambda d, s, c: msp430_add(d, s, c))
+  two("sub.w", lambda d, s, c: msp430_add(d, s ^ MASK, 1))
+  two("subc.w", lambda d, s, c: msp430_add(d, s ^ MASK, c))
+  two("and.w", lambda d, s, c: (d & s, int((d & s) != 0)))
+  two("bis.w", lambda d, s, c: (d | s, c))
+  two("xor.w", lambda d, s, c: (d ^ s, int((d ^ s) != 0)))
+  one("inv.w", lambda d, s, c: (d ^ MASK, int((d ^ MASK) != 0)))
+  one("inc.w", lambda d, s, c: msp430_add(d, 1, 0))
+  one("dec.w", lambda d, s, c: msp430_add(d, MASK, 0))
+  one("clr.w", lambda d, s, c: (0, c))
+  one("rra.w", lambda d, s, c: ((d >> 1) | (d & 0x8000), d & 1))
+  one("rrc.w", lambda d, s, c: ((d >> 1) | (c << 15), d & 1))
+  one("swpb", lambda d, s, c: (((d << 8) | (d >> 8)) & MASK, c))
+  one("sxt", lambda d, s, c: (sxt8(d), int(sxt8(d) != 0)))
+
+  return ops
+
+def msp430_step(op, state):
+  name, fn, s, d = op
+  regs = [ state[0], state[1] ]
+  regs[d], c = fn(regs[d], regs[s], state[2])
+  return (regs[0], regs[1], c)
+
+def msp430_start(x, n):
+  return (x, garbage[n], carry[n])
+
+# Bit fields only need %r and an and with a mask, which the search
+# above doesn't have since the mask depends on the idiom.  Every one of
+# these instructions moves bits around or clears them, so running it on
+# 0 with carry clear and set and on each single bit tells exactly what
+# a sequence does.  That makes the search small enough to do for each
+# field with its own masks.
+
+def msp430_bits_ops(width):
+  ops = []
+
+  def one(name, fn):
+    ops.append((name, fn, 0, 0))
+
+  one("rra.w %r", lambda d, s, c: ((d >> 1) | (d & 0x8000), d & 1))
+  one("rrc.w %r", lambda d, s, c: ((d >> 1) | (c << 15), d & 1))
+  one("add.w %r, %r", lambda d, s, c: msp430_add(d, d, 0))
+  one("addc.w %r, %r", lambda d, s, c: msp430_add(d, d, c))
+  one("swpb %r", lambda d, s, c: (((d << 8) | (d >> 8)) & MASK, c))
+  one("mov.b %r, %r", lambda d, s, c: (d & 0xff, c))
+  one("clr.w %r", lambda d, s, c: (0, c))
+  one("clrc", lambda d, s, c: (d, 0))
+
+  for shift in range(0, 17 - width):
+    mask = ((1 << width) - 1) << shift
+    one("and.w #0x%04x, %%r" % mask, lambda d, s, c, mask=mask: (d & mask, int((d & mask) != 0)))
+
+  return ops
+
+bits_starts = [ (0, 0, 0), (0, 0, 1) ] + [ (1 << i, 0, 0) for i in range(16) ]
+
+# Conditional jumps need all four flags.  The state is (r, t, flags,
+# skip) where skip is how many more instructions a taken jump goes
+# over.  Only one jump per sequence so there is only one label.
+
+MSP430_BRANCH_LEN = 4
+
+MSP430_C = 1
+MSP430_Z = 2
+MSP430_N = 4
+MSP430_V = 0x100
+
+def msp430_nz(v):
+  return (MSP430_Z if v == 0 else 0) | (MSP430_N if v & 0x8000 else 0)
+
+def msp430_arith(d, s, c):
+  v = d + s + c
+  r = v & MASK
+  f = msp430_nz(r)
+  if v >> 16: f |= MSP430_C
+  if (d ^ r) & (s ^ r) & 0x8000: f |= MSP430_V
+  return r, f
+
+def msp430_logic(r, v):
+  return r, msp430_nz(r) | (MSP430_C if r != 0 else 0) | (MSP430_V if v else 0)
+
+def msp430_branch_ops():
+  ops = []
+  regs = [ ("%r", 0), ("%t", 1) ]
+
+  # fn(d, s, flags) returns (value or None for flags only, flags)
+  def two(name, fn):
+    for sname, s in regs:
+      for dname, d in regs:
+        ops.append(("%s %s, %s" % (name, sname, dname), fn, s, d, 0))
+
+  def one(name, fn):
+    for dname, d in regs:
+      ops.append(("%s %s" % (name, dname), fn, d, d, 0))
+
+  two("mov.w", lambda d, s, f: (s, f))
+  two("add.w", lambda d, s, f: msp430_arith(d, s, 0))
+  two("sub.w", lambda d, s, f: msp430_arith(d, s ^ MASK, 1))
+  two("cmp.w", lambda d, s, f: (None, msp430_arith(d, s ^ MASK, 1)[1]))
+  two("xor.w", lambda d, s, f: msp430_logic(d ^ s, d & s & 0x8000))
+  one("inv.w", lambda d, s, f: msp430_logic(d ^ MASK, d & 0x8000))
+  one("inc.w", lambda d, s, f: msp430_arith(d, 1, 0))
+  one("tst.w", lambda d, s, f: (None, msp430_arith(d, MASK, 1)[1]))
+  one("rra.w", lambda d, s, f: ((d >> 1) | (d & 0x8000), msp430_nz((d >> 1) | (d & 0x8000)) | (d & 1)))
+
+  conds = [ ("jge", lambda f: bool(f & MSP430_N) == bool(f & MSP430_V)),
+            ("jl", lambda f: bool(f & MSP430_N) != bool(f & MSP430_V)),
+            ("jn", lambda f: bool(f & MSP430_N)),
+            ("jc", lambda f: bool(f & MSP430_C)),
+            ("jnc", lambda f: not (f & MSP430_C)) ]
+
+  for name, cond in conds:
+    for skip in [ 1, 2 ]:
+      ops.append(("%s %%l" % name, cond, 0, 0, skip))
+
+  return ops
+
+def msp430_branch_step(op, state):
+  name, fn, s, d, skip = op
+  r, t, f, k = state
+
+  if k > 0: return (r, t, f, k - 1)
+
+  if skip > 0: return (r, t, f, skip if fn(f) else 0)
+
+  regs = [ r, t ]
+  v, f = fn(regs[d], regs[s], f)
+  if v is not None: regs[d] = v
+  return (regs[0], regs[1], f, 0)
+
+def msp430_branch_start(x, n):
+  n %= len(garbage)
+  y = garbage[n]
+  if type(x) is tuple: x, y = x
+  return (x, y, (carry[n] * MSP430_C) | (garbage[n] & (MSP430_Z | MSP430_N | MSP430_V)), 0)
+
+# -------------------------------------------------------------- dsPIC
+# Three operand instructions, again all single cycle.  There are no
+# flags the sequences depend on so the state is only (r, t).  A mul is
+# a single cycle here so only very short sequences are worth having.
+
+DSPIC_MAX_LEN = 2
+
+def dspic_ops():
+  ops = []
+  regs = [ ("%r", 0), ("%t", 1) ]
+
+  for aname, a in regs:
+    for dname, d in regs:
+      ops.append(("mov %s, %s" % (aname, dname), lambda x, y: x, a, a, d))
+      ops.append(("neg %s, %s" % (aname, dname), lambda x, y: (-x) & MASK, a, a, d))
+      ops.append(("com %s, %s" % (aname, dname), lambda x, y: x ^ MASK, a, a, d))
+      ops.append(("se %s, %s" % (aname, dname), lambda x, y: sxt8(x), a, a, d))
+      ops.append(("ze %s, %s" % (aname, dname), lambda x, y: x & 0xff, a, a, d))
+
+      for k in range(1, 16):
+        ops.append(("sl %s, #%d, %s" % (aname, k, dname),
+          lambda x, y, k=k: (x << k) & MASK, a, a, d))
+        ops.append(("asr %s, #%d, %s" % (aname, k, dname),
+          lambda x, y, k=k: (sign16(x) >> k) & MASK, a, a, d))
+        ops.append(("lsr %s, #%d, %s" % (aname, k, dname),
+          lambda x, y, k=k: x >> k, a, a, d))
+
+      for bname, b in regs:
+        ops.append(("add %s, %s, %s" % (aname, bname, dname),
+          lambda x, y: (x + y) & MASK, a, b, d))
+        ops.append(("sub %s, %s, %s" % (aname, bname, dname),
+          lambda x, y: (x - y) & MASK, a, b, d))
+
+  return ops
+
+def dspic_step(op, state):
+  name, fn, a, b, d = op
+  regs = [ state[0], state[1] ]
+  regs[d] = fn(regs[a], regs[b])
+  return (regs[0], regs[1])
+
+def dspic_start(x, n):
+  return (x, garbage[n])
+
+# The flags for bra.  Instructions whose effect on the flags isn't
+# modelled leave them as None and a bra after one of those is thrown
+# out.  bra only skips one instruction.
+
+DSPIC_BRANCH_LEN = 3
+
+DSPIC_C = 1
+DSPIC_Z = 2
+DSPIC_OV = 4
+DSPIC_N = 8
+
+def dspic_nz(v):
+  return (DSPIC_Z if v == 0 else 0) | (DSPIC_N if v & 0x8000 else 0)
+
+def dspic_sub(a, b):
+  r = (a - b) & MASK
+  f = dspic_nz(r)
+  if a >= b: f |= DSPIC_C
+  if (a ^ b) & (a ^ r) & 0x8000: f |= DSPIC_OV
+  return r, f
+
+def dspic_add(a, b):
+  r = (a + b) & MASK
+  f = dspic_nz(r)
+  if a + b > MASK: f |= DSPIC_C
+  if (a ^ r) & (b ^ r) & 0x8000: f |= DSPIC_OV
+  return r, f
+
+def dspic_branch_ops():
+  ops = []
+  regs = [ ("%r", 0), ("%t", 1) ]
+
+  # fn(x, y, flags) returns (value or None for flags only, flags)
+  for aname, a in regs:
+    ops.append(("cp0 %s" % aname, lambda x, y, f: (None, dspic_sub(x, 0)[1]), a, a, a, 0))
+
+    for dname, d in regs:
+      ops.append(("mov %s, %s" % (aname, dname), lambda x, y, f: (x, None), a, a, d, 0))
+      ops.append(("neg %s, %s" % (aname, dname), lambda x, y, f: dspic_sub(0, x), a, a, d, 0))
+      ops.append(("asr %s, #15, %s" % (aname, dname),
+        lambda x, y, f: ((sign16(x) >> 15) & MASK, None), a, a, d, 0))
+
+      for bname, b in regs:
+        if a == b: continue
+        ops.append(("add %s, %s, %s" % (aname, bname, dname), lambda x, y, f: dspic_add(x, y), a, b, d, 0))
+        ops.append(("sub %s, %s, %s" % (aname, bname, dname), lambda x, y, f: dspic_sub(x, y), a, b, d, 0))
+        ops.append(("xor %s, %s, %s" % (aname, bname, dname),
+          lambda x, y, f: (x ^ y, None if f is None else (f & ~(DSPIC_Z | DSPIC_N)) | dspic_nz(x ^ y)), a, b, d, 0))
+
+    for bname, b in regs:
+      if a != b:
+        ops.append(("cp %s, %s" % (aname, bname), lambda x, y, f: (None, dspic_sub(x, y)[1]), a, b, a, 0))
+
+  conds = [ ("ge", lambda f: bool(f & DSPIC_N) == bool(f & DSPIC_OV)),
+            ("lt", lambda f: bool(f & DSPIC_N) != bool(f & DSPIC_OV)),
+            ("gt", lambda f: not (f & DSPIC_Z) and bool(f & DSPIC_N) == bool(f & DSPIC_OV)),
+            ("le", lambda f: bool(f & DSPIC_Z) or bool(f & DSPIC_N) != bool(f & DSPIC_OV)),
+            ("n", lambda f: bool(f & DSPIC_N)),
+            ("nn", lambda f: not (f & DSPIC_N)) ]
+
+  for name, cond in conds:
+    ops.append(("bra %s, %%l" % name, cond, 0, 0, 0, 1))
+
+  return ops
+
+def dspic_branch_step(op, state):
+  name, fn, a, b, d, skip = op
+  r, t, f, k = state
+
+  if k > 0: return (r, t, f, k - 1)
+
+  if skip > 0:
+    if f is None: return None
+    return (r, t, f, skip if fn(f) else 0)
+
+  regs = [ r, t ]
+  v, f = fn(regs[a], regs[b], f)
+  if v is not None: regs[d] = v
+  return (regs[0], regs[1], f, 0)
+
+def dspic_branch_start(x, n):
+  n %= len(garbage)
+  y = garbage[n]
+  if type(x) is tuple: x, y = x
+  return (x, y, (carry[n] * DSPIC_C) | (garbage[n] & (DSPIC_Z | DSPIC_OV | DSPIC_N)), 0)
+
+# -------------------------------------------------------------- search
+
+idioms = [ ("i2b", 0, lambda x: sxt8(x)),
+           ("i2s", 0, lambda x: x),
+           ("i2c", 0, lambda x: x) ]
+
+for c in range(MUL_MIN, MUL_MAX + 1):
+  idioms.append(("mul", c, lambda x, c=c: (x * c) & MASK))
+
+for shift in range(1, 16):
+  for width in range(1, 17 - shift):
+    idioms.append(("bits", (shift << 8) | width,
+      lambda x, shift=shift, width=width: (x >> shift) & ((1 << width) - 1)))
+
+idioms_branch = [ ("abs", 0, lambda x: abs(sign16(x)) & MASK) ]
+
+idioms_branch2 = [ ("min", 0, lambda x, y: min(sign16(x), sign16(y)) & MASK),
+                   ("max", 0, lambda x, y: max(sign16(x), sign16(y)) & MASK) ]
+
+def get_skip(op):
+  return op[-1] if "%l" in op[0] else 0
+
+def complete(seq):
+  # A jump needs the instructions it skips to be in the sequence
+  for n, op in enumerate(seq):
+    if n + get_skip(op) >= len(seq): return False
+  return True
+
+def run(seq, step, state):
+  for op in seq:
+    state = step(op, state)
+    if state is None: return None
+  return state[0]
+
+def cases(start, fn, arity):
+  if arity == 1:
+    for x in range(0, MASK + 1):
+      for n in range(0, 3):
+        yield start(x, n), fn(x)
+  else:
+    for x in range(0, MASK + 1):
+      for y in edges:
+        yield start((x, y), x & 3), fn(x, y)
+        yield start((y, x), x & 3), fn(y, x)
+
+def verify(seq, step, all_cases):
+  for state, result in all_cases:
+    if run(seq, step, state) != result: return False
+  return True
+
+def search(ops, step, starts, args, max_len, idioms, check):
+  # Breadth first search where sequences that leave the CPU in the same
+  # state for every test input are only expanded once.  starts are the
+  # CPU states for each test and args what the idioms are given for it.
+  states = [ tuple(starts) ]
+  seqs = [ [] ]
+  seen = set(states)
+  found = { }
+  level_start = 0
+
+  wanted = { }
+  for idiom in idioms:
+    r = tuple(idiom[2](*a) for a in args)
+    wanted.setdefault(r, []).append(idiom)
+
+  for length in range(0, max_len + 1):
+    level_end = len(states)
+
+    for i in range(level_start, level_end):
+      if complete(seqs[i]):
+        r = tuple(s[0] for s in states[i])
+
+        for idiom in wanted.get(r, []):
+          key = (idiom[0], idiom[1])
+          if key in found: continue
+          if check(seqs[i], idiom):
+            found[key] = seqs[i]
+
+      if length == max_len: continue
+
+      jumps = len([ op for op in seqs[i] if get_skip(op) != 0 ])
+
+      for op in ops:
+        if jumps != 0 and get_skip(op) != 0: continue
+        state = tuple(step(op, s) for s in states[i])
+        if None in state or state in seen: continue
+        seen.add(state)
+        states.append(state)
+        seqs.append(seqs[i] + [ op ])
+
+    level_start = level_end
+
+  return found
+
+def search_unary(ops, step, start, max_len, idioms):
+  return search(ops, step, [ start(x, n) for n, x in enumerate(tests) ],
+    [ (x,) for x in tests ], max_len, idioms,
+    lambda seq, idiom: verify(seq, step, cases(start, idiom[2], 1)))
+
+def search_binary(ops, step, start, max_len, idioms):
+  return search(ops, step, [ start(a, n) for n, a in enumerate(tests2) ],
+    tests2, max_len, idioms,
+    lambda seq, idiom: verify(seq, step, cases(start, idiom[2], 2)))
+
+def search_bits(found):
+  # Any field the general search didn't get in fewer instructions
+  for idiom in idioms:
+    if idiom[0] != "bits": continue
+
+    key = (idiom[0], idiom[1])
+    max_len = MSP430_MAX_LEN
+    if key in found: max_len = len(found[key]) - 1
+
+    # c is in bit 0 of the carry for these
+    result = search(msp430_bits_ops(idiom[1] & 0xff), msp430_step, bits_starts,
+      [ (s[0],) for s in bits_starts ], max_len, [ idiom ],
+      lambda seq, idiom: verify(seq, msp430_step,
+        [ ((x, 0, c), idiom[2](x)) for x in range(0, MASK + 1) for c in [ 0, 1 ] ]))
+
+    found.update(result)
+
+def search_chain(found):
+  # Shift and add for the constants in MUL_CHAIN.  Only mov, add, sub,
+  # inv and inc are used so every register holds a * x + b and the
+  # search can be done on (a, b) instead of on test values.  None is
+  # the garbage %t starts with.
+  def add(x, y):
+    if x is None or y is None: return None
+    return ((x[0] + y[0]) & MASK, (x[1] + y[1]) & MASK)
+
+  def neg(x):
+    if x is None: return None
+    return ((-x[0]) & MASK, (-x[1]) & MASK)
+
+  chain = [ ("mov.w %r, %t", lambda r, t: (r, r)),
+            ("mov.w %t, %r", lambda r, t: (t, t)),
+            ("add.w %r, %r", lambda r, t: (add(r, r), t)),
+            ("add.w %t, %t", lambda r, t: (r, add(t, t))),
+            ("add.w %t, %r", lambda r, t: (add(r, t), t)),
+            ("add.w %r, %t", lambda r, t: (r, add(t, r))),
+            ("sub.w %t, %r", lambda r, t: (add(r, neg(t)), t)),
+            ("sub.w %r, %t", lambda r, t: (r, add(t, neg(r)))),
+            ("inv.w %r", lambda r, t: (add(neg(r), (0, MASK)), t)),
+            ("inc.w %r", lambda r, t: (add(r, (0, 1)), t)) ]
+
+  ops = dict((op[0], op) for op in msp430_ops())
+  wanted = dict((((c & MASK), 0), c) for c in MUL_CHAIN if not ("mul", c) in found)
+
+  level = [ (((1, 0), None), []) ]
+  seen = set([ level[0][0] ])
+
+  for length in range(1, MSP430_MAX_CHAIN + 1):
+    if len(wanted) == 0: break
+    next_level = [ ]
+
+    for (r, t), seq in level:
+      for name, fn in chain:
+        state = fn(r, t)
+        if state[0] is None or state in seen: continue
+        seen.add(state)
+        next_level.append((state, seq + [ ops[name] ]))
+
+        c = wanted.get(state[0])
+        if c is None: continue
+        if verify(next_level[-1][1], msp430_step, cases(msp430_start, lambda x, c=c: (x * c) & MASK, 1)):
+          found[("mul", c)] = next_level[-1][1]
+          del wanted[state[0]]
+
+    level = next_level
+
+def get_text(seq):
+  text = [ op[0] for op in seq ]
+
+  for n, op in enumerate(seq):
+    if get_skip(op) != 0:
+      text.insert(n + get_skip(op) + 1, "%l:")
+      break
+
+  return text
+
+def write_table(name, found, max_len):
+  print("superopt_t %s[] =" % name)
+  print("{")
+
+  for idiom in idioms + idioms_branch + idioms_branch2:
+    key = (idiom[0], idiom[1])
+    if not key in found: continue
+    seq = found[key]
+    text = ", ".join([ "\"%s\"" % s for s in get_text(seq) ] + [ "NULL" ])
+    print("  { \"%s\", %d, %d, { %s } }," % (key[0], key[1], len(seq), text))
+
+  print("  { NULL, 0, 0, { NULL } }")
+  print("};")
+  print("")
+
+  missing = [ "%s %d" % (i[0], i[1]) for i in idioms if not (i[0], i[1]) in found ]
+  sys.stderr.write("%s: %d found, %d not found in %d instructions\n" %
+    (name, len(found), len(missing), max_len))
+
+print("""/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+// Generated by scripts/superopt.py.  Don't edit.
+
+#include <stdlib.h>
+
+#include "table_superopt.h"
+""")
+
+found = search_unary(msp430_ops(), msp430_step, msp430_start, MSP430_MAX_LEN, idioms)
+search_chain(found)
+search_bits(found)
+found.update(search_unary(msp430_branch_ops(), msp430_branch_step, msp430_branch_start, MSP430_BRANCH_LEN, idioms_branch))
+found.update(search_binary(msp430_branch_ops(), msp430_branch_step, msp430_branch_start, MSP430_BRANCH_LEN, idioms_branch2))
+write_table("table_superopt_msp430", found, MSP430_MAX_LEN)
+
+found = search_unary(dspic_ops(), dspic_step, dspic_start, DSPIC_MAX_LEN, idioms)
+found.update(search_unary(dspic_branch_ops(), dspic_branch_step, dspic_branch_start, DSPIC_BRANCH_LEN, idioms_branch))
+found.update(search_binary(dspic_branch_ops(), dspic_branch_step, dspic_branch_start, DSPIC_BRANCH_LEN, idioms_branch2))
+write_table("table_superopt_dspic", found, DSPIC_MAX_LEN)
@@ -0,0 +1,199 @@
+#!/usr/bin/env python
+
+# Writes synthetic class files for measuring how fast java_grinder
+# compiles and how that scales:
+#
+#   python scripts/synthclass.py [ -methods <n> ] [ -depth <n> ]
+#       [ -constants <n> ] [ -intrinsics <percent> ] [ -seed <n> ]
+#       <class name>
+#
+# The class file is <class name>.class in the current directory and has
+# main() plus <methods> methods of the form static int m<n>(int a, int b).
+# Each body is a chain of if / else <depth> deep with arithmetic at every
+# level.  <constants> integers are added to the constant pool and loaded
+# with ldc.  <intrinsics> is the chance each level calls IOPort0 or
+# Memory instead of doing plain arithmetic.  Every bytecode used here is
+# one java_grinder can compile so the class can be fed to compile_bench:
+#
+#   make cbench
+#   python scripts/synthclass.py -methods 2000 -depth 8 Synth
+#   ./compile_bench Synth.class /tmp/synth.asm msp430g2553
+
+import random
+import struct
+import sys
+
+class ConstantPool:
+  def __init__(self):
+    self.entries = []
+    self.index = {}
+
+  def add(self, key, data):
+    if key in self.index: return self.index[key]
+    self.entries.append(data)
+    self.index[key] = len(self.entries)
+    return self.index[key]
+
+  def utf8(self, text):
+    data = text.encode("latin-1")
+    return self.add(("utf8", text), struct.pack(">BH", 1, len(data)) + data)
+
+  def integer(self, value):
+    return self.add(("int", value), struct.pack(">Bi", 3, value))
+
+  def class_ref(self, name):
+    return self.add(("class", name), struct.pack(">BH", 7, self.utf8(name)))
+
+  def method_ref(self, class_name, name, descriptor):
+    c = self.class_ref(class_name)
+    n = self.add(("nat", name, descriptor),
+      struct.pack(">BHH", 12, self.utf8(name), self.utf8(descriptor)))
+    return self.add(("method", class_name, name, descriptor),
+      struct.pack(">BHH", 10, c, n))
+
+  def data(self):
+    return struct.pack(">H", len(self.entries) + 1) + b"".join(self.entries)
+
+class Code:
+  def __init__(self):
+    self.code = bytearray()
+
+  def op(self, *values):
+    self.code += bytearray(values)
+
+  def u16(self, value):
+    self.code += struct.pack(">H", value & 0xffff)
+
+  def branch(self, opcode):
+    # Returns where the offset goes so it can be filled in later
+    self.op(opcode)
+    self.u16(0)
+    return len(self.code) - 3
+
+  def patch(self, address):
+    offset = len(self.code) - address
+    self.code[address + 1:address + 3] = struct.pack(">h", offset)
+
+  def push(self, value):
+    if value >= -1 and value <= 5: self.op(0x03 + value)
+    elif value >= -128 and value <= 127: self.op(0x10, value & 0xff)
+    else:
+      self.op(0x11)
+      self.u16(value)
+
+# Locals are a, b and n
+ILOAD = [ 0x1a, 0x1b, 0x1c ]
+ISTORE = [ 0x3b, 0x3c, 0x3d ]
+ALU = [ 0x60, 0x64, 0x7e, 0x80, 0x82 ]  # iadd isub iand ior ixor
+
+def level(code, cp, depth, options, constants, methods):
+  # n = a <op> b or a <op> constant
+  code.op(ILOAD[0])
+
+  if len(constants) != 0 and random.randint(0, 3) == 0:
+    code.op(0x12, random.choice(constants))
+  else:
+    code.op(ILOAD[1])
+
+  code.op(random.choice(ALU))
+  code.op(ISTORE[2])
+
+  if random.randint(0, 99) < options["intrinsics"]:
+    if random.randint(0, 1) == 0:
+      code.op(ILOAD[2])
+      code.op(0xb8)
+      code.u16(cp.method_ref("net/mikekohn/java_grinder/IOPort0", "setPinsValue", "(I)V"))
+    else:
+      code.push(0x200 + random.randint(0, 127))
+      code.op(ILOAD[2])
+      code.op(0x91)   # i2b
+      code.op(0xb8)
+      code.u16(cp.method_ref("net/mikekohn/java_grinder/Memory", "write8", "(IB)V"))
+  elif len(methods) != 0 and random.randint(0, 7) == 0:
+    code.op(ILOAD[2])
+    code.op(ILOAD[1])
+    code.op(0xb8)
+    code.u16(cp.method_ref(options["name"], random.choice(methods), "(II)I"))
+    code.op(ISTORE[0])
+
+  if depth == 0: return
+
+  # if (n < k) { deeper } else { a = a + 1 }
+  code.op(ILOAD[2])
+  code.push(random.randint(-100, 100))
+  else_branch = code.branch(0xa2)   # if_icmpge
+  level(code, cp, depth - 1, options, constants, methods)
+  end_branch = code.branch(0xa7)    # goto
+  code.patch(else_branch)
+  code.op(0x84, 0, 1)               # iinc a, 1
+  code.patch(end_branch)
+
+def method(cp, name, descriptor, max_stack, max_locals, code):
+  attribute = struct.pack(">HHI", max_stack, max_locals, len(code.code))
+  attribute += bytes(code.code) + struct.pack(">HH", 0, 0)
+
+  data = struct.pack(">HHHH", 0x0009, cp.utf8(name), cp.utf8(descriptor), 1)
+  data += struct.pack(">HI", cp.utf8("Code"), len(attribute)) + attribute
+  return data
+
+def synthesize(options):
+  cp = ConstantPool()
+  this_class = cp.class_ref(options["name"])
+  super_class = cp.class_ref("java/lang/Object")
+
+  # Integers go first so ldc can reach them with an 8 bit index
+  constants = [ cp.integer(0x1000 + n) for n in range(options["constants"]) ]
+  constants = [ c for c in constants if c < 256 ]
+
+  methods = []
+  data = b""
+
+  for n in range(options["methods"]):
+    code = Code()
+    level(code, cp, options["depth"], options, constants, methods)
+    code.op(ILOAD[0])
+    code.op(0xac)   # ireturn
+    data += method(cp, "m%d" % n, "(II)I", 4, 3, code)
+    methods.append("m%d" % n)
+
+  # main() calls the last method and loops
+  code = Code()
+  code.op(0x04, 0x05)
+  code.op(0xb8)
+  code.u16(cp.method_ref(options["name"], methods[-1], "(II)I"))
+  code.op(0x57)   # pop
+  code.op(0xa7)
+  code.u16(0)
+  data = method(cp, "main", "([Ljava/lang/String;)V", 2, 1, code) + data
+
+  out = struct.pack(">IHH", 0xcafebabe, 0, 50) + cp.data()
+  out += struct.pack(">HHHH", 0x0021, this_class, super_class, 0)
+  out += struct.pack(">H", 0)
+  out += struct.pack(">H", len(methods) + 1) + data
+  out += struct.pack(">H", 0)
+
+  return out
+
+# ------------------------------------------------------------------ main
+options = { "methods": 1000, "depth": 4, "constants": 200, "intrinsics": 20,
+            "seed": 1, "name": None }
+
+n = 1
+while n < len(sys.argv):
+  if sys.argv[n].startswith("-") and sys.argv[n][1:] in options and n + 1 < len(sys.argv):
+    options[sys.argv[n][1:]] = int(sys.argv[n + 1])
+    n += 2
+  elif options["name"] == None and not sys.argv[n].startswith("-"):
+    options["name"] = sys.argv[n]
+    n += 1
+  else:
+    options["name"] = None
+    break
+
+if options["name"] == None or options["methods"] < 1:
+  print("Usage: python %s [ -methods <n> ] [ -depth <n> ] [ -constants <n> ] [ -intrinsics <percent> ] [ -seed <n> ] <class name>" % sys.argv[0])
+  sys.exit(1)
+
+random.seed(options["seed"])
+
+open(options["name"] + ".class", "wb").write(synthesize(options))
@@ -0,0 +1,383 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "Simulate.h"
+
+Simulate::Simulate() :
+  assembler(NULL),
+  cycles(0),
+  state(SIMULATE_RUNNING),
+  trace(false),
+  error_message(NULL),
+  stack_base(0),
+  stack_min(0),
+  stack_max(0),
+  stack_grows_up(false),
+  in_main(false),
+  result_address(0),
+  has_result_address(false),
+  has_result(false),
+  result(0),
+  functions(NULL),
+  function_count(0),
+  function_max(0),
+  depth(0),
+  counts(NULL),
+  count_count(0)
+{
+}
+
+Simulate::~Simulate()
+{
+  free(functions);
+  free(counts);
+}
+
+int Simulate::run(uint64_t max_cycles)
+{
+uint64_t start;
+int function;
+
+  state = SIMULATE_RUNNING;
+
+  while (state == SIMULATE_RUNNING)
+  {
+    if (cycles >= max_cycles)
+    {
+      state = SIMULATE_TIMEOUT;
+      break;
+    }
+
+    start = cycles;
+    function = depth == 0 ? -1 : frames[depth - 1].function;
+
+    if (counts != NULL) { count_address(get_pc()); }
+
+    if (step() != 0 && state == SIMULATE_RUNNING)
+    {
+      state = SIMULATE_ERROR;
+    }
+
+    if (function != -1) { functions[function].cycles += cycles - start; }
+  }
+
+  // Anything still running gets the cycles up to now
+  while (depth > 0)
+  {
+    depth--;
+    functions[frames[depth].function].inclusive += cycles - frames[depth].start;
+  }
+
+  return state == SIMULATE_ERROR ? -1 : 0;
+}
+
+static int compare_functions(const void *a, const void *b)
+{
+const simulate_function_t *fa = (const simulate_function_t *)a;
+const simulate_function_t *fb = (const simulate_function_t *)b;
+
+  if (fa->inclusive != fb->inclusive) { return fa->inclusive < fb->inclusive ? 1 : -1; }
+
+  return strcmp(fa->name, fb->name);
+}
+
+void Simulate::report(FILE *out)
+{
+uint32_t peak = 0;
+uint32_t address;
+int n;
+
+  switch(state)
+  {
+    case SIMULATE_HALTED: fprintf(out, "Stopped: halted\n"); break;
+    case SIMULATE_RETURNED: fprintf(out, "Stopped: main() returned\n"); break;
+    case SIMULATE_TIMEOUT: fprintf(out, "Stopped: cycle limit reached\n"); break;
+    case SIMULATE_ERROR:
+      fprintf(out, "Stopped: %s\n", error_message == NULL ? "error" : error_message);
+      break;
+    default: break;
+  }
+
+  // dsPIC stacks grow up, MSP430 stacks grow down
+  if (in_main)
+  {
+    peak = stack_grows_up ? stack_max - stack_base : stack_base - stack_min;
+  }
+
+  fprintf(out, "Total cycles: %" PRIu64 "\n", cycles);
+  fprintf(out, "Peak stack: %u bytes\n", peak);
+
+  if (state == SIMULATE_RETURNED)
+  {
+    fprintf(out, "Return value: %d\n", get_return_value());
+  }
+
+  if (has_result)
+  {
+    fprintf(out, "Result: %d\n", result);
+  }
+
+  qsort(functions, function_count, sizeof(simulate_function_t), compare_functions);
+
+  fprintf(out, "\n%-32s %8s %12s %12s %6s\n", "Method", "Calls", "Cycles", "Inclusive", "Size");
+
+  for (n = 0; n < function_count; n++)
+  {
+    address = functions[n].address;
+
+    fprintf(out, "%-32s %8u %12" PRIu64 " %12" PRIu64 " %6u\n",
+      functions[n].name,
+      functions[n].calls,
+      functions[n].cycles,
+      functions[n].inclusive,
+      code_size(address, assembler->get_code_end(address)));
+  }
+}
+
+void Simulate::dump_memory(FILE *out, uint32_t address, int length)
+{
+int n;
+
+  for (n = 0; n < length; n++)
+  {
+    fprintf(out, "Memory 0x%04x = 0x%02x\n", address + n, read_memory(address + n));
+  }
+}
+
+// The return value of the function at address is kept each time it
+// returns so a test can be run from main() and still be checked.
+void Simulate::set_result(uint32_t address)
+{
+  result_address = address;
+  has_result_address = true;
+}
+
+void Simulate::call_function(uint32_t address)
+{
+  if (depth == SIMULATE_MAX_DEPTH)
+  {
+    error_message = "call stack too deep";
+    state = SIMULATE_ERROR;
+    return;
+  }
+
+  frames[depth].function = find_function(address);
+  frames[depth].start = cycles;
+  functions[frames[depth].function].calls++;
+  depth++;
+}
+
+// Returns -1 when the outermost function returns
+int Simulate::return_function()
+{
+  if (has_result_address && depth > 0 &&
+      functions[frames[depth - 1].function].address == result_address)
+  {
+    result = get_return_value();
+    has_result = true;
+  }
+
+  if (depth <= 1) { return -1; }
+
+  depth--;
+  functions[frames[depth].function].inclusive += cycles - frames[depth].start;
+
+  return 0;
+}
+
+// The reset code jumps to main() instead of calling it so main() takes
+// over the outermost frame when it's reached.  name is for when more
+// than one label is at the address.
+void Simulate::set_entry(uint32_t address, const char *name)
+{
+  if (depth == 0)
+  {
+    frames[0].function = find_function(address, name);
+    frames[0].start = cycles;
+    functions[frames[0].function].calls++;
+    depth++;
+  }
+    else
+  {
+    functions[frames[0].function].inclusive += cycles - frames[0].start;
+    frames[0].function = find_function(address, name);
+    frames[0].start = cycles;
+    functions[frames[0].function].calls++;
+  }
+}
+
+void Simulate::check_stack(uint32_t sp)
+{
+  if (!in_main) { return; }
+
+  if (sp < stack_min) { stack_min = sp; }
+  if (sp > stack_max) { stack_max = sp; }
+}
+
+int Simulate::find_function(uint32_t address, const char *name)
+{
+int n;
+
+  for (n = 0; n < function_count; n++)
+  {
+    if (functions[n].address == address) { return n; }
+  }
+
+  if (function_count == function_max)
+  {
+    function_max += 64;
+    functions = (simulate_function_t *)realloc(functions, function_max * sizeof(simulate_function_t));
+  }
+
+  memset(&functions[function_count], 0, sizeof(simulate_function_t));
+  functions[function_count].address = address;
+
+  if (name == NULL && assembler != NULL) { name = assembler->find_label(address); }
+
+  if (name != NULL)
+  {
+    strncpy(functions[function_count].name, name, sizeof(functions[0].name) - 1);
+  }
+    else
+  {
+    sprintf(functions[function_count].name, "0x%04x", address);
+  }
+
+  return function_count++;
+}
+
+
+static int compare_counts(const void *a, const void *b)
+{
+const simulate_count_t *ca = (const simulate_count_t *)a;
+const simulate_count_t *cb = (const simulate_count_t *)b;
+
+  if (ca->address == cb->address) { return 0; }
+
+  return ca->address < cb->address ? -1 : 1;
+}
+
+// Every label gets a counter for the instruction at its address.  Run
+// on code from java_grinder --instrument there's a label at the start of
+// each basic block.
+void Simulate::start_profile()
+{
+assembler_symbol_t *symbols;
+int symbol_count;
+int n;
+
+  symbols = assembler->get_symbols(&symbol_count);
+  counts = (simulate_count_t *)malloc((symbol_count + 1) * sizeof(simulate_count_t));
+  count_count = 0;
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label || symbols[n].is_extern) { continue; }
+
+    counts[count_count].address = symbols[n].value;
+    counts[count_count].count = 0;
+    count_count++;
+  }
+
+  qsort(counts, count_count, sizeof(simulate_count_t), compare_counts);
+}
+
+void Simulate::count_address(uint32_t address)
+{
+simulate_count_t key;
+simulate_count_t *entry;
+
+  key.address = address;
+  entry = (simulate_count_t *)bsearch(&key, counts, count_count, sizeof(simulate_count_t), compare_counts);
+
+  if (entry != NULL) { entry->count++; }
+}
+
+uint32_t Simulate::get_count(uint32_t address)
+{
+simulate_count_t key;
+simulate_count_t *entry;
+
+  key.address = address;
+  entry = (simulate_count_t *)bsearch(&key, counts, count_count, sizeof(simulate_count_t), compare_counts);
+
+  return entry == NULL ? 0 : entry->count;
+}
+
+// Writes the counts in the format java_grinder --profile reads.  Block
+// labels are <method>_<bytecode address> and the method's own label is
+// the block at address 0 unless something jumps back to it.
+int Simulate::write_profile(const char *filename)
+{
+FILE *out;
+assembler_symbol_t *symbols;
+char method[64];
+char last[64];
+uint32_t address;
+const char *s;
+int symbol_count;
+int n, len;
+
+  out = fopen(filename, "wb");
+
+  if (out == NULL)
+  {
+    printf("Couldn't open profile %s\n", filename);
+    return -1;
+  }
+
+  fprintf(out, "# <method> <bytecode address> <count>\n");
+
+  symbols = assembler->get_symbols(&symbol_count);
+  last[0] = 0;
+
+  for (n = 0; n < symbol_count; n++)
+  {
+    if (!symbols[n].is_label || symbols[n].is_extern) { continue; }
+
+    s = strrchr(symbols[n].name, '_');
+    if (s == NULL || s[1] == 0 || strspn(s + 1, "0123456789") != strlen(s + 1)) { continue; }
+
+    len = s - symbols[n].name;
+    if (len == 0 || len >= (int)sizeof(method)) { continue; }
+
+    memcpy(method, symbols[n].name, len);
+    method[len] = 0;
+
+    if (!assembler->get_symbol(method, &address)) { continue; }
+
+    // A method's block labels come one after the other
+    if (strcmp(method, last) != 0)
+    {
+      strcpy(last, method);
+      snprintf(method + len, sizeof(method) - len, "_0");
+
+      if (!assembler->get_symbol(method, &address))
+      {
+        method[len] = 0;
+        assembler->get_symbol(method, &address);
+        fprintf(out, "%s 0 %u\n", last, get_count(address));
+      }
+    }
+
+    fprintf(out, "%s %s %u\n", last, s + 1, get_count(symbols[n].value));
+  }
+
+  fclose(out);
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _SIMULATE_H
+#define _SIMULATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Assembler.h"
+
+#define SIMULATE_MAX_DEPTH 256
+
+enum
+{
+  SIMULATE_RUNNING,
+  SIMULATE_HALTED,      // jump to itself
+  SIMULATE_RETURNED,    // main() returned
+  SIMULATE_TIMEOUT,     // ran out of cycles
+  SIMULATE_ERROR,
+};
+
+struct simulate_function_t
+{
+  uint32_t address;
+  char name[64];
+  uint32_t calls;
+  uint64_t cycles;      // cycles spent in the function itself
+  uint64_t inclusive;   // cycles including everything it called
+};
+
+// Times the instruction at a label's address ran for -profile
+struct simulate_count_t
+{
+  uint32_t address;
+  uint32_t count;
+};
+
+struct simulate_frame_t
+{
+  int function;
+  uint64_t start;
+};
+
+// Instruction set simulators for checking generated code without the
+// hardware.  Subclasses run one instruction per step() and tell the
+// base class about calls and returns so cycles can be split up per
+// method.
+
+class Simulate
+{
+public:
+  Simulate();
+  virtual ~Simulate();
+
+  virtual int load(Assembler *assembler) = 0;
+  virtual int step() = 0;
+  virtual int get_return_value() = 0;
+  virtual int read_memory(uint32_t address) = 0;
+
+  int run(uint64_t max_cycles);
+  void report(FILE *out);
+  void dump_memory(FILE *out, uint32_t address, int length);
+  void set_trace(bool trace) { this->trace = trace; }
+  void set_result(uint32_t address);
+  uint64_t get_cycles() { return cycles; }
+  void start_profile();
+  int write_profile(const char *filename);
+
+protected:
+  void call_function(uint32_t address);
+  int return_function();
+  void set_entry(uint32_t address, const char *name = NULL);
+  void check_stack(uint32_t sp);
+  int find_function(uint32_t address, const char *name = NULL);
+  virtual uint32_t code_size(uint32_t start, uint32_t end) { return end - start; }
+  virtual uint32_t get_pc() = 0;
+
+  Assembler *assembler;
+  uint64_t cycles;
+  int state;
+  bool trace;
+  const char *error_message;
+  uint32_t stack_base;
+  uint32_t stack_min;
+  uint32_t stack_max;
+  bool stack_grows_up;
+  bool in_main;
+
+private:
+  void count_address(uint32_t address);
+  uint32_t get_count(uint32_t address);
+
+  uint32_t result_address;
+  bool has_result_address;
+  bool has_result;
+  int result;
+  simulate_function_t *functions;
+  int function_count;
+  int function_max;
+  simulate_frame_t frames[SIMULATE_MAX_DEPTH];
+  int depth;
+  simulate_count_t *counts;
+  int count_count;
+};
+
+#endif
+
@@ -0,0 +1,1334 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "DSPIC.h"
+#include "SimulateDSPIC.h"
+
+#define SFR_ACCAL 0x0022
+#define SFR_ACCBL 0x0028
+#define SFR_RCOUNT 0x0036
+#define SFR_DCOUNT 0x0038
+#define SFR_SR 0x0042
+#define SFR_CORCON 0x0044
+#define RAM_START 0x0800
+#define CONFIG_START 0xf80000
+
+#define SPIRBF 0x0001
+
+#define ACC_MAX_1_31 0x7fffffffLL
+#define ACC_MAX_9_31 0x7fffffffffLL
+
+static dspic_periph_t dspic30f3012_ports[] =
+{
+  { 0x02c0, "TRISA" },
+  { 0x02c4, "LATA" },
+  { 0x02c6, "TRISB" },
+  { 0x02ca, "LATB" },
+  { 0x02cc, "TRISC" },
+  { 0x02d0, "LATC" },
+  { 0x02d2, "TRISD" },
+  { 0x02d6, "LATD" },
+  { 0, NULL }
+};
+
+static dspic_periph_t dspic33fj06gs101a_ports[] =
+{
+  { 0x02c0, "TRISA" },
+  { 0x02c4, "LATA" },
+  { 0x02c8, "TRISB" },
+  { 0x02cc, "LATB" },
+  { 0, NULL }
+};
+
+// Register pairs for the mmm field of mac/msc/mpy
+static const uint8_t dsp_pairs[][2] =
+{
+  { 4, 5 }, { 4, 6 }, { 4, 7 }, { 0, 0 }, { 5, 6 }, { 5, 7 }, { 6, 7 }
+};
+
+enum
+{
+  ALU_ADD,
+  ALU_ADDC,
+  ALU_SUB,
+  ALU_SUBB,
+  ALU_AND,
+  ALU_XOR,
+  ALU_IOR,
+};
+
+static int64_t sign40(int64_t value)
+{
+  value &= 0xffffffffffLL;
+  if (value & 0x8000000000LL) { value -= 0x10000000000LL; }
+
+  return value;
+}
+
+SimulateDSPIC::SimulateDSPIC(uint8_t chip_type) :
+  sr(0),
+  corcon(DSPIC_CORCON_SATDW),
+  pc(0),
+  spi_rx(0),
+  repeat_count(0),
+  repeat_total(0),
+  do_count(0),
+  do_start(0),
+  do_end(0),
+  do_active(false),
+  main_address(0),
+  has_main(false)
+{
+uint32_t n;
+
+  switch(chip_type)
+  {
+    case DSPIC33FJ06GS101A:
+      flash_end = 0x1000;
+      ram_end = 0x0900;
+      spi_stat = 0x0240;
+      spi_buf = 0x0248;
+      ports = dspic33fj06gs101a_ports;
+      break;
+    case DSPIC30F3012:
+    default:
+      flash_end = 0x4000;
+      ram_end = 0x1000;
+      spi_stat = 0x0220;
+      spi_buf = 0x0226;
+      ports = dspic30f3012_ports;
+      break;
+  }
+
+  program = (uint32_t *)malloc((flash_end / 2) * sizeof(uint32_t));
+
+  // Erased flash
+  for (n = 0; n < flash_end / 2; n++) { program[n] = 0xffffff; }
+
+  memset(reg, 0, sizeof(reg));
+  memset(memory, 0, sizeof(memory));
+  acc[0] = 0;
+  acc[1] = 0;
+
+  // Every pin starts out as an input
+  for (n = 0; ports[n].name != NULL; n++)
+  {
+    if (strncmp(ports[n].name, "TRIS", 4) == 0)
+    {
+      memory[ports[n].address] = 0xff;
+      memory[ports[n].address + 1] = 0xff;
+    }
+  }
+
+  // Reset value of the stack pointer.  The stack grows up.
+  reg[15] = RAM_START;
+  stack_grows_up = true;
+}
+
+SimulateDSPIC::~SimulateDSPIC()
+{
+  free(program);
+}
+
+int SimulateDSPIC::load(Assembler *assembler)
+{
+assembler_page_t *page;
+uint32_t address,word;
+int shift;
+int n;
+
+  this->assembler = assembler;
+
+  for (page = assembler->get_pages(); page != NULL; page = page->next)
+  {
+    for (n = 0; n < ASSEMBLER_PAGE_SIZE; n++)
+    {
+      if ((page->used[n / 8] & (1 << (n % 8))) == 0) { continue; }
+
+      // 4 bytes in the image for each program word
+      address = (page->address + n) / 2;
+      word = address / 2;
+      shift = ((page->address + n) & 3) * 8;
+
+      if (shift == 24) { continue; }
+      if (address >= CONFIG_START) { continue; }
+
+      if (address >= flash_end)
+      {
+        printf("Error: address 0x%06x is outside of flash\n", address & ~1);
+        return -1;
+      }
+
+      program[word] &= ~(0xff << shift);
+      program[word] |= page->data[n] << shift;
+    }
+  }
+
+  has_main = assembler->get_symbol("main", &main_address);
+
+  pc = 0;
+  set_entry(pc, "reset");
+
+  return 0;
+}
+
+int SimulateDSPIC::step()
+{
+uint32_t opcode;
+uint32_t address;
+
+  address = pc;
+  opcode = fetch();
+
+  // repeat runs the next instruction count+1 times, 1 cycle each for
+  // the instructions that can be repeated.
+  if ((opcode & 0xff0000) == 0x090000)
+  {
+    if ((opcode & 0x8000) != 0) { repeat_total = reg[opcode & 0xf] & 0x3fff; }
+    else { repeat_total = opcode & 0x3fff; }
+
+    cycles++;
+
+    address = pc;
+    opcode = fetch();
+
+    for (repeat_count = repeat_total; ; repeat_count--)
+    {
+      pc = address + 2;
+      if (execute(opcode) != 0) { return -1; }
+      if (repeat_count == 0 || state != SIMULATE_RUNNING) { break; }
+    }
+  }
+    else
+  {
+    repeat_total = 0;
+    repeat_count = 0;
+
+    if (execute(opcode) != 0) { return -1; }
+  }
+
+  // Falling off the last instruction of a do loop goes back to the start
+  // until DCOUNT runs out.  It takes no cycles.
+  if (do_active && address == do_end && pc == do_end + 2)
+  {
+    if (do_count == 0) { do_active = false; }
+    else { do_count--; pc = do_start; }
+  }
+
+  check_stack(reg[15]);
+
+  if (has_main && !in_main && pc == main_address)
+  {
+    set_entry(main_address, "main");
+    in_main = true;
+    stack_base = reg[15];
+    stack_min = reg[15];
+    stack_max = reg[15];
+  }
+
+  return 0;
+}
+
+int SimulateDSPIC::execute(uint32_t opcode)
+{
+int op = opcode >> 16;
+int d = (opcode >> 7) & 0xf;
+int s = opcode & 0xf;
+
+  if (state != SIMULATE_RUNNING) { return -1; }
+
+  if (opcode == 0x000000)
+  {
+    cycles++;
+    return 0;
+  }
+
+  // call and goto have the top 7 bits of the address in a second word
+  if (op == 0x02 || op == 0x04)
+  {
+    uint32_t address = pc - 2;
+    uint32_t target = (opcode & 0xfffe) | ((fetch() & 0x7f) << 16);
+
+    cycles += 2;
+
+    if (op == 0x02)
+    {
+      write16(reg[15], pc & 0xffff);
+      write16(reg[15] + 2, pc >> 16);
+      reg[15] += 4;
+      pc = target;
+      call_function(pc);
+    }
+      else
+    {
+      if (target == address) { state = SIMULATE_HALTED; }
+      pc = target;
+    }
+
+    return 0;
+  }
+
+  if (opcode == 0x060000)
+  {
+    cycles += 3;
+
+    if (return_function() != 0)
+    {
+      state = SIMULATE_RETURNED;
+      return 0;
+    }
+
+    reg[15] -= 4;
+    pc = read16(reg[15]) | ((read16(reg[15] + 2) & 0x7f) << 16);
+
+    return 0;
+  }
+
+  // do #lit14, Expr and do Wn, Expr run from the next instruction to
+  // the one at PC + 2 * Slit16 count + 1 times.  The hardware can nest
+  // one more loop but the generator never does.
+  if (op == 0x08)
+  {
+    int offset = (int16_t)(fetch() & 0xffff);
+
+    if (do_active)
+    {
+      fault("Nested do loop", pc - 4);
+      return -1;
+    }
+
+    if ((opcode & 0x8000) != 0) { do_count = reg[s] & 0x3fff; }
+    else { do_count = opcode & 0x3fff; }
+
+    do_start = pc;
+    do_end = pc + offset * 2;
+    do_active = true;
+
+    cycles += 2;
+    return 0;
+  }
+
+  if ((op & 0xf0) == 0x20)
+  {
+    reg[s] = (opcode >> 4) & 0xffff;
+    cycles++;
+    return 0;
+  }
+
+  if ((op & 0xf0) == 0x30 || (op >= 0x0c && op <= 0x0f))
+  {
+    return branch(opcode);
+  }
+
+  if (op >= 0x40 && op <= 0x7f) { return alu(opcode); }
+
+  // mov f, Wnd and mov Wns, f
+  if (op >= 0x80 && op <= 0x8f)
+  {
+    uint16_t f = (opcode >> 3) & 0xfffe;
+
+    if (op < 0x88) { reg[s] = read16(f); }
+    else { write16(f, reg[s]); }
+
+    cycles++;
+    return 0;
+  }
+
+  // mov [Ws+Slit10], Wnd and mov Wns, [Wd+Slit10]
+  if (op >= 0x90 && op <= 0x9f)
+  {
+    int bw = (opcode >> 14) & 1;
+    int k = (((opcode >> 15) & 0xf) << 6) | (((opcode >> 11) & 7) << 3) |
+            ((opcode >> 4) & 7);
+    uint16_t address;
+
+    if (k & 0x200) { k -= 0x400; }
+    if (bw == 0) { k *= 2; }
+
+    if (op < 0x98)
+    {
+      address = reg[s] + k;
+      write_dest(0, d, 0, bw, bw ? read8(address) : read16(address));
+    }
+      else
+    {
+      address = reg[d] + k;
+      if (bw) { write8(address, reg[s]); }
+      else { write16(address, reg[s]); }
+    }
+
+    cycles++;
+    return 0;
+  }
+
+  // bset/bclr/btg on Ws or on a byte in f
+  if (op == 0xa0 || op == 0xa1 || op == 0xa2 ||
+      op == 0xa8 || op == 0xa9 || op == 0xaa)
+  {
+    int kind = op & 3;
+    uint16_t address,value,mask;
+    int bw;
+
+    if (op >= 0xa8)
+    {
+      address = opcode & 0x1fff;
+      mask = 1 << ((opcode >> 13) & 7);
+      bw = 1;
+    }
+      else
+    {
+      int mode = (opcode >> 4) & 7;
+
+      bw = (opcode >> 10) & 1;
+      mask = 1 << ((opcode >> 12) & 0xf);
+
+      if (mode == 0)
+      {
+        if (kind == 0) { reg[s] |= mask; }
+        else if (kind == 1) { reg[s] &= ~mask; }
+        else { reg[s] ^= mask; }
+
+        cycles++;
+        return 0;
+      }
+
+      address = operand_address(mode, s, 0, bw, false);
+    }
+
+    value = bw ? read8(address) : read16(address);
+
+    if (kind == 0) { value |= mask; }
+    else if (kind == 1) { value &= ~mask; }
+    else { value ^= mask; }
+
+    if (bw) { write8(address, value); }
+    else { write16(address, value); }
+
+    cycles++;
+    return 0;
+  }
+
+  if (op >= 0xb0 && op <= 0xb3) { return alu_literal(opcode); }
+  if ((op >= 0xb4 && op <= 0xb7) || op == 0xbf) { return alu_file(opcode); }
+
+  // mul.uu/us/su/ss Wb, Ws, Wnd
+  if (op == 0xb8 || op == 0xb9)
+  {
+    int sign = ((op & 1) << 1) | ((opcode >> 15) & 1);
+    uint16_t wb = reg[(opcode >> 11) & 0xf];
+    uint16_t ws = read_source((opcode >> 4) & 7, s, 0, 0);
+    int64_t a = (sign & 2) ? (int16_t)wb : wb;
+    int64_t b = (sign & 1) ? (int16_t)ws : ws;
+    uint32_t result = (uint32_t)(a * b);
+
+    reg[d & 0xe] = result & 0xffff;
+    reg[(d & 0xe) + 1] = result >> 16;
+
+    cycles++;
+    return 0;
+  }
+
+  if ((op >= 0xc0 && op <= 0xcd) || (op >= 0xf0 && op <= 0xf3))
+  {
+    return dsp(opcode);
+  }
+
+  if (op == 0xd0 || op == 0xd1 || op == 0xdd || op == 0xde)
+  {
+    return shift(opcode);
+  }
+
+  if (op == 0xd8) { return divide(opcode); }
+
+  // cp0 Ws and cp Wb, Ws or #lit5
+  if (op == 0xe0 || op == 0xe1)
+  {
+    int bw = (opcode >> 10) & 1;
+    int mode = (opcode >> 4) & 7;
+    uint16_t a,b;
+
+    if (op == 0xe0)
+    {
+      a = read_source(mode, s, 0, bw);
+      b = 0;
+    }
+      else
+    {
+      a = reg[(opcode >> 11) & 0xf];
+      if (bw) { a &= 0xff; }
+
+      if ((mode & 6) == 6) { b = opcode & 0x1f; }
+      else { b = read_source(mode, s, 0, bw); }
+    }
+
+    alu_op(ALU_SUB, a, b, bw);
+
+    cycles++;
+    return 0;
+  }
+
+  // inc/inc2/dec/dec2/neg/com Ws, Wd
+  if (op == 0xe8 || op == 0xe9 || op == 0xea)
+  {
+    int bw = (opcode >> 14) & 1;
+    int kind = ((op & 3) << 1) | ((opcode >> 15) & 1);
+    uint16_t value = read_source((opcode >> 4) & 7, s, 0, bw);
+
+    switch(kind)
+    {
+      case 0: value = alu_op(ALU_ADD, value, 1, bw); break;
+      case 1: value = alu_op(ALU_ADD, value, 2, bw); break;
+      case 2: value = alu_op(ALU_SUB, value, 1, bw); break;
+      case 3: value = alu_op(ALU_SUB, value, 2, bw); break;
+      case 4: value = alu_op(ALU_SUB, 0, value, bw); break;
+      case 5: value = ~value; set_nz(value, bw); break;
+    }
+
+    write_dest((opcode >> 11) & 7, d, 0, bw, value);
+
+    cycles++;
+    return 0;
+  }
+
+  // clr Wd
+  if (op == 0xeb && (opcode & 0x8000) == 0)
+  {
+    write_dest((opcode >> 11) & 7, d, 0, (opcode >> 14) & 1, 0);
+    cycles++;
+    return 0;
+  }
+
+  // push f and pop f
+  if (op == 0xf8 || op == 0xf9)
+  {
+    uint16_t f = opcode & 0xfffe;
+
+    if (op == 0xf8)
+    {
+      write16(reg[15], read16(f));
+      reg[15] += 2;
+    }
+      else
+    {
+      reg[15] -= 2;
+      write16(f, read16(reg[15]));
+    }
+
+    cycles++;
+    return 0;
+  }
+
+  if (op == 0xfa)
+  {
+    if ((opcode & 0x8000) == 0)
+    {
+      write16(reg[15], reg[14]);
+      reg[14] = reg[15] + 2;
+      reg[15] = reg[14] + (opcode & 0x3ffe);
+    }
+      else
+    {
+      reg[15] = reg[14] - 2;
+      reg[14] = read16(reg[15]);
+    }
+
+    cycles++;
+    return 0;
+  }
+
+  // se and ze Ws, Wnd
+  if (op == 0xfb)
+  {
+    uint16_t value = read_source((opcode >> 4) & 7, s, 0, 1);
+
+    sr &= ~(DSPIC_SR_N | DSPIC_SR_Z | DSPIC_SR_C);
+
+    if ((opcode & 0x8000) == 0)
+    {
+      value = (int8_t)value;
+      if ((value & 0x8000) == 0) { sr |= DSPIC_SR_C; }
+    }
+      else
+    {
+      sr |= DSPIC_SR_C;
+    }
+
+    set_nz(value, 0);
+    reg[d] = value;
+
+    cycles++;
+    return 0;
+  }
+
+  fault("Unknown opcode", pc - 2);
+
+  return -1;
+}
+
+// Wb, Ws, Wd instructions (and Wb, #lit5, Wd).  mov Ws, Wd is here too.
+int SimulateDSPIC::alu(uint32_t opcode)
+{
+int op = (opcode >> 19) & 7;
+int wb = (opcode >> 15) & 0xf;
+int bw = (opcode >> 14) & 1;
+int dst_mode = (opcode >> 11) & 7;
+int d = (opcode >> 7) & 0xf;
+int src_mode = (opcode >> 4) & 7;
+int s = opcode & 0xf;
+uint16_t a,b;
+
+  cycles++;
+
+  if (op == 7)
+  {
+    b = read_source(src_mode, s, wb, bw);
+    write_dest(dst_mode, d, wb, bw, b);
+    return 0;
+  }
+
+  a = bw ? reg[wb] & 0xff : reg[wb];
+
+  if ((src_mode & 6) == 6) { b = opcode & 0x1f; }
+  else { b = read_source(src_mode, s, 0, bw); }
+
+  write_dest(dst_mode, d, 0, bw, alu_op(op, a, b, bw));
+
+  return 0;
+}
+
+// op #lit10, Wn and mov.b #lit8, Wn
+int SimulateDSPIC::alu_literal(uint32_t opcode)
+{
+int op = (((opcode >> 16) - 0xb0) << 1) | ((opcode >> 15) & 1);
+int bw = (opcode >> 14) & 1;
+int n = opcode & 0xf;
+uint16_t a;
+
+  cycles++;
+
+  if (op == 7)
+  {
+    reg[n] = (reg[n] & 0xff00) | ((opcode >> 4) & 0xff);
+    return 0;
+  }
+
+  a = bw ? reg[n] & 0xff : reg[n];
+
+  write_dest(0, n, 0, bw, alu_op(op, a, (opcode >> 4) & 0x3ff, bw));
+
+  return 0;
+}
+
+// op f {,WREG}, mov WREG, f and mov f {,WREG}
+int SimulateDSPIC::alu_file(uint32_t opcode)
+{
+int op = (((opcode >> 16) - 0xb4) << 1) | ((opcode >> 15) & 1);
+int bw = (opcode >> 14) & 1;
+int to_file = (opcode >> 13) & 1;
+uint16_t f = opcode & 0x1fff;
+uint16_t value;
+
+  cycles++;
+
+  if (op == 7)
+  {
+    if (bw) { write8(f, reg[0]); }
+    else { write16(f, reg[0]); }
+    return 0;
+  }
+
+  value = bw ? read8(f) : read16(f);
+
+  if ((opcode >> 16) == 0xbf)
+  {
+    set_nz(value, bw);
+  }
+    else
+  {
+    value = alu_op(op, value, bw ? reg[0] & 0xff : reg[0], bw);
+  }
+
+  if (to_file)
+  {
+    if (bw) { write8(f, value); }
+    else { write16(f, value); }
+  }
+    else
+  {
+    write_dest(0, 0, 0, bw, value);
+  }
+
+  return 0;
+}
+
+int SimulateDSPIC::shift(uint32_t opcode)
+{
+int op = opcode >> 16;
+int d = (opcode >> 7) & 0xf;
+uint16_t value,result = 0;
+int count;
+
+  cycles++;
+
+  // sl/lsr/asr Wb, #lit4 or Wns, Wnd only change N and Z
+  if (op == 0xdd || op == 0xde)
+  {
+    value = reg[(opcode >> 11) & 0xf];
+
+    if ((opcode & 0x40) != 0) { count = opcode & 0xf; }
+    else { count = reg[opcode & 0xf] & 0xf; }
+
+    if (op == 0xdd) { result = value << count; }
+    else if ((opcode & 0x8000) == 0) { result = value >> count; }
+    else { result = (int16_t)value >> count; }
+
+    reg[d] = result;
+    set_nz(result, 0);
+
+    return 0;
+  }
+
+  // Shift Ws by one into Wd
+  int bw = (opcode >> 14) & 1;
+  uint16_t msb = bw ? 0x80 : 0x8000;
+
+  if (op == 0xd0 && (opcode & 0x8000) != 0)
+  {
+    fault("Unknown opcode", pc - 2);
+    return -1;
+  }
+
+  value = read_source((opcode >> 4) & 7, opcode & 0xf, 0, bw);
+
+  sr &= ~DSPIC_SR_C;
+
+  if (op == 0xd0)
+  {
+    if (value & msb) { sr |= DSPIC_SR_C; }
+    result = value << 1;
+  }
+    else
+  {
+    if (value & 1) { sr |= DSPIC_SR_C; }
+    result = value >> 1;
+    if ((opcode & 0x8000) != 0) { result |= value & msb; }
+  }
+
+  set_nz(result, bw);
+  write_dest((opcode >> 11) & 7, d, 0, bw, result);
+
+  return 0;
+}
+
+int SimulateDSPIC::branch(uint32_t opcode)
+{
+int16_t offset = opcode & 0xffff;
+bool n = (sr & DSPIC_SR_N) != 0;
+bool ov = (sr & DSPIC_SR_OV) != 0;
+bool z = (sr & DSPIC_SR_Z) != 0;
+bool c = (sr & DSPIC_SR_C) != 0;
+bool take = false;
+
+  switch(opcode >> 16)
+  {
+    case 0x0c: take = (sr & DSPIC_SR_OA) != 0; break;
+    case 0x0d: take = (sr & DSPIC_SR_OB) != 0; break;
+    case 0x0e: take = (sr & DSPIC_SR_SA) != 0; break;
+    case 0x0f: take = (sr & DSPIC_SR_SB) != 0; break;
+    case 0x30: take = ov; break;
+    case 0x31: take = c; break;
+    case 0x32: take = z; break;
+    case 0x33: take = n; break;
+    case 0x34: take = z || (n != ov); break;
+    case 0x35: take = n != ov; break;
+    case 0x36: take = !c || z; break;
+    case 0x37: take = true; break;
+    case 0x38: take = !ov; break;
+    case 0x39: take = !c; break;
+    case 0x3a: take = !z; break;
+    case 0x3b: take = !n; break;
+    case 0x3c: take = !z && (n == ov); break;
+    case 0x3d: take = n == ov; break;
+    case 0x3e: take = c && !z; break;
+    default:
+      fault("Unknown opcode", pc - 2);
+      return -1;
+  }
+
+  if (!take)
+  {
+    cycles++;
+    return 0;
+  }
+
+  cycles += 2;
+
+  // bra $ is how programs stop
+  if (offset == -1)
+  {
+    state = SIMULATE_HALTED;
+    pc -= 2;
+    return 0;
+  }
+
+  pc += offset * 2;
+
+  return 0;
+}
+
+// div.s/div.u is 18 iterations under repeat #17 and the quotient and
+// remainder only show up in w0 and w1 at the end.
+int SimulateDSPIC::divide(uint32_t opcode)
+{
+int is_unsigned = (opcode >> 15) & 1;
+int m = (opcode >> 11) & 0xf;
+int is_long = (opcode >> 6) & 1;
+uint16_t divisor = reg[opcode & 0xf];
+int64_t dividend,quotient,remainder;
+
+  cycles++;
+
+  if (repeat_total != 17)
+  {
+    fault("div needs repeat #17", pc - 2);
+    return -1;
+  }
+
+  if (repeat_count != 0) { return 0; }
+
+  if (divisor == 0)
+  {
+    fault("Divide by zero", pc - 2);
+    return -1;
+  }
+
+  if (is_long)
+  {
+    uint32_t value = reg[m] | (reg[m + 1] << 16);
+    dividend = is_unsigned ? (int64_t)value : (int64_t)(int32_t)value;
+  }
+    else
+  {
+    dividend = is_unsigned ? (int64_t)reg[m] : (int64_t)(int16_t)reg[m];
+  }
+
+  if (is_unsigned)
+  {
+    quotient = dividend / divisor;
+    remainder = dividend % divisor;
+  }
+    else
+  {
+    quotient = dividend / (int16_t)divisor;
+    remainder = dividend % (int16_t)divisor;
+  }
+
+  sr &= ~(DSPIC_SR_N | DSPIC_SR_Z | DSPIC_SR_OV | DSPIC_SR_C);
+
+  if (is_unsigned ? quotient > 0xffff : (quotient > 32767 || quotient < -32768))
+  {
+    sr |= DSPIC_SR_OV;
+  }
+
+  reg[0] = quotient & 0xffff;
+  reg[1] = remainder & 0xffff;
+
+  if (reg[1] == 0) { sr |= DSPIC_SR_Z; }
+  if (!is_unsigned && (reg[0] & 0x8000) != 0) { sr |= DSPIC_SR_N; }
+
+  return 0;
+}
+
+int SimulateDSPIC::dsp(uint32_t opcode)
+{
+int op = opcode >> 16;
+int a = (opcode >> 15) & 1;
+int64_t value;
+
+  cycles++;
+
+  // mac/msc/mpy/mpy.n/clr with no prefetches
+  if (op <= 0xc7 || op >= 0xf0)
+  {
+    int aa = opcode & 3;
+
+    if (((opcode >> 6) & 0xf) != 4 || ((opcode >> 2) & 0xf) != 4 ||
+        (op <= 0xc7 && aa < 2))
+    {
+      fault("DSP prefetch and write back aren't supported", pc - 2);
+      return -1;
+    }
+
+    if (op == 0xc3)
+    {
+      accum_store(a, 0);
+      sr &= ~(a ? (DSPIC_SR_OB | DSPIC_SR_SB) : (DSPIC_SR_OA | DSPIC_SR_SA));
+      return 0;
+    }
+
+    if (op >= 0xf0)
+    {
+      int w = 4 + (op & 3);
+
+      value = product(reg[w], reg[w]);
+
+      if ((opcode & 3) == 1) { accum_store(a, value); }
+      else { accum_store(a, accum_value(a) + value); }
+
+      return 0;
+    }
+
+    if (op == 0xc7)
+    {
+      fault("Unknown opcode", pc - 2);
+      return -1;
+    }
+
+    value = product(reg[dsp_pairs[op & 7][0]], reg[dsp_pairs[op & 7][1]]);
+    if ((opcode & 0x4000) != 0) { value = -value; }
+
+    if (aa == 3) { accum_store(a, value); }
+    else { accum_store(a, accum_value(a) + value); }
+
+    return 0;
+  }
+
+  // sftac Acc, Wn or #Slit6 (positive shifts right)
+  if (op == 0xc8)
+  {
+    int count;
+
+    if ((opcode & 0x40) != 0)
+    {
+      count = opcode & 0x3f;
+      if (count & 0x20) { count -= 0x40; }
+    }
+      else
+    {
+      count = (int16_t)reg[opcode & 0xf];
+    }
+
+    if (count < -16 || count > 16)
+    {
+      fault("sftac shift out of range", pc - 2);
+      return -1;
+    }
+
+    accum_store(a, accum_shift(accum_value(a), count));
+
+    return 0;
+  }
+
+  // add Ws, #Slit4, Acc and lac Ws, #Slit4, Acc load Ws into bits 31:16
+  if (op == 0xc9 || op == 0xca)
+  {
+    int count = (opcode >> 7) & 0xf;
+
+    if (count & 8) { count -= 16; }
+
+    value = (int16_t)read_source((opcode >> 4) & 7, opcode & 0xf, (opcode >> 11) & 0xf, 0);
+    value = accum_shift(value * 65536, count);
+
+    if (op == 0xc9) { value += accum_value(a); }
+
+    accum_store(a, value);
+
+    return 0;
+  }
+
+  // add Acc, neg Acc, sub Acc
+  if (op == 0xcb)
+  {
+    switch((opcode >> 12) & 7)
+    {
+      case 0: accum_store(a, accum_value(a) + accum_value(a ^ 1)); return 0;
+      case 1: accum_store(a, -accum_value(a)); return 0;
+      case 3: accum_store(a, accum_value(a) - accum_value(a ^ 1)); return 0;
+    }
+
+    fault("Unknown opcode", pc - 2);
+    return -1;
+  }
+
+  // sac and sac.r store bits 31:16 after the shift
+  if (op == 0xcc || op == 0xcd)
+  {
+    int count = (opcode >> 7) & 0xf;
+    int64_t low;
+
+    if (count & 8) { count -= 16; }
+
+    value = accum_shift(accum_value(a), count);
+
+    if (op == 0xcd)
+    {
+      low = value & 0xffff;
+
+      // Conventional rounds 0x8000 up, convergent rounds it to even
+      if ((corcon & DSPIC_CORCON_RND) != 0 || low > 0x8000 ||
+          (low == 0x8000 && (value & 0x10000) != 0))
+      {
+        value += 0x8000;
+      }
+    }
+
+    value >>= 16;
+
+    if ((corcon & DSPIC_CORCON_SATDW) != 0)
+    {
+      if (value > 0x7fff) { value = 0x7fff; }
+      if (value < -0x8000) { value = -0x8000; }
+    }
+
+    write_dest((opcode >> 4) & 7, opcode & 0xf, (opcode >> 11) & 0xf, 0, value & 0xffff);
+
+    return 0;
+  }
+
+  fault("Unknown opcode", pc - 2);
+
+  return -1;
+}
+
+uint16_t SimulateDSPIC::alu_op(int op, uint16_t a, uint16_t b, int bw)
+{
+uint32_t mask = bw ? 0xff : 0xffff;
+uint32_t msb = bw ? 0x80 : 0x8000;
+uint32_t result;
+uint32_t carry;
+
+  switch(op)
+  {
+    case ALU_ADD:
+    case ALU_ADDC:
+      carry = op == ALU_ADDC ? (sr & DSPIC_SR_C) : 0;
+      result = (a & mask) + (b & mask) + carry;
+
+      sr &= ~(DSPIC_SR_C | DSPIC_SR_OV | DSPIC_SR_N | DSPIC_SR_DC);
+      if (result > mask) { sr |= DSPIC_SR_C; }
+      if (((a ^ result) & (b ^ result) & msb) != 0) { sr |= DSPIC_SR_OV; }
+      if (((a & 0xf) + (b & 0xf) + carry) > 0xf) { sr |= DSPIC_SR_DC; }
+      break;
+    case ALU_SUB:
+    case ALU_SUBB:
+      // C is set when there's no borrow
+      carry = op == ALU_SUBB ? ((sr & DSPIC_SR_C) ^ 1) : 0;
+      result = (a & mask) - (b & mask) - carry;
+
+      sr &= ~(DSPIC_SR_C | DSPIC_SR_OV | DSPIC_SR_N | DSPIC_SR_DC);
+      if ((a & mask) >= (b & mask) + carry) { sr |= DSPIC_SR_C; }
+      if (((a ^ b) & (a ^ result) & msb) != 0) { sr |= DSPIC_SR_OV; }
+      if ((a & 0xf) >= (b & 0xf) + carry) { sr |= DSPIC_SR_DC; }
+      break;
+    case ALU_AND: result = a & b; break;
+    case ALU_XOR: result = a ^ b; break;
+    case ALU_IOR: result = a | b; break;
+    default: result = 0; break;
+  }
+
+  result &= mask;
+
+  // addc and subb can only clear Z so multi-word compares work
+  if (op == ALU_ADDC || op == ALU_SUBB)
+  {
+    if (result != 0) { sr &= ~DSPIC_SR_Z; }
+    if (result & msb) { sr |= DSPIC_SR_N; }
+  }
+    else
+  {
+    set_nz(result, bw);
+  }
+
+  return result;
+}
+
+void SimulateDSPIC::set_nz(uint16_t value, int bw)
+{
+uint16_t mask = bw ? 0xff : 0xffff;
+uint16_t msb = bw ? 0x80 : 0x8000;
+
+  sr &= ~(DSPIC_SR_Z | DSPIC_SR_N);
+  if ((value & mask) == 0) { sr |= DSPIC_SR_Z; }
+  if ((value & msb) != 0) { sr |= DSPIC_SR_N; }
+}
+
+uint16_t SimulateDSPIC::read_source(int mode, int r, int wb, int bw)
+{
+uint16_t address;
+
+  if (mode == 0) { return bw ? reg[r] & 0xff : reg[r]; }
+
+  address = operand_address(mode, r, wb, bw, false);
+
+  return bw ? read8(address) : read16(address);
+}
+
+void SimulateDSPIC::write_dest(int mode, int r, int wb, int bw, uint16_t value)
+{
+uint16_t address;
+
+  if (mode == 0)
+  {
+    if (bw) { reg[r] = (reg[r] & 0xff00) | (value & 0xff); }
+    else { reg[r] = value; }
+    return;
+  }
+
+  address = operand_address(mode, r, wb, bw, true);
+
+  if (bw) { write8(address, value); }
+  else { write16(address, value); }
+}
+
+// [Wn], [Wn--], [Wn++], [--Wn], [++Wn], [Wn+Wb]
+uint16_t SimulateDSPIC::operand_address(int mode, int r, int wb, int bw, bool is_dest)
+{
+uint16_t size = bw ? 1 : 2;
+uint16_t address;
+
+  switch(mode)
+  {
+    case 1: address = reg[r]; break;
+    case 2: address = reg[r]; reg[r] -= size; break;
+    case 3: address = reg[r]; reg[r] += size; break;
+    case 4: reg[r] -= size; address = reg[r]; break;
+    case 5: reg[r] += size; address = reg[r]; break;
+    default: address = reg[r] + reg[wb]; break;
+  }
+
+  if (bw == 0 && (address & 1) != 0)
+  {
+    fault(is_dest ? "Misaligned word write" : "Misaligned word read", address);
+  }
+
+  return address;
+}
+
+int64_t SimulateDSPIC::accum_value(int a)
+{
+  return acc[a];
+}
+
+// Accumulators are 40 bits.  With SATA/SATB set they saturate at 1.31
+// (or 9.31 with ACCSAT) and set SA/SB.  OA/OB show the result went
+// into the guard bits.
+void SimulateDSPIC::accum_store(int a, int64_t value)
+{
+uint16_t overflow = a ? DSPIC_SR_OB : DSPIC_SR_OA;
+uint16_t saturate = a ? DSPIC_SR_SB : DSPIC_SR_SA;
+int64_t max = (corcon & DSPIC_CORCON_ACCSAT) != 0 ? ACC_MAX_9_31 : ACC_MAX_1_31;
+
+  if ((corcon & (a ? DSPIC_CORCON_SATB : DSPIC_CORCON_SATA)) != 0)
+  {
+    if (value > max) { value = max; sr |= saturate; }
+    if (value < -max - 1) { value = -max - 1; sr |= saturate; }
+  }
+    else
+  {
+    if (value > ACC_MAX_9_31 || value < -ACC_MAX_9_31 - 1) { sr |= saturate; }
+    value = sign40(value);
+  }
+
+  sr &= ~overflow;
+  if (value > ACC_MAX_1_31 || value < -ACC_MAX_1_31 - 1) { sr |= overflow; }
+
+  sr &= ~(DSPIC_SR_OAB | DSPIC_SR_SAB);
+  if ((sr & (DSPIC_SR_OA | DSPIC_SR_OB)) != 0) { sr |= DSPIC_SR_OAB; }
+  if ((sr & (DSPIC_SR_SA | DSPIC_SR_SB)) != 0) { sr |= DSPIC_SR_SAB; }
+
+  acc[a] = value;
+}
+
+int64_t SimulateDSPIC::accum_shift(int64_t value, int shift)
+{
+  if (shift > 0) { return value >> shift; }
+  if (shift < 0) { return value * ((int64_t)1 << -shift); }
+
+  return value;
+}
+
+// Fractional mode (CORCON.IF=0) shifts the 1.15 x 1.15 product left
+// one bit so it lines up as 1.31.
+int64_t SimulateDSPIC::product(uint16_t wm, uint16_t wn)
+{
+int64_t value = (int64_t)(int16_t)wm * (int16_t)wn;
+
+  if ((corcon & DSPIC_CORCON_IF) == 0) { value *= 2; }
+
+  return value;
+}
+
+uint32_t SimulateDSPIC::fetch()
+{
+uint32_t data;
+
+  if (pc >= flash_end)
+  {
+    fault("PC outside of flash", pc);
+    return 0xffffff;
+  }
+
+  data = program[pc / 2];
+  pc += 2;
+
+  return data;
+}
+
+uint8_t SimulateDSPIC::read8(uint16_t address)
+{
+  return (read16(address) >> ((address & 1) * 8)) & 0xff;
+}
+
+uint16_t SimulateDSPIC::read16(uint16_t address)
+{
+  address &= 0xfffe;
+
+  if (address < 0x20) { return reg[address >> 1]; }
+
+  if (address >= SFR_ACCAL && address < SFR_ACCBL + 6)
+  {
+    int a = address >= SFR_ACCBL ? 1 : 0;
+    int part = (address - (a ? SFR_ACCBL : SFR_ACCAL)) / 2;
+
+    // ACCxU reads back sign extended
+    if (part == 2) { return (int16_t)(int8_t)(acc[a] >> 32); }
+
+    return (acc[a] >> (part * 16)) & 0xffff;
+  }
+
+  if (address == SFR_RCOUNT) { return repeat_count; }
+  if (address == SFR_DCOUNT) { return do_count; }
+  if (address == SFR_SR) { return sr; }
+  if (address == SFR_CORCON) { return corcon; }
+
+  if (address == spi_buf)
+  {
+    memory[spi_stat] &= ~SPIRBF;
+    return spi_rx;
+  }
+
+  return memory[address] | (memory[address + 1] << 8);
+}
+
+void SimulateDSPIC::write8(uint16_t address, uint8_t data)
+{
+uint16_t word = address & 0xfffe;
+uint16_t value;
+
+  if (address >= RAM_START)
+  {
+    if (address >= ram_end)
+    {
+      fault("Write outside of RAM", address);
+      return;
+    }
+
+    memory[address] = data;
+    return;
+  }
+
+  value = word == spi_buf ? spi_rx : read16(word);
+
+  if (address & 1) { value = (value & 0x00ff) | (data << 8); }
+  else { value = (value & 0xff00) | data; }
+
+  write16(word, value);
+}
+
+void SimulateDSPIC::write16(uint16_t address, uint16_t data)
+{
+  if ((address & 1) != 0)
+  {
+    fault("Misaligned word write", address);
+    return;
+  }
+
+  if (address < 0x20)
+  {
+    reg[address >> 1] = data;
+    return;
+  }
+
+  if (address >= SFR_ACCAL && address < SFR_ACCBL + 6)
+  {
+    int a = address >= SFR_ACCBL ? 1 : 0;
+    int shift = ((address - (a ? SFR_ACCBL : SFR_ACCAL)) / 2) * 16;
+    int64_t value = acc[a] & ~((int64_t)0xffff << shift);
+
+    acc[a] = sign40(value | ((int64_t)data << shift));
+    return;
+  }
+
+  if (address == SFR_SR) { sr = data; return; }
+  if (address == SFR_CORCON) { corcon = data; return; }
+
+  if (address < RAM_START)
+  {
+    memory[address] = data & 0xff;
+    memory[address + 1] = data >> 8;
+    write_periph(address);
+    return;
+  }
+
+  if (address >= ram_end)
+  {
+    fault("Write outside of RAM", address);
+    return;
+  }
+
+  memory[address] = data & 0xff;
+  memory[address + 1] = data >> 8;
+}
+
+void SimulateDSPIC::write_periph(uint16_t address)
+{
+uint16_t data = memory[address] | (memory[address + 1] << 8);
+int n;
+
+  // A transfer finishes right away.  What was sent comes back in the
+  // buffer like MISO was tied to MOSI.
+  if (address == spi_buf)
+  {
+    if (trace) { printf("%" PRIu64 ": SPI1 0x%04x\n", cycles, data); }
+
+    spi_rx = data;
+    memory[spi_stat] |= SPIRBF;
+    return;
+  }
+
+  if (!trace) { return; }
+
+  for (n = 0; ports[n].name != NULL; n++)
+  {
+    if (ports[n].address == address)
+    {
+      printf("%" PRIu64 ": %s=0x%04x\n", cycles, ports[n].name, data);
+      return;
+    }
+  }
+}
+
+void SimulateDSPIC::fault(const char *message, uint32_t address)
+{
+static char text[128];
+
+  if (state == SIMULATE_ERROR) { return; }
+
+  snprintf(text, sizeof(text), "%s at 0x%04x (pc=0x%04x)", message, address, pc);
+  error_message = text;
+  state = SIMULATE_ERROR;
+}
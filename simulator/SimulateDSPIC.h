@@ -0,0 +1,108 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _SIMULATE_DSPIC_H
+#define _SIMULATE_DSPIC_H
+
+#include "Simulate.h"
+
+#define DSPIC_SR_C 0x0001
+#define DSPIC_SR_Z 0x0002
+#define DSPIC_SR_OV 0x0004
+#define DSPIC_SR_N 0x0008
+#define DSPIC_SR_DC 0x0100
+#define DSPIC_SR_SAB 0x0400
+#define DSPIC_SR_OAB 0x0800
+#define DSPIC_SR_SB 0x1000
+#define DSPIC_SR_SA 0x2000
+#define DSPIC_SR_OB 0x4000
+#define DSPIC_SR_OA 0x8000
+
+#define DSPIC_CORCON_IF 0x0001
+#define DSPIC_CORCON_RND 0x0002
+#define DSPIC_CORCON_ACCSAT 0x0010
+#define DSPIC_CORCON_SATDW 0x0020
+#define DSPIC_CORCON_SATB 0x0040
+#define DSPIC_CORCON_SATA 0x0080
+
+struct dspic_periph_t
+{
+  uint16_t address;
+  const char *name;
+};
+
+class SimulateDSPIC : public Simulate
+{
+public:
+  SimulateDSPIC(uint8_t chip_type);
+  virtual ~SimulateDSPIC();
+
+  virtual int load(Assembler *assembler);
+  virtual int step();
+  virtual int get_return_value() { return (int16_t)reg[0]; }
+  virtual int read_memory(uint32_t address) { return memory[address & 0xffff]; }
+
+protected:
+  // Program addresses count 2 per 24 bit instruction word
+  virtual uint32_t code_size(uint32_t start, uint32_t end) { return (end - start) / 2 * 3; }
+  virtual uint32_t get_pc() { return pc; }
+
+private:
+  int execute(uint32_t opcode);
+  int alu(uint32_t opcode);
+  int alu_literal(uint32_t opcode);
+  int alu_file(uint32_t opcode);
+  int shift(uint32_t opcode);
+  int branch(uint32_t opcode);
+  int divide(uint32_t opcode);
+  int dsp(uint32_t opcode);
+  uint16_t alu_op(int op, uint16_t a, uint16_t b, int bw);
+  void set_nz(uint16_t value, int bw);
+  uint16_t read_source(int mode, int r, int wb, int bw);
+  void write_dest(int mode, int r, int wb, int bw, uint16_t value);
+  uint16_t operand_address(int mode, int r, int wb, int bw, bool is_dest);
+  int64_t accum_value(int a);
+  void accum_store(int a, int64_t value);
+  int64_t accum_shift(int64_t value, int shift);
+  int64_t product(uint16_t wm, uint16_t wn);
+  uint32_t fetch();
+  uint8_t read8(uint16_t address);
+  uint16_t read16(uint16_t address);
+  void write8(uint16_t address, uint8_t data);
+  void write16(uint16_t address, uint16_t data);
+  void write_periph(uint16_t address);
+  void fault(const char *message, uint32_t address);
+
+  uint16_t reg[16];
+  uint16_t sr;
+  uint16_t corcon;
+  int64_t acc[2];
+  uint32_t pc;
+  uint32_t *program;
+  uint32_t flash_end;
+  uint8_t memory[65536];
+  uint16_t ram_end;
+  uint16_t spi_stat;
+  uint16_t spi_buf;
+  uint16_t spi_rx;
+  dspic_periph_t *ports;
+  int repeat_count;
+  int repeat_total;
+  int do_count;
+  uint32_t do_start;
+  uint32_t do_end;
+  bool do_active;
+  uint32_t main_address;
+  bool has_main;
+};
+
+#endif
+
@@ -0,0 +1,647 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "MIPS.h"
+#include "SimulateMIPS.h"
+
+#define FLASH_START 0x1d000000
+#define BOOT_START 0x1fc00000
+#define RESET_VECTOR 0xbfc00000
+
+// Each port has TRIS, PORT and LAT 0x10 apart and each of those has
+// CLR, SET and INV registers after it.
+#define PORT_TRIS 0x00
+#define PORT_PORT 0x10
+#define PORT_LAT 0x20
+#define PORT_CLR 0x04
+#define PORT_SET 0x08
+#define PORT_INV 0x0c
+
+// SPI1 has CON, STAT, BUF and BRG 0x10 apart
+#define SPI1_START 0x1f805800
+#define SPI_CON 0x00
+#define SPI_STAT 0x10
+#define SPI_BUF 0x20
+#define SPI_BRG 0x30
+#define SPIRBF 0x0001
+
+#define R(a) ((uint32_t)1 << (a))
+
+enum
+{
+  TRANSFER_JUMP,
+  TRANSFER_CALL,
+  TRANSFER_RETURN,
+};
+
+static uint32_t read32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write32(uint8_t *p, uint32_t data)
+{
+  p[0] = data & 0xff;
+  p[1] = (data >> 8) & 0xff;
+  p[2] = (data >> 16) & 0xff;
+  p[3] = data >> 24;
+}
+
+SimulateMIPS::SimulateMIPS(uint8_t chip_type) :
+  hi(0),
+  lo(0),
+  pc(RESET_VECTOR),
+  next_pc(0),
+  in_delay_slot(false),
+  branch_type(TRANSFER_JUMP),
+  late_reg(0),
+  hilo_ready(0),
+  main_address(0),
+  has_main(false)
+{
+int n;
+
+  switch(chip_type)
+  {
+    case PIC32MX250F128B:
+      ram_size = 0x8000;
+      flash_size = 0x20000;
+      boot_size = 0xc00;
+      port_start = 0x1f886010;
+      port_stride = 0x100;
+      port_count = 3;
+      break;
+    case PIC32MX795F512L:
+    default:
+      ram_size = 0x20000;
+      flash_size = 0x80000;
+      boot_size = 0x3000;
+      port_start = 0x1f886000;
+      port_stride = 0x40;
+      port_count = 7;
+      break;
+  }
+
+  ram = (uint8_t *)malloc(ram_size);
+  flash = (uint8_t *)malloc(flash_size);
+  boot = (uint8_t *)malloc(boot_size);
+
+  memset(reg, 0, sizeof(reg));
+  memset(ram, 0, ram_size);
+  memset(sfr, 0, sizeof(sfr));
+
+  // Erased flash
+  memset(flash, 0xff, flash_size);
+  memset(boot, 0xff, boot_size);
+
+  // Every pin starts out as an input
+  for (n = 0; n < port_count; n++)
+  {
+    write32(sfr + port_start - MIPS_SFR_START + n * port_stride + PORT_TRIS, 0xffff);
+  }
+}
+
+SimulateMIPS::~SimulateMIPS()
+{
+  free(ram);
+  free(flash);
+  free(boot);
+}
+
+int SimulateMIPS::load(Assembler *assembler)
+{
+assembler_page_t *page;
+uint32_t address;
+uint8_t *data;
+int n;
+
+  this->assembler = assembler;
+
+  for (page = assembler->get_pages(); page != NULL; page = page->next)
+  {
+    for (n = 0; n < ASSEMBLER_PAGE_SIZE; n++)
+    {
+      if ((page->used[n / 8] & (1 << (n % 8))) == 0) { continue; }
+
+      address = page->address + n;
+      data = get_memory(address, 1, false);
+
+      // Only flash can be programmed
+      if (data == NULL || ((address & 0x1fffffff) < FLASH_START))
+      {
+        printf("Error: address 0x%08x is outside of flash\n", address);
+        return -1;
+      }
+
+      *data = page->data[n];
+    }
+  }
+
+  has_main = assembler->get_symbol("main", &main_address);
+
+  pc = RESET_VECTOR;
+  set_entry(pc, "reset");
+
+  return 0;
+}
+
+// Roughly the M4K core: 1 cycle per instruction and no cost for a
+// branch since the delay slot does useful work (or is a nop).  Using
+// the result of a load or mul in the next instruction stalls 1 cycle
+// and mfhi / mflo wait for a divide to finish.
+int SimulateMIPS::step()
+{
+uint32_t address = pc;
+uint32_t target = next_pc;
+bool delay_slot = in_delay_slot;
+int type = branch_type;
+uint32_t opcode;
+uint8_t *code;
+
+  code = get_memory(pc, 4, false);
+
+  if (code == NULL)
+  {
+    fault("PC outside of memory", pc);
+    return -1;
+  }
+
+  opcode = read32(code);
+
+  in_delay_slot = false;
+  branch_type = TRANSFER_JUMP;
+  pc += 4;
+  cycles++;
+
+  if (late_reg != 0 && (get_uses(opcode) & R(late_reg)) != 0) { cycles++; }
+  late_reg = 0;
+
+  if (execute(opcode, address) != 0) { return -1; }
+
+  reg[0] = 0;
+
+  if (delay_slot)
+  {
+    if (in_delay_slot)
+    {
+      fault("Branch in a delay slot", address);
+      return -1;
+    }
+
+    pc = target;
+
+    // The reset code calls main() but it's counted as the entry point
+    if (type == TRANSFER_CALL && !(has_main && !in_main && pc == main_address))
+    {
+      call_function(pc);
+    }
+      else
+    if (type == TRANSFER_RETURN)
+    {
+      if (return_function() != 0) { state = SIMULATE_RETURNED; }
+    }
+  }
+
+  check_stack(reg[29]);
+
+  if (has_main && !in_main && pc == main_address)
+  {
+    set_entry(main_address, "main");
+    in_main = true;
+    stack_base = reg[29];
+    stack_min = reg[29];
+    stack_max = reg[29];
+  }
+
+  return 0;
+}
+
+int SimulateMIPS::read_memory(uint32_t address)
+{
+uint8_t *data = get_memory(address, 1, false);
+
+  return data == NULL ? 0 : *data;
+}
+
+int SimulateMIPS::execute(uint32_t opcode, uint32_t address)
+{
+int op = opcode >> 26;
+int rs = (opcode >> 21) & 0x1f;
+int rt = (opcode >> 16) & 0x1f;
+int32_t simm = (int16_t)(opcode & 0xffff);
+uint32_t uimm = opcode & 0xffff;
+uint32_t target = address + 4 + simm * 4;
+uint32_t data;
+
+  switch(op)
+  {
+    case 0x00:
+      return special(opcode, address);
+    case 0x01:
+      if (rt == 0) { if ((int32_t)reg[rs] < 0) { branch(address, target, TRANSFER_JUMP); } }
+      else if (rt == 1) { if ((int32_t)reg[rs] >= 0) { branch(address, target, TRANSFER_JUMP); } }
+      else { break; }
+      return 0;
+    case 0x02:
+    case 0x03:
+      target = ((address + 4) & 0xf0000000) | ((opcode & 0x3ffffff) << 2);
+      if (op == 0x03) { reg[31] = address + 8; }
+      branch(address, target, op == 0x03 ? TRANSFER_CALL : TRANSFER_JUMP);
+      return 0;
+    case 0x04:
+      if (reg[rs] == reg[rt]) { branch(address, target, TRANSFER_JUMP); }
+      return 0;
+    case 0x05:
+      if (reg[rs] != reg[rt]) { branch(address, target, TRANSFER_JUMP); }
+      return 0;
+    case 0x06:
+      if ((int32_t)reg[rs] <= 0) { branch(address, target, TRANSFER_JUMP); }
+      return 0;
+    case 0x07:
+      if ((int32_t)reg[rs] > 0) { branch(address, target, TRANSFER_JUMP); }
+      return 0;
+    case 0x08:
+      data = reg[rs] + simm;
+      if (((reg[rs] ^ data) & (simm ^ data)) & 0x80000000)
+      {
+        fault("Integer overflow", address);
+        return -1;
+      }
+      reg[rt] = data;
+      return 0;
+    case 0x09: reg[rt] = reg[rs] + simm; return 0;
+    case 0x0a: reg[rt] = (int32_t)reg[rs] < simm ? 1 : 0; return 0;
+    case 0x0b: reg[rt] = reg[rs] < (uint32_t)simm ? 1 : 0; return 0;
+    case 0x0c: reg[rt] = reg[rs] & uimm; return 0;
+    case 0x0d: reg[rt] = reg[rs] | uimm; return 0;
+    case 0x0e: reg[rt] = reg[rs] ^ uimm; return 0;
+    case 0x0f: reg[rt] = uimm << 16; return 0;
+    case 0x1f:
+      // seb and seh are the only SPECIAL3 instructions the generator uses
+      if ((opcode & 0x7ff) == 0x420) { reg[(opcode >> 11) & 0x1f] = (int32_t)(int8_t)reg[rt]; return 0; }
+      if ((opcode & 0x7ff) == 0x620) { reg[(opcode >> 11) & 0x1f] = (int32_t)(int16_t)reg[rt]; return 0; }
+      break;
+    case 0x1c:
+      // mul is the only SPECIAL2 instruction the generator uses
+      if ((opcode & 0x7ff) != 0x002) { break; }
+      reg[(opcode >> 11) & 0x1f] = reg[rs] * reg[rt];
+      late_reg = (opcode >> 11) & 0x1f;
+      return 0;
+    case 0x20:
+    case 0x21:
+    case 0x23:
+    case 0x24:
+    case 0x25:
+    {
+      static const int sizes[] = { 1, 2, 0, 4, 1, 2 };
+
+      if (load_data(reg[rs] + simm, sizes[op - 0x20], op < 0x23, &data) != 0) { return -1; }
+      reg[rt] = data;
+      late_reg = rt;
+      return 0;
+    }
+    case 0x28: return store_data(reg[rs] + simm, 1, reg[rt]);
+    case 0x29: return store_data(reg[rs] + simm, 2, reg[rt]);
+    case 0x2b: return store_data(reg[rs] + simm, 4, reg[rt]);
+    default:
+      break;
+  }
+
+  fault("Unknown instruction", address);
+
+  return -1;
+}
+
+int SimulateMIPS::special(uint32_t opcode, uint32_t address)
+{
+int rs = (opcode >> 21) & 0x1f;
+int rt = (opcode >> 16) & 0x1f;
+int rd = (opcode >> 11) & 0x1f;
+int sa = (opcode >> 6) & 0x1f;
+int64_t product;
+uint32_t target;
+
+  switch(opcode & 0x3f)
+  {
+    case 0x00: reg[rd] = reg[rt] << sa; return 0;
+    case 0x02: reg[rd] = reg[rt] >> sa; return 0;
+    case 0x03: reg[rd] = (int32_t)reg[rt] >> sa; return 0;
+    case 0x04: reg[rd] = reg[rt] << (reg[rs] & 0x1f); return 0;
+    case 0x06: reg[rd] = reg[rt] >> (reg[rs] & 0x1f); return 0;
+    case 0x07: reg[rd] = (int32_t)reg[rt] >> (reg[rs] & 0x1f); return 0;
+    case 0x08:
+      branch(address, reg[rs], rs == 31 ? TRANSFER_RETURN : TRANSFER_JUMP);
+      return 0;
+    case 0x09:
+      target = reg[rs];
+      reg[rd] = address + 8;
+      branch(address, target, TRANSFER_CALL);
+      return 0;
+    case 0x0c:
+      fault("syscall", address);
+      return -1;
+    case 0x0d:
+      fault("Breakpoint", address);
+      return -1;
+    case 0x10:
+    case 0x12:
+      if (cycles < hilo_ready) { cycles = hilo_ready; }
+      reg[rd] = (opcode & 0x3f) == 0x10 ? hi : lo;
+      return 0;
+    case 0x11: hi = reg[rs]; return 0;
+    case 0x13: lo = reg[rs]; return 0;
+    case 0x18:
+    case 0x19:
+      if ((opcode & 0x3f) == 0x18) { product = (int64_t)(int32_t)reg[rs] * (int32_t)reg[rt]; }
+      else { product = (uint64_t)reg[rs] * reg[rt]; }
+      lo = (uint32_t)product;
+      hi = (uint32_t)((uint64_t)product >> 32);
+      hilo_ready = cycles + 1;
+      return 0;
+    case 0x1a:
+    case 0x1b:
+      // Dividing by 0 leaves hi and lo undefined on the hardware
+      if (reg[rt] != 0)
+      {
+        if ((opcode & 0x3f) == 0x1b)
+        {
+          lo = reg[rs] / reg[rt];
+          hi = reg[rs] % reg[rt];
+        }
+          else
+        if (reg[rs] == 0x80000000 && reg[rt] == 0xffffffff)
+        {
+          lo = 0x80000000;
+          hi = 0;
+        }
+          else
+        {
+          lo = (int32_t)reg[rs] / (int32_t)reg[rt];
+          hi = (int32_t)reg[rs] % (int32_t)reg[rt];
+        }
+      }
+      // 35 cycles in all for a 32 bit divide
+      hilo_ready = cycles + 34;
+      return 0;
+    case 0x20:
+    case 0x22:
+    {
+      uint32_t b = (opcode & 0x3f) == 0x20 ? reg[rt] : -reg[rt];
+      uint32_t data = reg[rs] + b;
+
+      if ((((reg[rs] ^ data) & (b ^ data)) & 0x80000000) ||
+          ((opcode & 0x3f) == 0x22 && reg[rt] == 0x80000000 && (int32_t)reg[rs] >= 0))
+      {
+        fault("Integer overflow", address);
+        return -1;
+      }
+      reg[rd] = data;
+      return 0;
+    }
+    case 0x21: reg[rd] = reg[rs] + reg[rt]; return 0;
+    case 0x23: reg[rd] = reg[rs] - reg[rt]; return 0;
+    case 0x24: reg[rd] = reg[rs] & reg[rt]; return 0;
+    case 0x25: reg[rd] = reg[rs] | reg[rt]; return 0;
+    case 0x26: reg[rd] = reg[rs] ^ reg[rt]; return 0;
+    case 0x27: reg[rd] = ~(reg[rs] | reg[rt]); return 0;
+    case 0x2a: reg[rd] = (int32_t)reg[rs] < (int32_t)reg[rt] ? 1 : 0; return 0;
+    case 0x2b: reg[rd] = reg[rs] < reg[rt] ? 1 : 0; return 0;
+    default:
+      break;
+  }
+
+  fault("Unknown instruction", address);
+
+  return -1;
+}
+
+// Registers an instruction reads, for the load / mul interlock
+uint32_t SimulateMIPS::get_uses(uint32_t opcode)
+{
+int op = opcode >> 26;
+int rs = (opcode >> 21) & 0x1f;
+int rt = (opcode >> 16) & 0x1f;
+
+  switch(op)
+  {
+    case 0x00:
+      switch(opcode & 0x3f)
+      {
+        case 0x00: case 0x02: case 0x03: return R(rt);
+        case 0x08: case 0x09: case 0x11: case 0x13: return R(rs);
+        case 0x10: case 0x12: case 0x0c: case 0x0d: return 0;
+        default: return R(rs) | R(rt);
+      }
+    case 0x02:
+    case 0x03:
+    case 0x0f:
+      return 0;
+    case 0x1f:
+      return R(rt);
+    case 0x04:
+    case 0x05:
+    case 0x1c:
+    case 0x28:
+    case 0x29:
+    case 0x2b:
+      return R(rs) | R(rt);
+    default:
+      return R(rs);
+  }
+}
+
+// Sets up the jump that happens after the delay slot.  A branch to
+// itself is how the generated code stops.
+void SimulateMIPS::branch(uint32_t address, uint32_t target, int type)
+{
+  if (target == address)
+  {
+    state = SIMULATE_HALTED;
+    return;
+  }
+
+  next_pc = target;
+  in_delay_slot = true;
+  branch_type = type;
+}
+
+// Only kseg0 and kseg1 are mapped.  Flash can only be written by load().
+uint8_t *SimulateMIPS::get_memory(uint32_t address, int size, bool is_write)
+{
+uint32_t physical = address & 0x1fffffff;
+
+  if (address < 0x80000000 || address >= 0xc0000000) { return NULL; }
+  if ((address & (size - 1)) != 0) { return NULL; }
+
+  if (physical + size <= ram_size) { return ram + physical; }
+
+  if (physical >= MIPS_SFR_START && physical + size <= MIPS_SFR_START + MIPS_SFR_SIZE)
+  {
+    return sfr + (physical - MIPS_SFR_START);
+  }
+
+  if (is_write) { return NULL; }
+
+  if (physical >= FLASH_START && physical + size <= FLASH_START + flash_size)
+  {
+    return flash + (physical - FLASH_START);
+  }
+
+  if (physical >= BOOT_START && physical + size <= BOOT_START + boot_size)
+  {
+    return boot + (physical - BOOT_START);
+  }
+
+  return NULL;
+}
+
+int SimulateMIPS::load_data(uint32_t address, int size, bool is_signed, uint32_t *data)
+{
+uint8_t *p = get_memory(address, size, false);
+
+  if (p == NULL)
+  {
+    fault("Address error on load", address);
+    return -1;
+  }
+
+  switch(size)
+  {
+    case 1: *data = is_signed ? (uint32_t)(int8_t)p[0] : p[0]; break;
+    case 2:
+      *data = p[0] | (p[1] << 8);
+      if (is_signed) { *data = (uint32_t)(int16_t)*data; }
+      break;
+    default: *data = read32(p); break;
+  }
+
+  // Reading the buffer empties it
+  if ((address & 0x1fffffff & ~3) == SPI1_START + SPI_BUF)
+  {
+    write32(sfr + SPI1_START + SPI_STAT - MIPS_SFR_START,
+      read32(sfr + SPI1_START + SPI_STAT - MIPS_SFR_START) & ~SPIRBF);
+  }
+
+  return 0;
+}
+
+int SimulateMIPS::store_data(uint32_t address, int size, uint32_t data)
+{
+uint8_t *p = get_memory(address, size, true);
+int n;
+
+  if (p == NULL)
+  {
+    fault("Address error on store", address);
+    return -1;
+  }
+
+  for (n = 0; n < size; n++) { p[n] = (data >> (n * 8)) & 0xff; }
+
+  if (p >= sfr && p < sfr + MIPS_SFR_SIZE) { write_periph(address & ~3); }
+
+  return 0;
+}
+
+// A transfer finishes right away.  What was sent comes back in the
+// buffer like SDI was tied to SDO.  CLR and SET work on SPI1CON too.
+void SimulateMIPS::write_spi(uint32_t offset)
+{
+uint8_t *base = sfr + SPI1_START - MIPS_SFR_START;
+uint32_t data = read32(base + offset);
+
+  if (offset == SPI_BUF)
+  {
+    if (trace) { printf("%" PRIu64 ": SPI1 0x%04x\n", cycles, data & 0xffff); }
+
+    write32(base + SPI_STAT, read32(base + SPI_STAT) | SPIRBF);
+    return;
+  }
+
+  if (offset == SPI_CON + PORT_CLR || offset == SPI_CON + PORT_SET)
+  {
+    if (offset == SPI_CON + PORT_CLR) { write32(base + SPI_CON, read32(base + SPI_CON) & ~data); }
+    else { write32(base + SPI_CON, read32(base + SPI_CON) | data); }
+
+    write32(base + offset, 0);
+  }
+}
+
+// CLR, SET and INV change the register they belong to and read back as
+// 0.  Writing PORT writes LAT and reading PORT gives LAT for outputs
+// (nothing drives the inputs).
+void SimulateMIPS::write_periph(uint32_t address)
+{
+uint32_t offset = (address & 0x1fffffff) - port_start;
+uint8_t *base;
+uint8_t *lat;
+uint32_t data;
+int port;
+int which;
+
+  if ((address & 0x1fffffff) >= SPI1_START && (address & 0x1fffffff) < SPI1_START + SPI_BRG + 0x10)
+  {
+    write_spi((address & 0x1fffffff) - SPI1_START);
+    return;
+  }
+
+  if (offset >= port_stride * port_count) { return; }
+
+  port = offset / port_stride;
+  offset = offset % port_stride;
+
+  if (offset >= PORT_LAT + 0x10) { return; }
+
+  which = offset & ~0xf;
+  if (which == PORT_PORT) { which = PORT_LAT; }
+
+  base = sfr + port_start - MIPS_SFR_START + port * port_stride;
+  data = read32(base + which);
+
+  switch(offset & 0xf)
+  {
+    case PORT_CLR: data &= ~read32(base + offset); break;
+    case PORT_SET: data |= read32(base + offset); break;
+    case PORT_INV: data ^= read32(base + offset); break;
+    default: data = read32(base + offset); break;
+  }
+
+  if ((offset & 0xf) != 0) { write32(base + offset, 0); }
+
+  write32(base + which, data);
+
+  lat = base + PORT_LAT;
+  write32(base + PORT_PORT, read32(lat) & ~read32(base + PORT_TRIS));
+
+  if (trace)
+  {
+    printf("%" PRIu64 ": %s%c=0x%04x\n", cycles,
+      which == PORT_TRIS ? "TRIS" : "LAT", 'A' + port, data & 0xffff);
+  }
+}
+
+void SimulateMIPS::fault(const char *message, uint32_t address)
+{
+static char text[128];
+
+  if (state == SIMULATE_ERROR) { return; }
+
+  snprintf(text, sizeof(text), "%s at 0x%08x (pc=0x%08x)", message, address, pc);
+  error_message = text;
+  state = SIMULATE_ERROR;
+}
+
@@ -0,0 +1,74 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _SIMULATE_MIPS_H
+#define _SIMULATE_MIPS_H
+
+#include "Simulate.h"
+
+// PIC32MX (MIPS32 M4K core) running out of kseg0 / kseg1.  Only the
+// integer instructions the MIPS generator emits, the I/O port registers
+// and SPI1 are there.
+
+#define MIPS_SFR_START 0x1f800000
+#define MIPS_SFR_SIZE 0x87000
+
+class SimulateMIPS : public Simulate
+{
+public:
+  SimulateMIPS(uint8_t chip_type);
+  virtual ~SimulateMIPS();
+
+  virtual int load(Assembler *assembler);
+  virtual int step();
+  virtual int get_return_value() { return (int32_t)reg[2]; }
+  virtual int read_memory(uint32_t address);
+
+protected:
+  virtual uint32_t get_pc() { return pc; }
+
+private:
+  int execute(uint32_t opcode, uint32_t address);
+  uint32_t get_uses(uint32_t opcode);
+  int special(uint32_t opcode, uint32_t address);
+  void branch(uint32_t address, uint32_t target, int type);
+  uint8_t *get_memory(uint32_t address, int size, bool is_write);
+  int load_data(uint32_t address, int size, bool is_signed, uint32_t *data);
+  int store_data(uint32_t address, int size, uint32_t data);
+  void write_periph(uint32_t address);
+  void write_spi(uint32_t offset);
+  void fault(const char *message, uint32_t address);
+
+  uint32_t reg[32];
+  uint32_t hi;
+  uint32_t lo;
+  uint32_t pc;
+  uint32_t next_pc;
+  bool in_delay_slot;
+  int branch_type;
+  int late_reg;
+  uint64_t hilo_ready;
+  uint8_t *ram;
+  uint32_t ram_size;
+  uint8_t *flash;
+  uint32_t flash_size;
+  uint8_t *boot;
+  uint32_t boot_size;
+  uint8_t sfr[MIPS_SFR_SIZE];
+  uint32_t port_start;
+  uint32_t port_stride;
+  int port_count;
+  uint32_t main_address;
+  bool has_main;
+};
+
+#endif
+
@@ -0,0 +1,854 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "MSP430.h"
+#include "SimulateMSP430.h"
+
+// Peripherals that do more than hold a value.  Where they are depends
+// on the family so the chip picks one of these.
+struct msp430_periph_t
+{
+  uint16_t periph_end;    // everything below this is a peripheral
+  uint16_t ram_start;
+  uint16_t p1in;
+  uint16_t p2in;
+  uint16_t wdtctl;
+  uint16_t usicnt;        // USI parts, 0 if there is none
+  uint16_t ucb0txbuf;     // eUSCI_B0 parts, 0 if there is none
+  uint16_t mpy;           // MPY, MPYS, ... SUMEXT, 0 if there's no multiplier
+  const char *ports[8];   // OUT / DIR registers the trace prints
+  uint16_t port_address[8];
+};
+
+// The G2xx value line parts have no hardware multiplier
+static msp430_periph_t msp430x2xx_periph =
+{
+  0x0200, 0x0200, 0x0020, 0x0028, 0x0120, 0x007b, 0, 0,
+  { "P1OUT", "P1DIR", "P2OUT", "P2DIR", NULL },
+  { 0x0021, 0x0022, 0x0029, 0x002a },
+};
+
+static msp430_periph_t msp430fr5969_periph =
+{
+  0x1000, 0x1c00, 0x0200, 0x0201, 0x015c, 0, 0x064e, 0x04c0,
+  { "P1OUT", "P2OUT", "P1DIR", "P2DIR", NULL },
+  { 0x0202, 0x0203, 0x0204, 0x0205 },
+};
+
+// USI, offsets from USICNT
+#define USICTL1 -2
+#define USISRL 1
+#define USIIFG 0x01
+
+// eUSCI_B0, offsets from UCB0TXBUF
+#define UCB0RXBUF -2
+#define UCB0IFG 0x1e
+#define UCRXIFG 0x01
+#define UCTXIFG 0x02
+
+// Hardware multiplier, offsets from MPY
+#define MPY 0
+#define MPYS 2
+#define OP2 8
+#define RESLO 10
+#define RESHI 12
+#define SUMEXT 14
+
+// Cycles from the MSP430x2xx family guide (SLAU144).  Sources are
+// Rn, @Rn, @Rn+, #N and x(Rn)/EDE/&EDE.  The constant generator counts
+// as Rn.
+enum
+{
+  SOURCE_REGISTER,
+  SOURCE_INDIRECT,
+  SOURCE_INDIRECT_INC,
+  SOURCE_IMMEDIATE,
+  SOURCE_INDEXED,
+};
+
+//                                        Rm  PC  x(Rm)
+static const uint8_t cycles_double[][3] = { { 1, 2, 4 },   // Rn
+                                            { 2, 2, 5 },   // @Rn
+                                            { 2, 3, 5 },   // @Rn+
+                                            { 2, 3, 5 },   // #N
+                                            { 3, 3, 6 } }; // x(Rn)
+
+//                                          Rn @Rn @Rn+ #N x(Rn)
+static const uint8_t cycles_rotate[] =    { 1,  3,  3,  0,  4 };
+static const uint8_t cycles_push[] =      { 3,  4,  4,  4,  5 };
+static const uint8_t cycles_call[] =      { 4,  4,  5,  5,  5 };
+
+SimulateMSP430::SimulateMSP430(uint8_t chip_type) :
+  periph(&msp430x2xx_periph),
+  mpy_address(MPY),
+  main_address(0),
+  has_main(false)
+{
+  flash_end = 0xffff;
+
+  switch(chip_type)
+  {
+    case MSP430G2553:
+      flash_start = 0xc000;
+      ram_end = 0x0400;
+      break;
+    case MSP430FR5969:
+      flash_start = 0x4400;
+      flash_end = 0x13fff;
+      ram_end = 0x2400;
+      periph = &msp430fr5969_periph;
+      break;
+    case MSP430G2231:
+    default:
+      flash_start = 0xf800;
+      ram_end = 0x0280;
+      break;
+  }
+
+  memset(reg, 0, sizeof(reg));
+  memset(memory, 0xff, sizeof(memory));
+  memset(memory, 0, periph->periph_end);
+}
+
+SimulateMSP430::~SimulateMSP430()
+{
+}
+
+int SimulateMSP430::load(Assembler *assembler)
+{
+assembler_page_t *page;
+uint32_t address;
+int n;
+
+  this->assembler = assembler;
+
+  for (page = assembler->get_pages(); page != NULL; page = page->next)
+  {
+    for (n = 0; n < ASSEMBLER_PAGE_SIZE; n++)
+    {
+      if ((page->used[n / 8] & (1 << (n % 8))) == 0) { continue; }
+
+      address = page->address + n;
+
+      if (address > flash_end || address < flash_start)
+      {
+        printf("Error: address 0x%04x is outside of flash\n", address);
+        return -1;
+      }
+
+      memory[address] = page->data[n];
+    }
+  }
+
+  has_main = assembler->get_symbol("main", &main_address);
+
+  reg[0] = read16(0xfffe);
+  set_entry(reg[0]);
+
+  return 0;
+}
+
+int SimulateMSP430::step()
+{
+uint16_t opcode;
+int count = 1;
+
+  opcode = fetch();
+
+  // MSP430X extension word used as a repeat count for the next
+  // instruction.
+  if ((opcode & 0xf800) == 0x1800)
+  {
+    if ((opcode & 0x0080) != 0) { count = (reg[opcode & 0xf] & 0xf) + 1; }
+    else { count = (opcode & 0xf) + 1; }
+
+    cycles++;
+    opcode = fetch();
+  }
+
+  uint32_t pc = reg[0];
+
+  while (count-- > 0)
+  {
+    reg[0] = pc;
+    if (execute(opcode) != 0) { return -1; }
+  }
+
+  check_stack(reg[1]);
+
+  if (has_main && !in_main && reg[0] == main_address)
+  {
+    set_entry(main_address);
+    in_main = true;
+    stack_base = reg[1];
+    stack_min = reg[1];
+  }
+
+  return 0;
+}
+
+int SimulateMSP430::execute(uint16_t opcode)
+{
+  if (opcode >= 0x4000) { return double_operand(opcode); }
+  if ((opcode & 0xe000) == 0x2000) { return jump(opcode); }
+  if ((opcode & 0xffc0) == 0x1340 || (opcode & 0xfff0) == 0x13b0) { return calla(opcode); }
+  if ((opcode & 0xfc00) == 0x1000) { return single_operand(opcode); }
+  if ((opcode & 0xfc00) == 0x1400) { return push_pop_multiple(opcode); }
+  if ((opcode & 0xf0e0) == 0x0040) { return rotate(opcode); }
+  if ((opcode & 0xf000) == 0x0000) { return address_instr(opcode); }
+
+  fault("Unknown opcode", reg[0] - 2);
+
+  return -1;
+}
+
+int SimulateMSP430::double_operand(uint16_t opcode)
+{
+int op = opcode >> 12;
+int sreg = (opcode >> 8) & 0xf;
+int ad = (opcode >> 7) & 1;
+int bw = (opcode >> 6) & 1;
+int as = (opcode >> 4) & 3;
+int dreg = opcode & 0xf;
+uint16_t mask = bw ? 0xff : 0xffff;
+uint16_t msb = bw ? 0x80 : 0x8000;
+uint16_t src,dst,result;
+uint16_t address = 0;
+int source;
+
+  source = get_source(sreg, as, bw, &src, &address);
+
+  if (ad == 1)
+  {
+    uint16_t base = reg[0];
+    uint16_t offset = fetch();
+
+    if (dreg == 0) { address = base + offset; }
+    else if (dreg == 2) { address = offset; }
+    else { address = reg[dreg] + offset; }
+
+    dst = bw ? read8(address) : read16(address);
+    cycles += cycles_double[source][2];
+  }
+    else
+  {
+    dst = reg[dreg] & mask;
+    cycles += cycles_double[source][dreg == 0 ? 1 : 0];
+  }
+
+  switch(op)
+  {
+    case 0x4: // mov
+      result = src;
+      break;
+    case 0x5: // add
+      result = alu_add(dst, src, 0, bw);
+      break;
+    case 0x6: // addc
+      result = alu_add(dst, src, reg[2] & MSP430_SR_C, bw);
+      break;
+    case 0x7: // subc
+      result = alu_add(dst, ~src & mask, reg[2] & MSP430_SR_C, bw);
+      break;
+    case 0x8: // sub
+    case 0x9: // cmp
+      result = alu_add(dst, ~src & mask, 1, bw);
+      break;
+    case 0xa: // dadd
+      result = alu_dadd(dst, src, bw);
+      break;
+    case 0xb: // bit
+    case 0xf: // and
+      result = src & dst;
+      set_nz(result, bw);
+      reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+      if (result != 0) { reg[2] |= MSP430_SR_C; }
+      break;
+    case 0xc: // bic
+      result = dst & ~src;
+      break;
+    case 0xd: // bis
+      result = dst | src;
+      break;
+    case 0xe: // xor
+      result = src ^ dst;
+      set_nz(result, bw);
+      reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+      if (result != 0) { reg[2] |= MSP430_SR_C; }
+      if ((src & msb) && (dst & msb)) { reg[2] |= MSP430_SR_V; }
+      break;
+    default:
+      fault("Unknown opcode", reg[0] - 2);
+      return -1;
+  }
+
+  // cmp and bit only set flags
+  if (op == 0x9 || op == 0xb) { return 0; }
+
+  result &= mask;
+
+  if (ad == 1)
+  {
+    if (bw) { write8(address, result); }
+    else { write16(address, result); }
+
+    return 0;
+  }
+
+  // ret
+  if (opcode == 0x4130)
+  {
+    reg[0] = result;
+
+    if (return_function() != 0) { state = SIMULATE_RETURNED; }
+
+    return 0;
+  }
+
+  // Byte instructions clear the upper half of the register
+  reg[dreg] = result;
+  if (dreg == 0 || dreg == 1) { reg[dreg] &= 0xfffe; }
+
+  return 0;
+}
+
+int SimulateMSP430::single_operand(uint16_t opcode)
+{
+int op = (opcode >> 7) & 7;
+int bw = (opcode >> 6) & 1;
+int as = (opcode >> 4) & 3;
+int r = opcode & 0xf;
+uint16_t mask = bw ? 0xff : 0xffff;
+uint16_t msb = bw ? 0x80 : 0x8000;
+uint16_t value,result;
+uint16_t address = 0;
+int source;
+
+  if (op == 6) // reti
+  {
+    reg[2] = read16(reg[1]);
+    reg[1] += 2;
+    reg[0] = read16(reg[1]);
+    reg[1] += 2;
+    cycles += 5;
+    return 0;
+  }
+
+  if (op == 7)
+  {
+    fault("Unknown opcode", reg[0] - 2);
+    return -1;
+  }
+
+  source = get_source(r, as, bw, &value, &address);
+
+  switch(op)
+  {
+    case 0: // rrc
+      result = (value >> 1) | ((reg[2] & MSP430_SR_C) ? msb : 0);
+      reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+      if (value & 1) { reg[2] |= MSP430_SR_C; }
+      set_nz(result, bw);
+      break;
+    case 1: // swpb
+      result = (value >> 8) | (value << 8);
+      break;
+    case 2: // rra
+      result = (value >> 1) | (value & msb);
+      reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+      if (value & 1) { reg[2] |= MSP430_SR_C; }
+      set_nz(result, bw);
+      break;
+    case 3: // sxt
+      result = (value & 0x80) ? (value | 0xff00) : (value & 0xff);
+      set_nz(result, 0);
+      reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+      if (result != 0) { reg[2] |= MSP430_SR_C; }
+      mask = 0xffff;
+      break;
+    case 4: // push
+      reg[1] -= 2;
+      if (bw) { write8(reg[1], value); }
+      else { write16(reg[1], value); }
+      cycles += cycles_push[source];
+      return 0;
+    case 5: // call
+      reg[1] -= 2;
+      write16(reg[1], reg[0]);
+      reg[0] = value & 0xfffe;
+      cycles += cycles_call[source];
+      call_function(reg[0]);
+      return 0;
+  }
+
+  cycles += cycles_rotate[source];
+  result &= mask;
+
+  if (as == 0)
+  {
+    reg[r] = result;
+  }
+    else
+  {
+    if (bw) { write8(address, result); }
+    else { write16(address, result); }
+  }
+
+  return 0;
+}
+
+int SimulateMSP430::jump(uint16_t opcode)
+{
+int cond = (opcode >> 10) & 7;
+int offset = opcode & 0x3ff;
+bool n = (reg[2] & MSP430_SR_N) != 0;
+bool v = (reg[2] & MSP430_SR_V) != 0;
+bool take = false;
+
+  if (offset & 0x200) { offset -= 0x400; }
+
+  cycles += 2;
+
+  switch(cond)
+  {
+    case 0: take = (reg[2] & MSP430_SR_Z) == 0; break;
+    case 1: take = (reg[2] & MSP430_SR_Z) != 0; break;
+    case 2: take = (reg[2] & MSP430_SR_C) == 0; break;
+    case 3: take = (reg[2] & MSP430_SR_C) != 0; break;
+    case 4: take = n; break;
+    case 5: take = n == v; break;
+    case 6: take = n != v; break;
+    case 7: take = true; break;
+  }
+
+  if (!take) { return 0; }
+
+  // jmp $ is how programs stop
+  if (offset == -1)
+  {
+    state = SIMULATE_HALTED;
+    return 0;
+  }
+
+  reg[0] = (reg[0] + offset * 2) & 0xfffff;
+
+  return 0;
+}
+
+int SimulateMSP430::rotate(uint16_t opcode)
+{
+int count = ((opcode >> 10) & 3) + 1;
+int op = (opcode >> 8) & 3;
+int r = opcode & 0xf;
+uint16_t value = reg[r];
+int n;
+
+  for (n = 0; n < count; n++)
+  {
+    uint16_t carry = reg[2] & MSP430_SR_C;
+
+    reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+
+    switch(op)
+    {
+      case 0: // rrcm
+        if (value & 1) { reg[2] |= MSP430_SR_C; }
+        value = (value >> 1) | (carry ? 0x8000 : 0);
+        break;
+      case 1: // rram
+        if (value & 1) { reg[2] |= MSP430_SR_C; }
+        value = (value >> 1) | (value & 0x8000);
+        break;
+      case 2: // rlam
+        if (value & 0x8000) { reg[2] |= MSP430_SR_C; }
+        value = value << 1;
+        break;
+      case 3: // rrum
+        if (value & 1) { reg[2] |= MSP430_SR_C; }
+        value = value >> 1;
+        break;
+    }
+  }
+
+  set_nz(value, 0);
+  reg[r] = value;
+  cycles += count;
+
+  return 0;
+}
+
+// MSP430X mova with a register, @Rn, @Rn+ or #imm20 source.  bra is
+// mova into PC and reta is mova @SP+, PC.  20 bit values in memory are
+// two words with the top 4 bits in the second.
+int SimulateMSP430::address_instr(uint16_t opcode)
+{
+int sreg = (opcode >> 8) & 0xf;
+int dreg = opcode & 0xf;
+uint32_t value;
+
+  switch((opcode >> 4) & 0xf)
+  {
+    case 0x0: // mova @Rsrc, Rdst
+      value = read16(reg[sreg]) | ((read16(reg[sreg] + 2) & 0xf) << 16);
+      cycles += 3;
+      break;
+    case 0x1: // mova @Rsrc+, Rdst
+      value = read16(reg[sreg]) | ((read16(reg[sreg] + 2) & 0xf) << 16);
+      reg[sreg] += 4;
+      cycles += dreg == 0 ? 4 : 3;
+      break;
+    case 0x8: // mova #imm20, Rdst
+      value = (sreg << 16) | fetch();
+      cycles += dreg == 0 ? 3 : 2;
+      break;
+    case 0xc: // mova Rsrc, Rdst
+      value = reg[sreg];
+      cycles += dreg == 0 ? 3 : 1;
+      break;
+    default:
+      fault("Unknown opcode", reg[0] - 2);
+      return -1;
+  }
+
+  reg[dreg] = value & 0xfffff;
+
+  if (dreg == 0)
+  {
+    reg[0] &= 0xffffe;
+
+    // reta
+    if (opcode == 0x0110)
+    {
+      if (return_function() != 0) { state = SIMULATE_RETURNED; }
+    }
+  }
+
+  return 0;
+}
+
+// calla Rn or #imm20 pushes all 20 bits of the return address
+int SimulateMSP430::calla(uint16_t opcode)
+{
+uint32_t address;
+
+  if ((opcode & 0xfff0) == 0x13b0)
+  {
+    address = ((opcode & 0xf) << 16) | fetch();
+  }
+    else
+  {
+    address = reg[opcode & 0xf];
+  }
+
+  reg[1] -= 2;
+  write16(reg[1], reg[0] >> 16);
+  reg[1] -= 2;
+  write16(reg[1], reg[0] & 0xffff);
+  reg[0] = address & 0xffffe;
+  cycles += 5;
+  call_function(reg[0]);
+
+  return 0;
+}
+
+// pushm #n, Rn pushes Rn down to Rn-n+1 and popm has the lowest of the
+// registers in the opcode.  .a moves all 20 bits in 2 words.
+int SimulateMSP430::push_pop_multiple(uint16_t opcode)
+{
+int count = ((opcode >> 4) & 0xf) + 1;
+int r = opcode & 0xf;
+bool is_address = (opcode & 0x0100) == 0;
+int n;
+
+  if ((opcode & 0x0200) == 0)
+  {
+    for (n = 0; n < count; n++)
+    {
+      if (is_address)
+      {
+        reg[1] -= 2;
+        write16(reg[1], reg[r - n] >> 16);
+      }
+
+      reg[1] -= 2;
+      write16(reg[1], reg[r - n] & 0xffff);
+    }
+  }
+    else
+  {
+    for (n = 0; n < count; n++)
+    {
+      reg[r + n] = read16(reg[1]);
+      reg[1] += 2;
+
+      if (is_address)
+      {
+        reg[r + n] |= (read16(reg[1]) & 0xf) << 16;
+        reg[1] += 2;
+      }
+    }
+  }
+
+  cycles += 2 + count;
+
+  return 0;
+}
+
+// Returns which column of the cycle tables the source uses
+int SimulateMSP430::get_source(int sreg, int as, int bw, uint16_t *value, uint16_t *address)
+{
+  if (sreg == 3)
+  {
+    static const int16_t cg[] = { 0, 1, 2, -1 };
+    *value = cg[as] & (bw ? 0xff : 0xffff);
+    return SOURCE_REGISTER;
+  }
+
+  if (sreg == 2 && as >= 2)
+  {
+    *value = as == 2 ? 4 : 8;
+    return SOURCE_REGISTER;
+  }
+
+  switch(as)
+  {
+    case 0:
+      *value = bw ? (reg[sreg] & 0xff) : reg[sreg];
+      return SOURCE_REGISTER;
+    case 1:
+    {
+      uint16_t base = reg[0];
+      uint16_t offset = fetch();
+
+      if (sreg == 0) { *address = base + offset; }
+      else if (sreg == 2) { *address = offset; }
+      else { *address = reg[sreg] + offset; }
+
+      *value = bw ? read8(*address) : read16(*address);
+      return SOURCE_INDEXED;
+    }
+    case 2:
+      *address = reg[sreg];
+      *value = bw ? read8(*address) : read16(*address);
+      return SOURCE_INDIRECT;
+    default:
+      if (sreg == 0)
+      {
+        *value = fetch();
+        if (bw) { *value &= 0xff; }
+        return SOURCE_IMMEDIATE;
+      }
+
+      *address = reg[sreg];
+      *value = bw ? read8(*address) : read16(*address);
+      reg[sreg] += (bw && sreg != 1) ? 1 : 2;
+      return SOURCE_INDIRECT_INC;
+  }
+}
+
+uint16_t SimulateMSP430::alu_add(uint16_t dst, uint16_t src, int carry, int bw)
+{
+uint32_t mask = bw ? 0xff : 0xffff;
+uint32_t msb = bw ? 0x80 : 0x8000;
+uint32_t result = dst + src + carry;
+
+  reg[2] &= ~(MSP430_SR_C | MSP430_SR_V);
+  if (result > mask) { reg[2] |= MSP430_SR_C; }
+  if (((src ^ result) & (dst ^ result) & msb) != 0) { reg[2] |= MSP430_SR_V; }
+
+  result &= mask;
+  set_nz(result, bw);
+
+  return result;
+}
+
+uint16_t SimulateMSP430::alu_dadd(uint16_t dst, uint16_t src, int bw)
+{
+int digits = bw ? 2 : 4;
+int carry = reg[2] & MSP430_SR_C;
+uint16_t result = 0;
+int n;
+
+  for (n = 0; n < digits; n++)
+  {
+    int digit = ((dst >> (n * 4)) & 0xf) + ((src >> (n * 4)) & 0xf) + carry;
+    carry = 0;
+    if (digit > 9) { digit -= 10; carry = 1; }
+    result |= digit << (n * 4);
+  }
+
+  reg[2] &= ~MSP430_SR_C;
+  if (carry) { reg[2] |= MSP430_SR_C; }
+  set_nz(result, bw);
+
+  return result;
+}
+
+void SimulateMSP430::set_nz(uint16_t value, int bw)
+{
+uint16_t mask = bw ? 0xff : 0xffff;
+uint16_t msb = bw ? 0x80 : 0x8000;
+
+  reg[2] &= ~(MSP430_SR_Z | MSP430_SR_N);
+  if ((value & mask) == 0) { reg[2] |= MSP430_SR_Z; }
+  if ((value & msb) != 0) { reg[2] |= MSP430_SR_N; }
+}
+
+uint16_t SimulateMSP430::fetch()
+{
+uint32_t pc = reg[0] & 0xffffe;
+uint16_t data;
+
+  // Code can be above 64k so this doesn't go through read16()
+  data = memory[pc] | (memory[pc + 1] << 8);
+  reg[0] = (pc + 2) & 0xfffff;
+
+  return data;
+}
+
+uint8_t SimulateMSP430::read8(uint16_t address)
+{
+  if (address >= periph->periph_end) { return memory[address]; }
+
+  if (address == periph->p1in || address == periph->p2in) { return 0; }
+  if (address == periph->wdtctl) { return 0x80; }
+  if (address == periph->wdtctl + 1) { return 0x69; }
+
+  // Reading the eUSCI receive buffer clears its flag
+  if (periph->ucb0txbuf != 0 && address == periph->ucb0txbuf + UCB0RXBUF)
+  {
+    memory[periph->ucb0txbuf + UCB0IFG] &= ~UCRXIFG;
+  }
+
+  return memory[address];
+}
+
+uint16_t SimulateMSP430::read16(uint16_t address)
+{
+  address &= 0xfffe;
+
+  return read8(address) | (read8(address + 1) << 8);
+}
+
+void SimulateMSP430::write8(uint16_t address, uint8_t data)
+{
+  if (address < periph->periph_end)
+  {
+    write_periph(address, data);
+    return;
+  }
+
+  if (address < periph->ram_start || address >= ram_end)
+  {
+    fault("Write outside of RAM", address);
+    return;
+  }
+
+  memory[address] = data;
+}
+
+void SimulateMSP430::write16(uint16_t address, uint16_t data)
+{
+  address &= 0xfffe;
+
+  write8(address, data & 0xff);
+  write8(address + 1, data >> 8);
+}
+
+void SimulateMSP430::write_periph(uint16_t address, uint8_t data)
+{
+uint16_t mpy = periph->mpy;
+uint16_t usicnt = periph->usicnt;
+uint16_t txbuf = periph->ucb0txbuf;
+int n;
+
+  memory[address] = data;
+
+  for (n = 0; trace && periph->ports[n] != NULL; n++)
+  {
+    if (address == periph->port_address[n])
+    {
+      printf("%" PRIu64 ": %s=0x%02x\n", cycles, periph->ports[n], data);
+      break;
+    }
+  }
+
+  // A USI transfer finishes right away.  What was sent comes back in
+  // USISRL like MISO was tied to MOSI.
+  if (usicnt != 0 && address == usicnt && (data & 0x1f) != 0)
+  {
+    if (trace)
+    {
+      printf("%" PRIu64 ": SPI0 0x%02x\n", cycles, memory[usicnt + USISRL]);
+    }
+
+    memory[usicnt] &= 0xe0;
+    memory[usicnt + USICTL1] |= USIIFG;
+  }
+
+  // Same for eUSCI_B0: the byte written to UCB0TXBUF is received
+  if (txbuf != 0 && address == txbuf)
+  {
+    if (trace)
+    {
+      printf("%" PRIu64 ": SPI0 0x%02x\n", cycles, data);
+    }
+
+    memory[txbuf + UCB0RXBUF] = data;
+    memory[txbuf + UCB0IFG] |= UCRXIFG | UCTXIFG;
+  }
+
+  // The hardware multiplier.  Writing MPY or MPYS picks unsigned or
+  // signed and writing the high byte of OP2 starts it.  MAC isn't here.
+  if (mpy == 0) { }
+    else
+  if (address == mpy + MPY + 1 || address == mpy + MPYS + 1)
+  {
+    mpy_address = address - 1 - mpy;
+  }
+    else
+  if (address == mpy + OP2 + 1)
+  {
+    uint32_t result;
+
+    if (mpy_address == MPYS)
+    {
+      result = (int16_t)read16(mpy + MPYS) * (int16_t)read16(mpy + OP2);
+      memory[mpy + SUMEXT] = memory[mpy + SUMEXT + 1] = (result & 0x80000000) ? 0xff : 0;
+    }
+      else
+    {
+      result = (uint32_t)read16(mpy + MPY) * read16(mpy + OP2);
+      memory[mpy + SUMEXT] = memory[mpy + SUMEXT + 1] = 0;
+    }
+
+    memory[mpy + RESLO] = result & 0xff;
+    memory[mpy + RESLO + 1] = (result >> 8) & 0xff;
+    memory[mpy + RESHI] = (result >> 16) & 0xff;
+    memory[mpy + RESHI + 1] = result >> 24;
+  }
+}
+
+void SimulateMSP430::fault(const char *message, uint16_t address)
+{
+static char text[128];
+
+  snprintf(text, sizeof(text), "%s at 0x%04x (pc=0x%04x)", message, address, reg[0]);
+  error_message = text;
+  state = SIMULATE_ERROR;
+}
+
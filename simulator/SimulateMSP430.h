@@ -0,0 +1,73 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#ifndef _SIMULATE_MSP430_H
+#define _SIMULATE_MSP430_H
+
+#include "Simulate.h"
+
+#define MSP430_SR_C 0x0001
+#define MSP430_SR_Z 0x0002
+#define MSP430_SR_N 0x0004
+#define MSP430_SR_V 0x0100
+
+struct msp430_periph_t;
+
+class SimulateMSP430 : public Simulate
+{
+public:
+  SimulateMSP430(uint8_t chip_type);
+  virtual ~SimulateMSP430();
+
+  virtual int load(Assembler *assembler);
+  virtual int step();
+  virtual int get_return_value() { return (int16_t)reg[15]; }
+  virtual int read_memory(uint32_t address) { return memory[address & 0xfffff]; }
+
+protected:
+  virtual uint32_t get_pc() { return reg[0]; }
+
+private:
+  int execute(uint16_t opcode);
+  int double_operand(uint16_t opcode);
+  int single_operand(uint16_t opcode);
+  int jump(uint16_t opcode);
+  int rotate(uint16_t opcode);
+  int address_instr(uint16_t opcode);
+  int calla(uint16_t opcode);
+  int push_pop_multiple(uint16_t opcode);
+  int get_source(int sreg, int as, int bw, uint16_t *value, uint16_t *address);
+  uint16_t alu_add(uint16_t dst, uint16_t src, int carry, int bw);
+  uint16_t alu_dadd(uint16_t dst, uint16_t src, int bw);
+  void set_nz(uint16_t value, int bw);
+  uint16_t fetch();
+  uint8_t read8(uint16_t address);
+  uint16_t read16(uint16_t address);
+  void write8(uint16_t address, uint8_t data);
+  void write16(uint16_t address, uint16_t data);
+  void write_periph(uint16_t address, uint8_t data);
+  void fault(const char *message, uint16_t address);
+
+  // MSP430X registers and the PC are 20 bits.  .w instructions clear
+  // the top 4 bits of the register they write.
+  uint32_t reg[16];
+  uint8_t memory[0x100000];
+  uint32_t flash_start;
+  uint32_t flash_end;
+  uint16_t ram_end;
+  msp430_periph_t *periph;
+  uint16_t mpy_address;   // MPY or MPYS, whichever was written last
+  uint32_t main_address;
+  bool has_main;
+};
+
+#endif
+
@@ -0,0 +1,173 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.mikekohn.net/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "AssemblerDSPIC.h"
+#include "AssemblerMIPS.h"
+#include "AssemblerMSP430.h"
+#include "DSPIC.h"
+#include "MIPS.h"
+#include "MSP430.h"
+#include "SimulateDSPIC.h"
+#include "SimulateMIPS.h"
+#include "SimulateMSP430.h"
+
+#define DEFAULT_MAX_CYCLES 10000000
+#define MAX_DUMPS 16
+
+int main(int argc, char *argv[])
+{
+Assembler *assembler;
+Simulate *simulate;
+uint64_t max_cycles = DEFAULT_MAX_CYCLES;
+bool trace = false;
+const char *result = NULL;
+const char *profile = NULL;
+uint32_t dump_address[MAX_DUMPS];
+int dump_length[MAX_DUMPS];
+int dump_count = 0;
+uint32_t address;
+int ret;
+int n;
+
+  if (argc < 3)
+  {
+    printf("Usage: %s <asm file> <msp430g2231/msp430g2553/msp430x/msp430fr5969/dspic30f3012/dspic33fj06gs101a/pic32mx250f128b/pic32mx795f512l> [ -max_cycles <n> ] [ -trace ] [ -result <label> ] [ -dump <address> <length> ] [ -profile <file> ]\n", argv[0]);
+    printf("  -profile writes how often each block ran for java_grinder --profile\n");
+    printf("  (compile with --instrument so every block has a label).\n");
+    exit(0);
+  }
+
+  for (n = 3; n < argc; n++)
+  {
+    if (strcmp(argv[n], "-max_cycles") == 0 && n + 1 < argc)
+    {
+      max_cycles = strtoull(argv[++n], NULL, 0);
+    }
+      else
+    if (strcmp(argv[n], "-trace") == 0)
+    {
+      trace = true;
+    }
+      else
+    if (strcmp(argv[n], "-result") == 0 && n + 1 < argc)
+    {
+      result = argv[++n];
+    }
+      else
+    if (strcmp(argv[n], "-profile") == 0 && n + 1 < argc)
+    {
+      profile = argv[++n];
+    }
+      else
+    if (strcmp(argv[n], "-dump") == 0 && n + 2 < argc && dump_count < MAX_DUMPS)
+    {
+      dump_address[dump_count] = strtoul(argv[++n], NULL, 0);
+      dump_length[dump_count] = strtol(argv[++n], NULL, 0);
+      dump_count++;
+    }
+      else
+    {
+      printf("Unknown option %s\n", argv[n]);
+      exit(1);
+    }
+  }
+
+  if (strcasecmp("msp430g2231", argv[2]) == 0)
+  {
+    assembler = new AssemblerMSP430();
+    simulate = new SimulateMSP430(MSP430G2231);
+  }
+    else
+  if (strcasecmp("msp430x", argv[2]) == 0 ||
+      strcasecmp("msp430fr5969", argv[2]) == 0)
+  {
+    assembler = new AssemblerMSP430();
+    simulate = new SimulateMSP430(MSP430FR5969);
+  }
+    else
+  if (strcasecmp("msp430g2553", argv[2]) == 0)
+  {
+    assembler = new AssemblerMSP430();
+    simulate = new SimulateMSP430(MSP430G2553);
+  }
+    else
+  if (strcasecmp("dspic30f3012", argv[2]) == 0)
+  {
+    assembler = new AssemblerDSPIC();
+    simulate = new SimulateDSPIC(DSPIC30F3012);
+  }
+    else
+  if (strcasecmp("dspic33fj06gs101a", argv[2]) == 0)
+  {
+    assembler = new AssemblerDSPIC();
+    simulate = new SimulateDSPIC(DSPIC33FJ06GS101A);
+  }
+    else
+  if (strcasecmp("pic32mx250f128b", argv[2]) == 0)
+  {
+    assembler = new AssemblerMIPS();
+    simulate = new SimulateMIPS(PIC32MX250F128B);
+  }
+    else
+  if (strcasecmp("pic32mx795f512l", argv[2]) == 0)
+  {
+    assembler = new AssemblerMIPS();
+    simulate = new SimulateMIPS(PIC32MX795F512L);
+  }
+    else
+  {
+    printf("Unknown cpu type: %s\n", argv[2]);
+    exit(1);
+  }
+
+  if (assembler->assemble(argv[1]) != 0 || simulate->load(assembler) != 0)
+  {
+    delete simulate;
+    delete assembler;
+    exit(1);
+  }
+
+  if (result != NULL)
+  {
+    if (!assembler->get_symbol(result, &address))
+    {
+      printf("Unknown label %s\n", result);
+      delete simulate;
+      delete assembler;
+      exit(1);
+    }
+
+    simulate->set_result(address);
+  }
+
+  simulate->set_trace(trace);
+  if (profile != NULL) { simulate->start_profile(); }
+  ret = simulate->run(max_cycles);
+  simulate->report(stdout);
+
+  if (profile != NULL && simulate->write_profile(profile) != 0) { ret = -1; }
+
+  for (n = 0; n < dump_count; n++)
+  {
+    simulate->dump_memory(stdout, dump_address[n], dump_length[n]);
+  }
+
+  delete simulate;
+  delete assembler;
+
+  return ret == 0 ? 0 : 1;
+}
+
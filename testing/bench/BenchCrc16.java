@@ -0,0 +1,40 @@
+
+// CRC-16-CCITT a bit at a time over 64 pseudo random bytes.
+
+public class BenchCrc16
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int crc = 0xffff;
+    int seed = 1;
+    int n, bit;
+
+    for (n = 0; n < 64; n++)
+    {
+      seed = (seed * 75 + 74) & 0xffff;
+      crc = crc ^ ((seed >> 8) << 8);
+
+      for (bit = 0; bit < 8; bit++)
+      {
+        if ((crc & 0x8000) != 0)
+        {
+          crc = ((crc << 1) ^ 0x1021) & 0xffff;
+        }
+          else
+        {
+          crc = (crc << 1) & 0xffff;
+        }
+      }
+    }
+
+    return crc;
+  }
+}
+
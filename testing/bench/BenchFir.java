@@ -0,0 +1,35 @@
+
+// 8 tap symmetric low pass FIR filter with the delay line in locals
+// over 64 samples of a sawtooth.  Samples are 8 bit so the sum of
+// products fits in a 16 bit int.
+
+public class BenchFir
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int x0 = 0, x1 = 0, x2 = 0, x3 = 0, x4 = 0, x5 = 0, x6 = 0, x7 = 0;
+    int checksum = 0;
+    int n, y;
+
+    for (n = 0; n < 64; n++)
+    {
+      x7 = x6; x6 = x5; x5 = x4; x4 = x3;
+      x3 = x2; x2 = x1; x1 = x0;
+      x0 = ((n * 37) & 0xff) - 128;
+
+      y = (x0 + x7) * 3 + (x1 + x6) * 9 + (x2 + x5) * 17 + (x3 + x4) * 23;
+
+      checksum = checksum ^ (y >> 6);
+    }
+
+    return checksum;
+  }
+}
+
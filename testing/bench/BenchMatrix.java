@@ -0,0 +1,55 @@
+
+import net.mikekohn.java_grinder.Memory;
+
+// 4x4 fixed point matrix multiply C = A * B in RAM.  Values are Q4 and
+// small enough that a row times a column fits in a 16 bit int.
+
+public class BenchMatrix
+{
+  static final int A = BenchRam.BASE;
+  static final int B = BenchRam.BASE + 32;
+  static final int C = BenchRam.BASE + 64;
+
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int row, col, k, sum;
+    int checksum = 0;
+
+    for (k = 0; k < 16; k++)
+    {
+      Memory.write16(A + k * 2, (short)((k * 5) % 31 - 15));
+      Memory.write16(B + k * 2, (short)((k * 11) % 29 - 14));
+    }
+
+    for (row = 0; row < 4; row++)
+    {
+      for (col = 0; col < 4; col++)
+      {
+        sum = 0;
+
+        for (k = 0; k < 4; k++)
+        {
+          sum += Memory.read16(A + (row * 4 + k) * 2) *
+                 Memory.read16(B + (k * 4 + col) * 2);
+        }
+
+        Memory.write16(C + (row * 4 + col) * 2, (short)(sum >> 4));
+      }
+    }
+
+    for (k = 0; k < 16; k++)
+    {
+      checksum = checksum * 3 + Memory.read16(C + k * 2);
+    }
+
+    return checksum & 0x7fff;
+  }
+}
+
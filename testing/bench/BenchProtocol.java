@@ -0,0 +1,84 @@
+
+// Frame parser state machine for 0x7e <length> <payload> <checksum>
+// frames fed a byte at a time from a generated stream with some noise
+// between frames.  Returns the number of good frames and their bytes.
+
+public class BenchProtocol
+{
+  static final int STATE_SYNC = 0;
+  static final int STATE_LENGTH = 1;
+  static final int STATE_PAYLOAD = 2;
+  static final int STATE_CHECKSUM = 3;
+
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int state = STATE_SYNC;
+    int length = 0;
+    int count = 0;
+    int sum = 0;
+    int frames = 0;
+    int bytes = 0;
+    int n, c;
+
+    for (n = 0; n < 400; n++)
+    {
+      c = next_byte(n);
+
+      if (state == STATE_SYNC)
+      {
+        if (c == 0x7e) { state = STATE_LENGTH; }
+      }
+        else
+      if (state == STATE_LENGTH)
+      {
+        if (c == 0 || c > 16) { state = STATE_SYNC; }
+        else { length = c; count = 0; sum = 0; state = STATE_PAYLOAD; }
+      }
+        else
+      if (state == STATE_PAYLOAD)
+      {
+        sum = (sum + c) & 0xff;
+        count++;
+        if (count == length) { state = STATE_CHECKSUM; }
+      }
+        else
+      {
+        if (c == sum) { frames++; bytes += length; }
+        state = STATE_SYNC;
+      }
+    }
+
+    return (frames << 8) | (bytes & 0xff);
+  }
+
+  // Frames of 20 bytes: sync, length 8, 8 payload bytes, checksum and
+  // then noise.  Every fifth frame has a bad checksum.
+  static public int next_byte(int n)
+  {
+    int frame = n / 20;
+    int offset = n % 20;
+    int k;
+    int sum = 0;
+
+    if (offset == 0) { return 0x7e; }
+    if (offset == 1) { return 8; }
+    if (offset < 10) { return (frame * 7 + offset * 13) & 0xff; }
+
+    if (offset == 10)
+    {
+      for (k = 2; k < 10; k++) { sum = (sum + ((frame * 7 + k * 13) & 0xff)) & 0xff; }
+      if (frame % 5 == 4) { sum = sum ^ 1; }
+      return sum;
+    }
+
+    return (offset * 29) & 0x7f;
+  }
+}
+
@@ -0,0 +1,55 @@
+
+import net.mikekohn.java_grinder.Memory;
+
+// 16 entry ring buffer of bytes in RAM with a producer that writes in
+// bursts and a consumer that drains a few at a time.
+
+public class BenchRing
+{
+  static final int SIZE = 16;
+
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int head = 0;
+    int tail = 0;
+    int count = 0;
+    int produced = 0;
+    int checksum = 0;
+    int n;
+
+    while (produced < 200)
+    {
+      for (n = 0; n < 5 && count < SIZE; n++)
+      {
+        Memory.write8(BenchRam.BASE + head, (byte)produced);
+        head = (head + 1) & (SIZE - 1);
+        count++;
+        produced++;
+      }
+
+      for (n = 0; n < 3 && count > 0; n++)
+      {
+        checksum = (checksum + (Memory.read8(BenchRam.BASE + tail) & 0xff)) & 0x7fff;
+        tail = (tail + 1) & (SIZE - 1);
+        count--;
+      }
+    }
+
+    while (count > 0)
+    {
+      checksum = (checksum + (Memory.read8(BenchRam.BASE + tail) & 0xff)) & 0x7fff;
+      tail = (tail + 1) & (SIZE - 1);
+      count--;
+    }
+
+    return checksum;
+  }
+}
+
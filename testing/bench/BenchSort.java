@@ -0,0 +1,51 @@
+
+import net.mikekohn.java_grinder.Memory;
+
+// Insertion sort of 32 16 bit values in RAM.
+
+public class BenchSort
+{
+  static final int COUNT = 32;
+
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int seed = 7;
+    int n, i, value, prev;
+    int checksum = 0;
+
+    for (n = 0; n < COUNT; n++)
+    {
+      seed = (seed * 109 + 89) & 0x7fff;
+      Memory.write16(BenchRam.BASE + n * 2, (short)(seed - 0x4000));
+    }
+
+    for (n = 1; n < COUNT; n++)
+    {
+      value = Memory.read16(BenchRam.BASE + n * 2);
+
+      for (i = n; i > 0; i--)
+      {
+        prev = Memory.read16(BenchRam.BASE + i * 2 - 2);
+        if (prev <= value) { break; }
+        Memory.write16(BenchRam.BASE + i * 2, (short)prev);
+      }
+
+      Memory.write16(BenchRam.BASE + i * 2, (short)value);
+    }
+
+    for (n = 0; n < COUNT; n++)
+    {
+      checksum = ((checksum << 1) ^ Memory.read16(BenchRam.BASE + n * 2)) & 0xffff;
+    }
+
+    return checksum;
+  }
+}
+
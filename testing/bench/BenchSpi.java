@@ -0,0 +1,58 @@
+
+import net.mikekohn.java_grinder.IOPort0;
+
+// Bit banged SPI mode 0 writes to a shift register on port 0: pin 0 is
+// SCK and pin 1 MOSI.  Returns how many 1 bits went out.
+
+public class BenchSpi
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+    int count = 0;
+
+    IOPort0.setPinsAsOutput(0x3);
+    IOPort0.setPinsValue(0);
+
+    for (n = 0; n < 16; n++)
+    {
+      count += send(n * 17);
+    }
+
+    return count;
+  }
+
+  static public int send(int data)
+  {
+    int bit;
+    int count = 0;
+
+    for (bit = 0; bit < 8; bit++)
+    {
+      if ((data & 0x80) != 0)
+      {
+        IOPort0.setPinsHigh(0x2);
+        count++;
+      }
+        else
+      {
+        IOPort0.setPinsLow(0x2);
+      }
+
+      IOPort0.setPinsHigh(0x1);
+      IOPort0.setPinsLow(0x1);
+
+      data = data << 1;
+    }
+
+    return count;
+  }
+}
+
@@ -0,0 +1,51 @@
+
+// Integer square root a bit at a time of every 97th number below 32768.
+
+public class BenchSqrt
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+    int sum = 0;
+
+    for (n = 0; n < 32768 - 97; n += 97)
+    {
+      sum += sqrt(n);
+    }
+
+    return sum;
+  }
+
+  static public int sqrt(int value)
+  {
+    int root = 0;
+    int bit = 0x4000;
+
+    while (bit > value) { bit = bit >> 2; }
+
+    while (bit != 0)
+    {
+      if (value >= root + bit)
+      {
+        value = value - (root + bit);
+        root = (root >> 1) + bit;
+      }
+        else
+      {
+        root = root >> 1;
+      }
+
+      bit = bit >> 2;
+    }
+
+    return root;
+  }
+}
+
@@ -0,0 +1,9 @@
+
+// Start of the RAM the benchmarks use for buffers on the dsPIC30F3012.
+// The stack goes up from 0x800.
+
+public class BenchRam
+{
+  static final int BASE = 0x0c00;
+}
+
@@ -0,0 +1,9 @@
+
+// Start of the RAM the benchmarks use for buffers on the MSP430FR5969.
+// The stack comes down from 0x2400.
+
+public class BenchRam
+{
+  static final int BASE = 0x1c00;
+}
+
@@ -0,0 +1,9 @@
+
+// Start of the RAM the benchmarks use for buffers on the PIC32MX250F128B
+// (kseg0).  The stack comes down from 0x80008000.
+
+public class BenchRam
+{
+  static final int BASE = 0x80000000;
+}
+
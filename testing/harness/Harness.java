@@ -0,0 +1,21 @@
+
+import java.lang.reflect.Method;
+
+import net.mikekohn.java_grinder.Trace;
+
+// Runs the test() method of a harness program on the host JVM with the
+// recording stubs in stubs/ ahead of JavaGrinder.jar on the classpath.
+// The target runs main() instead which calls test() and then loops.
+
+public class Harness
+{
+  static public void main(String args[]) throws Exception
+  {
+    Method test = Class.forName(args[0]).getMethod("test");
+    int result = ((Integer)test.invoke(null)).intValue();
+
+    Trace.dumpMemory();
+    System.out.println("Result: " + result);
+  }
+}
+
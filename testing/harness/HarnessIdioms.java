@@ -0,0 +1,45 @@
+// Sequences from the superoptimizer table: multiply by a constant, bit
+// fields and Math.abs, min and max.  Everything passed to Math stays in
+// 16 bits.
+
+public class HarnessIdioms
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int sum = 0;
+    int n;
+
+    for (n = -16000; n < 16000; n += 1231)
+    {
+      sum += mul_const(n) ^ bits(n);
+      sum += limits(n, 1000 - n);
+    }
+
+    sum += limits(-32768, 32767) + limits(32767, -32768);
+
+    return sum + bits(-1) + bits(-32768);
+  }
+
+  static public int mul_const(int n)
+  {
+    return n * 7 + n * 10 - n * 12 + n * 100 - n * -13 + n * 11 + n * -9 + n * 14;
+  }
+
+  static public int bits(int n)
+  {
+    return ((n >> 3) & 1) + ((n >>> 12) & 15) * 3 + ((n >> 8) & 255) -
+           ((n >> 1) & 0x7fff) + ((n >> 4) & 0x3f) + ((n >>> 15) & 1);
+  }
+
+  static public int limits(int a, int b)
+  {
+    return Math.abs(a) + Math.min(a, b) * 3 - Math.max(a, b) + Math.abs(b >> 1);
+  }
+}
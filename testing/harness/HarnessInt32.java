@@ -0,0 +1,118 @@
+// Values that don't fit in 16 bits.  The targets keep them in 2 words
+// where a compare needs the upper bits and use the low 16 bits anywhere
+// else so the sum still matches.
+
+public class HarnessInt32
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int sum = 0;
+    int n;
+
+    for (n = -3; n < 4; n++)
+    {
+      sum += over(n * 9000);
+      sum += under(n * 7000);
+      sum += param(n * 8000);
+    }
+
+    sum += count(20000, 30000);
+    sum += count(-30000, 25000) * 16;
+    sum += steps() * 256;
+    sum += unsigned_char((char)40000);
+    sum += unsigned_char((char)20000) * 2;
+    sum += bytes(0x5a) + bytes(0xa5);
+
+    return sum;
+  }
+
+  // n + 30000 can carry into the high word
+  static public int over(int n)
+  {
+    int big = n + 30000;
+    int flags = 0;
+
+    if (big > 40000) { flags += 1; }
+    if (big >= 100000) { flags += 2; }
+    if (big - 70000 < 0) { flags += 4; }
+    if (big != 48000) { flags += 8; }
+    if (big <= 65535) { flags += 16; }
+
+    return flags + big;
+  }
+
+  // n - 40000 can borrow from the high word
+  static public int under(int n)
+  {
+    int small = n - 40000;
+    int flags = 0;
+
+    if (small < -50000) { flags += 1; }
+    if (small > -40000) { flags += 2; }
+    if (small + 65536 >= 0) { flags += 4; }
+    if (small == -61000) { flags += 8; }
+
+    return flags + small;
+  }
+
+  // A parameter that gets bigger than 16 bits needs its high word when
+  // the method starts
+  static public int param(int n)
+  {
+    n = n + 40000;
+
+    if (n > 50000) { return 1; }
+    if (n < 20000) { return 2; }
+
+    return 3;
+  }
+
+  static public int count(int start, int step)
+  {
+    int total = start;
+    int n = 0;
+
+    while (total < 200000)
+    {
+      total += step;
+      n++;
+    }
+
+    return n;
+  }
+
+  // iinc of a local that holds 2 words
+  static public int steps()
+  {
+    int total;
+    int n = 0;
+
+    for (total = 0; total < 70000; total += 1000) { n++; }
+
+    return n;
+  }
+
+  // A char is 0 to 65535 so c + c can't be done as a signed 16 bit int
+  static public int unsigned_char(char c)
+  {
+    if (c + c > 65535) { return 1; }
+
+    return 0;
+  }
+
+  // Both sides of | and ^ are 0 to 255 so the targets can use byte ops
+  static public int bytes(int n)
+  {
+    int a = n & 0xff;
+    int b = (a | 0x0f) ^ 0x3c;
+
+    return (byte)(b & 0x7f) + (a ^ 0xff);
+  }
+}
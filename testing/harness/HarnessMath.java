@@ -0,0 +1,52 @@
+
+// Multiply, divide and method calls.  int is 16 bits on the targets so
+// everything here stays in range.
+
+public class HarnessMath
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+    int sum = 0;
+
+    for (n = 0; n < 10; n++)
+    {
+      sum = add_nums(sum, n * 3);
+    }
+
+    sum = sum * 7 + sum / 10 - sum % 10;
+    sum = (sum << 2) ^ (sum >> 1);
+
+    for (n = -32000; n < 31000; n += 997)
+    {
+      sum += div_const(n);
+    }
+
+    return sum + div_const(-32768);
+  }
+
+  // Division by constants that aren't a power of 2, once on their own
+  // and once as a quotient and remainder of the same value
+  static public int div_const(int n)
+  {
+    int q, r;
+
+    q = (n + 5) / 7;
+    r = (n + 5) % 7;
+
+    return q + r + n / 10 - n % 100 + n / -3 + n % 1000;
+  }
+
+  static public int add_nums(int a, int b)
+  {
+    return a + b;
+  }
+}
+
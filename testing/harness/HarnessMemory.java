@@ -0,0 +1,29 @@
+
+import net.mikekohn.java_grinder.Memory;
+
+// The addresses are in the MSP430's RAM so this one only runs there.
+
+public class HarnessMemory
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+
+    for (n = 0; n < 8; n++)
+    {
+      Memory.write8(0x300 + n, (byte)(n * 5));
+    }
+
+    Memory.write16(0x310, (short)0x1234);
+
+    return Memory.read8(0x302) + Memory.read16(0x310);
+  }
+}
+
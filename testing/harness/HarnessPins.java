@@ -0,0 +1,34 @@
+import net.mikekohn.java_grinder.IOPort0;
+
+// Port writes without SPI so it runs on every CPU including PIC32.
+
+public class HarnessPins
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+    int count = 0;
+
+    IOPort0.setPinsAsOutput(0x0f);
+
+    for (n = 0; n < 8; n++)
+    {
+      IOPort0.setPinsValue(n);
+      count += n * n;
+    }
+
+    IOPort0.setPinsHigh(0x09);
+    IOPort0.setPinsLow(0x03);
+    IOPort0.setPinsAsInput(0x0c);
+
+    return count;
+  }
+}
+
@@ -0,0 +1,34 @@
+
+import net.mikekohn.java_grinder.IOPort0;
+import net.mikekohn.java_grinder.SPI0;
+
+public class HarnessPorts
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int n;
+    int count = 0;
+
+    IOPort0.setPinsAsOutput(0x18);
+    SPI0.init(SPI0.DIV128, 0);
+
+    for (n = 0; n < 5; n++)
+    {
+      IOPort0.setPinsValue(n << 3);
+      count += SPI0.send('A' + n);
+    }
+
+    IOPort0.setPinsHigh(0x10);
+    IOPort0.setPinsLow(0x08);
+
+    return count;
+  }
+}
+
@@ -0,0 +1,44 @@
+
+// Expressions deep enough that the operand stack runs out of registers
+// and locals have to be pushed onto the hardware stack.
+
+public class HarnessSpill
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int sum = 0;
+
+    sum += spill(0);
+    sum += spill(1);
+    sum += spill(-5);
+    sum += spill(300);
+    sum += spill(0x1234);
+
+    return sum;
+  }
+
+  static public int spill(int x)
+  {
+    int a1 = x ^ 7;
+    int a2 = x ^ 14;
+    int a3 = x ^ 21;
+    int a4 = x ^ 28;
+    int a5 = x ^ 35;
+    int a6 = x ^ 42;
+    int a7 = x ^ 49;
+    int a8 = x ^ 56;
+    int a9 = x ^ 63;
+    int t;
+
+    // Each local is loaded before anything is added so the stack is ten
+    // deep at the end, and the assignment dups with the stack spilled.
+    return a1 + (a2 ^ (a3 + (a4 ^ (a5 + (a6 ^ (a7 + (a8 ^ (a9 + (t = a1 - a9)))))))));
+  }
+}
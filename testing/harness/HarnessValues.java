@@ -0,0 +1,45 @@
+// Expressions that get computed more than once.  The second time can be
+// copied from a local or the stack but only while nothing changed what
+// they were computed from.
+
+public class HarnessValues
+{
+  static public void main(String args[])
+  {
+    test();
+
+    while(true);
+  }
+
+  static public int test()
+  {
+    int sum = 0;
+    int n;
+
+    for (n = 0; n < 6; n++)
+    {
+      sum += values(n, 7 - n);
+    }
+
+    return sum;
+  }
+
+  static public int values(int x, int y)
+  {
+    int a = x + 23;
+    int b = (x + 23) * y;
+    int d = b - y;
+    int c;
+
+    if (y > 3) { c = b + 1; x++; }
+    else { c = b - 1; }
+
+    // b - y is the same on both paths but x changed on one of them so
+    // x + 23 has to be done again
+    c += (x + 23) + (b ^ y) + (b - y) * d;
+    a = a - (b ^ y);
+    y = y << 2;
+
+    return a + b + c + (y << 2) + (x + 23) * 3;
+  }
+}
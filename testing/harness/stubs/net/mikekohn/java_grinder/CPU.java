@@ -0,0 +1,27 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+public class CPU
+{
+  private CPU()
+  {
+  }
+
+  public static void setClock16()
+  {
+  }
+
+  public static void nop()
+  {
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+// The simulators read back 0 from input pins so the host does too.
+
+abstract public class IOPort
+{
+  static int dir[] = new int[6];
+  static int out[] = new int[6];
+
+  protected IOPort()
+  {
+  }
+
+  static void setPinsAsInput(int port, int mask)
+  {
+    dir[port] &= ~mask;
+    Trace.port(port, "DIR", dir[port]);
+  }
+
+  static void setPinsAsOutput(int port, int mask)
+  {
+    dir[port] |= mask;
+    Trace.port(port, "DIR", dir[port]);
+  }
+
+  static void setPinsValue(int port, int value)
+  {
+    out[port] = value;
+    Trace.port(port, "OUT", out[port]);
+  }
+
+  static void setPinsHigh(int port, int mask)
+  {
+    out[port] |= mask;
+    Trace.port(port, "OUT", out[port]);
+  }
+
+  static void setPinsLow(int port, int mask)
+  {
+    out[port] &= ~mask;
+    Trace.port(port, "OUT", out[port]);
+  }
+
+  static boolean isPinInputHigh(int port, int pin)
+  {
+    return false;
+  }
+
+  static int getPortInputValue(int port)
+  {
+    return 0;
+  }
+}
@@ -0,0 +1,31 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+public class IOPort2 extends IOPort
+{
+  protected IOPort2()
+  {
+  }
+
+  public static void setPinsAsInput(int mask) { setPinsAsInput(2, mask); }
+  public static void setPinsAsOutput(int mask) { setPinsAsOutput(2, mask); }
+  public static void setPinsValue(int value) { setPinsValue(2, value); }
+  public static void setPinsHigh(int mask) { setPinsHigh(2, mask); }
+  public static void setPinsLow(int mask) { setPinsLow(2, mask); }
+  public static void setPinAsOuput(int pin) { setPinsAsOutput(2, 1 << pin); }
+  public static void setPinAsInput(int pin) { setPinsAsInput(2, 1 << pin); }
+  public static void setPinHigh(int pin) { setPinsHigh(2, 1 << pin); }
+  public static void setPinLow(int pin) { setPinsLow(2, 1 << pin); }
+  public static boolean isPinInputHigh(int pin) { return isPinInputHigh(2, pin); }
+  public static int getPortInputValue() { return getPortInputValue(2); }
+}
@@ -0,0 +1,31 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+public class IOPort4 extends IOPort
+{
+  protected IOPort4()
+  {
+  }
+
+  public static void setPinsAsInput(int mask) { setPinsAsInput(4, mask); }
+  public static void setPinsAsOutput(int mask) { setPinsAsOutput(4, mask); }
+  public static void setPinsValue(int value) { setPinsValue(4, value); }
+  public static void setPinsHigh(int mask) { setPinsHigh(4, mask); }
+  public static void setPinsLow(int mask) { setPinsLow(4, mask); }
+  public static void setPinAsOuput(int pin) { setPinsAsOutput(4, 1 << pin); }
+  public static void setPinAsInput(int pin) { setPinsAsInput(4, 1 << pin); }
+  public static void setPinHigh(int pin) { setPinsHigh(4, 1 << pin); }
+  public static void setPinLow(int pin) { setPinsLow(4, 1 << pin); }
+  public static boolean isPinInputHigh(int pin) { return isPinInputHigh(4, pin); }
+  public static int getPortInputValue() { return getPortInputValue(4); }
+}
@@ -0,0 +1,31 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+public class IOPort5 extends IOPort
+{
+  protected IOPort5()
+  {
+  }
+
+  public static void setPinsAsInput(int mask) { setPinsAsInput(5, mask); }
+  public static void setPinsAsOutput(int mask) { setPinsAsOutput(5, mask); }
+  public static void setPinsValue(int value) { setPinsValue(5, value); }
+  public static void setPinsHigh(int mask) { setPinsHigh(5, mask); }
+  public static void setPinsLow(int mask) { setPinsLow(5, mask); }
+  public static void setPinAsOuput(int pin) { setPinsAsOutput(5, 1 << pin); }
+  public static void setPinAsInput(int pin) { setPinsAsInput(5, 1 << pin); }
+  public static void setPinHigh(int pin) { setPinsHigh(5, 1 << pin); }
+  public static void setPinLow(int pin) { setPinsLow(5, 1 << pin); }
+  public static boolean isPinInputHigh(int pin) { return isPinInputHigh(5, pin); }
+  public static int getPortInputValue() { return getPortInputValue(5); }
+}
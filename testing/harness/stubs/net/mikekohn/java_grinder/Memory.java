@@ -0,0 +1,42 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+// Both CPUs are little endian.
+
+public class Memory
+{
+  private Memory()
+  {
+  }
+
+  public static byte read8(int address)
+  {
+    return (byte)Trace.read8(address);
+  }
+
+  public static void write8(int address, byte value)
+  {
+    Trace.write8(address, value);
+  }
+
+  public static short read16(int address)
+  {
+    return (short)(Trace.read8(address) | (Trace.read8(address + 1) << 8));
+  }
+
+  public static void write16(int address, short value)
+  {
+    Trace.write8(address, value);
+    Trace.write8(address + 1, value >> 8);
+  }
+}
@@ -0,0 +1,44 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+// The simulators tie MISO to MOSI so whatever is sent comes back.
+
+abstract public class SPI
+{
+  static public final int DIV1 = 0;
+  static public final int DIV2 = 1;
+  static public final int DIV4 = 2;
+  static public final int DIV8 = 3;
+  static public final int DIV16 = 4;
+  static public final int DIV32 = 5;
+  static public final int DIV64 = 6;
+  static public final int DIV128 = 7;
+
+  static int received[] = new int[2];
+
+  protected SPI()
+  {
+  }
+
+  static int send(int index, int c)
+  {
+    Trace.event(String.format("SPI%d 0x%02x", index, c & 0xff));
+    received[index] = c & 0xff;
+    return received[index];
+  }
+
+  static int read(int index)
+  {
+    return received[index];
+  }
+}
@@ -0,0 +1,27 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+public class SPI1 extends SPI
+{
+  public SPI1()
+  {
+  }
+
+  public static void init(int clock_divisor, int mode) { }
+  public static int send(int c) { return send(1, c); }
+  public static int read() { return read(1); }
+  public static boolean isDataAvailable() { return true; }
+  public static boolean isBusy() { return false; }
+  public static void disable() { }
+  public static void enable() { }
+}
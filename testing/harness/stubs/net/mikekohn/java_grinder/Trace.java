@@ -0,0 +1,58 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+import java.util.TreeMap;
+
+// Host side stand-ins for the java_grinder API record what a program
+// does to the hardware so scripts/harness.py can compare it with what
+// the simulator saw.  Every event is one line on stdout.
+
+public class Trace
+{
+  static TreeMap<Integer,Integer> memory = new TreeMap<Integer,Integer>();
+
+  private Trace()
+  {
+  }
+
+  static void event(String text)
+  {
+    System.out.println(text);
+  }
+
+  static void port(int port, String name, int value)
+  {
+    event(String.format("PORT%d %s=0x%04x", port, name, value & 0xffff));
+  }
+
+  static void write8(int address, int value)
+  {
+    memory.put(address & 0xffff, value & 0xff);
+  }
+
+  static int read8(int address)
+  {
+    Integer value = memory.get(address & 0xffff);
+
+    return value == null ? 0 : value;
+  }
+
+  /** Print the final value of every byte written through Memory */
+  public static void dumpMemory()
+  {
+    for (Integer address : memory.keySet())
+    {
+      event(String.format("Memory 0x%04x = 0x%02x", address, memory.get(address)));
+    }
+  }
+}
@@ -0,0 +1,26 @@
+/**
+ *  Java Grinder
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: http://www.naken.cc/
+ * License: GPL
+ *
+ * Copyright 2014 by Michael Kohn
+ *
+ */
+
+package net.mikekohn.java_grinder;
+
+// Neither simulator has a UART yet so these events are only listed.
+
+abstract public class UART
+{
+  protected UART()
+  {
+  }
+
+  static void send(int index, byte c)
+  {
+    Trace.event(String.format("UART%d 0x%02x", index, c & 0xff));
+  }
+}